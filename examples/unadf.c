@@ -71,7 +71,6 @@ int utimeWin32( const char * const            pathname,
 #endif  // WIN32
 
 #define UNADF_VERSION       ADFLIB_VERSION
-#define EXTRACT_BUFFER_SIZE 8192
 
 /* command-line arguments */
 bool list_mode     = false,
@@ -488,7 +487,6 @@ void extract_filepath(struct AdfVolume *vol, char *filepath)
 void extract_file(struct AdfVolume *vol, char *filename, char *out, mode_t perms)
 {
     struct AdfFile *f = NULL;
-    uint8_t buf[EXTRACT_BUFFER_SIZE];
     int fd = 0;
 
     if ((f = adfFileOpen(vol, filename, ADF_FILE_MODE_READ)) == NULL)  {
@@ -518,19 +516,11 @@ void extract_file(struct AdfVolume *vol, char *filename, char *out, mode_t perms
         }
     }
 
-    /* copy from volume to local file until EOF */
-    while (!adfFileAtEOF(f)) {
-        unsigned n = adfFileRead(f, sizeof(buf), buf);
-        if (n != sizeof(buf) && !adfFileAtEOF(f)) {
-            fprintf(stderr, "%s: error reading %s at %u\n",
-                adf_file, filename, adfFileGetPos(f));
-            goto error_handler;
-        }
-
-        if (write(fd, buf, n) != n) {
-            print_error(out);
-            goto error_handler;
-        }
+    /* copy from volume to local file */
+    if (adfFileExportToFd(f, fd) != ADF_RC_OK) {
+        fprintf(stderr, "%s: error extracting %s to %s\n",
+            adf_file, filename, out);
+        goto error_handler;
     }
 
 error_handler:
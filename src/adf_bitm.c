@@ -27,31 +27,104 @@
 #include "adf_byteorder.h"
 #include "adf_cache.h"
 //#include "adf_debug.h"
+#include "adf_dev.h"
+#include "adf_dev_driver.h"
 #include "adf_dir.h"
 #include "adf_env.h"
 #include "adf_file_block.h"
 #include "adf_raw.h"
+#include "adf_thread.h"
 #include "adf_util.h"
 #include "adf_vector.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
 
 #define CHECK_NONZERO_BMPAGES_BEYOND_BMSIZE 0
 
 extern uint32_t bitMask[ 32 ];
 
-static ADF_RETCODE adfBitmapListSetUsed( struct AdfVolume * const      vol,
-                                         const struct AdfList * const  list );
+/* state of a (possibly multithreaded) scan of the directory tree,
+   building a map of used blocks (see adfBitmapMapBuild) */
+struct AdfBitmapScan {
+    struct AdfVolume *  vol;
+    struct AdfMutex *   lock;
+    struct AdfCond *    cond;
+
+    ADF_SECTNUM *       chains;      /* stack of hash chains (1st blocks) to process */
+    unsigned            nChains,
+                        chainsSize;
+    unsigned            nBusy;       /* workers currently processing a chain */
+
+    uint32_t **         maps;        /* a private map for each worker */
+    unsigned            nMaps,
+                        nWorkers;    /* workers started */
+    uint32_t *          dirs;        /* directories already seen (shared) */
+
+    int                 hostFd;      /* to read blocks with pread() (without
+                                        the device I/O lock), -1 if none */
+    ADF_RETCODE         rc;
+};
+
+static ADF_RETCODE adfBitmapMapBuild( struct AdfVolume * const           vol,
+                                      const struct AdfRootBlock * const  root,
+                                      const unsigned                     nThreads,
+                                      uint32_t * const                   map );
+
+static void adfBitmapScanWorker( void * const  scanArg );
+
+static ADF_RETCODE adfBitmapScanPushChains( struct AdfBitmapScan * const  scan,
+                                            const int32_t                 hashTable[] );
+
+static ADF_RETCODE adfBitmapChainSetUsed( struct AdfBitmapScan * const  scan,
+                                          uint32_t * const              map,
+                                          ADF_SECTNUM                   sector );
+
+static int adfBitmapScanHostFd_( struct AdfDevice * const  dev );
+
+static ADF_RETCODE adfBitmapScanReadBlock_( const struct AdfBitmapScan * const  scan,
+                                            const ADF_SECTNUM                   nSect,
+                                            uint8_t * const                     buf,
+                                            const AdfStatsBlockType             type );
+
+static bool adfBitmapMapSetUsed( const struct AdfVolume * const  vol,
+                                 uint32_t * const                map,
+                                 const ADF_SECTNUM               nSect );
+
+static bool adfBitmapMapIsFree( const uint32_t * const  map,
+                                const ADF_SECTNUM       nSect );
 
 static ADF_RETCODE adfBitmapFileBlocksSetUsed(
-    struct AdfVolume * const                 vol,
+    const struct AdfBitmapScan * const       scan,
+    uint32_t * const                         map,
     const struct AdfFileHeaderBlock * const  fhBlock );
 
 static ADF_RETCODE adfBitmapDirCacheSetUsed(
-    struct AdfVolume * const  vol,
-    ADF_SECTNUM               dCacheBlockNum );
+    const struct AdfBitmapScan * const  scan,
+    uint32_t * const                    map,
+    ADF_SECTNUM                         dCacheBlockNum );
+
+static ADF_RETCODE adfBitmapMapCommit( struct AdfVolume * const  vol,
+                                       const uint32_t * const    map );
+
+static uint32_t * adfBitmapMapCreate( const struct AdfVolume * const  vol );
+
+static struct AdfBitmapBlock * adfBitmapGetPage_( struct AdfVolume * const  vol,
+                                                  const unsigned            page );
+
+static ADF_RETCODE adfBitmapReadExtPointers_( struct AdfVolume * const  vol );
+
+static ADF_RETCODE adfBitmapLoadPages_( struct AdfVolume * const  vol );
+
+static ADF_RETCODE adfBitmapBlockDecode_( const struct AdfVolume * const  vol,
+                                          const ADF_SECTNUM               nSect,
+                                          const uint8_t * const           buf,
+                                          struct AdfBitmapBlock * const   bitm );
 
 static uint32_t nBlock2bitmapSize( uint32_t  nBlock );
 
@@ -89,7 +162,8 @@ ADF_RETCODE adfCreateBitmap( struct AdfVolume * const  vol )
     if ( rc != ADF_RC_OK )
         return rc;
 
-    for ( int i = vol->firstBlock + 2; i <= vol->lastBlock - vol->firstBlock; i++ )
+    /* block numbers in the bitmap are relative to the volume */
+    for ( int i = 2; i <= vol->lastBlock - vol->firstBlock; i++ )
         adfSetBlockFree( vol, i );
 
     return rc;
@@ -105,6 +179,8 @@ ADF_RETCODE adfBitmapAllocate( struct AdfVolume * const  vol )
 {
     vol->bitmap.size = nBlock2bitmapSize(
         adfVolGetSizeInBlocksWithoutBootblock( vol ) );
+    vol->bitmap.extBlock = 0;
+    vol->bitmap.updatesDeferred = 0;
 
     vol->bitmap.table = (struct AdfBitmapBlock**)
         malloc( sizeof(struct AdfBitmapBlock *) * vol->bitmap.size );
@@ -158,9 +234,13 @@ ADF_RETCODE adfBitmapAllocate( struct AdfVolume * const  vol )
  */
 void adfFreeBitmap( struct AdfVolume * const  vol )
 {
-    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ )
-        free( vol->bitmap.table[ i ] );
+    if ( vol->bitmap.table != NULL ) {
+        for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ )
+            free( vol->bitmap.table[ i ] );
+    }
     vol->bitmap.size = 0;
+    vol->bitmap.extBlock = 0;
+    vol->bitmap.updatesDeferred = 0;
 
     free( vol->bitmap.table );
     vol->bitmap.table = NULL;
@@ -176,61 +256,57 @@ void adfFreeBitmap( struct AdfVolume * const  vol )
 /*
  * adfReadBitmap
  *
+ * Sets up the bitmap of a mounted volume: allocates the table of pages and
+ * gets pointers to the pages from the root block. The pages themselves
+ * (and pointers stored in bitmap extension blocks) are read only when needed
+ * (see adfBitmapGetPage_() and adfBitmapLoad()).
  */
 ADF_RETCODE adfReadBitmap( struct AdfVolume * const           vol,
                            const struct AdfRootBlock * const  root )
 {
-    ADF_RETCODE rc = ADF_RC_OK;
+    vol->bitmap.size = nBlock2bitmapSize(
+        adfVolGetSizeInBlocksWithoutBootblock( vol ) );
 
-    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ ) {
-        vol->bitmap.blocksChg[ i ] = false;
+    vol->bitmap.table = (struct AdfBitmapBlock **)
+        calloc( vol->bitmap.size, sizeof(struct AdfBitmapBlock *) );
+    vol->bitmap.blocks = (ADF_SECTNUM *)
+        calloc( vol->bitmap.size, sizeof(ADF_SECTNUM) );
+    vol->bitmap.blocksChg = (bool *) calloc( vol->bitmap.size, sizeof(bool) );
+    if ( vol->bitmap.table == NULL ||
+         vol->bitmap.blocks == NULL ||
+         vol->bitmap.blocksChg == NULL )
+    {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        adfFreeBitmap( vol );
+        return ADF_RC_MALLOC;
     }
+    vol->bitmap.updatesDeferred = 0;
 
-    uint32_t j = 0,
-             i = 0;
+    uint32_t i = 0;
     /* bitmap pointers in rootblock : 0 <= i < ADF_BM_PAGES_ROOT_SIZE */
-    ADF_SECTNUM bmSect;
     while ( i < vol->bitmap.size &&
             i < ADF_BM_PAGES_ROOT_SIZE &&
             root->bmPages[ i ] != 0 )
     {
-        vol->bitmap.blocks[ j ] = bmSect = root->bmPages[ i ];
+        const ADF_SECTNUM bmSect = root->bmPages[ i ];
         if ( ! adfVolIsSectNumValid( vol, bmSect ) ) {
             adfEnv.wFct( "%s: sector %d out of range, root bm[%u]",
                          __func__, bmSect, i );
             adfFreeBitmap( vol );
             return ADF_RC_ERROR;
         }
-
-        rc = adfReadBitmapBlock( vol, bmSect, vol->bitmap.table[ j ] );
-        if ( rc != ADF_RC_OK ) {
-            adfFreeBitmap( vol );
-            return rc;
-        }
-        j++;
+        vol->bitmap.blocks[ i ] = bmSect;
         i++;
     }
 
     /* state validity checks */
     assert ( i <= ADF_BM_PAGES_ROOT_SIZE );
 
-    assert ( ( i < vol->bitmap.size &&
-               root->bmPages[ i ] != 0 ) ||
-             ( i == vol->bitmap.size ) );
-
     // some images fail on this, https://github.com/adflib/ADFlib/issues/63
     //   assert ( ( i == vol->bitmap.size && root->bmPages[i] == 0 ) ||
     //            ( i < vol->bitmap.size ) );
 
-    assert ( ( i < vol->bitmap.size &&
-               root->bmExt != 0 ) ||
-             ( i == vol->bitmap.size ) );
-
-    assert ( ( i == vol->bitmap.size &&
-               root->bmExt == 0 ) ||
-             ( i < vol->bitmap.size ) );
-
-    if  ( i < vol->bitmap.size  &&  root->bmPages[i] == 0 ) {
+    if  ( i < vol->bitmap.size  &&  i < ADF_BM_PAGES_ROOT_SIZE ) {
         adfEnv.eFct( "%s: root bmpages[%u] == 0, "
                      "but vol. %s should have %u bm sectors",
                      __func__, i, vol->volName, vol->bitmap.size );
@@ -251,49 +327,20 @@ ADF_RETCODE adfReadBitmap( struct AdfVolume * const           vol,
         __func__, i, vol->bitmap.size, root->bmPages );
 #endif
 
-    if ( root->bmExt == 0 )
-        return rc;
+    vol->bitmap.extBlock = ( i < vol->bitmap.size ) ? root->bmExt : 0;
 
-    struct AdfBitmapExtBlock bmExt;
-    ADF_SECTNUM bmExtSect = root->bmExt;
-#if CHECK_NONZERO_BMPAGES_BEYOND_BMSIZE == 1
-    unsigned bmExt_i = 0;
-#endif
-    while ( bmExtSect != 0 ) {
-        /* bitmap pointers in bitmapExtBlock, j <= mapSize */
-        rc = adfReadBitmapExtBlock( vol, bmExtSect, &bmExt );
-        if ( rc != ADF_RC_OK ) {
-            adfFreeBitmap( vol );
-            return rc;
-        }
-        i = 0;
-        while ( i < ADF_BM_PAGES_EXT_SIZE && j < vol->bitmap.size ) {
-            bmSect = bmExt.bmPages[ i ];
-            if ( ! adfVolIsSectNumValid( vol, bmSect ) ) {
-                adfEnv.wFct( "%s: sector %d out of range, "
-                             "bmext %d bmpages[%u]",
-                             __func__, bmSect, bmExtSect, i );
-                return ADF_RC_ERROR;
-            }
-            vol->bitmap.blocks[ j ] = bmSect;
-
-            rc = adfReadBitmapBlock( vol, bmSect, vol->bitmap.table[ j ] );
-            if ( rc != ADF_RC_OK ) {
-                adfFreeBitmap( vol );
-                return rc;
-            }
-            i++; j++;
-        }
+    return ADF_RC_OK;
+}
 
-#if CHECK_NONZERO_BMPAGES_BEYOND_BMSIZE == 1
-        checkNonzeroBMpagesBeyondBMsizeExt(
-            __func__, i, bmExt_i, bmExtSect, vol->bitmap.size, bmExt.bmPages );
-        bmExt_i++;
-#endif
-        bmExtSect = bmExt.nextBlock;
-    }
 
-    return rc;
+/*
+ * adfBitmapLoad
+ *
+ * read all bitmap pages not read yet
+ */
+ADF_RETCODE adfBitmapLoad( struct AdfVolume * const  vol )
+{
+    return adfBitmapLoadPages_( vol );
 }
 
 
@@ -307,6 +354,9 @@ ADF_RETCODE adfUpdateBitmap( struct AdfVolume * const  vol )
 
 /*printf("adfUpdateBitmap\n");*/
 
+    if ( vol->bitmap.updatesDeferred > 0 )
+        return ADF_RC_OK;
+
     ADF_RETCODE rc = adfReadRootBlock( vol, (uint32_t) vol->rootBlock, &root );
     if ( rc != ADF_RC_OK )
         return rc;
@@ -328,7 +378,58 @@ ADF_RETCODE adfUpdateBitmap( struct AdfVolume * const  vol )
 
     root.bmFlag = ADF_BM_VALID;
     adfTime2AmigaTime( adfGiveCurrentTime(), &root.days, &root.mins, &root.ticks );
-    return adfWriteRootBlock( vol, (uint32_t) vol->rootBlock, &root );
+    rc = adfWriteRootBlock( vol, (uint32_t) vol->rootBlock, &root );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    /* (the end of a metadata change) */
+    return adfDevSyncPoint( vol->dev, ADF_SYNC_METADATA );
+}
+
+
+/*
+ * adfBitmapDeferUpdates
+ *
+ * Starts (or nests) a batch of changes of the volume: until the matching
+ * adfBitmapCommit(), adfUpdateBitmap() does not write anything, so that
+ * the bitmap blocks changed by all operations in the batch are written once.
+ *
+ * The bitmap on the disk is marked invalid for the time of the batch
+ * (as it is while writing it), so if the batch is not completed, AmigaOS
+ * rebuilds the bitmap on validation.
+ */
+ADF_RETCODE adfBitmapDeferUpdates( struct AdfVolume * const  vol )
+{
+    if ( vol->bitmap.updatesDeferred == 0 ) {
+        struct AdfRootBlock root;
+        ADF_RETCODE rc = adfReadRootBlock( vol, (uint32_t) vol->rootBlock, &root );
+        if ( rc != ADF_RC_OK )
+            return rc;
+
+        root.bmFlag = ADF_BM_INVALID;
+        rc = adfWriteRootBlock( vol, (uint32_t) vol->rootBlock, &root );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+    vol->bitmap.updatesDeferred++;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfBitmapCommit
+ *
+ * ends a batch started with adfBitmapDeferUpdates(); on the end of
+ * the outermost one the bitmap is written (adfUpdateBitmap())
+ */
+ADF_RETCODE adfBitmapCommit( struct AdfVolume * const  vol )
+{
+    if ( vol->bitmap.updatesDeferred == 0 ) {
+        adfEnv.wFct( "%s: no bitmap updates deferred", __func__ );
+        return adfUpdateBitmap( vol );
+    }
+    vol->bitmap.updatesDeferred--;
+    return adfUpdateBitmap( vol );
 }
 
 
@@ -390,9 +491,10 @@ ADF_RETCODE adfWriteNewBitmap( struct AdfVolume * const  vol )
         root.bmExt = bitExtBlock[ k ];
         struct AdfBitmapExtBlock bitme;
         while ( nBlock < vol->bitmap.size ) {
+            memset( &bitme, 0, sizeof(struct AdfBitmapExtBlock) );
             int i = 0;
             while ( i < ADF_BM_PAGES_EXT_SIZE && nBlock < vol->bitmap.size ) {
-                bitme.bmPages[ i ] = vol->bitmap.blocks[ nBlock ] = sectList[ i ];
+                bitme.bmPages[ i ] = vol->bitmap.blocks[ nBlock ] = sectList[ nBlock ];
                 i++;
                 nBlock++;
             }
@@ -425,12 +527,34 @@ ADF_RETCODE adfWriteNewBitmap( struct AdfVolume * const  vol )
 ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
                                   const struct AdfRootBlock * const  root )
 {
-    ADF_RETCODE rc = ADF_RC_OK;
+    return adfReconstructBitmapParallel( vol, root, 1 );
+}
 
-    // all bitmap blocks are to update (to improve/optimize, ie. compare with existing)
-    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ ) {
-        vol->bitmap.blocksChg[ i ] = true;
-    }
+
+/*
+ * adfReconstructBitmapParallel
+ *
+ * The new map is built in a private buffer (initially: all blocks free)
+ * during a single traversal of the directory tree, in which every entry
+ * block is read only once. The result is compared with the bitmap blocks
+ * on the disk and only those which differ are marked as changed (to be
+ * written by adfUpdateBitmap()).
+ *
+ * The traversal is shared by nThreads workers (see adfBitmapMapBuild);
+ * with a driver giving a host fd (dump, native) they read blocks with
+ * pread(), in parallel - otherwise, reads are serialized by the device
+ * I/O lock.
+ */
+ADF_RETCODE adfReconstructBitmapParallel(
+    struct AdfVolume * const           vol,
+    const struct AdfRootBlock * const  root,
+    const unsigned                     nThreads )
+{
+    uint32_t * const map = adfBitmapMapCreate( vol );
+    if ( map == NULL )
+        return ADF_RC_MALLOC;
+
+    ADF_RETCODE rc = ADF_RC_OK;
 
     uint32_t i = 0,
              j = 0;
@@ -445,14 +569,9 @@ ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
             adfEnv.wFct( "%s: sector %d out of range, root bm[%u]",
                          __func__, bmSect, i );
             adfFreeBitmap( vol );
-            return ADF_RC_ERROR;
+            rc = ADF_RC_ERROR;
+            goto free_map;
         }
-
-        //rc = adfReadBitmapBlock ( vol, nSect, vol->bitmapTable[j] );
-        //if ( rc != ADF_RC_OK ) {
-        //    adfFreeBitmap(vol);
-        //    return rc;
-        //}
         j++;
         i++;
     }
@@ -483,7 +602,8 @@ ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
                      "but vol. %s should have %u bm sectors",
                      __func__, i, vol->volName, vol->bitmap.size );
         adfFreeBitmap( vol );
-        return ADF_RC_ERROR;
+        rc = ADF_RC_ERROR;
+        goto free_map;
     }
 
     if ( i < vol->bitmap.size  &&  root->bmExt == 0 ) {
@@ -491,7 +611,8 @@ ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
                      "%u total to read, but root->bmExt is 0",
                      __func__, i, ADF_BM_PAGES_ROOT_SIZE, vol->bitmap.size );
         adfFreeBitmap( vol );
-        return ADF_RC_ERROR;
+        rc = ADF_RC_ERROR;
+        goto free_map;
     }
 
 #if CHECK_NONZERO_BMPAGES_BEYOND_BMSIZE == 1
@@ -510,8 +631,9 @@ ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
         rc = adfReadBitmapExtBlock( vol, bmExtSect, &bmExtBlock );
         if ( rc != ADF_RC_OK ) {
             adfFreeBitmap( vol );
-            return rc;
+            goto free_map;
         }
+
         i = 0;
         while ( i < ADF_BM_PAGES_EXT_SIZE && j < vol->bitmap.size ) {
             const ADF_SECTNUM bmBlkPtr = bmExtBlock.bmPages[ i ];
@@ -520,15 +642,10 @@ ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
                              "bmext %d bmpages[%u]",
                              __func__, bmBlkPtr, bmExtSect, i );
                 adfFreeBitmap( vol );
-                return ADF_RC_ERROR;
+                rc = ADF_RC_ERROR;
+                goto free_map;
             }
             vol->bitmap.blocks[ j ] = bmBlkPtr;
-
-            //rc = adfReadBitmapBlock ( vol, nSect, vol->bitmapTable[j] );
-            //if ( rc != ADF_RC_OK ) {
-            //    adfFreeBitmap(vol);
-            //    return rc;
-            //}
             i++; j++;
         }
 
@@ -540,53 +657,108 @@ ADF_RETCODE adfReconstructBitmap( struct AdfVolume * const           vol,
         bmExtSect = bmExtBlock.nextBlock;
     }
 
-    // initially - set all free
-    for ( int32_t i = 2 ;
-          i < vol->lastBlock - vol->firstBlock ;   // CHECK UPPER COND
-          i++ )
-    {
-        adfSetBlockFree( vol, i );
-    }
+    rc = adfBitmapMapBuild( vol, root, nThreads, map );
+    if ( rc != ADF_RC_OK )
+        goto free_map;
 
-    // then - mark all used blocks
+    rc = adfBitmapMapCommit( vol, map );
 
-    // mark rootblock
-    adfSetBlockUsed( vol, vol->rootBlock );
+free_map:
+    free( map );
+    return rc;
+}
 
-    // mark bitmap blocks (all - from rootblock and bitmap ext. blocks)
-    for ( uint32_t i = 0 ; i < vol->bitmap.size ; i++ ) {
-        //if ( vol->bitmapBlocks[i] > 0 )  -- this should always be TRUE
-        adfSetBlockUsed( vol, vol->bitmap.blocks[ i ] );
+
+/*
+ * adfVerifyBitmap
+ *
+ * Compares the volume's bitmap (as it is in memory) with blocks
+ * actually referenced by the filesystem structures. Nothing is written.
+ */
+ADF_RETCODE adfVerifyBitmap( struct AdfVolume * const       vol,
+                             const unsigned                 nThreads,
+                             struct AdfBitmapCheck * const  check )
+{
+    check->usedUnreferenced = adfVectorSectorsCreate( 0 );
+    check->referencedFree   = adfVectorSectorsCreate( 0 );
+
+    if ( ! vol->mounted || vol->bitmap.size < 1 ) {
+        adfEnv.eFct( "%s: volume not mounted", __func__ );
+        return ADF_RC_ERROR;
     }
 
-    // traverse all files and directories
+    /* all pages are compared (and their pointers needed to build the map) */
+    ADF_RETCODE rc = adfBitmapLoad( vol );
+    if ( rc != ADF_RC_OK )
+        return rc;
 
-    struct AdfDirBlock //AdfEntryBlock
-        rootDirBlock;
-    rc = adfReadEntryBlock( vol, vol->rootBlock,
-                            ( struct AdfEntryBlock * ) &rootDirBlock );
-    if ( rc != ADF_RC_OK ) {
-        adfEnv.eFct( "%s: error reading directory entry block (%d)\n",
-                     __func__, vol->rootBlock );
+    struct AdfRootBlock root;
+    rc = adfReadRootBlock( vol, (uint32_t) vol->rootBlock, &root );
+    if ( rc != ADF_RC_OK )
         return rc;
+
+    uint32_t * const map = adfBitmapMapCreate( vol );
+    if ( map == NULL )
+        return ADF_RC_MALLOC;
+
+    rc = adfBitmapMapBuild( vol, &root, nThreads, map );
+    if ( rc != ADF_RC_OK )
+        goto free_map;
+
+    const ADF_SECTNUM volLastBlock = vol->lastBlock - vol->firstBlock;
+
+    /* count first... */
+    unsigned nUsedUnreferenced = 0,
+             nReferencedFree   = 0;
+    for ( ADF_SECTNUM nSect = 2 ; nSect <= volLastBlock ; nSect++ ) {
+        const bool referenced  = ! adfBitmapMapIsFree( map, nSect ),
+                   markedFree  = adfIsBlockFree( vol, nSect );
+        if ( referenced && markedFree )
+            nReferencedFree++;
+        else if ( ! referenced && ! markedFree )
+            nUsedUnreferenced++;
     }
 
-    if ( ! adfIsDirEmpty( (const struct AdfDirBlock * const) &rootDirBlock ) ) {
-        // note: for a large volume (a hard disk) getting all entries can become big
-        // - it may need to be optimized
-        struct AdfList * const entries = adfGetRDirEnt( vol, vol->rootBlock, true );
-        if ( entries == NULL ) {
-            return ADF_RC_ERROR;
-        }
+    /* ... then collect */
+    check->usedUnreferenced = adfVectorSectorsCreate( nUsedUnreferenced );
+    check->referencedFree   = adfVectorSectorsCreate( nReferencedFree );
+    if ( check->usedUnreferenced.nItems != nUsedUnreferenced ||
+         check->referencedFree.nItems   != nReferencedFree )
+    {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        adfFreeBitmapCheck( check );
+        rc = ADF_RC_MALLOC;
+        goto free_map;
+    }
 
-        adfBitmapListSetUsed( vol, entries );
-        adfFreeDirList( entries );
+    unsigned iUsedUnreferenced = 0,
+             iReferencedFree   = 0;
+    for ( ADF_SECTNUM nSect = 2 ; nSect <= volLastBlock ; nSect++ ) {
+        const bool referenced  = ! adfBitmapMapIsFree( map, nSect ),
+                   markedFree  = adfIsBlockFree( vol, nSect );
+        if ( referenced && markedFree )
+            check->referencedFree.sectors[ iReferencedFree++ ] = nSect;
+        else if ( ! referenced && ! markedFree )
+            check->usedUnreferenced.sectors[ iUsedUnreferenced++ ] = nSect;
     }
 
+free_map:
+    free( map );
     return rc;
 }
 
 
+/*
+ * adfFreeBitmapCheck
+ *
+ */
+void adfFreeBitmapCheck( struct AdfBitmapCheck * const  check )
+{
+    check->usedUnreferenced.destroy( &check->usedUnreferenced );
+    check->referencedFree.destroy( &check->referencedFree );
+}
+
+
 /*
  * adfGet1FreeBlock
  *
@@ -610,11 +782,30 @@ bool adfGetFreeBlocks( struct AdfVolume * const  vol,
 {
     int i, j;
     int32_t block = vol->rootBlock;
+    const int32_t volLastBlock = vol->lastBlock - vol->firstBlock;
 
     i = 0;
     bool diskFull = false;
 /*printf("lastblock=%ld\n",vol->lastBlock);*/
     while ( i < nbSect && !diskFull ) {
+        // skip whole map words of used blocks (not containing the root block,
+        // where the search ends)
+        if ( ( block - 2 ) % 32 == 0 &&
+             block + 31 <= volLastBlock &&
+             ! ( block < vol->rootBlock && vol->rootBlock < block + 32 ) )
+        {
+            const int sectOfMap = block - 2;
+            const struct AdfBitmapBlock * const bitm = adfBitmapGetPage_(
+                vol, (unsigned) ( sectOfMap / ( ADF_BM_MAP_SIZE * 32 ) ) );
+            if ( bitm != NULL &&
+                 bitm->map[ ( sectOfMap / 32 ) % ADF_BM_MAP_SIZE ] == 0 )
+            {
+                block = ( block + 31 == volLastBlock ) ? 2 : block + 32;
+                diskFull = ( block == vol->rootBlock );
+                continue;
+            }
+        }
+
         if ( adfIsBlockFree( vol, block ) ) {
             sectList[ i ] = block;
             i++;
@@ -643,8 +834,8 @@ bool adfGetFreeBlocks( struct AdfVolume * const  vol,
  * adfIsBlockFree
  *
  */
-bool adfIsBlockFree( const struct AdfVolume * const  vol,
-                     const ADF_SECTNUM               nSect )
+bool adfIsBlockFree( struct AdfVolume * const  vol,
+                     const ADF_SECTNUM         nSect )
 {
     assert( nSect >= 2 );
     const int
@@ -658,8 +849,10 @@ printf("bitm=%x,  ",bitMask[ sectOfMap%32]);
 printf("res=%x,  ",vol->bitmapTable[ block ]->map[ indexInMap ]
         & bitMask[ sectOfMap%32 ]);
 */
-    return ( ( vol->bitmap.table[ block ]->map[ indexInMap ] &
-               bitMask[ sectOfMap % 32 ] ) != 0 );
+    const struct AdfBitmapBlock * const bitm = adfBitmapGetPage_( vol, (unsigned) block );
+    if ( bitm == NULL )
+        return false;     /* unknown - safer to consider it used */
+    return ( ( bitm->map[ indexInMap ] & bitMask[ sectOfMap % 32 ] ) != 0 );
 }
 
 
@@ -682,16 +875,54 @@ void adfSetBlockFree( struct AdfVolume * const  vol,
 printf("bit=%d,  ",sectOfMap%32);
 *printf("bitm=%x,  ",bitMask[ sectOfMap%32]);*/
 
-    const uint32_t oldValue = vol->bitmap.table[ block ]->map[ indexInMap ];
+    struct AdfBitmapBlock * const bitm = adfBitmapGetPage_( vol, (unsigned) block );
+    if ( bitm == NULL )
+        return;
+
+    const uint32_t oldValue = bitm->map[ indexInMap ];
 /*printf("old=%x,  ",oldValue);*/
-    vol->bitmap.table[ block ]->map[ indexInMap ] =
-        oldValue | bitMask[ sectOfMap % 32 ];
+    bitm->map[ indexInMap ] = oldValue | bitMask[ sectOfMap % 32 ];
 /*printf("new=%x,  ",vol->bitmapTable[ block ]->map[ indexInMap ]);*/
 
     vol->bitmap.blocksChg[ block ] = true;
 }
 
 
+/*
+ * adfSetBlockRangeFree
+ *
+ * mark free nBlocks consecutive blocks, starting from nSect
+ * (setting whole map words at once)
+ */
+void adfSetBlockRangeFree( struct AdfVolume * const  vol,
+                           const ADF_SECTNUM         nSect,
+                           const unsigned            nBlocks )
+{
+    assert( nSect >= 2 );
+    assert( nSect + (ADF_SECTNUM) nBlocks - 1 <= vol->lastBlock - vol->firstBlock );
+
+    unsigned sectOfMap = (unsigned) nSect - 2;
+    const unsigned sectOfMapEnd = sectOfMap + nBlocks;
+    while ( sectOfMap < sectOfMapEnd ) {
+        const unsigned
+            block      = sectOfMap / ( ADF_BM_MAP_SIZE * 32 ),
+            indexInMap = ( sectOfMap / 32 ) % ADF_BM_MAP_SIZE,
+            firstBit   = sectOfMap % 32,
+            nBits      = min( 32 - firstBit, sectOfMapEnd - sectOfMap );
+
+        struct AdfBitmapBlock * const bitm = adfBitmapGetPage_( vol, block );
+        if ( bitm == NULL )
+            return;
+
+        const uint32_t mask = ( nBits == 32 ) ? 0xffffffff :
+            ( ( ( 1u << nBits ) - 1 ) << firstBit );
+        bitm->map[ indexInMap ] |= mask;
+        vol->bitmap.blocksChg[ block ] = true;
+        sectOfMap += nBits;
+    }
+}
+
+
 /*
  * adfSetBlockUsed
  *
@@ -707,10 +938,12 @@ void adfSetBlockUsed( struct AdfVolume * const  vol,
         block      = sectOfMap / ( ADF_BM_MAP_SIZE * 32 ),
         indexInMap = ( sectOfMap / 32 ) % ADF_BM_MAP_SIZE;
 
-    const uint32_t oldValue = vol->bitmap.table[ block ]->map[ indexInMap ];
+    struct AdfBitmapBlock * const bitm = adfBitmapGetPage_( vol, (unsigned) block );
+    if ( bitm == NULL )
+        return;
 
-    vol->bitmap.table[ block ]->map[ indexInMap ] =
-        oldValue & ( ~bitMask[ sectOfMap % 32 ] );
+    const uint32_t oldValue = bitm->map[ indexInMap ];
+    bitm->map[ indexInMap ] = oldValue & ( ~bitMask[ sectOfMap % 32 ] );
     vol->bitmap.blocksChg[ block ] = true;
 }
 
@@ -719,17 +952,32 @@ void adfSetBlockUsed( struct AdfVolume * const  vol,
  * adfReadBitmapBlock
  *
  */
-ADF_RETCODE adfReadBitmapBlock( struct AdfVolume *       vol,
-                                ADF_SECTNUM              nSect,
-                                struct AdfBitmapBlock *  bitm )
+ADF_RETCODE adfReadBitmapBlock( const struct AdfVolume * const  vol,
+                                const ADF_SECTNUM               nSect,
+                                struct AdfBitmapBlock * const   bitm )
 {
     uint8_t buf[ ADF_LOGICAL_BLOCK_SIZE ];
 
 /*printf("bitmap %ld\n",nSect);*/
-    ADF_RETCODE rc = adfVolReadBlock( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, (uint32_t) nSect, buf,
+                                            ADF_STATS_BLOCK_BITMAP );
     if ( rc != ADF_RC_OK )
         return rc;
 
+    return adfBitmapBlockDecode_( vol, nSect, buf, bitm );
+}
+
+
+/*
+ * adfBitmapBlockDecode_
+ *
+ * a bitmap block read from the disk (buf) to bitm
+ */
+static ADF_RETCODE adfBitmapBlockDecode_( const struct AdfVolume * const  vol,
+                                          const ADF_SECTNUM               nSect,
+                                          const uint8_t * const           buf,
+                                          struct AdfBitmapBlock * const   bitm )
+{
     memcpy( bitm, buf, ADF_LOGICAL_BLOCK_SIZE );
 #ifdef LITT_ENDIAN
     /* big to little = 68000 to x86 */
@@ -777,7 +1025,7 @@ ADF_RETCODE adfWriteBitmapBlock( struct AdfVolume * const             vol,
 
 /*	dumpBlock((uint8_t*)buf);*/
 
-    return adfVolWriteBlock( vol, (uint32_t) nSect, buf );
+    return adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf, ADF_STATS_BLOCK_BITMAP );
 }
 
 
@@ -785,13 +1033,14 @@ ADF_RETCODE adfWriteBitmapBlock( struct AdfVolume * const             vol,
  * adfReadBitmapExtBlock
  *
  */
-ADF_RETCODE adfReadBitmapExtBlock( struct AdfVolume * const          vol,
+ADF_RETCODE adfReadBitmapExtBlock( const struct AdfVolume * const    vol,
                                    const ADF_SECTNUM                 nSect,
                                    struct AdfBitmapExtBlock * const  bitme )
 {
     uint8_t buf[ ADF_LOGICAL_BLOCK_SIZE ];
 
-    ADF_RETCODE rc = adfVolReadBlock( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, (uint32_t) nSect, buf,
+                                            ADF_STATS_BLOCK_BITMAP );
     if ( rc != ADF_RC_OK )
         return rc;
 
@@ -821,7 +1070,7 @@ ADF_RETCODE adfWriteBitmapExtBlock( struct AdfVolume * const                vol,
 #endif
 
 /*	dumpBlock((uint8_t*)buf);*/
-    return adfVolWriteBlock( vol, (uint32_t) nSect, buf );
+    return adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf, ADF_STATS_BLOCK_BITMAP );
 }
 
 
@@ -829,9 +1078,14 @@ ADF_RETCODE adfWriteBitmapExtBlock( struct AdfVolume * const                vol,
  * adfCountFreeBlocks
  *
  */
-uint32_t adfCountFreeBlocks( const struct AdfVolume * const  vol )
+uint32_t adfCountFreeBlocks( struct AdfVolume * const  vol )
 {
     assert( vol->lastBlock - vol->firstBlock > 2 );
+
+    /* all pages are needed - read them at once (rather than one by one) */
+    if ( adfBitmapLoadPages_( vol ) != ADF_RC_OK )
+        adfEnv.wFct( "%s: bitmap incomplete, volume '%s'", __func__, vol->volName );
+
     uint32_t freeBlocks = 0L;
     for ( int j = 2; j <= vol->lastBlock - vol->firstBlock; j++ )
         if ( adfIsBlockFree( vol, j ) )
@@ -858,101 +1112,445 @@ bool adfVolBitmapIsMarkedValid( struct AdfVolume * const  vol )
 /*#######################################################################################*/
 
 
-static ADF_RETCODE adfBitmapListSetUsed( struct AdfVolume * const      vol,
-                                         const struct AdfList * const  list )
+/*
+ * adfBitmapMapCreate
+ *
+ * allocate a private map (all blocks free) - it has the same layout as
+ * the bitmap blocks' maps concatenated, so a block's bit is at the same
+ * (flat) index
+ */
+static uint32_t * adfBitmapMapCreate( const struct AdfVolume * const  vol )
+{
+    const size_t mapSize = sizeof(uint32_t) * ADF_BM_MAP_SIZE * vol->bitmap.size;
+    uint32_t * const map = (uint32_t *) malloc( mapSize );
+    if ( map == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return NULL;
+    }
+    memset( map, 0xff, mapSize );
+    return map;
+}
+
+
+/*
+ * adfBitmapMapBuild
+ *
+ * Mark in map all blocks used by the volume's structures (the rootblock,
+ * bitmap blocks, directories, files etc.)
+ *
+ * The directory tree is split into hash chains (the unit of work) kept on
+ * a stack shared by nThreads workers. Each worker marks blocks in its own
+ * map (so no locking is needed for that); finally, the maps are merged
+ * into one (with bitwise AND, as used blocks are 0s).
+ *
+ * Without threads available (or with nThreads <= 1) the same is done by one
+ * worker, in the caller's thread.
+ *
+ * With many workers and a driver giving a host file descriptor (getHostFd),
+ * blocks are read with pread() on it - in parallel, without the device I/O
+ * lock (the write buffer is flushed once, before). Otherwise (or if
+ * the host fd cannot be used) they are read through the device, one at
+ * a time (under the lock). Reads done with pread() are not counted
+ * in the device and volume statistics.
+ */
+static ADF_RETCODE adfBitmapMapBuild( struct AdfVolume * const           vol,
+                                      const struct AdfRootBlock * const  root,
+                                      const unsigned                     nThreads,
+                                      uint32_t * const                   map )
+{
+    // mark rootblock
+    adfBitmapMapSetUsed( vol, map, vol->rootBlock );
+
+    // mark bitmap blocks (all - from rootblock and bitmap ext. blocks)
+    for ( uint32_t i = 0 ; i < vol->bitmap.size ; i++ ) {
+        adfBitmapMapSetUsed( vol, map, vol->bitmap.blocks[ i ] );
+    }
+
+    // mark bitmap ext. blocks
+    ADF_SECTNUM bmExtSect = root->bmExt;
+    while ( bmExtSect != 0 ) {
+        if ( ! adfBitmapMapSetUsed( vol, map, bmExtSect ) ) {
+            adfEnv.eFct( "%s: invalid or repeated bitmap ext. block %d",
+                         __func__, bmExtSect );
+            return ADF_RC_ERROR;
+        }
+        struct AdfBitmapExtBlock bmExtBlock;
+        ADF_RETCODE rc = adfReadBitmapExtBlock( vol, bmExtSect, &bmExtBlock );
+        if ( rc != ADF_RC_OK )
+            return rc;
+        bmExtSect = bmExtBlock.nextBlock;
+    }
+
+    // traverse all files and directories
+    unsigned nMaps = ( nThreads < 1 ? 1 :
+                       nThreads > ADF_THREADS_MAX ? ADF_THREADS_MAX :
+                       nThreads );
+    if ( ! adfThreadsAvailable() || vol->dev->ioLock == NULL )
+        nMaps = 1;
+
+    struct AdfBitmapScan scan = {
+        .vol        = vol,
+        .lock       = NULL,
+        .cond       = NULL,
+        .chains     = NULL,
+        .nChains    = 0,
+        .chainsSize = 0,
+        .nBusy      = 0,
+        .maps       = NULL,
+        .nMaps      = nMaps,
+        .nWorkers   = 0,
+        .dirs       = NULL,
+        .hostFd     = -1,
+        .rc         = ADF_RC_OK
+    };
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    scan.maps = (uint32_t **) calloc( nMaps, sizeof(uint32_t *) );
+    if ( scan.maps == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+    scan.maps[ 0 ] = map;    // the 1st worker marks directly in the result
+    for ( unsigned i = 1 ; i < nMaps ; i++ ) {
+        scan.maps[ i ] = adfBitmapMapCreate( vol );
+        if ( scan.maps[ i ] == NULL ) {
+            rc = ADF_RC_MALLOC;
+            goto cleanup;
+        }
+    }
+
+    if ( nMaps > 1 ) {
+        scan.lock = adfMutexCreate();
+        scan.cond = adfCondCreate();
+        scan.dirs = adfBitmapMapCreate( vol );
+        if ( scan.lock == NULL || scan.cond == NULL || scan.dirs == NULL ) {
+            rc = ADF_RC_ERROR;
+            goto cleanup;
+        }
+        scan.hostFd = adfBitmapScanHostFd_( vol->dev );
+    }
+
+    // mark the root directory cache
+    rc = adfBitmapDirCacheSetUsed( &scan, map, root->extension );
+    if ( rc != ADF_RC_OK )
+        goto cleanup;
+
+    rc = adfBitmapScanPushChains( &scan, root->hashTable );
+    if ( rc != ADF_RC_OK )
+        goto cleanup;
+
+    adfThreadsRun( nMaps, adfBitmapScanWorker, &scan );
+    rc = scan.rc;
+    if ( rc != ADF_RC_OK )
+        goto cleanup;
+
+    // merge maps of all workers
+    const size_t mapWords = (size_t) ADF_BM_MAP_SIZE * vol->bitmap.size;
+    for ( unsigned i = 1 ; i < nMaps ; i++ ) {
+        const uint32_t * const workerMap = scan.maps[ i ];
+        for ( size_t j = 0 ; j < mapWords ; j++ )
+            map[ j ] &= workerMap[ j ];
+    }
+
+cleanup:
+    free( scan.dirs );
+    adfCondDestroy( scan.cond );
+    adfMutexDestroy( scan.lock );
+    for ( unsigned i = 1 ; i < nMaps ; i++ )
+        free( scan.maps[ i ] );
+    free( scan.maps );
+    free( scan.chains );
+    return rc;
+}
+
+
+/*
+ * adfBitmapScanWorker
+ *
+ * take hash chains from the stack and process them - until the stack
+ * is empty and no other worker is busy (could add more chains)
+ */
+static void adfBitmapScanWorker( void * const  scanArg )
+{
+    struct AdfBitmapScan * const scan = scanArg;
+
+    adfMutexLock( scan->lock );
+    uint32_t * const map = scan->maps[ scan->nWorkers++ ];
+
+    while ( true ) {
+        while ( scan->nChains == 0  &&
+                scan->nBusy > 0     &&
+                scan->rc == ADF_RC_OK )
+        {
+            adfCondWait( scan->cond, scan->lock );
+        }
+        if ( scan->nChains == 0 || scan->rc != ADF_RC_OK )
+            break;
+
+        const ADF_SECTNUM chain = scan->chains[ --scan->nChains ];
+        scan->nBusy++;
+        adfMutexUnlock( scan->lock );
+
+        const ADF_RETCODE rc = adfBitmapChainSetUsed( scan, map, chain );
+
+        adfMutexLock( scan->lock );
+        scan->nBusy--;
+        if ( rc != ADF_RC_OK )
+            scan->rc = rc;
+    }
+
+    adfCondBroadcast( scan->cond );
+    adfMutexUnlock( scan->lock );
+}
+
+
+/*
+ * adfBitmapScanPushChains
+ *
+ * put all (non-empty) hash chains of a directory on the stack
+ */
+static ADF_RETCODE adfBitmapScanPushChains( struct AdfBitmapScan * const  scan,
+                                            const int32_t                 hashTable[] )
 {
     ADF_RETCODE rc = ADF_RC_OK;
 
-    const struct AdfList * cell = list;
-    while ( cell != NULL ) {
-        const struct AdfEntry * const entry =
-            (const struct AdfEntry * const) cell->content;
+    adfMutexLock( scan->lock );
+
+    if ( scan->nChains + ADF_HT_SIZE > scan->chainsSize ) {
+        const unsigned newSize = scan->chainsSize * 2 + ADF_HT_SIZE;
+        ADF_SECTNUM * const chains = (ADF_SECTNUM *)
+            realloc( scan->chains, sizeof(ADF_SECTNUM) * newSize );
+        if ( chains == NULL ) {
+            adfEnv.eFct( "%s: malloc", __func__ );
+            rc = ADF_RC_MALLOC;
+            goto unlock;
+        }
+        scan->chains     = chains;
+        scan->chainsSize = newSize;
+    }
+
+    for ( unsigned i = 0 ; i < ADF_HT_SIZE ; i++ ) {
+        if ( hashTable[ i ] != 0 )
+            scan->chains[ scan->nChains++ ] = hashTable[ i ];
+    }
+    adfCondBroadcast( scan->cond );
+
+unlock:
+    adfMutexUnlock( scan->lock );
+    return rc;
+}
+
+
+/*
+ * adfBitmapChainSetUsed
+ *
+ * mark used all entries from a hash chain (with their blocks); directories
+ * found are not processed here - their hash chains are put on the stack
+ */
+static ADF_RETCODE adfBitmapChainSetUsed( struct AdfBitmapScan * const  scan,
+                                          uint32_t * const              map,
+                                          ADF_SECTNUM                   sector )
+{
+    struct AdfVolume * const vol = scan->vol;
+    ADF_RETCODE rc = ADF_RC_OK;
 
+    while ( sector != 0 ) {
         // mark entry block
         // (all header blocks (file, dir, links) are done with this)
-        adfSetBlockUsed( vol, entry->sector );
+        if ( ! adfBitmapMapSetUsed( vol, map, sector ) ) {
+            adfEnv.wFct( "%s: entry block %d invalid or already in use "
+                         "(loop in a hash chain?), volume '%s'",
+                         __func__, sector, vol->volName );
+            break;
+        }
 
-        // mark file blocks
-        if ( entry->type == ADF_ST_FILE ) {
-            struct AdfFileHeaderBlock fhBlock;
-            rc = adfReadEntryBlock( vol, entry->sector,
-                                    (struct AdfEntryBlock *) &fhBlock );
-            if ( rc != ADF_RC_OK ) {
-                adfEnv.eFct( "%s: error reading entry (file) block, "
-                             "block %d, volume '%s', file name '%s'",
-                             __func__, entry->sector, vol->volName, entry->name );
-                break;
-            }
+        uint8_t buf[ 512 ];
+        struct AdfEntryBlock entryBlk;
+        rc = adfBitmapScanReadBlock_( scan, sector, buf, ADF_STATS_BLOCK_HEADER );
+        if ( rc == ADF_RC_OK )
+            rc = adfDecodeEntryBlock( vol, sector, buf, &entryBlk );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: error reading entry block %d, volume '%s'",
+                         __func__, sector, vol->volName );
+            return rc;
+        }
 
-            rc = adfBitmapFileBlocksSetUsed( vol, &fhBlock );
+        // mark file blocks
+        if ( entryBlk.secType == ADF_ST_FILE ) {
+            rc = adfBitmapFileBlocksSetUsed(
+                scan, map, (const struct AdfFileHeaderBlock *) &entryBlk );
             if ( rc != ADF_RC_OK ) {
                 adfEnv.eFct( "%s: adfBitmapFileBlocksSetUsed returned "
                              "error %d, block %d, volume '%s', file name '%s'",
-                             __func__, rc, entry->sector, vol->volName, entry->name );
-                break;
+                             __func__, rc, sector, vol->volName, entryBlk.name );
+                return rc;
             }
         }
 
-        // mark directory and directory cache blocks
-        else if ( entry->type == ADF_ST_DIR ) {
-            struct AdfDirBlock dirBlock;
-            rc = adfReadEntryBlock( vol, entry->sector,
-                                    (struct AdfEntryBlock *) &dirBlock );
-            if ( rc != ADF_RC_OK ) {
-                adfEnv.eFct( "%s: error reading entry (directory) block, "
-                             "block %d, volume '%s', directory name '%s'",
-                             __func__, entry->sector, vol->volName, entry->name );
+        // mark directory cache blocks and queue the subdirectory
+        else if ( entryBlk.secType == ADF_ST_DIR ) {
+            // with many workers, a directory (ie. from a damaged volume,
+            // referenced more than once) could be processed by many of them
+            // (their maps are separate) - so must check it globally
+            adfMutexLock( scan->lock );
+            const bool dirSeen = ( scan->dirs != NULL &&
+                                   ! adfBitmapMapSetUsed( vol, scan->dirs, sector ) );
+            adfMutexUnlock( scan->lock );
+            if ( dirSeen ) {
+                adfEnv.wFct( "%s: directory block %d referenced more than once, "
+                             "volume '%s'", __func__, sector, vol->volName );
                 break;
             }
-            rc = adfBitmapDirCacheSetUsed( vol, dirBlock.extension );
+
+            rc = adfBitmapDirCacheSetUsed( scan, map, entryBlk.extension );
             if ( rc != ADF_RC_OK ) {
                 adfEnv.eFct( "%s: adfBitmapDirCacheSetUsed returned "
                              "error %d, block %d, volume '%s', directory name '%s'",
-                             __func__, rc, entry->sector, vol->volName, entry->name );
-                break;
+                             __func__, rc, sector, vol->volName, entryBlk.name );
+                return rc;
             }
+
+            rc = adfBitmapScanPushChains( scan, entryBlk.hashTable );
+            if ( rc != ADF_RC_OK )
+                return rc;
         }
 
-        // if any subdirectory present - process recursively
-        if ( cell->subdir != NULL ) {
-            const struct AdfList * const subdir =
-                ( const struct AdfList * const ) cell->subdir;
-            rc = adfBitmapListSetUsed( vol, subdir );
-            if ( rc != ADF_RC_OK ) {
-                adfEnv.eFct( "%s: adfBitmapListSetUsed returned "
-                             "error %d, volume '%s', directory name '%s'",
-                             __func__, rc, vol->volName,
-                             ( (const struct AdfEntry * const) subdir->content )->name );
-                break;
+        sector = entryBlk.nextSameHash;
+    }
+    return rc;
+}
+
+
+/*
+ * adfBitmapScanHostFd_
+ *
+ * get the host fd for reading blocks with pread() (see adfBitmapMapBuild),
+ * -1 if the device does not have one (or pending writes cannot be flushed)
+ */
+static int adfBitmapScanHostFd_( struct AdfDevice * const  dev )
+{
+#ifdef _WIN32
+    (void) dev;
+    return -1;
+#else
+    if ( dev->drv->getHostFd == NULL ||
+         dev->geometry.blockSize != 512 ||
+         adfDevFlush( dev ) != ADF_RC_OK )    // (buffered writes)
+    {
+        return -1;
+    }
+    adfMutexLock( dev->ioLock );
+    const int hostFd = dev->drv->getHostFd( dev );
+    adfMutexUnlock( dev->ioLock );
+    return hostFd;
+#endif
+}
+
+
+/*
+ * adfBitmapScanReadBlock_
+ *
+ * read a (raw) block of the volume - with pread() on the host fd if
+ * available, otherwise through the device
+ */
+static ADF_RETCODE adfBitmapScanReadBlock_( const struct AdfBitmapScan * const  scan,
+                                            const ADF_SECTNUM                   nSect,
+                                            uint8_t * const                     buf,
+                                            const AdfStatsBlockType             type )
+{
+    const struct AdfVolume * const vol = scan->vol;
+#ifndef _WIN32
+    if ( scan->hostFd >= 0 ) {
+        if ( ! adfVolIsSectNumValid( vol, nSect ) ) {
+            adfEnv.wFct( "%s: nSect %d out of range", __func__, nSect );
+            return ADF_RC_BLOCKOUTOFRANGE;
+        }
+        if ( adfEnv.useRWAccess )
+            adfEnv.rwhAccess( vol->firstBlock + nSect, nSect, false );
+        const off_t offset = (off_t) ( vol->firstBlock + nSect ) * 512;
+        size_t done = 0;
+        while ( done < 512 ) {
+            const ssize_t n = pread( scan->hostFd, buf + done, 512 - done,
+                                     offset + (off_t) done );
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n <= 0 ) {
+                adfEnv.eFct( "%s: error reading block %d, volume '%s'",
+                             __func__, nSect, vol->volName );
+                return ADF_RC_ERROR;
             }
+            done += (size_t) n;
         }
-        cell = cell->next;
+        return ADF_RC_OK;
     }
-    return rc;
+#endif
+    return adfVolReadBlockOfType( vol, (uint32_t) nSect, buf, type );
+}
+
+
+/*
+ * adfBitmapMapSetUsed
+ *
+ * mark a block used in a private map (see adfBitmapMapBuild)
+ *
+ * returns false if the block is out of range or was already marked used
+ */
+static bool adfBitmapMapSetUsed( const struct AdfVolume * const  vol,
+                                 uint32_t * const                map,
+                                 const ADF_SECTNUM               nSect )
+{
+    if ( nSect < 2  ||  nSect > vol->lastBlock - vol->firstBlock ) {
+        adfEnv.wFct( "%s: block %d out of range, volume '%s'",
+                     __func__, nSect, vol->volName );
+        return false;
+    }
+
+    const uint32_t
+        sectOfMap = (uint32_t) nSect - 2,
+        mask      = bitMask[ sectOfMap % 32 ];
+    uint32_t * const word = &map[ sectOfMap / 32 ];
+
+    const bool wasFree = ( ( *word & mask ) != 0 );
+    *word &= ~mask;
+    return wasFree;
+}
+
+
+static bool adfBitmapMapIsFree( const uint32_t * const  map,
+                                const ADF_SECTNUM       nSect )
+{
+    const uint32_t sectOfMap = (uint32_t) nSect - 2;
+    return ( ( map[ sectOfMap / 32 ] & bitMask[ sectOfMap % 32 ] ) != 0 );
 }
 
 
 static ADF_RETCODE adfBitmapFileBlocksSetUsed (
-    struct AdfVolume * const                 vol,
+    const struct AdfBitmapScan * const       scan,
+    uint32_t * const                         map,
     const struct AdfFileHeaderBlock * const  fhBlock )
 {
+    const struct AdfVolume * const vol = scan->vol;
     ADF_RETCODE rc = ADF_RC_OK;
 
     // mark blocks from the header
     for ( uint32_t block = 0 ; block < ADF_MAX_DATABLK ; block++ ) {
         if ( fhBlock->dataBlocks[ block ] > 1 )
-            adfSetBlockUsed( vol, fhBlock->dataBlocks[ block ] );
+            adfBitmapMapSetUsed( vol, map, fhBlock->dataBlocks[ block ] );
     }
 
     // mark blocks from ext blocks
-
-    //const int nExtBlocks = (int) adfFileSize2Extblocks ( fhBlock->byteSize,
-    //                                                     vol->datablockSize );
     ADF_SECTNUM extBlockPtr = fhBlock->extension;
     struct AdfFileExtBlock fext;
     while ( extBlockPtr != 0 ) {
-        adfSetBlockUsed( vol, extBlockPtr );
-        rc = adfReadFileExtBlock( vol, extBlockPtr, &fext );
+        if ( ! adfBitmapMapSetUsed( vol, map, extBlockPtr ) ) {
+            adfEnv.wFct( "%s: ext block %d invalid or already in use, file '%s'",
+                         __func__, extBlockPtr, fhBlock->fileName );
+            break;
+        }
+        uint8_t buf[ 512 ];
+        rc = adfBitmapScanReadBlock_( scan, extBlockPtr, buf, ADF_STATS_BLOCK_EXT );
+        if ( rc == ADF_RC_OK )
+            rc = adfDecodeFileExtBlock( vol, extBlockPtr, buf, &fext );
         if ( rc != ADF_RC_OK ) {
             adfEnv.eFct( "%s: error reading ext block %d, file '%s'",
                          __func__, extBlockPtr, fhBlock->fileName );
@@ -960,7 +1558,7 @@ static ADF_RETCODE adfBitmapFileBlocksSetUsed (
         }
         for ( uint32_t block = 0 ; block < ADF_MAX_DATABLK ; block++ ) {
             if ( fext.dataBlocks[ block ] > 1 )
-                adfSetBlockUsed( vol, fext.dataBlocks[ block ] );
+                adfBitmapMapSetUsed( vol, map, fext.dataBlocks[ block ] );
         }
         extBlockPtr = fext.extension;
     }
@@ -968,15 +1566,22 @@ static ADF_RETCODE adfBitmapFileBlocksSetUsed (
 }
 
 
-static ADF_RETCODE adfBitmapDirCacheSetUsed( struct AdfVolume * const  vol,
-                                             ADF_SECTNUM               dCacheBlockNum )
+static ADF_RETCODE adfBitmapDirCacheSetUsed( const struct AdfBitmapScan * const  scan,
+                                             uint32_t * const                    map,
+                                             ADF_SECTNUM                         dCacheBlockNum )
 {
+    const struct AdfVolume * const vol = scan->vol;
     ADF_RETCODE rc = ADF_RC_OK;
     while ( dCacheBlockNum != 0 ) {
-        adfSetBlockUsed( vol, dCacheBlockNum );
+        if ( ! adfBitmapMapSetUsed( vol, map, dCacheBlockNum ) )
+            break;
 
+        uint8_t buf[ 512 ];
         struct AdfDirCacheBlock dirCacheBlock;
-        rc = adfReadDirCBlock( vol, dCacheBlockNum, &dirCacheBlock );
+        rc = adfBitmapScanReadBlock_( scan, dCacheBlockNum, buf,
+                                      ADF_STATS_BLOCK_DIRCACHE );
+        if ( rc == ADF_RC_OK )
+            rc = adfDecodeDirCBlock( vol, dCacheBlockNum, buf, &dirCacheBlock );
         if ( rc != ADF_RC_OK )
             break;
 
@@ -986,6 +1591,231 @@ static ADF_RETCODE adfBitmapDirCacheSetUsed( struct AdfVolume * const  vol,
 }
 
 
+/*
+ * adfBitmapMapCommit
+ *
+ * copy a private map into the volume's bitmap blocks, marking as changed
+ * only blocks different from those on the disk
+ */
+static ADF_RETCODE adfBitmapMapCommit( struct AdfVolume * const  vol,
+                                       const uint32_t * const    map )
+{
+    /* bits beyond the last block of the volume are kept as they are */
+    const uint32_t nBits = adfVolGetSizeInBlocksWithoutBootblock( vol );
+
+    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ ) {
+        uint8_t buf[ ADF_LOGICAL_BLOCK_SIZE ];
+        ADF_RETCODE rc = adfVolReadBlockOfType( vol, (uint32_t) vol->bitmap.blocks[ i ],
+                                                buf, ADF_STATS_BLOCK_BITMAP );
+        if ( rc != ADF_RC_OK )
+            return rc;
+
+        struct AdfBitmapBlock onDisk;
+        memcpy( &onDisk, buf, ADF_LOGICAL_BLOCK_SIZE );
+#ifdef LITT_ENDIAN
+        adfSwapEndian( (uint8_t *) &onDisk, ADF_SWBL_BITMAP );
+#endif
+        const bool checksumOk =
+            ( onDisk.checkSum == adfNormalSum( buf, 0, ADF_LOGICAL_BLOCK_SIZE ) );
+
+        if ( vol->bitmap.table[ i ] == NULL ) {
+            /* not read yet (read-only mount) */
+            vol->bitmap.table[ i ] = (struct AdfBitmapBlock *)
+                calloc( 1, sizeof(struct AdfBitmapBlock) );
+            if ( vol->bitmap.table[ i ] == NULL ) {
+                adfEnv.eFct( "%s: malloc", __func__ );
+                return ADF_RC_MALLOC;
+            }
+        }
+        struct AdfBitmapBlock * const page = vol->bitmap.table[ i ];
+        if ( checksumOk )
+            *page = onDisk;
+
+        for ( uint32_t k = 0 ; k < ADF_BM_MAP_SIZE ; k++ ) {
+            const uint32_t
+                wordIdx  = i * ADF_BM_MAP_SIZE + k,
+                firstBit = wordIdx * 32;
+            if ( firstBit >= nBits )
+                break;
+            if ( nBits - firstBit >= 32 ) {
+                page->map[ k ] = map[ wordIdx ];
+            } else {
+                const uint32_t inRange = bitMask[ nBits - firstBit ] - 1;
+                page->map[ k ] = ( page->map[ k ] & ~inRange ) |
+                                 ( map[ wordIdx ] & inRange );
+            }
+        }
+
+        vol->bitmap.blocksChg[ i ] =
+            ( ! checksumOk ||
+              memcmp( page->map, onDisk.map, sizeof(onDisk.map) ) != 0 );
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfBitmapGetPage_
+ *
+ * get a bitmap page, reading it if it was not read yet
+ */
+static struct AdfBitmapBlock * adfBitmapGetPage_( struct AdfVolume * const  vol,
+                                                  const unsigned            page )
+{
+    struct AdfBitmapBlock * bitm = vol->bitmap.table[ page ];
+    if ( bitm != NULL )
+        return bitm;
+
+    if ( vol->bitmap.blocks[ page ] == 0 &&
+         adfBitmapReadExtPointers_( vol ) != ADF_RC_OK )
+        return NULL;
+
+    bitm = (struct AdfBitmapBlock *) malloc( sizeof(struct AdfBitmapBlock) );
+    if ( bitm == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return NULL;
+    }
+
+    if ( adfReadBitmapBlock( vol, vol->bitmap.blocks[ page ], bitm ) != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error reading bitmap page %u (block %d), volume '%s'",
+                     __func__, page, vol->bitmap.blocks[ page ], vol->volName );
+        free( bitm );
+        return NULL;
+    }
+
+    vol->bitmap.table[ page ] = bitm;
+    return bitm;
+}
+
+
+/*
+ * adfBitmapReadExtPointers_
+ *
+ * get pointers to bitmap pages stored in bitmap extension blocks
+ */
+static ADF_RETCODE adfBitmapReadExtPointers_( struct AdfVolume * const  vol )
+{
+    struct AdfBitmapExtBlock bmExt;
+    ADF_SECTNUM bmExtSect = vol->bitmap.extBlock;
+    uint32_t j = ADF_BM_PAGES_ROOT_SIZE;
+#if CHECK_NONZERO_BMPAGES_BEYOND_BMSIZE == 1
+    unsigned bmExt_i = 0;
+#endif
+    while ( bmExtSect != 0 && j < vol->bitmap.size ) {
+        if ( ! adfVolIsSectNumValid( vol, bmExtSect ) ) {
+            adfEnv.eFct( "%s: bitmap ext. block %d out of range, volume '%s'",
+                         __func__, bmExtSect, vol->volName );
+            return ADF_RC_ERROR;
+        }
+
+        /* bitmap pointers in bitmapExtBlock, j <= mapSize */
+        ADF_RETCODE rc = adfReadBitmapExtBlock( vol, bmExtSect, &bmExt );
+        if ( rc != ADF_RC_OK )
+            return rc;
+
+        unsigned i = 0;
+        while ( i < ADF_BM_PAGES_EXT_SIZE && j < vol->bitmap.size ) {
+            const ADF_SECTNUM bmSect = bmExt.bmPages[ i ];
+            if ( ! adfVolIsSectNumValid( vol, bmSect ) ) {
+                adfEnv.wFct( "%s: sector %d out of range, "
+                             "bmext %d bmpages[%u]",
+                             __func__, bmSect, bmExtSect, i );
+                return ADF_RC_ERROR;
+            }
+            vol->bitmap.blocks[ j ] = bmSect;
+            i++; j++;
+        }
+
+#if CHECK_NONZERO_BMPAGES_BEYOND_BMSIZE == 1
+        checkNonzeroBMpagesBeyondBMsizeExt(
+            __func__, i, bmExt_i, bmExtSect, vol->bitmap.size, bmExt.bmPages );
+        bmExt_i++;
+#endif
+        bmExtSect = bmExt.nextBlock;
+    }
+
+    if ( j < vol->bitmap.size ) {
+        adfEnv.eFct( "%s: found pointers to %u of %u bitmap blocks, volume '%s'",
+                     __func__, j, vol->bitmap.size, vol->volName );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfBitmapLoadPages_
+ *
+ * read all bitmap pages not read yet (with as few device reads as possible)
+ */
+static ADF_RETCODE adfBitmapLoadPages_( struct AdfVolume * const  vol )
+{
+    if ( vol->bitmap.size > 0  &&
+         vol->bitmap.blocks[ vol->bitmap.size - 1 ] == 0 )
+    {
+        ADF_RETCODE rc = adfBitmapReadExtPointers_( vol );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+
+    unsigned nPages = 0;
+    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ )
+        if ( vol->bitmap.table[ i ] == NULL )
+            nPages++;
+    if ( nPages == 0 )
+        return ADF_RC_OK;
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    uint32_t * const  sectors = (uint32_t *) malloc( sizeof(uint32_t) * nPages );
+    unsigned * const  pages   = (unsigned *) malloc( sizeof(unsigned) * nPages );
+    uint8_t ** const  bufs    = (uint8_t **) malloc( sizeof(uint8_t *) * nPages );
+    uint8_t * const   data    = (uint8_t *) malloc( (size_t) ADF_LOGICAL_BLOCK_SIZE *
+                                                    nPages );
+    if ( sectors == NULL || pages == NULL || bufs == NULL || data == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        rc = ADF_RC_MALLOC;
+        goto free_bufs;
+    }
+
+    unsigned n = 0;
+    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ ) {
+        if ( vol->bitmap.table[ i ] != NULL )
+            continue;
+        pages[ n ]   = i;
+        sectors[ n ] = (uint32_t) vol->bitmap.blocks[ i ];
+        bufs[ n ]    = data + (size_t) n * ADF_LOGICAL_BLOCK_SIZE;
+        n++;
+    }
+
+    rc = adfVolReadBlocksOfType( vol, nPages, sectors, bufs, ADF_STATS_BLOCK_BITMAP );
+    if ( rc != ADF_RC_OK )
+        goto free_bufs;
+
+    for ( unsigned i = 0 ; i < nPages ; i++ ) {
+        struct AdfBitmapBlock * const bitm = (struct AdfBitmapBlock *)
+            malloc( sizeof(struct AdfBitmapBlock) );
+        if ( bitm == NULL ) {
+            adfEnv.eFct( "%s: malloc", __func__ );
+            rc = ADF_RC_MALLOC;
+            break;
+        }
+        rc = adfBitmapBlockDecode_( vol, (ADF_SECTNUM) sectors[ i ], bufs[ i ], bitm );
+        if ( rc != ADF_RC_OK ) {
+            free( bitm );
+            break;
+        }
+        vol->bitmap.table[ pages[ i ] ] = bitm;
+    }
+
+free_bufs:
+    free( data );
+    free( bufs );
+    free( pages );
+    free( sectors );
+    return rc;
+}
+
+
 static uint32_t nBlock2bitmapSize( uint32_t  nBlock )
 {
     uint32_t mapSize = (uint32_t) nBlock / ( ADF_BM_MAP_SIZE * 32 );
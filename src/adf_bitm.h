@@ -29,6 +29,7 @@
 #include "adf_err.h"
 #include "adf_prefix.h"
 #include "adf_types.h"
+#include "adf_vector.h"
 #include "adf_vol.h"
 
 
@@ -39,21 +40,61 @@ ADF_RETCODE adfBitmapAllocate( struct AdfVolume * const  vol );
 ADF_PREFIX void adfFreeBitmap( struct AdfVolume * const  vol );
 
 
-/* read volume's bitmap */
+/* set up volume's bitmap (pages are read on first use) */
 ADF_RETCODE adfReadBitmap( struct AdfVolume * const           vol,
                            const struct AdfRootBlock * const  root );
 
+/* read all pages of volume's bitmap not read yet */
+ADF_RETCODE adfBitmapLoad( struct AdfVolume * const  vol );
+
 /* write volume's bitmap */
 ADF_PREFIX ADF_RETCODE adfUpdateBitmap( struct AdfVolume * const  vol );
 
+/* batch changes: bitmap updates are postponed (nesting allowed) until
+   the matching adfBitmapCommit() writes the bitmap once */
+ADF_PREFIX ADF_RETCODE adfBitmapDeferUpdates( struct AdfVolume * const  vol );
+ADF_PREFIX ADF_RETCODE adfBitmapCommit( struct AdfVolume * const  vol );
+
 /* write new volume's bitmap (while creating/formatting the volume) */
 ADF_RETCODE adfWriteNewBitmap( struct AdfVolume * const  vol );
 
-/* reconstruct bitmap based on blocks allocated for written data */
+/* reconstruct bitmap based on blocks allocated for written data
+   (only bitmap blocks differing from those on the disk are marked changed) */
 ADF_PREFIX ADF_RETCODE adfReconstructBitmap(
     struct AdfVolume * const           vol,
     const struct AdfRootBlock * const  root );
 
+/* as above, with the directory tree traversal shared by nThreads threads
+   (if the library is built without threads - done in the caller's thread)
+
+   With a driver giving a host file descriptor (getHostFd: dump, native),
+   the threads read blocks with pread() on it, in parallel (these reads
+   are not counted in the device and volume statistics). With other
+   drivers, block reads go through the device, which serializes them
+   (under the device's I/O lock) - only decoding the blocks, following
+   the block lists and marking the map run in parallel. */
+ADF_PREFIX ADF_RETCODE adfReconstructBitmapParallel(
+    struct AdfVolume * const           vol,
+    const struct AdfRootBlock * const  root,
+    const unsigned                     nThreads );
+
+
+/* bitmap consistency check (read-only)
+   (the traversal is shared by nThreads threads, reading blocks as
+   in adfReconstructBitmapParallel()) */
+
+struct AdfBitmapCheck {
+    struct AdfVectorSectors
+        usedUnreferenced,     /* marked used, but not used by anything */
+        referencedFree;       /* used (referenced), but marked free */
+};
+
+ADF_PREFIX ADF_RETCODE adfVerifyBitmap( struct AdfVolume * const       vol,
+                                        const unsigned                 nThreads,
+                                        struct AdfBitmapCheck * const  check );
+
+ADF_PREFIX void adfFreeBitmapCheck( struct AdfBitmapCheck * const  check );
+
 
 /* block allocate */
 
@@ -66,8 +107,8 @@ bool adfGetFreeBlocks( struct AdfVolume * const  vol,
 
 /* block status operations */
 
-bool adfIsBlockFree( const struct AdfVolume * const  vol,
-                     const ADF_SECTNUM               nSect );
+bool adfIsBlockFree( struct AdfVolume * const  vol,
+                     const ADF_SECTNUM         nSect );
 
 void adfSetBlockFree( struct AdfVolume * const  vol,
                       const ADF_SECTNUM         nSect );
@@ -75,13 +116,17 @@ void adfSetBlockFree( struct AdfVolume * const  vol,
 void adfSetBlockUsed( struct AdfVolume * const  vol,
                       const ADF_SECTNUM         nSect );
 
+void adfSetBlockRangeFree( struct AdfVolume * const  vol,
+                           const ADF_SECTNUM         nSect,
+                           const unsigned            nBlocks );
+
 
 /* bitmap block read/write operations */
 
 ADF_PREFIX ADF_RETCODE adfReadBitmapBlock(
-    struct AdfVolume * const       vol,
-    const ADF_SECTNUM              nSect,
-    struct AdfBitmapBlock * const  bitm );
+    const struct AdfVolume * const  vol,
+    const ADF_SECTNUM               nSect,
+    struct AdfBitmapBlock * const   bitm );
 
 ADF_PREFIX ADF_RETCODE adfWriteBitmapBlock(
     struct AdfVolume * const             vol,
@@ -89,7 +134,7 @@ ADF_PREFIX ADF_RETCODE adfWriteBitmapBlock(
     const struct AdfBitmapBlock * const  bitm );
 
 ADF_PREFIX ADF_RETCODE adfReadBitmapExtBlock(
-    struct AdfVolume * const          vol,
+    const struct AdfVolume * const    vol,
     const ADF_SECTNUM                 nSect,
     struct AdfBitmapExtBlock * const  bitme );
 
@@ -100,7 +145,8 @@ ADF_PREFIX ADF_RETCODE adfWriteBitmapExtBlock(
 
 
 /* status */
-ADF_PREFIX uint32_t adfCountFreeBlocks( const struct AdfVolume * const  vol );
+/* (bitmap pages not read yet are read here) */
+ADF_PREFIX uint32_t adfCountFreeBlocks( struct AdfVolume * const  vol );
 
 ADF_PREFIX bool adfVolBitmapIsMarkedValid( struct AdfVolume * const  vol );
 
@@ -625,10 +625,25 @@ ADF_RETCODE adfReadDirCBlock( const struct AdfVolume * const   vol,
 {
     uint8_t buf[512];
 
-    ADF_RETCODE rc = adfVolReadBlock ( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType ( vol, (uint32_t) nSect, buf,
+                                             ADF_STATS_BLOCK_DIRCACHE );
     if ( rc != ADF_RC_OK )
         return rc;
 
+    return adfDecodeDirCBlock( vol, nSect, buf, dirc );
+}
+
+
+/*
+ * adfDecodeDirCBlock
+ *
+ * decode (and check) raw directory cache block buf (read from sector nSect)
+ */
+ADF_RETCODE adfDecodeDirCBlock( const struct AdfVolume * const   vol,
+                                const ADF_SECTNUM                nSect,
+                                const uint8_t * const            buf,
+                                struct AdfDirCacheBlock * const  dirc )
+{
     memcpy(dirc,buf,512);
 #ifdef LITT_ENDIAN
     adfSwapEndian ( (uint8_t *) dirc, ADF_SWBL_CACHE );
@@ -651,7 +666,7 @@ ADF_RETCODE adfReadDirCBlock( const struct AdfVolume * const   vol,
  * adfWriteDirCblock
  *
  */
-ADF_RETCODE adfWriteDirCBlock( const struct AdfVolume * const   vol,
+ADF_RETCODE adfWriteDirCBlock( struct AdfVolume * const         vol,
                                const int32_t                    nSect,
                                struct AdfDirCacheBlock * const  dirc )
 {
@@ -671,7 +686,7 @@ ADF_RETCODE adfWriteDirCBlock( const struct AdfVolume * const   vol,
 /*    *(int32_t*)(buf+20) = swapUint32fromPtr((uint8_t*)&newSum);*/
 
 /*puts("adfWriteDirCBlock");*/
-    return adfVolWriteBlock ( vol, (uint32_t) nSect, buf );
+    return adfVolWriteBlockOfType ( vol, (uint32_t) nSect, buf, ADF_STATS_BLOCK_DIRCACHE );
 }
 
 /*################################################################################*/
@@ -79,7 +79,12 @@ ADF_PREFIX ADF_RETCODE adfReadDirCBlock( const struct AdfVolume * const   vol,
                                          const ADF_SECTNUM                nSect,
                                          struct AdfDirCacheBlock * const  dirc );
 
-ADF_RETCODE adfWriteDirCBlock( const struct AdfVolume * const   vol,
+ADF_RETCODE adfDecodeDirCBlock( const struct AdfVolume * const   vol,
+                                const ADF_SECTNUM                nSect,
+                                const uint8_t * const            buf,
+                                struct AdfDirCacheBlock * const  dirc );
+
+ADF_RETCODE adfWriteDirCBlock( struct AdfVolume * const         vol,
                                const int32_t                    nSect,
                                struct AdfDirCacheBlock * const  dirc );
 
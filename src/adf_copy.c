@@ -0,0 +1,658 @@
+/*
+ *  adf_copy.c - copying files and directory trees (between volumes)
+ *               and between volumes and the host
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* copy_file_range() */
+#endif
+
+#include "adf_copy.h"
+
+#include "adf_bitm.h"
+#include "adf_cache.h"
+#include "adf_dev.h"
+#include "adf_dev_driver.h"
+#include "adf_dir.h"
+#include "adf_env.h"
+#include "adf_file.h"
+#include "adf_file_block.h"
+#include "adf_file_util.h"
+#include "adf_str.h"
+#include "adf_thread.h"
+#include "adf_util.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+
+/* data blocks exported at once */
+#define ADF_COPY_EXPORT_BATCH  256
+
+
+/* data source (for adfFileAppend) reading the source file */
+struct AdfCopySource_ {
+    const struct AdfFile *  file;
+    uint32_t                offset;
+};
+
+static uint32_t adfCopySourceRead_( void * const     ctx,
+                                    uint8_t * const  buf,
+                                    const uint32_t   n );
+
+static uint32_t adfCopyFdRead_( void * const     ctx,
+                                uint8_t * const  buf,
+                                const uint32_t   n );
+
+static bool adfCopyFdWrite_( const int                fd,
+                             const uint8_t *          buf,
+                             uint32_t                 n );
+
+static uint32_t adfCopyKernel_( const int       fdIn,
+                                const off_t     offset,
+                                const int       fdOut,
+                                const uint32_t  n );
+
+static ADF_RETCODE adfCopyResolvePath_( struct AdfVolume * const  vol,
+                                        const char * const        path,
+                                        ADF_SECTNUM * const       parent,
+                                        char * const              name );
+
+static ADF_RETCODE adfCopyCheckDst_( struct AdfVolume * const  vol,
+                                     const ADF_SECTNUM         parent,
+                                     const char * const        name );
+
+static ADF_RETCODE adfCopyFile_( struct AdfVolume * const  srcVol,
+                                 const ADF_SECTNUM         srcParent,
+                                 const char * const        srcName,
+                                 struct AdfVolume * const  dstVol,
+                                 const ADF_SECTNUM         dstParent,
+                                 const char * const        dstName );
+
+static ADF_RETCODE adfCopyDir_( struct AdfVolume * const  srcVol,
+                                const ADF_SECTNUM         srcDir,
+                                struct AdfVolume * const  dstVol,
+                                const ADF_SECTNUM         dstParent,
+                                const char * const        dstName );
+
+static ADF_RETCODE adfCopyEntryMeta_( const struct AdfEntryBlock * const  src,
+                                      struct AdfVolume * const            dstVol,
+                                      const ADF_SECTNUM                   dstParent,
+                                      const char * const                  dstName );
+
+
+/*****************************************************************************
+ *
+ * Public functions
+ *
+ *****************************************************************************/
+
+/*
+ * adfFileCopy
+ *
+ */
+ADF_RETCODE adfFileCopy( struct AdfVolume * const  srcVol,
+                         const char * const        srcPath,
+                         struct AdfVolume * const  dstVol,
+                         const char * const        dstPath )
+{
+    if ( dstVol->readOnly ) {
+        adfEnv.wFct( "%s: destination volume is read only", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    ADF_SECTNUM srcParent, dstParent;
+    char srcName[ ADF_MAX_NAME_LEN + 1 ],
+         dstName[ ADF_MAX_NAME_LEN + 1 ];
+    ADF_RETCODE rc = adfCopyResolvePath_( srcVol, srcPath, &srcParent, srcName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    rc = adfCopyResolvePath_( dstVol, dstPath, &dstParent, dstName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    rc = adfCopyCheckDst_( dstVol, dstParent, dstName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    rc = adfBitmapDeferUpdates( dstVol );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    rc = adfCopyFile_( srcVol, srcParent, srcName, dstVol, dstParent, dstName );
+    const ADF_RETCODE rcCommit = adfBitmapCommit( dstVol );
+    return ( rc != ADF_RC_OK ) ? rc : rcCommit;
+}
+
+
+/*
+ * adfTreeCopy
+ *
+ */
+ADF_RETCODE adfTreeCopy( struct AdfVolume * const  srcVol,
+                         const char * const        srcPath,
+                         struct AdfVolume * const  dstVol,
+                         const char * const        dstPath )
+{
+    if ( dstVol->readOnly ) {
+        adfEnv.wFct( "%s: destination volume is read only", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    ADF_SECTNUM srcParent, dstParent;
+    char srcName[ ADF_MAX_NAME_LEN + 1 ],
+         dstName[ ADF_MAX_NAME_LEN + 1 ];
+    ADF_RETCODE rc = adfCopyResolvePath_( srcVol, srcPath, &srcParent, srcName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    rc = adfCopyResolvePath_( dstVol, dstPath, &dstParent, dstName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    rc = adfCopyCheckDst_( dstVol, dstParent, dstName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    struct AdfEntryBlock entry;
+    ADF_SECTNUM srcSect = adfGetEntryBlock( srcVol, srcParent, srcName, &entry );
+    if ( srcSect == -1 ) {
+        adfEnv.wFct( "%s: '%s' not found", __func__, srcPath );
+        return ADF_RC_ERROR;
+    }
+    if ( entry.secType == ADF_ST_LDIR ) {
+        srcSect = entry.realEntry;
+        rc = adfReadEntryBlock( srcVol, srcSect, &entry );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+
+    if ( entry.secType != ADF_ST_DIR )
+        return adfFileCopy( srcVol, srcPath, dstVol, dstPath );
+
+    // a directory cannot be copied into itself (or its subdirectory)
+    if ( srcVol == dstVol ) {
+        for ( ADF_SECTNUM dir = dstParent ; dir != 0 ; ) {
+            if ( dir == srcSect ) {
+                adfEnv.wFct( "%s: cannot copy '%s' into itself", __func__, srcPath );
+                return ADF_RC_ERROR;
+            }
+            if ( dir == dstVol->rootBlock )
+                break;
+            struct AdfEntryBlock dirBlock;
+            rc = adfReadEntryBlock( dstVol, dir, &dirBlock );
+            if ( rc != ADF_RC_OK )
+                return rc;
+            dir = dirBlock.parent;
+        }
+    }
+
+    rc = adfBitmapDeferUpdates( dstVol );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    rc = adfCopyDir_( srcVol, srcSect, dstVol, dstParent, dstName );
+    const ADF_RETCODE rcCommit = adfBitmapCommit( dstVol );
+    return ( rc != ADF_RC_OK ) ? rc : rcCommit;
+}
+
+
+/*
+ * adfFileExportToFd
+ *
+ * the data blocks are processed in batches; for FFS on a device with a host
+ * file descriptor, runs of consecutive blocks are copied by the kernel
+ * (straight from the image), other data is read with adfFilePread()
+ */
+ADF_RETCODE adfFileExportToFd( const struct AdfFile * const  file,
+                               const int                     fd )
+{
+    const struct AdfVolume * const vol = file->volume;
+    struct AdfDevice * const       dev = vol->dev;
+    const unsigned blockSize   = vol->datablockSize;
+    const uint32_t size        = adfFileGetSize( file );
+    const unsigned nDataBlocks = adfFileSize2Datablocks( size, blockSize );
+
+    uint8_t * const buf = malloc( ADF_COPY_EXPORT_BATCH * 512 );
+    if ( buf == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+
+    ADF_SECTNUM sectors[ ADF_COPY_EXPORT_BATCH ];
+    bool kernelCopy = adfVolIsFFS( vol ) &&
+                      dev->drv->getHostFd != NULL &&
+                      dev->geometry.blockSize == 512 &&
+                      adfDevFlush( dev ) == ADF_RC_OK;  // (buffered writes)
+    ADF_RETCODE rc = ADF_RC_OK;
+    for ( unsigned first = 0, nBatch ; first < nDataBlocks ; first += nBatch ) {
+        nBatch = min( (unsigned) ADF_COPY_EXPORT_BATCH, nDataBlocks - first );
+        const uint32_t batchStart = first * blockSize,
+                       batchSize  = min( nBatch * blockSize, size - batchStart );
+        uint32_t done = 0;
+
+        if ( kernelCopy ) {
+            rc = adfFileGetDataBlockSectors( file, first, nBatch, sectors );
+            if ( rc != ADF_RC_OK )
+                break;
+
+            adfMutexLock( dev->ioLock );
+            const int hostFd = dev->drv->getHostFd( dev );
+            kernelCopy = ( hostFd >= 0 );
+            for ( unsigned i = 0, nRun ; kernelCopy && i < nBatch ; i += nRun ) {
+                nRun = 1;
+                while ( i + nRun < nBatch &&
+                        sectors[ i + nRun ] == sectors[ i ] + (ADF_SECTNUM) nRun )
+                    nRun++;
+
+                const uint32_t runSize = min( nRun * 512, batchSize - done );
+                const off_t    offset  =
+                    (off_t) ( vol->firstBlock + sectors[ i ] ) * 512;
+                const uint32_t copied  = adfCopyKernel_( hostFd, offset, fd, runSize );
+                done += copied;
+                kernelCopy = ( copied == runSize );
+            }
+            adfMutexUnlock( dev->ioLock );
+        }
+
+        // the rest (all, if not copied by the kernel)
+        if ( done < batchSize ) {
+            const struct AdfIoVec iov = { buf, batchSize - done };
+            if ( adfFilePread( file, batchStart + done, &iov, 1 ) != iov.len ) {
+                adfEnv.eFct( "%s: error reading file data", __func__ );
+                rc = ADF_RC_ERROR;
+                break;
+            }
+            if ( ! adfCopyFdWrite_( fd, buf, iov.len ) ) {
+                adfEnv.eFct( "%s: error writing to fd %d", __func__, fd );
+                rc = ADF_RC_ERROR;
+                break;
+            }
+        }
+    }
+
+    free( buf );
+    return rc;
+}
+
+
+/*
+ * adfFileImportFromFd
+ *
+ * the file is created with its final size at once (adfFileAppend()),
+ * the data read from fd directly into runs of data blocks
+ */
+ADF_RETCODE adfFileImportFromFd( struct AdfVolume * const  vol,
+                                 const char * const        name,
+                                 const int                 fd,
+                                 const uint32_t            size )
+{
+    ADF_RETCODE rc = adfCopyCheckDst_( vol, vol->curDirPtr, name );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    struct AdfFile * const file = adfFileOpen( vol, name, ADF_FILE_MODE_WRITE );
+    if ( file == NULL )
+        return ADF_RC_ERROR;
+
+    int fdIn = fd;
+    rc = adfFileAppend( file, size, adfCopyFdRead_, &fdIn );
+    adfFileClose( file );
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error importing '%s' from fd %d", __func__, name, fd );
+        // (not leaving a partial file)
+        adfRemoveEntry( vol, vol->curDirPtr, name );
+    }
+    return rc;
+}
+
+
+/*****************************************************************************
+ *
+ * Private functions
+ *
+ *****************************************************************************/
+
+/*
+ * adfCopySourceRead_
+ *
+ */
+static uint32_t adfCopySourceRead_( void * const     ctx,
+                                    uint8_t * const  buf,
+                                    const uint32_t   n )
+{
+    struct AdfCopySource_ * const src = (struct AdfCopySource_ *) ctx;
+    const struct AdfIoVec iov = { buf, n };
+    const uint32_t nRead = adfFilePread( src->file, src->offset, &iov, 1 );
+    src->offset += nRead;
+    return nRead;
+}
+
+
+/*
+ * adfCopyFdRead_
+ *
+ * data source reading a host file descriptor (ctx)
+ */
+static uint32_t adfCopyFdRead_( void * const     ctx,
+                                uint8_t * const  buf,
+                                const uint32_t   n )
+{
+    const int fd = *(const int *) ctx;
+    uint32_t nRead = 0;
+    while ( nRead < n ) {
+        const long r = (long) read( fd, buf + nRead, n - nRead );
+        if ( r < 0 && errno == EINTR )
+            continue;
+        if ( r <= 0 )
+            break;
+        nRead += (uint32_t) r;
+    }
+    return nRead;
+}
+
+
+/*
+ * adfCopyFdWrite_
+ *
+ */
+static bool adfCopyFdWrite_( const int                fd,
+                             const uint8_t *          buf,
+                             uint32_t                 n )
+{
+    while ( n > 0 ) {
+        const long r = (long) write( fd, buf, n );
+        if ( r < 0 && errno == EINTR )
+            continue;
+        if ( r <= 0 )
+            return false;
+        buf += r;
+        n   -= (uint32_t) r;
+    }
+    return true;
+}
+
+
+/*
+ * adfCopyKernel_
+ *
+ * copy n bytes from offset of fdIn to (the position of) fdOut in the kernel;
+ * returns the number of bytes copied (less than n if not possible)
+ */
+static uint32_t adfCopyKernel_( const int       fdIn,
+                                const off_t     offset,
+                                const int       fdOut,
+                                const uint32_t  n )
+{
+    off_t    offsetIn = offset;
+    uint32_t copied   = 0;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    while ( copied < n ) {
+        const ssize_t r = copy_file_range( fdIn, &offsetIn, fdOut, NULL,
+                                           n - copied, 0 );
+        if ( r < 0 && errno == EINTR )
+            continue;
+        if ( r <= 0 )
+            break;     // (eg. EXDEV or ENOSYS - try sendfile)
+        copied += (uint32_t) r;
+    }
+#endif
+
+#ifdef HAVE_SENDFILE
+    while ( copied < n ) {
+        const ssize_t r = sendfile( fdOut, fdIn, &offsetIn, n - copied );
+        if ( r < 0 && errno == EINTR )
+            continue;
+        if ( r <= 0 )
+            break;
+        copied += (uint32_t) r;
+    }
+#endif
+
+    (void) fdIn;
+    (void) fdOut;
+    (void) offsetIn;
+    return copied;
+}
+
+
+/*
+ * adfCopyResolvePath_
+ *
+ * get the parent directory (from the current directory of the volume)
+ * and the name of the last element of path
+ */
+static ADF_RETCODE adfCopyResolvePath_( struct AdfVolume * const  vol,
+                                        const char * const        path,
+                                        ADF_SECTNUM * const       parent,
+                                        char * const              name )
+{
+    ADF_SECTNUM dir = vol->curDirPtr;
+    const char * elem = path;
+    name[ 0 ] = '\0';
+
+    while ( *elem != '\0' ) {
+        const char * const sep = strchr( elem, '/' );
+        const size_t len = ( sep != NULL ) ? (size_t) ( sep - elem ) : strlen( elem );
+        if ( len > ADF_MAX_NAME_LEN ) {
+            adfEnv.wFct( "%s: name too long in '%s'", __func__, path );
+            return ADF_RC_ERROR;
+        }
+
+        if ( len > 0 ) {
+            // the previous element must be a directory
+            if ( name[ 0 ] != '\0' ) {
+                struct AdfEntryBlock entry;
+                ADF_SECTNUM nSect = adfGetEntryBlock( vol, dir, name, &entry );
+                if ( nSect == -1 ) {
+                    adfEnv.wFct( "%s: '%s' not found in '%s'", __func__, name, path );
+                    return ADF_RC_ERROR;
+                }
+                if ( entry.secType == ADF_ST_LDIR )
+                    nSect = entry.realEntry;
+                else if ( entry.secType != ADF_ST_DIR ) {
+                    adfEnv.wFct( "%s: '%s' is not a directory in '%s'",
+                                 __func__, name, path );
+                    return ADF_RC_ERROR;
+                }
+                dir = nSect;
+            }
+            memcpy( name, elem, len );
+            name[ len ] = '\0';
+        }
+
+        if ( sep == NULL )
+            break;
+        elem = sep + 1;
+    }
+
+    if ( name[ 0 ] == '\0' ) {
+        adfEnv.wFct( "%s: invalid path '%s'", __func__, path );
+        return ADF_RC_ERROR;
+    }
+    *parent = dir;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfCopyCheckDst_
+ *
+ */
+static ADF_RETCODE adfCopyCheckDst_( struct AdfVolume * const  vol,
+                                     const ADF_SECTNUM         parent,
+                                     const char * const        name )
+{
+    struct AdfEntryBlock entry;
+    if ( adfGetEntryBlock( vol, parent, name, &entry ) != -1 ) {
+        adfEnv.wFct( "%s: '%s' already exists", __func__, name );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfCopyFile_
+ *
+ * the destination file is created with its final size at once
+ * (adfFileAppend()), reading the source in runs of data blocks
+ */
+static ADF_RETCODE adfCopyFile_( struct AdfVolume * const  srcVol,
+                                 const ADF_SECTNUM         srcParent,
+                                 const char * const        srcName,
+                                 struct AdfVolume * const  dstVol,
+                                 const ADF_SECTNUM         dstParent,
+                                 const char * const        dstName )
+{
+    // files are opened in a directory given with curDirPtr
+    const ADF_SECTNUM srcCurDir = srcVol->curDirPtr;
+    srcVol->curDirPtr = srcParent;
+    struct AdfFile * const srcFile = adfFileOpen( srcVol, srcName, ADF_FILE_MODE_READ );
+    srcVol->curDirPtr = srcCurDir;
+    if ( srcFile == NULL )
+        return ADF_RC_ERROR;
+
+    const ADF_SECTNUM dstCurDir = dstVol->curDirPtr;
+    dstVol->curDirPtr = dstParent;
+    struct AdfFile * const dstFile = adfFileOpen( dstVol, dstName, ADF_FILE_MODE_WRITE );
+    dstVol->curDirPtr = dstCurDir;
+    if ( dstFile == NULL ) {
+        adfFileClose( srcFile );
+        return ADF_RC_ERROR;
+    }
+
+    struct AdfCopySource_ source = { srcFile, 0 };
+    ADF_RETCODE rc = adfFileAppend( dstFile, adfFileGetSize( srcFile ),
+                                    adfCopySourceRead_, &source );
+    adfFileClose( dstFile );
+
+    // (the header of an opened file is the real one, also for a hard link)
+    struct AdfEntryBlock srcEntry;
+    memcpy( &srcEntry, srcFile->fileHdr, sizeof(struct AdfEntryBlock) );
+    adfFileClose( srcFile );
+
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error copying '%s'", __func__, srcName );
+        // (not leaving a partial copy)
+        adfRemoveEntry( dstVol, dstParent, dstName );
+        return rc;
+    }
+    return adfCopyEntryMeta_( &srcEntry, dstVol, dstParent, dstName );
+}
+
+
+/*
+ * adfCopyDir_
+ *
+ */
+static ADF_RETCODE adfCopyDir_( struct AdfVolume * const  srcVol,
+                                const ADF_SECTNUM         srcDir,
+                                struct AdfVolume * const  dstVol,
+                                const ADF_SECTNUM         dstParent,
+                                const char * const        dstName )
+{
+    struct AdfEntryBlock srcEntry;
+    ADF_RETCODE rc = adfReadEntryBlock( srcVol, srcDir, &srcEntry );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    rc = adfCreateDir( dstVol, dstParent, dstName );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    struct AdfEntryBlock dstEntry;
+    const ADF_SECTNUM dstDir = adfGetEntryBlock( dstVol, dstParent, dstName, &dstEntry );
+    if ( dstDir == -1 )
+        return ADF_RC_ERROR;
+
+    struct AdfList * const list = adfGetDirEnt( srcVol, srcDir );
+    for ( const struct AdfList * cell = list ; cell != NULL && rc == ADF_RC_OK ;
+          cell = cell->next )
+    {
+        const struct AdfEntry * const entry = (const struct AdfEntry *) cell->content;
+        switch ( entry->type ) {
+        case ADF_ST_FILE:
+            rc = adfCopyFile_( srcVol, srcDir, entry->name, dstVol, dstDir, entry->name );
+            break;
+        case ADF_ST_DIR:
+            rc = adfCopyDir_( srcVol, entry->sector, dstVol, dstDir, entry->name );
+            break;
+        default:
+            adfEnv.wFct( "%s: '%s' is a link, skipped", __func__, entry->name );
+        }
+    }
+    adfFreeDirList( list );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    // (after the contents - creating entries updates the directory)
+    return adfCopyEntryMeta_( &srcEntry, dstVol, dstParent, dstName );
+}
+
+
+/*
+ * adfCopyEntryMeta_
+ *
+ * set protection bits, comment and date of the destination entry
+ * as in the source one
+ */
+static ADF_RETCODE adfCopyEntryMeta_( const struct AdfEntryBlock * const  src,
+                                      struct AdfVolume * const            dstVol,
+                                      const ADF_SECTNUM                   dstParent,
+                                      const char * const                  dstName )
+{
+    struct AdfEntryBlock parent, entry;
+    ADF_RETCODE rc = adfReadEntryBlock( dstVol, dstParent, &parent );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    const ADF_SECTNUM nSect =
+        adfNameToEntryBlk( dstVol, parent.hashTable, dstName, &entry, NULL );
+    if ( nSect == -1 ) {
+        adfEnv.eFct( "%s: entry '%s' not found", __func__, dstName );
+        return ADF_RC_ERROR;
+    }
+
+    entry.access  = src->access;
+    entry.commLen = src->commLen;
+    memcpy( entry.comment, src->comment, sizeof(entry.comment) );
+    entry.days    = src->days;
+    entry.mins    = src->mins;
+    entry.ticks   = src->ticks;
+
+    rc = ( entry.secType == ADF_ST_DIR ) ?
+        adfWriteDirBlock( dstVol, nSect, (struct AdfDirBlock *) &entry ) :
+        adfWriteFileHdrBlock( dstVol, nSect, (struct AdfFileHeaderBlock *) &entry );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    if ( adfVolHasDIRCACHE( dstVol ) )
+        rc = adfUpdateCache( dstVol, &parent, &entry, true );
+    return rc;
+}
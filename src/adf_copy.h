@@ -0,0 +1,77 @@
+/*
+ *  adf_copy.h - copying files and directory trees (between volumes)
+ *               and between volumes and the host
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_COPY_H
+#define ADF_COPY_H
+
+#include "adf_err.h"
+#include "adf_file.h"
+#include "adf_prefix.h"
+#include "adf_vol.h"
+
+/*
+ * Paths are relative to the current directory of the volume (curDirPtr),
+ * with names separated with '/'. The destination must not exist.
+ *
+ * Files are copied in runs of data blocks (all blocks of the destination
+ * allocated at once), converting the data between OFS and FFS if needed.
+ * Protection bits, comments and dates are preserved; the destination
+ * bitmap is written once, after all data is copied.
+ *
+ * The volumes can be the same (but a directory cannot be copied into
+ * itself). Links are not copied (skipped with a warning).
+ */
+
+ADF_PREFIX ADF_RETCODE adfFileCopy( struct AdfVolume * const  srcVol,
+                                    const char * const        srcPath,
+                                    struct AdfVolume * const  dstVol,
+                                    const char * const        dstPath );
+
+/* copy a file or a directory with all its contents */
+ADF_PREFIX ADF_RETCODE adfTreeCopy( struct AdfVolume * const  srcVol,
+                                    const char * const        srcPath,
+                                    struct AdfVolume * const  dstVol,
+                                    const char * const        dstPath );
+
+
+/*
+ * Host import/export: the file data is written to / read from a host
+ * file descriptor (at its current position).
+ *
+ * Exporting an FFS file from a device giving a host file descriptor
+ * (a dump) copies physically contiguous runs of data blocks in the kernel
+ * (copy_file_range() or sendfile(), if available). Otherwise (or if these
+ * fail) the data is copied through a buffer.
+ */
+
+ADF_PREFIX ADF_RETCODE adfFileExportToFd( const struct AdfFile * const  file,
+                                          const int                     fd );
+
+/* create file name (in the current directory) with size bytes read from fd */
+ADF_PREFIX ADF_RETCODE adfFileImportFromFd( struct AdfVolume * const  vol,
+                                            const char * const        name,
+                                            const int                 fd,
+                                            const uint32_t            size );
+
+#endif  /* ADF_COPY_H */
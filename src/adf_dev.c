@@ -28,8 +28,11 @@
 #include "adf_dev_flop.h"
 #include "adf_dev_hd.h"
 #include "adf_dev_hdfile.h"
+#include "adf_dev_trace.h"
 #include "adf_env.h"
 #include "adf_limits.h"
+#include "adf_thread.h"
+#include "adf_util.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -43,6 +46,57 @@ static struct AdfDevice * adfDevOpenWithDrv_(
 static ADF_RETCODE adfDevSetCalculatedGeometry_( struct AdfDevice * const  dev );
 static ADF_RETCODE adfDevReadRdb( struct AdfDevice * const dev );
 
+static unsigned adfDevWBufFind_( const struct AdfDevWriteBuffer * const  wBuf,
+                                 const uint32_t                          pSect );
+
+static ADF_RETCODE adfDevWBufWrite_( const struct AdfDevice * const  dev,
+                                     const uint32_t                  pSect,
+                                     const uint8_t * const           block );
+
+static void adfDevWBufRead_( const struct AdfDevice * const  dev,
+                             const uint32_t                  pSect,
+                             const uint32_t                  size,
+                             uint8_t * const                 buf );
+
+static ADF_RETCODE adfDevWBufFlush_( const struct AdfDevice * const  dev );
+
+static ADF_RETCODE adfDevReadBlock_( const struct AdfDevice * const  dev,
+                                     const uint32_t                  pSect,
+                                     const uint32_t                  size,
+                                     uint8_t * const                 buf,
+                                     const AdfStatsBlockType         type,
+                                     const AdfTraceSource            source );
+
+static ADF_RETCODE adfDevReadBlocks_( const struct AdfDevice * const  dev,
+                                      const unsigned                  nBlocks,
+                                      const uint32_t * const          pSects,
+                                      uint8_t * const * const         bufs,
+                                      const AdfStatsBlockType         type,
+                                      const AdfTraceSource            source );
+
+static ADF_RETCODE adfDevWriteBlock_( const struct AdfDevice * const  dev,
+                                      const uint32_t                  pSect,
+                                      const uint32_t                  size,
+                                      const uint8_t * const           buf,
+                                      const AdfStatsBlockType         type,
+                                      const AdfTraceSource            source );
+
+
+/* write-back buffer (accessed only with dev->ioLock locked) */
+struct AdfDevWBufEntry {
+    uint32_t  pSect;
+    unsigned  slot;            /* index of the block in data */
+};
+
+struct AdfDevWriteBuffer {
+    unsigned                  maxBlocks,
+                              nBlocks;
+    struct AdfDevWBufEntry *  entries;    /* nBlocks, sorted by sector */
+    unsigned *                freeSlots;  /* maxBlocks - nBlocks, a stack */
+    uint8_t *                 data;       /* maxBlocks blocks */
+    uint8_t *                 runBuf;     /* ADF_DEV_WRITE_RUN_MAX blocks */
+};
+
 
 /*****************************************************************************
  *
@@ -60,10 +114,11 @@ struct AdfDevice * adfDevCreate(  const char * const  driverName,
                                   const uint32_t      heads,
                                   const uint32_t      sectors )
 {
-    uint32_t sizeBlocks = cylinders * heads * sectors;
+    const uint64_t sizeBlocks = (uint64_t) cylinders * heads * sectors;
     if ( sizeBlocks > ADF_DEV_SIZE_MAX_BLOCKS ) {
-        adfEnv.eFct( " %s: size %u blocks is bigger than max. %u blocks",
-                     sizeBlocks, ADF_DEV_SIZE_MAX_BLOCKS );
+        adfEnv.eFct( " %s: size %llu blocks is bigger than max. %llu blocks",
+                     __func__, (unsigned long long) sizeBlocks,
+                     (unsigned long long) ADF_DEV_SIZE_MAX_BLOCKS );
         return NULL;
     }
 
@@ -77,6 +132,11 @@ struct AdfDevice * adfDevCreate(  const char * const  driverName,
 
     dev->rdb.status = ADF_DEV_RDB_STATUS_NOTFOUND;  // better: ADF_DEV_RDB_STATUS_UNCHECKED ?
     dev->rdb.block  = NULL;
+    dev->ioLock     = adfMutexCreate();
+    dev->wBuf       = NULL;
+    dev->syncPolicy = ADF_SYNC_NONE;
+    dev->stats      = calloc( 1, sizeof(struct AdfDevStats) );
+    dev->trace      = NULL;
 
     return dev;
 }
@@ -108,19 +168,42 @@ struct AdfDevice * adfDevOpenWithDriver( const char * const   driverName,
  * adfDevClose
  *
  * Closes/releases an opened device.
+ * Returns an error if buffered or pending writes could not be completed.
  */
-void adfDevClose( struct AdfDevice * const  dev )
+ADF_RETCODE adfDevClose( struct AdfDevice * const  dev )
 {
     if ( dev == NULL )
-        return;
+        return ADF_RC_OK;
 
     free( dev->rdb.block );
     dev->rdb.block = NULL;
 
-    if ( dev->mounted )
+    ADF_RETCODE rc = ADF_RC_OK;
+    if ( dev->mounted ) {
         adfDevUnMount( dev );
+    } else if ( ! dev->readOnly ) {
+        rc = adfDevSyncPoint( dev, ADF_SYNC_UNMOUNT );
+        if ( rc != ADF_RC_OK )
+            adfEnv.eFct( "%s: error syncing device '%s'", __func__, dev->name );
+    }
+
+    const ADF_RETCODE rcWBuf = adfDevSetWriteBuffer( dev, 0 );
+    if ( rcWBuf != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error writing buffered blocks to device '%s'",
+                     __func__, dev->name );
+        if ( rc == ADF_RC_OK )
+            rc = rcWBuf;
+    }
+    if ( dev->trace != NULL )
+        adfDevTraceStop( dev );
+
+    adfMutexDestroy( dev->ioLock );
+    dev->ioLock = NULL;
+    free( dev->stats );
+    dev->stats = NULL;
 
-    dev->drv->closeDev( dev );
+    const ADF_RETCODE rcClose = dev->drv->closeDev( dev );
+    return ( rc != ADF_RC_OK ) ? rc : rcClose;
 }
 
 
@@ -177,6 +260,8 @@ void adfDevUnMount( struct AdfDevice * const  dev )
     //if ( dev->volList ) {
     if ( dev->nVol > 0 ) {
         for ( int i = 0 ; i < dev->nVol ; i++ ) {
+            if ( dev->volList[i]->mounted )
+                adfVolUnMount ( dev->volList[i] );
             free ( dev->volList[i]->volName );
             free ( dev->volList[i] );
         }
@@ -184,10 +269,120 @@ void adfDevUnMount( struct AdfDevice * const  dev )
         dev->nVol = 0;
     }
 
+    if ( ! dev->readOnly ) {
+        adfDevFlush( dev );
+        if ( adfDevSyncPoint( dev, ADF_SYNC_UNMOUNT ) != ADF_RC_OK )
+            adfEnv.eFct( "%s: error syncing device '%s'", __func__, dev->name );
+    }
+
     dev->volList = NULL;
     dev->mounted = false;
 }
 
+/*
+ * adfDevForEachVolume
+ *
+ */
+struct AdfDevForEach {
+    struct AdfDevice *  dev;
+    AdfVolFct           fct;
+    void *              data;
+    ADF_RETCODE *       status;
+    struct AdfMutex *   lock;
+    int                 next;     /* next volume to process */
+};
+
+static void adfDevForEachWorker_( void * const  arg )
+{
+    struct AdfDevForEach * const job = arg;
+    while ( true ) {
+        adfMutexLock( job->lock );
+        const int nPart = job->next++;
+        adfMutexUnlock( job->lock );
+
+        if ( nPart >= job->dev->nVol )
+            break;
+        job->status[ nPart ] = job->fct( job->dev->volList[ nPart ],
+                                         nPart, job->data );
+    }
+}
+
+ADF_RETCODE adfDevForEachVolume( struct AdfDevice * const  dev,
+                                 const unsigned            nThreads,
+                                 const AdfVolFct           fct,
+                                 void * const              data,
+                                 ADF_RETCODE * const       status )
+{
+    if ( dev == NULL || ! dev->mounted ) {
+        adfEnv.eFct( "%s: device not mounted", __func__ );
+        return ADF_RC_ERROR;
+    }
+    if ( dev->nVol < 1 )
+        return ADF_RC_OK;
+
+    struct AdfDevForEach job = {
+        .dev    = dev,
+        .fct    = fct,
+        .data   = data,
+        .status = status,
+        .lock   = NULL,
+        .next   = 0
+    };
+    if ( job.status == NULL ) {
+        job.status = (ADF_RETCODE *) malloc( sizeof(ADF_RETCODE) * (unsigned) dev->nVol );
+        if ( job.status == NULL ) {
+            adfEnv.eFct( "%s: malloc", __func__ );
+            return ADF_RC_MALLOC;
+        }
+    }
+
+    /* without the device lock - the device cannot be shared */
+    unsigned nWorkers = min( nThreads, (unsigned) dev->nVol );
+    if ( nWorkers > 1 && dev->ioLock != NULL ) {
+        job.lock = adfMutexCreate();
+        if ( job.lock == NULL )
+            nWorkers = 1;
+    } else {
+        nWorkers = 1;
+    }
+
+    adfThreadsRun( nWorkers, adfDevForEachWorker_, &job );
+    adfMutexDestroy( job.lock );
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    for ( int i = 0 ; i < dev->nVol && rc == ADF_RC_OK ; i++ )
+        rc = job.status[ i ];
+
+    if ( status == NULL )
+        free( job.status );
+    return rc;
+}
+
+
+/*
+ * adfDevMountAll
+ *
+ */
+static ADF_RETCODE adfDevMountVol_( struct AdfVolume * const  vol,
+                                    const int                 nPart,
+                                    void * const              mode )
+{
+    if ( vol->mounted )
+        return ADF_RC_OK;
+    return ( adfVolMount( vol->dev, nPart, *(AdfAccessMode *) mode ) != NULL ?
+             ADF_RC_OK : ADF_RC_ERROR );
+}
+
+ADF_RETCODE adfDevMountAll( struct AdfDevice * const  dev,
+                            const AdfAccessMode       mode,
+                            const unsigned            nThreads,
+                            ADF_RETCODE * const       status )
+{
+    AdfAccessMode volMode = mode;
+    return adfDevForEachVolume( dev, nThreads, adfDevMountVol_, &volMode, status );
+}
+
+
 /*
  * adfDevReadBlock
  *
@@ -197,10 +392,33 @@ ADF_RETCODE adfDevReadBlock( const struct AdfDevice * const  dev,
                              const uint32_t                  size,
                              uint8_t * const                 buf )
 {
+    return adfDevReadBlock_( dev, pSect, size, buf,
+                             ADF_STATS_BLOCK_OTHER, ADF_TRACE_SRC_DEVICE );
+}
+
+ADF_RETCODE adfDevReadBlockOfType( const struct AdfDevice * const  dev,
+                                   const uint32_t                  pSect,
+                                   const uint32_t                  size,
+                                   uint8_t * const                 buf,
+                                   const AdfStatsBlockType         type )
+{
+    return adfDevReadBlock_( dev, pSect, size, buf, type, ADF_TRACE_SRC_VOLUME );
+}
+
+static ADF_RETCODE adfDevReadBlock_( const struct AdfDevice * const  dev,
+                                     const uint32_t                  pSect,
+                                     const uint32_t                  size,
+                                     uint8_t * const                 buf,
+                                     const AdfStatsBlockType         type,
+                                     const AdfTraceSource            source )
+{
+    adfMutexLock( dev->ioLock );
+    const uint64_t start = ( dev->trace != NULL ) ? adfStatsClockNs() : 0;
+
     const unsigned nFullBlocks = size / dev->geometry.blockSize;
-    ADF_RETCODE rc = dev->drv->readSectors( dev, pSect, nFullBlocks, buf );
+    ADF_RETCODE rc = adfDevDrvReadSectors( dev, pSect, nFullBlocks, buf );
     if ( rc != ADF_RC_OK )
-        return rc;
+        goto unlock;
 
     const unsigned remainder = size % dev->geometry.blockSize;
     if ( remainder != 0 ) {
@@ -209,15 +427,119 @@ ADF_RETCODE adfDevReadBlock( const struct AdfDevice * const  dev,
 #else
         uint8_t blockBuf[ dev->geometry.blockSize ];
 #endif
-        ADF_RETCODE rc = dev->drv->readSectors( dev, pSect + nFullBlocks, 1, blockBuf );
+        rc = adfDevDrvReadSectors( dev, pSect + nFullBlocks, 1, blockBuf );
         if ( rc != ADF_RC_OK )
-            return rc;
+            goto unlock;
         memcpy( buf + size - remainder, blockBuf, remainder );
     }
 
-    return ADF_RC_OK;
+    if ( dev->wBuf != NULL && dev->wBuf->nBlocks > 0 )
+        adfDevWBufRead_( dev, pSect, size, buf );
+
+unlock:
+    if ( dev->trace != NULL )
+        adfDevTraceAdd( dev, ADF_TRACE_OP_READ, pSect,
+                        ( size + dev->geometry.blockSize - 1 ) / dev->geometry.blockSize,
+                        type, source, start, adfStatsClockNs(), rc );
+    adfMutexUnlock( dev->ioLock );
+    return rc;
 }
 
+/*
+ * adfDevReadBlocks
+ *
+ */
+struct AdfDevBlockReq {
+    uint32_t   pSect;
+    uint8_t *  buf;
+};
+
+static int adfDevBlockReqCmp_( const void * const  a,
+                               const void * const  b )
+{
+    const uint32_t
+        sa = ( (const struct AdfDevBlockReq *) a )->pSect,
+        sb = ( (const struct AdfDevBlockReq *) b )->pSect;
+    return ( sa > sb ) - ( sa < sb );
+}
+
+ADF_RETCODE adfDevReadBlocks( const struct AdfDevice * const  dev,
+                              const unsigned                  nBlocks,
+                              const uint32_t * const          pSects,
+                              uint8_t * const * const         bufs )
+{
+    return adfDevReadBlocks_( dev, nBlocks, pSects, bufs,
+                              ADF_STATS_BLOCK_OTHER, ADF_TRACE_SRC_DEVICE );
+}
+
+ADF_RETCODE adfDevReadBlocksOfType( const struct AdfDevice * const  dev,
+                                    const unsigned                  nBlocks,
+                                    const uint32_t * const          pSects,
+                                    uint8_t * const * const         bufs,
+                                    const AdfStatsBlockType         type )
+{
+    return adfDevReadBlocks_( dev, nBlocks, pSects, bufs, type, ADF_TRACE_SRC_VOLUME );
+}
+
+static ADF_RETCODE adfDevReadBlocks_( const struct AdfDevice * const  dev,
+                                      const unsigned                  nBlocks,
+                                      const uint32_t * const          pSects,
+                                      uint8_t * const * const         bufs,
+                                      const AdfStatsBlockType         type,
+                                      const AdfTraceSource            source )
+{
+    if ( nBlocks < 1 )
+        return ADF_RC_OK;
+
+    const uint32_t blockSize = dev->geometry.blockSize;
+
+    struct AdfDevBlockReq * const reqs = (struct AdfDevBlockReq *)
+        malloc( sizeof(struct AdfDevBlockReq) * nBlocks );
+    uint8_t * const runBuf = (uint8_t *) malloc( blockSize * ADF_DEV_READ_RUN_MAX );
+    if ( reqs == NULL || runBuf == NULL ) {
+        free( reqs );
+        free( runBuf );
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+
+    for ( unsigned i = 0 ; i < nBlocks ; i++ ) {
+        reqs[ i ].pSect = pSects[ i ];
+        reqs[ i ].buf   = bufs[ i ];
+    }
+    qsort( reqs, nBlocks, sizeof(struct AdfDevBlockReq), adfDevBlockReqCmp_ );
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    unsigned first = 0;
+    while ( first < nBlocks ) {
+        /* find a run of blocks close enough to be read at once */
+        const uint32_t runStart = reqs[ first ].pSect;
+        unsigned last = first;
+        while ( last + 1 < nBlocks &&
+                reqs[ last + 1 ].pSect - reqs[ last ].pSect <= ADF_DEV_READ_GAP_MAX &&
+                reqs[ last + 1 ].pSect - runStart < ADF_DEV_READ_RUN_MAX )
+        {
+            last++;
+        }
+        const uint32_t runLen = reqs[ last ].pSect - runStart + 1;
+
+        rc = adfDevReadBlock_( dev, runStart, runLen * blockSize, runBuf, type, source );
+        if ( rc != ADF_RC_OK )
+            break;
+
+        for ( unsigned i = first ; i <= last ; i++ )
+            memcpy( reqs[ i ].buf,
+                    runBuf + ( reqs[ i ].pSect - runStart ) * blockSize,
+                    blockSize );
+        first = last + 1;
+    }
+
+    free( runBuf );
+    free( reqs );
+    return rc;
+}
+
+
 /*
  * adfDevWriteBlock
  *
@@ -227,35 +549,394 @@ ADF_RETCODE adfDevWriteBlock( const struct AdfDevice * const  dev,
                               const uint32_t                  size,
                               const uint8_t * const           buf )
 {
-    const unsigned nFullBlocks = size / dev->geometry.blockSize;
-    ADF_RETCODE rc = dev->drv->writeSectors( dev, pSect, nFullBlocks, buf );
-    if ( rc != ADF_RC_OK )
-        return rc;
+    return adfDevWriteBlock_( dev, pSect, size, buf,
+                              ADF_STATS_BLOCK_OTHER, ADF_TRACE_SRC_DEVICE );
+}
+
+ADF_RETCODE adfDevWriteBlockOfType( const struct AdfDevice * const  dev,
+                                    const uint32_t                  pSect,
+                                    const uint32_t                  size,
+                                    const uint8_t * const           buf,
+                                    const AdfStatsBlockType         type )
+{
+    return adfDevWriteBlock_( dev, pSect, size, buf, type, ADF_TRACE_SRC_VOLUME );
+}
+
+static ADF_RETCODE adfDevWriteBlock_( const struct AdfDevice * const  dev,
+                                      const uint32_t                  pSect,
+                                      const uint32_t                  size,
+                                      const uint8_t * const           buf,
+                                      const AdfStatsBlockType         type,
+                                      const AdfTraceSource            source )
+{
+    adfMutexLock( dev->ioLock );
+    const uint64_t start = ( dev->trace != NULL ) ? adfStatsClockNs() : 0;
+
+    const uint32_t blockSize   = dev->geometry.blockSize;
+    const unsigned nFullBlocks = size / blockSize,
+                   remainder   = size % blockSize;
+    struct AdfDevWriteBuffer * const wBuf = dev->wBuf;
+    ADF_RETCODE rc;
+
+    if ( wBuf != NULL && nFullBlocks + ( remainder != 0 ) <= wBuf->maxBlocks ) {
+        for ( unsigned i = 0 ; i < nFullBlocks ; i++ ) {
+            rc = adfDevWBufWrite_( dev, pSect + i, buf + i * blockSize );
+            if ( rc != ADF_RC_OK )
+                goto unlock;
+        }
+    } else {
+        // (does not fit in the buffer - written directly, after it)
+        rc = ( wBuf != NULL ) ? adfDevWBufFlush_( dev ) : ADF_RC_OK;
+        if ( rc != ADF_RC_OK )
+            goto unlock;
+        rc = adfDevDrvWriteSectors( dev, pSect, nFullBlocks, buf );
+        if ( rc != ADF_RC_OK )
+            goto unlock;
+    }
 
-    const unsigned remainder = size % dev->geometry.blockSize;
     if ( remainder != 0 ) {
 #ifdef _MSC_VER
-        uint8_t * const blockBuf = _alloca( dev->geometry.blockSize );
+        uint8_t * const blockBuf = _alloca( blockSize );
 #else
-        uint8_t blockBuf[dev->geometry.blockSize];
+        uint8_t blockBuf[ blockSize ];
 #endif
         memcpy( blockBuf, buf + size - remainder, remainder );
-        memset( blockBuf + remainder, 0, dev->geometry.blockSize - remainder );
-        ADF_RETCODE rc = dev->drv->writeSectors( dev, pSect + nFullBlocks, 1, blockBuf );
-        if ( rc != ADF_RC_OK )
-            return rc;
+        memset( blockBuf + remainder, 0, blockSize - remainder );
+        rc = ( wBuf != NULL ) ?
+            adfDevWBufWrite_( dev, pSect + nFullBlocks, blockBuf ) :
+            adfDevDrvWriteSectors( dev, pSect + nFullBlocks, 1, blockBuf );
+    } else {
+        rc = ADF_RC_OK;
+    }
+
+unlock:
+    if ( dev->trace != NULL )
+        adfDevTraceAdd( dev, ADF_TRACE_OP_WRITE, pSect,
+                        nFullBlocks + ( remainder != 0 ),
+                        type, source, start, adfStatsClockNs(), rc );
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+/*
+ * adfDevSetWriteBuffer
+ *
+ */
+ADF_RETCODE adfDevSetWriteBuffer( struct AdfDevice * const  dev,
+                                  const unsigned            maxBlocks )
+{
+    adfMutexLock( dev->ioLock );
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    struct AdfDevWriteBuffer * wBuf = dev->wBuf;
+    if ( wBuf != NULL ) {
+        rc = adfDevWBufFlush_( dev );
+        free( wBuf->runBuf );
+        free( wBuf->data );
+        free( wBuf->freeSlots );
+        free( wBuf->entries );
+        free( wBuf );
+        dev->wBuf = NULL;
     }
+    if ( maxBlocks == 0 || rc != ADF_RC_OK )
+        goto unlock;
+
+    const uint32_t blockSize = dev->geometry.blockSize;
+    wBuf = malloc( sizeof(struct AdfDevWriteBuffer) );
+    if ( wBuf == NULL ) {
+        rc = ADF_RC_MALLOC;
+        goto unlock;
+    }
+    wBuf->maxBlocks = maxBlocks;
+    wBuf->nBlocks   = 0;
+    wBuf->entries   = malloc( sizeof(struct AdfDevWBufEntry) * maxBlocks );
+    wBuf->freeSlots = malloc( sizeof(unsigned) * maxBlocks );
+    wBuf->data      = malloc( (size_t) blockSize * maxBlocks );
+    wBuf->runBuf    = malloc( (size_t) blockSize * ADF_DEV_WRITE_RUN_MAX );
+    if ( wBuf->entries == NULL || wBuf->freeSlots == NULL ||
+         wBuf->data == NULL || wBuf->runBuf == NULL )
+    {
+        free( wBuf->runBuf );
+        free( wBuf->data );
+        free( wBuf->freeSlots );
+        free( wBuf->entries );
+        free( wBuf );
+        rc = ADF_RC_MALLOC;
+        goto unlock;
+    }
+    for ( unsigned i = 0 ; i < maxBlocks ; i++ )
+        wBuf->freeSlots[ i ] = i;
+    dev->wBuf = wBuf;
+
+unlock:
+    adfMutexUnlock( dev->ioLock );
+    if ( rc == ADF_RC_MALLOC )
+        adfEnv.eFct( "%s: malloc", __func__ );
+    return rc;
+}
+
+
+/*
+ * adfDevFlush
+ *
+ */
+ADF_RETCODE adfDevFlush( struct AdfDevice * const  dev )
+{
+    adfMutexLock( dev->ioLock );
+    const ADF_RETCODE rc = ( dev->wBuf != NULL ) ? adfDevWBufFlush_( dev ) :
+                                                   ADF_RC_OK;
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+/*
+ * adfDevSync
+ *
+ */
+ADF_RETCODE adfDevSync( struct AdfDevice * const  dev )
+{
+    adfMutexLock( dev->ioLock );
+    ADF_RETCODE rc = ( dev->wBuf != NULL ) ? adfDevWBufFlush_( dev ) :
+                                             ADF_RC_OK;
+    if ( rc == ADF_RC_OK && dev->drv->sync != NULL && ! dev->readOnly )
+        rc = dev->drv->sync( dev );
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+void adfDevSetSyncPolicy( struct AdfDevice * const  dev,
+                          const AdfSyncPolicy       policy )
+{
+    dev->syncPolicy = policy;
+}
+
+
+/*
+ * adfDevSyncPoint
+ *
+ */
+ADF_RETCODE adfDevSyncPoint( struct AdfDevice * const  dev,
+                             const AdfSyncPolicy       point )
+{
+    return ( dev->syncPolicy >= point ) ? adfDevSync( dev ) : ADF_RC_OK;
+}
+
 
+/*
+ * adfDevGetStats
+ *
+ */
+ADF_RETCODE adfDevGetStats( const struct AdfDevice * const  dev,
+                            struct AdfDevStats * const      stats )
+{
+    if ( dev->stats == NULL ) {
+        memset( stats, 0, sizeof(struct AdfDevStats) );
+        return ADF_RC_ERROR;
+    }
+    adfMutexLock( dev->ioLock );
+    *stats = *dev->stats;
+    adfMutexUnlock( dev->ioLock );
     return ADF_RC_OK;
 }
 
 
+/*
+ * adfDevResetStats
+ *
+ */
+void adfDevResetStats( struct AdfDevice * const  dev )
+{
+    if ( dev->stats == NULL )
+        return;
+    adfMutexLock( dev->ioLock );
+    memset( dev->stats, 0, sizeof(struct AdfDevStats) );
+    adfMutexUnlock( dev->ioLock );
+}
+
+
+/*
+ * adfDevDrvReadSectors
+ *
+ */
+ADF_RETCODE adfDevDrvReadSectors( const struct AdfDevice * const  dev,
+                                  const uint32_t                  block,
+                                  const uint32_t                  lenBlocks,
+                                  uint8_t * const                 buf )
+{
+    if ( dev->stats == NULL || lenBlocks == 0 )
+        return dev->drv->readSectors( dev, block, lenBlocks, buf );
+
+    const uint64_t start = adfStatsClockNs();
+    const ADF_RETCODE rc = dev->drv->readSectors( dev, block, lenBlocks, buf );
+    adfIoStatsAdd( &dev->stats->read, lenBlocks, dev->geometry.blockSize, start, rc );
+    return rc;
+}
+
+
+/*
+ * adfDevDrvWriteSectors
+ *
+ */
+ADF_RETCODE adfDevDrvWriteSectors( const struct AdfDevice * const  dev,
+                                   const uint32_t                  block,
+                                   const uint32_t                  lenBlocks,
+                                   const uint8_t * const           buf )
+{
+    if ( dev->stats == NULL || lenBlocks == 0 )
+        return dev->drv->writeSectors( dev, block, lenBlocks, buf );
+
+    const uint64_t start = adfStatsClockNs();
+    const ADF_RETCODE rc = dev->drv->writeSectors( dev, block, lenBlocks, buf );
+    adfIoStatsAdd( &dev->stats->write, lenBlocks, dev->geometry.blockSize, start, rc );
+    return rc;
+}
+
+
 /*****************************************************************************
  *
  * Private / lower-level functions
  *
  *****************************************************************************/
 
+/*
+ * adfDevWBufFind_
+ *
+ * index of the first buffered block with sector >= pSect
+ */
+static unsigned adfDevWBufFind_( const struct AdfDevWriteBuffer * const  wBuf,
+                                 const uint32_t                          pSect )
+{
+    unsigned lo = 0,
+             hi = wBuf->nBlocks;
+    while ( lo < hi ) {
+        const unsigned mid = lo + ( hi - lo ) / 2;
+        if ( wBuf->entries[ mid ].pSect < pSect )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+/*
+ * adfDevWBufWrite_
+ *
+ * put a block in the write buffer (flushing it first, if full)
+ */
+static ADF_RETCODE adfDevWBufWrite_( const struct AdfDevice * const  dev,
+                                     const uint32_t                  pSect,
+                                     const uint8_t * const           block )
+{
+    struct AdfDevWriteBuffer * const wBuf = dev->wBuf;
+    const uint32_t blockSize = dev->geometry.blockSize;
+
+    if ( pSect >= dev->sizeBlocks )
+        return ADF_RC_ERROR;
+
+    unsigned i = adfDevWBufFind_( wBuf, pSect );
+    if ( i < wBuf->nBlocks && wBuf->entries[ i ].pSect == pSect ) {
+        memcpy( wBuf->data + (size_t) wBuf->entries[ i ].slot * blockSize,
+                block, blockSize );
+        return ADF_RC_OK;
+    }
+
+    if ( wBuf->nBlocks == wBuf->maxBlocks ) {
+        const ADF_RETCODE rc = adfDevWBufFlush_( dev );
+        if ( rc != ADF_RC_OK )
+            return rc;
+        i = 0;
+    }
+
+    const unsigned slot = wBuf->freeSlots[ wBuf->maxBlocks - wBuf->nBlocks - 1 ];
+    memmove( &wBuf->entries[ i + 1 ], &wBuf->entries[ i ],
+             sizeof(struct AdfDevWBufEntry) * ( wBuf->nBlocks - i ) );
+    wBuf->entries[ i ].pSect = pSect;
+    wBuf->entries[ i ].slot  = slot;
+    memcpy( wBuf->data + (size_t) slot * blockSize, block, blockSize );
+    wBuf->nBlocks++;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfDevWBufRead_
+ *
+ * update data read from the device with buffered blocks
+ */
+static void adfDevWBufRead_( const struct AdfDevice * const  dev,
+                             const uint32_t                  pSect,
+                             const uint32_t                  size,
+                             uint8_t * const                 buf )
+{
+    const struct AdfDevWriteBuffer * const wBuf = dev->wBuf;
+    const uint32_t blockSize = dev->geometry.blockSize;
+
+    for ( unsigned i = adfDevWBufFind_( wBuf, pSect ) ; i < wBuf->nBlocks ; i++ ) {
+        const uint32_t offset = ( wBuf->entries[ i ].pSect - pSect ) * blockSize;
+        if ( offset >= size )
+            break;
+        memcpy( buf + offset,
+                wBuf->data + (size_t) wBuf->entries[ i ].slot * blockSize,
+                min( blockSize, size - offset ) );
+    }
+}
+
+
+/*
+ * adfDevWBufFlush_
+ *
+ * write all buffered blocks in ascending order, merging adjacent ones;
+ * (if a write fails, the blocks not written stay in the buffer)
+ */
+static ADF_RETCODE adfDevWBufFlush_( const struct AdfDevice * const  dev )
+{
+    struct AdfDevWriteBuffer * const wBuf = dev->wBuf;
+    const uint32_t blockSize = dev->geometry.blockSize;
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    unsigned first = 0;
+    while ( first < wBuf->nBlocks ) {
+        const struct AdfDevWBufEntry * const run = &wBuf->entries[ first ];
+        unsigned runLen = 1;
+        while ( first + runLen < wBuf->nBlocks &&
+                runLen < ADF_DEV_WRITE_RUN_MAX &&
+                run[ runLen ].pSect == run[ 0 ].pSect + runLen )
+        {
+            runLen++;
+        }
+
+        const uint8_t * runData;
+        if ( runLen == 1 ) {
+            runData = wBuf->data + (size_t) run[ 0 ].slot * blockSize;
+        } else {
+            for ( unsigned i = 0 ; i < runLen ; i++ )
+                memcpy( wBuf->runBuf + i * blockSize,
+                        wBuf->data + (size_t) run[ i ].slot * blockSize, blockSize );
+            runData = wBuf->runBuf;
+        }
+
+        rc = adfDevDrvWriteSectors( dev, run[ 0 ].pSect, runLen, runData );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: writing blocks %u-%u failed",
+                         __func__, run[ 0 ].pSect, run[ 0 ].pSect + runLen - 1 );
+            break;
+        }
+        first += runLen;
+    }
+
+    // free the slots of written blocks, keep the others
+    for ( unsigned i = 0 ; i < first ; i++ )
+        wBuf->freeSlots[ wBuf->maxBlocks - wBuf->nBlocks + i ] = wBuf->entries[ i ].slot;
+    wBuf->nBlocks -= first;
+    memmove( &wBuf->entries[ 0 ], &wBuf->entries[ first ],
+             sizeof(struct AdfDevWBufEntry) * wBuf->nBlocks );
+    return rc;
+}
+
 
 static struct AdfDevice * adfDevOpenWithDrv_(
     const struct AdfDeviceDriver * const  driver,
@@ -270,6 +951,11 @@ static struct AdfDevice * adfDevOpenWithDrv_(
         adfEnv.eFct( " %s: openDev failed, dev. name '%s'", __func__, name );
         return NULL;
     }
+    dev->ioLock     = NULL;    // created below, when the device is accepted
+    dev->wBuf       = NULL;
+    dev->syncPolicy = ADF_SYNC_NONE;
+    dev->stats      = NULL;
+    dev->trace      = NULL;
 
     // set class depending only on size (until more data available...)
     dev->dev_class = adfDevGetClassBySizeBlocks( dev->sizeBlocks );
@@ -311,6 +997,9 @@ static struct AdfDevice * adfDevOpenWithDrv_(
             }*/
     }
 
+    dev->ioLock = adfMutexCreate();
+    dev->stats  = calloc( 1, sizeof(struct AdfDevStats) );
+
     // check if the dev contains and RDB
     dev->rdb.block = NULL;             // was not initialized yet
     ADF_RETCODE rc = adfDevReadRdb( dev );
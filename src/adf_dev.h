@@ -30,6 +30,7 @@
 #include "adf_dev_driver.h"
 #include "adf_dev_type.h"
 #include "adf_prefix.h"
+#include "adf_stats.h"
 #include "adf_vol.h"
 
 
@@ -48,8 +49,26 @@ typedef enum {
 } AdfDevRdbStatus;
 
 
+/*
+ * Durability policy: when the written data is made durable (synced with
+ * adfDevSync: written through the buffers of the library, the driver
+ * and the host system to the storage). Each policy includes the previous
+ * ones (eg. ADF_SYNC_FILE_CLOSE syncs also on unmount).
+ */
+typedef enum {
+    ADF_SYNC_NONE,         // only with explicit adfDevSync() / adfVolSync()
+    ADF_SYNC_UNMOUNT,      // when a volume or the device is unmounted/closed
+    ADF_SYNC_FILE_CLOSE,   // when a file opened for writing is closed
+    ADF_SYNC_METADATA      // after each metadata change (bitmap commit)
+} AdfSyncPolicy;
+
+
 /* ----- DEVICES ----- */
 
+struct AdfMutex;
+struct AdfDevWriteBuffer;
+struct AdfDevTrace;
+
 struct AdfDevice {
     char *         name;
     AdfDevType     type;
@@ -71,6 +90,25 @@ struct AdfDevice {
     void *         drvData;          /* driver-specific device data,
                                         (private, use only in the driver code!) */
 
+    struct AdfMutex *
+                   ioLock;           /* serializes driver calls (NULL if the lib
+                                        is built without threads) */
+
+    struct AdfDevWriteBuffer *
+                   wBuf;             /* write-back buffer (NULL if not used,
+                                        see adfDevSetWriteBuffer) */
+
+    AdfSyncPolicy  syncPolicy;       /* ADF_SYNC_NONE by default,
+                                        see adfDevSetSyncPolicy */
+
+    struct AdfDevStats *
+                   stats;            /* I/O statistics (NULL if not collected),
+                                        see adfDevGetStats */
+
+    struct AdfDevTrace *
+                   trace;            /* access trace (NULL if not traced),
+                                        see adfDevTraceStart */
+
     bool           mounted;
 
     // stuff available when mounted
@@ -115,7 +153,7 @@ ADF_PREFIX struct AdfDevice * adfDevOpenWithDriver(
     const char * const  name,
     const AdfAccessMode mode );
 
-ADF_PREFIX void adfDevClose( struct AdfDevice * const dev );
+ADF_PREFIX ADF_RETCODE adfDevClose( struct AdfDevice * const dev );
 
 
 ADF_PREFIX int adfDevType( const struct AdfDevice * const dev );
@@ -124,6 +162,36 @@ ADF_PREFIX ADF_RETCODE adfDevMount( struct AdfDevice * const dev );
 ADF_PREFIX void adfDevUnMount( struct AdfDevice * const dev );
 
 
+/*
+ * Operations on all volumes of a (mounted) device
+ *
+ * Volumes are processed by up to nThreads threads (if the library is built
+ * with threads; otherwise - one by one, in the caller's thread). Device I/O
+ * is serialized, all other volume state is independent, so a function
+ * called for volumes must only not share (unprotected) data between calls.
+ *
+ * If status is not NULL, it must have dev->nVol elements, receiving
+ * the result for each volume. Returned is ADF_RC_OK if all succeeded,
+ * otherwise the error of the first volume that failed.
+ */
+
+typedef ADF_RETCODE (*AdfVolFct)( struct AdfVolume * const  vol,
+                                  const int                 nPart,
+                                  void * const              data );
+
+ADF_PREFIX ADF_RETCODE adfDevForEachVolume( struct AdfDevice * const  dev,
+                                            const unsigned            nThreads,
+                                            const AdfVolFct           fct,
+                                            void * const              data,
+                                            ADF_RETCODE * const       status );
+
+/* mount all volumes (mounted are those with dev->volList[ i ]->mounted set) */
+ADF_PREFIX ADF_RETCODE adfDevMountAll( struct AdfDevice * const  dev,
+                                       const AdfAccessMode       mode,
+                                       const unsigned            nThreads,
+                                       ADF_RETCODE * const       status );
+
+
 ADF_PREFIX ADF_RETCODE adfDevReadBlock( const struct AdfDevice * const  dev,
                                         uint32_t                        pSect,
                                         const uint32_t                  size,
@@ -134,6 +202,105 @@ ADF_PREFIX ADF_RETCODE adfDevWriteBlock( const struct AdfDevice * const  dev,
                                          const uint32_t                  size,
                                          const uint8_t * const           buf );
 
+/* (internal) the above, requested by a volume for blocks of the given type
+   (for the trace) */
+ADF_RETCODE adfDevReadBlockOfType( const struct AdfDevice * const  dev,
+                                   const uint32_t                  pSect,
+                                   const uint32_t                  size,
+                                   uint8_t * const                 buf,
+                                   const AdfStatsBlockType         type );
+
+ADF_RETCODE adfDevWriteBlockOfType( const struct AdfDevice * const  dev,
+                                    const uint32_t                  pSect,
+                                    const uint32_t                  size,
+                                    const uint8_t * const           buf,
+                                    const AdfStatsBlockType         type );
+
+/*
+ * adfDevReadBlocks
+ *
+ * Reads nBlocks blocks (of any, not necessarily consecutive or ordered
+ * sectors pSects[i]) to buffers bufs[i] (each of the device's block size).
+ * The sectors are read in ascending order and close ones are coalesced
+ * into multi-block reads (gaps up to ADF_DEV_READ_GAP_MAX blocks are read
+ * and discarded).
+ */
+#define ADF_DEV_READ_GAP_MAX   8
+#define ADF_DEV_READ_RUN_MAX  64
+
+ADF_PREFIX ADF_RETCODE adfDevReadBlocks( const struct AdfDevice * const  dev,
+                                         const unsigned                  nBlocks,
+                                         const uint32_t * const          pSects,
+                                         uint8_t * const * const         bufs );
+
+ADF_RETCODE adfDevReadBlocksOfType( const struct AdfDevice * const  dev,
+                                    const unsigned                  nBlocks,
+                                    const uint32_t * const          pSects,
+                                    uint8_t * const * const         bufs,
+                                    const AdfStatsBlockType         type );
+
+/*
+ * Write-back buffer
+ *
+ * Writes with adfDevWriteBlock can be buffered: up to maxBlocks written
+ * blocks are kept in memory (a block written again only updates the buffer,
+ * reads return the buffered data). They are written to the device when
+ * the buffer is full, with adfDevSync(), when the device is unmounted
+ * or closed (also a volume), in ascending sector order, adjacent blocks
+ * merged into writes of up to ADF_DEV_WRITE_RUN_MAX blocks.
+ *
+ * It is not used by default (maxBlocks 0 flushes and disables the buffer).
+ */
+#define ADF_DEV_WRITE_BUFFER_BLOCKS  256
+#define ADF_DEV_WRITE_RUN_MAX         64
+
+ADF_PREFIX ADF_RETCODE adfDevSetWriteBuffer( struct AdfDevice * const  dev,
+                                             const unsigned            maxBlocks );
+
+/* write all buffered blocks to the device (driver) */
+ADF_PREFIX ADF_RETCODE adfDevFlush( struct AdfDevice * const  dev );
+
+/*
+ * adfDevSync
+ *
+ * Flushes the write buffer and makes all written data durable
+ * (with the sync function of the driver, if it has one).
+ */
+ADF_PREFIX ADF_RETCODE adfDevSync( struct AdfDevice * const  dev );
+
+ADF_PREFIX void adfDevSetSyncPolicy( struct AdfDevice * const  dev,
+                                     const AdfSyncPolicy       policy );
+
+/* (internal) sync if required by the policy at the given point */
+ADF_RETCODE adfDevSyncPoint( struct AdfDevice * const  dev,
+                             const AdfSyncPolicy       point );
+
+/*
+ * I/O statistics
+ *
+ * All reads and writes done with the driver (including writes of
+ * the write-back buffer and those of adfDevAsync* functions, also done
+ * with io_uring) are counted, since the device was opened or the stats
+ * were reset. adfDevGetStats returns ADF_RC_ERROR if the stats are not
+ * available (not collected).
+ */
+ADF_PREFIX ADF_RETCODE adfDevGetStats( const struct AdfDevice * const  dev,
+                                       struct AdfDevStats * const      stats );
+
+ADF_PREFIX void adfDevResetStats( struct AdfDevice * const  dev );
+
+/* (internal) driver's read / write, counted in the stats
+   (dev->ioLock must be locked) */
+ADF_RETCODE adfDevDrvReadSectors( const struct AdfDevice * const  dev,
+                                  const uint32_t                  block,
+                                  const uint32_t                  lenBlocks,
+                                  uint8_t * const                 buf );
+
+ADF_RETCODE adfDevDrvWriteSectors( const struct AdfDevice * const  dev,
+                                   const uint32_t                  block,
+                                   const uint32_t                  lenBlocks,
+                                   const uint8_t * const           buf );
+
 /*
  * adfDevGetInfo
  *
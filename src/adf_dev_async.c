@@ -0,0 +1,692 @@
+/*
+ *  adf_dev_async.c - asynchronous device I/O
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* syscall() */
+#endif
+
+#include "adf_dev_async.h"
+
+#include "adf_dev_driver.h"
+#include "adf_dev_trace.h"
+#include "adf_env.h"
+#include "adf_stats.h"
+#include "adf_thread.h"
+#include "adf_util.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_IO_URING
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/* threads of the pool (driver calls are serialized anyway) */
+#define ADF_DEV_ASYNC_WORKERS  4
+
+
+struct AdfDevAsyncReq_ {
+    uint64_t     tag,
+                 startNs;       /* (io_uring) submitted at, for the stats */
+    uint8_t *    buf;
+    uint32_t     block,
+                 lenBlocks;
+    bool         write;
+    ADF_RETCODE  rc;
+};
+
+/* a FIFO of request slots */
+struct AdfDevAsyncFifo_ {
+    unsigned *  slots;
+    unsigned    head,
+                nItems;
+};
+
+#ifdef HAVE_IO_URING
+struct AdfUring_ {
+    int                    fd;
+    unsigned *             sqHead,
+             *             sqTail,
+             *             sqArray;
+    unsigned               sqMask;
+    unsigned *             cqHead,
+             *             cqTail;
+    unsigned               cqMask;
+    struct io_uring_sqe *  sqes;
+    struct io_uring_cqe *  cqes;
+    void *                 sqRing,
+         *                 cqRing;
+    size_t                 sqRingSize,
+                           cqRingSize,
+                           sqesSize;
+    unsigned               nToSubmit,   /* queued, not taken by the kernel yet */
+                           nInRing;     /* submitted, not completed */
+};
+#endif
+
+struct AdfDevAsync {
+    struct AdfDevice *        dev;
+    AdfDevAsyncBackend        backend;
+    unsigned                  depth;
+
+    struct AdfDevAsyncReq_ *  reqs;
+    unsigned *                freeSlots;
+    unsigned                  nFree;
+
+    /* threads (and sync): requests to do (pending) and done (to collect) */
+    struct AdfMutex *         lock;
+    struct AdfCond *          workCond,
+                   *          doneCond;
+    struct AdfDevAsyncFifo_   pending,
+                              done;
+    struct AdfThread *        workers[ ADF_DEV_ASYNC_WORKERS ];
+    unsigned                  nWorkers;
+    bool                      stop;
+
+#ifdef HAVE_IO_URING
+    struct AdfUring_          ring;
+#endif
+};
+
+
+static ADF_RETCODE adfDevAsyncSubmit_( struct AdfDevAsync * const  aio,
+                                       const bool                  write,
+                                       const uint32_t              block,
+                                       const uint32_t              lenBlocks,
+                                       uint8_t * const             buf,
+                                       const uint64_t              tag );
+
+static ADF_RETCODE adfDevAsyncDo_( const struct AdfDevice * const       dev,
+                                   const struct AdfDevAsyncReq_ * const  req );
+
+static void adfDevAsyncWorker_( void * const  aioArg );
+
+static void adfDevAsyncFifoPush_( struct AdfDevAsyncFifo_ * const  fifo,
+                                  const unsigned                   size,
+                                  const unsigned                   slot );
+
+static unsigned adfDevAsyncFifoPop_( struct AdfDevAsyncFifo_ * const  fifo,
+                                     const unsigned                   size );
+
+#ifdef HAVE_IO_URING
+static bool adfUringSetup_( struct AdfUring_ * const  ring,
+                            const unsigned            entries );
+
+static void adfUringTeardown_( struct AdfUring_ * const  ring );
+
+static void adfUringSubmit_( struct AdfDevAsync * const  aio,
+                             const unsigned              slot,
+                             const int                   hostFd );
+
+static unsigned adfUringReap_( struct AdfDevAsync * const  aio,
+                               unsigned * const            slots,
+                               const unsigned              maxSlots );
+
+static void adfUringEnter_( struct AdfUring_ * const  ring,
+                            const unsigned            minComplete );
+#endif
+
+
+/*****************************************************************************
+ *
+ * Public functions
+ *
+ *****************************************************************************/
+
+/*
+ * adfDevAsyncCreate
+ *
+ */
+struct AdfDevAsync * adfDevAsyncCreate( struct AdfDevice * const  dev,
+                                        const unsigned            depth )
+{
+    struct AdfDevAsync * const aio = calloc( 1, sizeof(struct AdfDevAsync) );
+    if ( aio == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return NULL;
+    }
+    aio->dev     = dev;
+    aio->backend = ADF_DEV_ASYNC_SYNC;
+    aio->depth   = ( depth < 1 ? 1 :
+                     depth > ADF_DEV_ASYNC_DEPTH_MAX ? ADF_DEV_ASYNC_DEPTH_MAX :
+                     depth );
+#ifdef HAVE_IO_URING
+    aio->ring.fd = -1;
+#endif
+
+    aio->reqs          = calloc( aio->depth, sizeof(struct AdfDevAsyncReq_) );
+    aio->freeSlots     = calloc( aio->depth, sizeof(unsigned) );
+    aio->pending.slots = calloc( aio->depth, sizeof(unsigned) );
+    aio->done.slots    = calloc( aio->depth, sizeof(unsigned) );
+    if ( aio->reqs == NULL || aio->freeSlots == NULL ||
+         aio->pending.slots == NULL || aio->done.slots == NULL )
+    {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        adfDevAsyncDestroy( aio );
+        return NULL;
+    }
+    for ( unsigned i = 0 ; i < aio->depth ; i++ )
+        aio->freeSlots[ i ] = aio->depth - 1 - i;
+    aio->nFree = aio->depth;
+
+#ifdef HAVE_IO_URING
+    if ( dev->drv->getHostFd != NULL &&
+         adfUringSetup_( &aio->ring, aio->depth ) )
+    {
+        aio->backend = ADF_DEV_ASYNC_IO_URING;
+        return aio;
+    }
+#endif
+
+    if ( adfThreadsAvailable() && dev->ioLock != NULL ) {
+        aio->lock     = adfMutexCreate();
+        aio->workCond = adfCondCreate();
+        aio->doneCond = adfCondCreate();
+        if ( aio->lock != NULL && aio->workCond != NULL && aio->doneCond != NULL ) {
+            const unsigned nWorkers = min( aio->depth, (unsigned) ADF_DEV_ASYNC_WORKERS );
+            while ( aio->nWorkers < nWorkers ) {
+                aio->workers[ aio->nWorkers ] = adfThreadStart( adfDevAsyncWorker_, aio );
+                if ( aio->workers[ aio->nWorkers ] == NULL )
+                    break;
+                aio->nWorkers++;
+            }
+            if ( aio->nWorkers > 0 )
+                aio->backend = ADF_DEV_ASYNC_THREADS;
+        }
+    }
+    return aio;
+}
+
+
+/*
+ * adfDevAsyncDestroy
+ *
+ */
+void adfDevAsyncDestroy( struct AdfDevAsync * const  aio )
+{
+    if ( aio == NULL )
+        return;
+
+    struct AdfDevAsyncCompletion completions[ 64 ];
+    while ( aio->reqs != NULL && adfDevAsyncInFlight( aio ) > 0 )
+        adfDevAsyncWait( aio, completions, 64, 1 );
+
+    adfMutexLock( aio->lock );
+    aio->stop = true;
+    adfCondBroadcast( aio->workCond );
+    adfMutexUnlock( aio->lock );
+    for ( unsigned i = 0 ; i < aio->nWorkers ; i++ )
+        adfThreadJoin( aio->workers[ i ] );
+
+#ifdef HAVE_IO_URING
+    adfUringTeardown_( &aio->ring );
+#endif
+    adfCondDestroy( aio->doneCond );
+    adfCondDestroy( aio->workCond );
+    adfMutexDestroy( aio->lock );
+    free( aio->done.slots );
+    free( aio->pending.slots );
+    free( aio->freeSlots );
+    free( aio->reqs );
+    free( aio );
+}
+
+
+AdfDevAsyncBackend adfDevAsyncGetBackend( const struct AdfDevAsync * const  aio )
+{
+    return aio->backend;
+}
+
+
+unsigned adfDevAsyncInFlight( const struct AdfDevAsync * const  aio )
+{
+    return aio->depth - aio->nFree;
+}
+
+
+ADF_RETCODE adfDevAsyncRead( struct AdfDevAsync * const  aio,
+                             const uint32_t              block,
+                             const uint32_t              lenBlocks,
+                             uint8_t * const             buf,
+                             const uint64_t              tag )
+{
+    return adfDevAsyncSubmit_( aio, false, block, lenBlocks, buf, tag );
+}
+
+
+ADF_RETCODE adfDevAsyncWrite( struct AdfDevAsync * const  aio,
+                              const uint32_t              block,
+                              const uint32_t              lenBlocks,
+                              const uint8_t * const       buf,
+                              const uint64_t              tag )
+{
+    return adfDevAsyncSubmit_( aio, true, block, lenBlocks, (uint8_t *) buf, tag );
+}
+
+
+/*
+ * adfDevAsyncPoll
+ *
+ */
+unsigned adfDevAsyncPoll( struct AdfDevAsync * const            aio,
+                          struct AdfDevAsyncCompletion * const  completions,
+                          const unsigned                        maxCompl )
+{
+    unsigned slots[ 64 ];
+    unsigned n = 0;
+    while ( n < maxCompl ) {
+        const unsigned nMax = min( maxCompl - n, 64u );
+        unsigned nReaped = 0;
+
+        adfMutexLock( aio->lock );
+        while ( nReaped < nMax && aio->done.nItems > 0 )
+            slots[ nReaped++ ] = adfDevAsyncFifoPop_( &aio->done, aio->depth );
+        adfMutexUnlock( aio->lock );
+#ifdef HAVE_IO_URING
+        if ( aio->backend == ADF_DEV_ASYNC_IO_URING )
+            nReaped += adfUringReap_( aio, slots + nReaped, nMax - nReaped );
+#endif
+        if ( nReaped == 0 )
+            break;
+
+        for ( unsigned i = 0 ; i < nReaped ; i++ ) {
+            const struct AdfDevAsyncReq_ * const req = &aio->reqs[ slots[ i ] ];
+            completions[ n ].tag = req->tag;
+            completions[ n ].rc  = req->rc;
+            n++;
+            aio->freeSlots[ aio->nFree++ ] = slots[ i ];
+        }
+    }
+    return n;
+}
+
+
+/*
+ * adfDevAsyncWait
+ *
+ */
+unsigned adfDevAsyncWait( struct AdfDevAsync * const            aio,
+                          struct AdfDevAsyncCompletion * const  completions,
+                          const unsigned                        maxCompl,
+                          const unsigned                        minCompl )
+{
+    const unsigned nWanted = min( minCompl, min( maxCompl, adfDevAsyncInFlight( aio ) ) );
+
+    unsigned n = adfDevAsyncPoll( aio, completions, maxCompl );
+    while ( n < nWanted ) {
+#ifdef HAVE_IO_URING
+        if ( aio->backend == ADF_DEV_ASYNC_IO_URING && aio->ring.nInRing > 0 )
+            adfUringEnter_( &aio->ring, 1 );
+#endif
+        if ( aio->backend == ADF_DEV_ASYNC_THREADS ) {
+            adfMutexLock( aio->lock );
+            while ( aio->done.nItems == 0 )
+                adfCondWait( aio->doneCond, aio->lock );
+            adfMutexUnlock( aio->lock );
+        }
+        n += adfDevAsyncPoll( aio, completions + n, maxCompl - n );
+    }
+    return n;
+}
+
+
+/*****************************************************************************
+ *
+ * Private functions
+ *
+ *****************************************************************************/
+
+/*
+ * adfDevAsyncSubmit_
+ *
+ */
+static ADF_RETCODE adfDevAsyncSubmit_( struct AdfDevAsync * const  aio,
+                                       const bool                  write,
+                                       const uint32_t              block,
+                                       const uint32_t              lenBlocks,
+                                       uint8_t * const             buf,
+                                       const uint64_t              tag )
+{
+    struct AdfDevice * const dev = aio->dev;
+
+    if ( lenBlocks < 1 || block + lenBlocks > dev->sizeBlocks ||
+         block + lenBlocks < block )
+    {
+        adfEnv.eFct( "%s: blocks %u-%u out of range (device size %u)",
+                     __func__, block, block + lenBlocks - 1, dev->sizeBlocks );
+        return ADF_RC_ERROR;
+    }
+    if ( write && dev->readOnly ) {
+        adfEnv.eFct( "%s: device '%s' is read only", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+    if ( aio->nFree == 0 )
+        return ADF_RC_ERROR;    // full - collect completions first
+
+    // (requests bypass the write buffer of the device)
+    const ADF_RETCODE rcFlush = adfDevFlush( dev );
+    if ( rcFlush != ADF_RC_OK )
+        return rcFlush;
+
+    if ( dev->trace != NULL ) {
+        adfMutexLock( dev->ioLock );
+        const uint64_t now = adfStatsClockNs();
+        adfDevTraceAdd( dev, write ? ADF_TRACE_OP_WRITE : ADF_TRACE_OP_READ,
+                        block, lenBlocks, ADF_STATS_BLOCK_OTHER, ADF_TRACE_SRC_ASYNC,
+                        now, now, ADF_RC_OK );
+        adfMutexUnlock( dev->ioLock );
+    }
+
+    const unsigned slot = aio->freeSlots[ --aio->nFree ];
+    struct AdfDevAsyncReq_ * const req = &aio->reqs[ slot ];
+    req->tag       = tag;
+    req->buf       = buf;
+    req->block     = block;
+    req->lenBlocks = lenBlocks;
+    req->write     = write;
+    req->rc        = ADF_RC_OK;
+
+#ifdef HAVE_IO_URING
+    if ( aio->backend == ADF_DEV_ASYNC_IO_URING ) {
+        // (the driver flushes its own buffers, if any)
+        adfMutexLock( dev->ioLock );
+        const int hostFd = dev->drv->getHostFd( dev );
+        adfMutexUnlock( dev->ioLock );
+        if ( hostFd >= 0 ) {
+            adfUringSubmit_( aio, slot, hostFd );
+            return ADF_RC_OK;
+        }
+        // no host fd (now) - done synchronously below
+    }
+#endif
+
+    adfMutexLock( aio->lock );
+    if ( aio->backend == ADF_DEV_ASYNC_THREADS ) {
+        adfDevAsyncFifoPush_( &aio->pending, aio->depth, slot );
+        adfCondBroadcast( aio->workCond );
+    } else {
+        req->rc = adfDevAsyncDo_( dev, req );
+        adfDevAsyncFifoPush_( &aio->done, aio->depth, slot );
+    }
+    adfMutexUnlock( aio->lock );
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfDevAsyncDo_
+ *
+ * do a request synchronously (with the driver)
+ */
+static ADF_RETCODE adfDevAsyncDo_( const struct AdfDevice * const       dev,
+                                   const struct AdfDevAsyncReq_ * const  req )
+{
+    adfMutexLock( dev->ioLock );
+    const ADF_RETCODE rc = req->write ?
+        adfDevDrvWriteSectors( dev, req->block, req->lenBlocks, req->buf ) :
+        adfDevDrvReadSectors( dev, req->block, req->lenBlocks, req->buf );
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+/*
+ * adfDevAsyncWorker_
+ *
+ * a thread of the pool: do pending requests until stopped
+ */
+static void adfDevAsyncWorker_( void * const  aioArg )
+{
+    struct AdfDevAsync * const aio = aioArg;
+
+    adfMutexLock( aio->lock );
+    while ( true ) {
+        while ( aio->pending.nItems == 0 && ! aio->stop )
+            adfCondWait( aio->workCond, aio->lock );
+        if ( aio->pending.nItems == 0 )
+            break;
+
+        const unsigned slot = adfDevAsyncFifoPop_( &aio->pending, aio->depth );
+        adfMutexUnlock( aio->lock );
+
+        const ADF_RETCODE rc = adfDevAsyncDo_( aio->dev, &aio->reqs[ slot ] );
+
+        adfMutexLock( aio->lock );
+        aio->reqs[ slot ].rc = rc;
+        adfDevAsyncFifoPush_( &aio->done, aio->depth, slot );
+        adfCondBroadcast( aio->doneCond );
+    }
+    adfMutexUnlock( aio->lock );
+}
+
+
+static void adfDevAsyncFifoPush_( struct AdfDevAsyncFifo_ * const  fifo,
+                                  const unsigned                   size,
+                                  const unsigned                   slot )
+{
+    fifo->slots[ ( fifo->head + fifo->nItems ) % size ] = slot;
+    fifo->nItems++;
+}
+
+
+static unsigned adfDevAsyncFifoPop_( struct AdfDevAsyncFifo_ * const  fifo,
+                                     const unsigned                   size )
+{
+    const unsigned slot = fifo->slots[ fifo->head ];
+    fifo->head = ( fifo->head + 1 ) % size;
+    fifo->nItems--;
+    return slot;
+}
+
+
+/*****************************************************************************
+ *
+ * io_uring backend (raw system calls, no liburing)
+ *
+ *****************************************************************************/
+
+#ifdef HAVE_IO_URING
+
+/*
+ * adfUringSetup_
+ *
+ */
+static bool adfUringSetup_( struct AdfUring_ * const  ring,
+                            const unsigned            entries )
+{
+    struct io_uring_params params;
+    memset( &params, 0, sizeof params );
+
+    ring->fd = (int) syscall( __NR_io_uring_setup, entries, &params );
+    if ( ring->fd < 0 )
+        return false;      // (not supported or not permitted)
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes +
+                       params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMmap = ( params.features & IORING_FEAT_SINGLE_MMAP );
+    if ( singleMmap )
+        ring->sqRingSize = ring->cqRingSize = max( ring->sqRingSize,
+                                                   ring->cqRingSize );
+
+    ring->sqRing = mmap( NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+    if ( ring->sqRing == MAP_FAILED ) {
+        ring->sqRing = NULL;
+        adfUringTeardown_( ring );
+        return false;
+    }
+
+    ring->cqRing = singleMmap ? ring->sqRing :
+        mmap( NULL, ring->cqRingSize, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING );
+    if ( ring->cqRing == MAP_FAILED ) {
+        ring->cqRing = NULL;
+        adfUringTeardown_( ring );
+        return false;
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap( NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+    if ( ring->sqes == MAP_FAILED ) {
+        ring->sqes = NULL;
+        adfUringTeardown_( ring );
+        return false;
+    }
+
+    uint8_t * const sq = ring->sqRing,
+            * const cq = ring->cqRing;
+    ring->sqHead  = (unsigned *) ( sq + params.sq_off.head );
+    ring->sqTail  = (unsigned *) ( sq + params.sq_off.tail );
+    ring->sqArray = (unsigned *) ( sq + params.sq_off.array );
+    ring->sqMask  = *(unsigned *) ( sq + params.sq_off.ring_mask );
+    ring->cqHead  = (unsigned *) ( cq + params.cq_off.head );
+    ring->cqTail  = (unsigned *) ( cq + params.cq_off.tail );
+    ring->cqMask  = *(unsigned *) ( cq + params.cq_off.ring_mask );
+    ring->cqes    = (struct io_uring_cqe *) ( cq + params.cq_off.cqes );
+    ring->nToSubmit = ring->nInRing = 0;
+    return true;
+}
+
+
+static void adfUringTeardown_( struct AdfUring_ * const  ring )
+{
+    if ( ring->fd < 0 )
+        return;
+    if ( ring->sqes != NULL )
+        munmap( ring->sqes, ring->sqesSize );
+    if ( ring->cqRing != NULL && ring->cqRing != ring->sqRing )
+        munmap( ring->cqRing, ring->cqRingSize );
+    if ( ring->sqRing != NULL )
+        munmap( ring->sqRing, ring->sqRingSize );
+    close( ring->fd );
+    ring->fd = -1;
+}
+
+
+/*
+ * adfUringSubmit_
+ *
+ * (the number of requests in flight is limited to the queue depth, so
+ * neither the submission nor the completion ring can overflow)
+ */
+static void adfUringSubmit_( struct AdfDevAsync * const  aio,
+                             const unsigned              slot,
+                             const int                   hostFd )
+{
+    struct AdfUring_ * const ring = &aio->ring;
+    const struct AdfDevAsyncReq_ * const req = &aio->reqs[ slot ];
+    const uint32_t blockSize = aio->dev->geometry.blockSize;
+
+    const unsigned tail  = *ring->sqTail,
+                   index = tail & ring->sqMask;
+    struct io_uring_sqe * const sqe = &ring->sqes[ index ];
+    memset( sqe, 0, sizeof(struct io_uring_sqe) );
+    sqe->opcode    = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = hostFd;
+    sqe->off       = (uint64_t) req->block * blockSize;
+    sqe->addr      = (uint64_t) (uintptr_t) req->buf;
+    sqe->len       = req->lenBlocks * blockSize;
+    sqe->user_data = slot;
+    ring->sqArray[ index ] = index;
+    aio->reqs[ slot ].startNs = adfStatsClockNs();
+    __atomic_store_n( ring->sqTail, tail + 1, __ATOMIC_RELEASE );
+
+    ring->nToSubmit++;
+    ring->nInRing++;
+    adfUringEnter_( ring, 0 );
+}
+
+
+/*
+ * adfUringEnter_
+ *
+ * submit queued requests and (if minComplete > 0) wait for completions
+ */
+static void adfUringEnter_( struct AdfUring_ * const  ring,
+                            const unsigned            minComplete )
+{
+    const unsigned flags = ( minComplete > 0 ) ? IORING_ENTER_GETEVENTS : 0;
+    while ( true ) {
+        const long ret = syscall( __NR_io_uring_enter, ring->fd, ring->nToSubmit,
+                                  minComplete, flags, NULL, 0 );
+        if ( ret >= 0 ) {
+            ring->nToSubmit -= (unsigned) ret;
+            return;
+        }
+        if ( errno != EINTR )
+            return;     // (EAGAIN/EBUSY - queued requests are submitted later)
+    }
+}
+
+
+/*
+ * adfUringReap_
+ *
+ */
+static unsigned adfUringReap_( struct AdfDevAsync * const  aio,
+                               unsigned * const            slots,
+                               const unsigned              maxSlots )
+{
+    struct AdfUring_ * const ring = &aio->ring;
+    const uint32_t blockSize = aio->dev->geometry.blockSize;
+
+    unsigned head = *ring->cqHead,
+             n    = 0;
+    const unsigned tail = __atomic_load_n( ring->cqTail, __ATOMIC_ACQUIRE );
+
+    // completed requests are counted in the stats (like driver calls,
+    // see adfDevDrvReadSectors)
+    struct AdfDevice * const dev = aio->dev;
+    const bool countStats = ( head != tail && dev->stats != NULL );
+    if ( countStats )
+        adfMutexLock( dev->ioLock );
+
+    while ( head != tail && n < maxSlots ) {
+        const struct io_uring_cqe * const cqe = &ring->cqes[ head & ring->cqMask ];
+        const unsigned slot = (unsigned) cqe->user_data;
+        struct AdfDevAsyncReq_ * const req = &aio->reqs[ slot ];
+        req->rc = ( cqe->res == (int32_t) ( req->lenBlocks * blockSize ) ) ?
+            ADF_RC_OK : ADF_RC_ERROR;
+        if ( countStats )
+            adfIoStatsAdd( req->write ? &dev->stats->write : &dev->stats->read,
+                           req->lenBlocks, blockSize, req->startNs, req->rc );
+        slots[ n++ ] = slot;
+        head++;
+    }
+    __atomic_store_n( ring->cqHead, head, __ATOMIC_RELEASE );
+
+    if ( countStats )
+        adfMutexUnlock( dev->ioLock );
+    ring->nInRing -= n;
+    return n;
+}
+
+#endif  /* HAVE_IO_URING */
@@ -0,0 +1,106 @@
+/*
+ *  adf_dev_async.h - asynchronous device I/O
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_DEV_ASYNC_H
+#define ADF_DEV_ASYNC_H
+
+#include "adf_dev.h"
+#include "adf_err.h"
+#include "adf_prefix.h"
+
+#include <stdint.h>
+
+/*
+ * Asynchronous I/O queue of a device
+ *
+ * Reads and writes of runs of device blocks are submitted with a user tag
+ * and complete in any order; completions (tag and status) are collected
+ * with adfDevAsyncPoll() (not blocking) or adfDevAsyncWait().
+ *
+ * The backend is chosen when the queue is created:
+ * - io_uring (Linux, if available) - for drivers giving a host file
+ *   descriptor (getHostFd: the dump and the Linux native driver),
+ * - a pool of threads calling the driver (the calls are serialized with
+ *   dev->ioLock - the I/O overlaps only with the caller's work),
+ * - synchronous (no threads) - a request is done when submitted.
+ *
+ * A queue must be used by one thread at a time. Buffers must stay valid
+ * until their requests complete. The order of requests in flight (and of
+ * other I/O on the device) is undefined - to read blocks being written,
+ * wait for the write to complete first.
+ */
+
+#define ADF_DEV_ASYNC_DEPTH_MAX  1024
+
+typedef enum {
+    ADF_DEV_ASYNC_SYNC,
+    ADF_DEV_ASYNC_THREADS,
+    ADF_DEV_ASYNC_IO_URING
+} AdfDevAsyncBackend;
+
+struct AdfDevAsync;
+
+struct AdfDevAsyncCompletion {
+    uint64_t     tag;
+    ADF_RETCODE  rc;
+};
+
+/* a queue of up to depth (max. ADF_DEV_ASYNC_DEPTH_MAX) requests in flight */
+ADF_PREFIX struct AdfDevAsync * adfDevAsyncCreate( struct AdfDevice * const  dev,
+                                                   const unsigned            depth );
+
+/* (waits for all requests in flight, their completions are dropped) */
+ADF_PREFIX void adfDevAsyncDestroy( struct AdfDevAsync * const  aio );
+
+ADF_PREFIX AdfDevAsyncBackend adfDevAsyncGetBackend(
+    const struct AdfDevAsync * const  aio );
+
+/* requests submitted, but not collected yet */
+ADF_PREFIX unsigned adfDevAsyncInFlight( const struct AdfDevAsync * const  aio );
+
+/* submit a read / write of lenBlocks device blocks starting from block;
+   fails if depth requests are in flight (collect completions first) */
+ADF_PREFIX ADF_RETCODE adfDevAsyncRead( struct AdfDevAsync * const  aio,
+                                        const uint32_t              block,
+                                        const uint32_t              lenBlocks,
+                                        uint8_t * const             buf,
+                                        const uint64_t              tag );
+
+ADF_PREFIX ADF_RETCODE adfDevAsyncWrite( struct AdfDevAsync * const  aio,
+                                         const uint32_t              block,
+                                         const uint32_t              lenBlocks,
+                                         const uint8_t * const       buf,
+                                         const uint64_t              tag );
+
+/* collect up to maxCompl completions, returns their number */
+ADF_PREFIX unsigned adfDevAsyncPoll( struct AdfDevAsync * const            aio,
+                                     struct AdfDevAsyncCompletion * const  completions,
+                                     const unsigned                        maxCompl );
+
+/* as above, but wait until at least minCompl (or all in flight, if fewer) */
+ADF_PREFIX unsigned adfDevAsyncWait( struct AdfDevAsync * const            aio,
+                                     struct AdfDevAsyncCompletion * const  completions,
+                                     const unsigned                        maxCompl,
+                                     const unsigned                        minCompl );
+
+#endif  /* ADF_DEV_ASYNC_H */
@@ -62,6 +62,17 @@ struct AdfDeviceDriver {
     /* optional (can be NULL); should help to match device string with the driver */
 
     bool (*isDevice)( const char * const name );
+
+    /* optional (can be NULL); a host file descriptor to read the device data
+       directly (device block n at byte n * geometry.blockSize), -1 if none;
+       the data written with writeSectors must be up to date on it */
+
+    int (*getHostFd)( const struct AdfDevice * const  dev );
+
+    /* optional (can be NULL); make the written data durable (write all
+       buffered data through to the storage, like fsync) */
+
+    ADF_RETCODE (*sync)( const struct AdfDevice * const  dev );
 };
 
 #endif  /* ADF_DEV_DRIVER_H */
@@ -22,6 +22,10 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* fseeko(), ftello() */
+#endif
+
 #include "adf_dev_driver_dump.h"
 
 #include "adf_blk.h"
@@ -29,11 +33,18 @@
 #include "adf_env.h"
 #include "adf_err.h"
 #include "adf_limits.h"
+#include "adf_util.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <io.h>         /* _commit() */
+#else
+#include <unistd.h>     /* fsync(), fdatasync() */
+#endif
+
 
 struct DevDumpData {
     FILE * fd;
@@ -81,10 +92,10 @@ static struct AdfDevice * adfCreateDumpDevice( const char * const  filename,
 /*    for(i=0; i<cylinders*heads*sectors; i++)
         fwrite(buf, sizeof(uint8_t), 512 , nDev->fd);
 */
-    long lastBlockOffset = ( ( cylinders * heads * sectors ) - 1 ) *
-        ADF_LOGICAL_BLOCK_SIZE;
-    r = fseek( *fd, lastBlockOffset, SEEK_SET );
-    if ( r == -1 ) {
+    const AdfFileOffset lastBlockOffset =
+        ( (AdfFileOffset) cylinders * heads * sectors - 1 ) * ADF_LOGICAL_BLOCK_SIZE;
+    r = adfFSeek( *fd, lastBlockOffset, SEEK_SET );
+    if ( r != 0 ) {
         fclose( *fd );
         free( dev->drvData );
         free( dev );
@@ -167,9 +178,26 @@ static struct AdfDevice * adfDevDumpOpen( const char * const   name,
     dev->geometry.blockSize = ADF_DEV_BLOCK_SIZE;
 
     /* determines size */
-    fseek( *fd, 0, SEEK_END );
-    dev->sizeBlocks = (uint32_t)( ftell( *fd ) / dev->geometry.blockSize );
-    fseek( *fd, 0, SEEK_SET );
+    AdfFileOffset size = -1;
+    if ( adfFSeek( *fd, 0, SEEK_END ) == 0 )
+        size = adfFTell( *fd );
+    if ( size < 0 || adfFSeek( *fd, 0, SEEK_SET ) != 0 ) {
+        adfEnv.eFct( "%s: cannot get the size of '%s'", __func__, name );
+        fclose( *fd );
+        free( dev->drvData );
+        free( dev );
+        return NULL;
+    }
+
+    uint64_t sizeBlocks = (uint64_t) size / dev->geometry.blockSize;
+    if ( sizeBlocks > ADF_DEV_SIZE_MAX_BLOCKS ) {
+        adfEnv.wFct( "%s: '%s' is bigger (%llu blocks) than supported, "
+                     "only the first %llu blocks are accessible",
+                     __func__, name, (unsigned long long) sizeBlocks,
+                     (unsigned long long) ADF_DEV_SIZE_MAX_BLOCKS );
+        sizeBlocks = ADF_DEV_SIZE_MAX_BLOCKS;
+    }
+    dev->sizeBlocks = (uint32_t) sizeBlocks;
 
     dev->dev_class = adfDevGetClassBySizeBlocks( dev->sizeBlocks );
     dev->type  = ADF_DEVTYPE_UNKNOWN; // geometry unknown
@@ -214,8 +242,8 @@ static ADF_RETCODE adfReadDumpSectors( const struct AdfDevice * const  dev,
         return ADF_RC_ERROR;
 
     FILE * const fd = ( (struct DevDumpData *) dev->drvData )->fd;
-    int pos = fseek( fd, dev->geometry.blockSize * block, SEEK_SET );
-    if ( pos == -1 )
+    const AdfFileOffset offset = (AdfFileOffset) dev->geometry.blockSize * block;
+    if ( adfFSeek( fd, offset, SEEK_SET ) != 0 )
         return ADF_RC_ERROR;
 
     if ( fread( buf, dev->geometry.blockSize, lenBlocks, fd ) != lenBlocks )
@@ -238,8 +266,8 @@ static ADF_RETCODE adfWriteDumpSectors( const struct AdfDevice * const  dev,
         return ADF_RC_ERROR;
 
     FILE * const fd = ( (struct DevDumpData *) dev->drvData )->fd;
-    int r = fseek( fd, dev->geometry.blockSize * block, SEEK_SET );
-    if ( r == -1 )
+    const AdfFileOffset offset = (AdfFileOffset) dev->geometry.blockSize * block;
+    if ( adfFSeek( fd, offset, SEEK_SET ) != 0 )
         return ADF_RC_ERROR;
 
     if ( fwrite( buf, dev->geometry.blockSize, lenBlocks, fd ) != lenBlocks )
@@ -249,6 +277,40 @@ static ADF_RETCODE adfWriteDumpSectors( const struct AdfDevice * const  dev,
 }
 
 
+/*
+ * adfDumpGetHostFd
+ *
+ * (pending writes are flushed first)
+ */
+static int adfDumpGetHostFd( const struct AdfDevice * const  dev )
+{
+    FILE * const fd = ( (struct DevDumpData *) dev->drvData )->fd;
+    if ( fflush( fd ) != 0 )
+        return -1;
+    return fileno( fd );
+}
+
+
+/*
+ * adfDumpSync
+ *
+ */
+static ADF_RETCODE adfDumpSync( const struct AdfDevice * const  dev )
+{
+    FILE * const fd = ( (struct DevDumpData *) dev->drvData )->fd;
+    if ( fflush( fd ) != 0 )
+        return ADF_RC_ERROR;
+#if defined _WIN32
+    const int r = _commit( _fileno( fd ) );
+#elif defined HAVE_FDATASYNC
+    const int r = fdatasync( fileno( fd ) );   // (the size does not change)
+#else
+    const int r = fsync( fileno( fd ) );
+#endif
+    return ( r == 0 ) ? ADF_RC_OK : ADF_RC_ERROR;
+}
+
+
 static bool adfDevDumpIsNativeDevice( void )
 {
     return false;
@@ -263,7 +325,9 @@ const struct AdfDeviceDriver adfDeviceDriverDump = {
     .readSectors  = adfReadDumpSectors,
     .writeSectors = adfWriteDumpSectors,
     .isNative     = adfDevDumpIsNativeDevice,
-    .isDevice     = NULL
+    .isDevice     = NULL,
+    .getHostFd    = adfDumpGetHostFd,
+    .sync         = adfDumpSync
 };
 
 /*##################################################################################*/
@@ -0,0 +1,806 @@
+/*
+ *  adf_dev_driver_gzip.c - compressed (gzip) image device driver
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* fseeko(), ftello() */
+#endif
+
+#include "adf_dev_driver_gzip.h"
+
+#include "adf_dev_type.h"
+#include "adf_env.h"
+#include "adf_limits.h"
+#include "adf_util.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+
+static uint32_t  gzipSpacing     = ADF_GZIP_SPACING_DEFAULT;
+static bool      gzipIndexSaving = false;
+
+
+/*
+ * adfGzipSetIndexSpacing
+ *
+ */
+ADF_RETCODE adfGzipSetIndexSpacing( const uint32_t  spacing )
+{
+    if ( spacing < ADF_GZIP_SPACING_MIN ) {
+        adfEnv.eFct( "%s: spacing %u smaller than min. %u",
+                     __func__, spacing, ADF_GZIP_SPACING_MIN );
+        return ADF_RC_ERROR;
+    }
+    gzipSpacing = spacing;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfGzipSetIndexSaving
+ *
+ */
+void adfGzipSetIndexSaving( const bool  enabled )
+{
+    gzipIndexSaving = enabled;
+}
+
+
+/*
+ * gzipIsDevice
+ *
+ * (by the name extension: .adz, .hdz, .gz)
+ */
+static bool gzipIsDevice( const char * const  name )
+{
+    static const char * const extensions[] = { ".adz", ".hdz", ".gz" };
+
+    const size_t nameLen = strlen( name );
+    for ( unsigned i = 0 ; i < sizeof extensions / sizeof extensions[ 0 ] ; i++ ) {
+        const size_t extLen = strlen( extensions[ i ] );
+        if ( nameLen <= extLen )
+            continue;
+        const char * const ext = name + nameLen - extLen;
+        size_t j = 0;
+        while ( j < extLen && tolower( (unsigned char) ext[ j ] ) == extensions[ i ][ j ] )
+            j++;
+        if ( j == extLen )
+            return true;
+    }
+    return false;
+}
+
+
+static bool gzipIsDevNative( void )
+{
+    return false;
+}
+
+
+#ifdef HAVE_ZLIB
+
+#define GZIP_WINDOW_SIZE    32768
+#define GZIP_BUF_SIZE       65536
+
+#define GZIP_INDEX_MAGIC        "ADFGZIX2"
+#define GZIP_INDEX_MAGIC_LEN    8
+#define GZIP_INDEX_HEADER_SIZE  ( GZIP_INDEX_MAGIC_LEN + 36 )
+#define GZIP_TRAILER_SIZE       8       /* CRC32, ISIZE */
+#define GZIP_INDEX_POINT_SIZE   24
+
+/* a point where decompressing can start (at a deflate block boundary) */
+struct GzipPoint {
+    uint64_t   out;         /* offset in the decompressed data */
+    uint64_t   in;          /* offset of the next (full) compressed byte */
+    unsigned   bits;        /* used bits of the byte before 'in' (0-7) */
+    unsigned   windowLen;
+    uint8_t *  window;      /* the decompressed data before 'out' */
+};
+
+/* decompressed data from a point up to the next one */
+struct GzipPart {
+    uint32_t   point;       /* UINT32_MAX - unused */
+    uint64_t   lastUse;
+    size_t     len,
+               capacity;
+    uint8_t *  data;
+};
+
+struct DevGzipData {
+    FILE *              fd;
+    uint64_t            compressedSize,
+                        size;
+
+    /* identify the image of a saved index */
+    uint8_t             trailer[ GZIP_TRAILER_SIZE ];
+    int64_t             mtime;
+
+    struct GzipPoint *  points;
+    uint32_t            nPoints,
+                        capacity;
+
+    /* (updated when reading - with the device I/O lock held) */
+    struct GzipPart     cache[ ADF_GZIP_CACHE_PARTS ];
+    uint64_t            useCounter;
+
+    uint8_t *           inBuf;
+};
+
+static ADF_RETCODE gzipIndexBuild_( struct DevGzipData * const  data,
+                                    const uint32_t              spacing );
+static ADF_RETCODE gzipIndexLoad_( struct DevGzipData * const  data,
+                                   const char * const          indexName );
+static ADF_RETCODE gzipIndexSave_( const struct DevGzipData * const  data,
+                                   const char * const                indexName );
+static ADF_RETCODE gzipAddPoint_( struct DevGzipData * const  data,
+                                  const uint64_t              out,
+                                  const uint64_t              in,
+                                  const unsigned              bits,
+                                  z_stream * const            strm );
+static void gzipIndexFree_( struct DevGzipData * const  data );
+
+static const uint8_t * gzipGetPart_( struct DevGzipData * const  data,
+                                     const uint32_t              point,
+                                     size_t * const              len );
+static ADF_RETCODE gzipInflatePart_( struct DevGzipData * const  data,
+                                     const uint32_t              point,
+                                     uint8_t * const             buf,
+                                     const size_t                len );
+
+static void gzipPut64_( uint8_t * const  buf,
+                        const uint64_t   val );
+static uint64_t gzipGet64_( const uint8_t * const  buf );
+
+static ADF_RETCODE gzipRelease( struct AdfDevice * const  dev );
+
+
+/*
+ * gzipOpen
+ *
+ */
+static struct AdfDevice * gzipOpen( const char * const   name,
+                                    const AdfAccessMode  mode )
+{
+    if ( mode == ADF_ACCESS_MODE_READWRITE )
+        adfEnv.wFct( "%s: compressed image '%s' opened read-only", __func__, name );
+
+    struct AdfDevice * const  dev = ( struct AdfDevice * )
+        malloc( sizeof ( struct AdfDevice ) );
+    if ( dev == NULL ) {
+        adfEnv.eFct( "%s: malloc error", __func__ );
+        return NULL;
+    }
+
+    struct DevGzipData * const data = calloc( 1, sizeof ( struct DevGzipData ) );
+    if ( data == NULL ) {
+        adfEnv.eFct( "%s: malloc data error", __func__ );
+        free( dev );
+        return NULL;
+    }
+    for ( unsigned i = 0 ; i < ADF_GZIP_CACHE_PARTS ; i++ )
+        data->cache[ i ].point = UINT32_MAX;
+
+    dev->drvData  = data;
+    dev->name     = strdup( name );
+    dev->readOnly = true;
+    dev->drv      = &adfDeviceDriverGzip;
+
+    data->inBuf = malloc( GZIP_BUF_SIZE );
+    data->fd    = fopen( name, "rb" );
+    if ( dev->name == NULL || data->inBuf == NULL || data->fd == NULL ) {
+        adfEnv.eFct( "%s: cannot open '%s'", __func__, name );
+        gzipRelease( dev );
+        return NULL;
+    }
+
+    AdfFileOffset compressedSize = -1;
+    if ( adfFSeek( data->fd, 0, SEEK_END ) == 0 )
+        compressedSize = adfFTell( data->fd );
+    if ( compressedSize < 0 ) {
+        adfEnv.eFct( "%s: cannot get the size of '%s'", __func__, name );
+        gzipRelease( dev );
+        return NULL;
+    }
+    data->compressedSize = (uint64_t) compressedSize;
+
+    if ( compressedSize >= GZIP_TRAILER_SIZE &&
+         ( adfFSeek( data->fd, -GZIP_TRAILER_SIZE, SEEK_END ) != 0 ||
+           fread( data->trailer, GZIP_TRAILER_SIZE, 1, data->fd ) != 1 ) )
+    {
+        adfEnv.eFct( "%s: cannot read '%s'", __func__, name );
+        gzipRelease( dev );
+        return NULL;
+    }
+    struct stat st;
+    data->mtime = ( stat( name, &st ) == 0 ) ? (int64_t) st.st_mtime : 0;
+
+    //
+    // Index of access points (saved one, if enabled and valid)
+    //
+    char * indexName = NULL;
+    if ( gzipIndexSaving ) {
+        indexName = malloc( strlen( name ) + sizeof ADF_GZIP_INDEX_EXT );
+        if ( indexName == NULL ) {
+            adfEnv.eFct( "%s: malloc error", __func__ );
+            gzipRelease( dev );
+            return NULL;
+        }
+        strcpy( indexName, name );
+        strcat( indexName, ADF_GZIP_INDEX_EXT );
+    }
+
+    if ( indexName == NULL || gzipIndexLoad_( data, indexName ) != ADF_RC_OK ) {
+        if ( gzipIndexBuild_( data, gzipSpacing ) != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: cannot decompress '%s'", __func__, name );
+            free( indexName );
+            gzipRelease( dev );
+            return NULL;
+        }
+        if ( indexName != NULL && gzipIndexSave_( data, indexName ) != ADF_RC_OK )
+            adfEnv.wFct( "%s: cannot save index '%s'", __func__, indexName );
+    }
+    free( indexName );
+
+    dev->geometry.blockSize = ADF_DEV_BLOCK_SIZE;
+
+    uint64_t sizeBlocks = data->size / dev->geometry.blockSize;
+    if ( sizeBlocks * dev->geometry.blockSize != data->size ) {
+        adfEnv.wFct( "%s: the size of '%s' (%llu) is unaligned to %u-byte blocks",
+                     __func__, name, (unsigned long long) data->size,
+                     dev->geometry.blockSize );
+    }
+    if ( sizeBlocks > ADF_DEV_SIZE_MAX_BLOCKS ) {
+        adfEnv.wFct( "%s: '%s' is bigger (%llu blocks) than supported, "
+                     "only the first %llu blocks are accessible",
+                     __func__, name, (unsigned long long) sizeBlocks,
+                     (unsigned long long) ADF_DEV_SIZE_MAX_BLOCKS );
+        sizeBlocks = ADF_DEV_SIZE_MAX_BLOCKS;
+    }
+    dev->sizeBlocks = (uint32_t) sizeBlocks;
+
+    dev->dev_class = adfDevGetClassBySizeBlocks( dev->sizeBlocks );
+    dev->type      = ADF_DEVTYPE_UNKNOWN; // geometry unknown
+    dev->nVol      = 0;
+    dev->volList   = NULL;
+    dev->mounted   = false;
+
+    return dev;
+}
+
+
+/*
+ * gzipRelease
+ *
+ */
+static ADF_RETCODE gzipRelease( struct AdfDevice * const  dev )
+{
+    struct DevGzipData * const data = dev->drvData;
+
+    if ( data->fd != NULL )
+        fclose( data->fd );
+    gzipIndexFree_( data );
+    for ( unsigned i = 0 ; i < ADF_GZIP_CACHE_PARTS ; i++ )
+        free( data->cache[ i ].data );
+    free( data->inBuf );
+    free( data );
+    free( dev->name );
+    free( dev );
+    return ADF_RC_OK;
+}
+
+
+/*
+ * gzipReadSectors
+ *
+ */
+static ADF_RETCODE gzipReadSectors( const struct AdfDevice * const  dev,
+                                    const uint32_t                  block,
+                                    const uint32_t                  lenBlocks,
+                                    uint8_t * const                 buf )
+{
+    if ( block + lenBlocks > dev->sizeBlocks )
+        return ADF_RC_ERROR;
+
+    struct DevGzipData * const data = dev->drvData;
+
+    uint64_t offset = (uint64_t) dev->geometry.blockSize * block;
+    size_t   len    = (size_t) dev->geometry.blockSize * lenBlocks,
+             done   = 0;
+
+    // the last point before the offset
+    uint32_t lo = 0,
+             hi = data->nPoints;
+    while ( hi - lo > 1 ) {
+        const uint32_t mid = lo + ( hi - lo ) / 2;
+        if ( data->points[ mid ].out <= offset )
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    for ( uint32_t point = lo ; len > 0 ; point++ ) {
+        size_t partLen;
+        const uint8_t * const part = gzipGetPart_( data, point, &partLen );
+        if ( part == NULL )
+            return ADF_RC_ERROR;
+
+        const size_t skip = (size_t) ( offset - data->points[ point ].out ),
+                     n    = min( len, partLen - skip );
+        memcpy( buf + done, part + skip, n );
+        done   += n;
+        len    -= n;
+        offset += n;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * gzipIndexBuild_
+ *
+ * decompress the whole image, adding access points at the deflate block
+ * boundaries at least 'spacing' bytes (of decompressed data) apart
+ */
+static ADF_RETCODE gzipIndexBuild_( struct DevGzipData * const  data,
+                                    const uint32_t              spacing )
+{
+    uint8_t * const outBuf = malloc( GZIP_BUF_SIZE );
+    if ( outBuf == NULL ) {
+        adfEnv.eFct( "%s: malloc error", __func__ );
+        return ADF_RC_MALLOC;
+    }
+
+    z_stream strm;
+    memset( &strm, 0, sizeof strm );
+    if ( inflateInit2( &strm, 15 + 32 ) != Z_OK ) {   // (gzip or zlib header)
+        adfEnv.eFct( "%s: inflateInit2 failed", __func__ );
+        free( outBuf );
+        return ADF_RC_ERROR;
+    }
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    uint64_t totalIn  = 0,
+             totalOut = 0,
+             last     = 0;
+    int ret;
+    if ( adfFSeek( data->fd, 0, SEEK_SET ) != 0 ) {
+        rc = ADF_RC_ERROR;
+        goto end;
+    }
+
+    do {
+        if ( strm.avail_in == 0 ) {
+            strm.avail_in = (uInt) fread( data->inBuf, 1, GZIP_BUF_SIZE, data->fd );
+            strm.next_in  = data->inBuf;
+            if ( strm.avail_in == 0 ) {
+                adfEnv.eFct( "%s: %s", __func__, ferror( data->fd ) ?
+                             "read error" : "unexpected end of compressed data" );
+                rc = ADF_RC_ERROR;
+                goto end;
+            }
+        }
+
+        strm.next_out  = outBuf;
+        strm.avail_out = GZIP_BUF_SIZE;
+        totalIn  += strm.avail_in;
+        totalOut += strm.avail_out;
+        ret = inflate( &strm, Z_BLOCK );
+        totalIn  -= strm.avail_in;
+        totalOut -= strm.avail_out;
+
+        if ( ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR ||
+             ret == Z_STREAM_ERROR )
+        {
+            adfEnv.eFct( "%s: invalid compressed data (zlib error %d)", __func__, ret );
+            rc = ADF_RC_ERROR;
+            goto end;
+        }
+
+        // (at a block boundary, not after the last block)
+        if ( ( strm.data_type & 128 ) && ! ( strm.data_type & 64 ) &&
+             ( data->nPoints == 0 || totalOut - last >= spacing ) )
+        {
+            rc = gzipAddPoint_( data, totalOut, totalIn,
+                                (unsigned) strm.data_type & 7, &strm );
+            if ( rc != ADF_RC_OK )
+                goto end;
+            last = totalOut;
+        }
+    } while ( ret != Z_STREAM_END );
+
+    data->size = totalOut;
+
+    // (concatenated gzip streams are not supported)
+    if ( strm.avail_in > 0 || fread( data->inBuf, 1, 1, data->fd ) > 0 )
+        adfEnv.wFct( "%s: data after the end of the compressed stream ignored",
+                     __func__ );
+
+end:
+    inflateEnd( &strm );
+    free( outBuf );
+    if ( rc != ADF_RC_OK )
+        gzipIndexFree_( data );
+    return rc;
+}
+
+
+/*
+ * gzipAddPoint_
+ *
+ */
+static ADF_RETCODE gzipAddPoint_( struct DevGzipData * const  data,
+                                  const uint64_t              out,
+                                  const uint64_t              in,
+                                  const unsigned              bits,
+                                  z_stream * const            strm )
+{
+    if ( data->nPoints == data->capacity ) {
+        const uint32_t capacity = ( data->capacity > 0 ) ? data->capacity * 2 : 16;
+        struct GzipPoint * const points =
+            realloc( data->points, sizeof ( struct GzipPoint ) * capacity );
+        if ( points == NULL ) {
+            adfEnv.eFct( "%s: malloc error", __func__ );
+            return ADF_RC_MALLOC;
+        }
+        data->points   = points;
+        data->capacity = capacity;
+    }
+
+    struct GzipPoint * const point = &data->points[ data->nPoints ];
+    point->out       = out;
+    point->in        = in;
+    point->bits      = bits;
+    point->windowLen = 0;
+    point->window    = NULL;
+
+    if ( out > 0 ) {
+        point->window = malloc( GZIP_WINDOW_SIZE );
+        if ( point->window == NULL ) {
+            adfEnv.eFct( "%s: malloc error", __func__ );
+            return ADF_RC_MALLOC;
+        }
+        uInt windowLen = GZIP_WINDOW_SIZE;
+        if ( inflateGetDictionary( strm, point->window, &windowLen ) != Z_OK ) {
+            free( point->window );
+            adfEnv.eFct( "%s: inflateGetDictionary failed", __func__ );
+            return ADF_RC_ERROR;
+        }
+        point->windowLen = windowLen;
+    }
+
+    data->nPoints++;
+    return ADF_RC_OK;
+}
+
+
+static void gzipIndexFree_( struct DevGzipData * const  data )
+{
+    for ( uint32_t i = 0 ; i < data->nPoints ; i++ )
+        free( data->points[ i ].window );
+    free( data->points );
+    data->points   = NULL;
+    data->nPoints  = 0;
+    data->capacity = 0;
+}
+
+
+/*
+ * gzipGetPart_
+ *
+ * the decompressed data from a point (cached, the least recently used
+ * part is replaced)
+ */
+static const uint8_t * gzipGetPart_( struct DevGzipData * const  data,
+                                     const uint32_t              point,
+                                     size_t * const              len )
+{
+    struct GzipPart * part = &data->cache[ 0 ];
+    for ( unsigned i = 0 ; i < ADF_GZIP_CACHE_PARTS ; i++ ) {
+        struct GzipPart * const p = &data->cache[ i ];
+        if ( p->point == point ) {
+            p->lastUse = ++data->useCounter;
+            *len = p->len;
+            return p->data;
+        }
+        if ( p->point == UINT32_MAX ||
+             ( part->point != UINT32_MAX && p->lastUse < part->lastUse ) )
+            part = p;
+    }
+
+    const uint64_t end = ( point + 1 < data->nPoints ) ?
+        data->points[ point + 1 ].out : data->size;
+    const uint64_t partLen = end - data->points[ point ].out;
+    if ( partLen > UINT_MAX ) {
+        adfEnv.eFct( "%s: part %u too big (%llu)", __func__, point,
+                     (unsigned long long) partLen );
+        return NULL;
+    }
+
+    if ( part->capacity < partLen ) {
+        uint8_t * const buf = realloc( part->data, (size_t) partLen );
+        if ( buf == NULL ) {
+            adfEnv.eFct( "%s: malloc error", __func__ );
+            return NULL;
+        }
+        part->data     = buf;
+        part->capacity = (size_t) partLen;
+    }
+
+    part->point = UINT32_MAX;
+    if ( gzipInflatePart_( data, point, part->data, (size_t) partLen ) != ADF_RC_OK )
+        return NULL;
+
+    part->point   = point;
+    part->len     = (size_t) partLen;
+    part->lastUse = ++data->useCounter;
+    *len = part->len;
+    return part->data;
+}
+
+
+/*
+ * gzipInflatePart_
+ *
+ * decompress 'len' bytes starting from a point
+ */
+static ADF_RETCODE gzipInflatePart_( struct DevGzipData * const  data,
+                                     const uint32_t              point,
+                                     uint8_t * const             buf,
+                                     const size_t                len )
+{
+    const struct GzipPoint * const p = &data->points[ point ];
+
+    z_stream strm;
+    memset( &strm, 0, sizeof strm );
+    if ( inflateInit2( &strm, -15 ) != Z_OK ) {     // (raw deflate)
+        adfEnv.eFct( "%s: inflateInit2 failed", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    ADF_RETCODE rc = ADF_RC_ERROR;
+    if ( adfFSeek( data->fd, (AdfFileOffset) ( p->in - ( p->bits ? 1 : 0 ) ),
+                   SEEK_SET ) != 0 )
+        goto end;
+    if ( p->bits ) {
+        const int byte = getc( data->fd );
+        if ( byte == EOF )
+            goto end;
+        inflatePrime( &strm, (int) p->bits, byte >> ( 8 - p->bits ) );
+    }
+    if ( p->windowLen > 0 &&
+         inflateSetDictionary( &strm, p->window, p->windowLen ) != Z_OK )
+        goto end;
+
+    strm.next_out  = buf;
+    strm.avail_out = (uInt) len;
+    while ( strm.avail_out > 0 ) {
+        if ( strm.avail_in == 0 ) {
+            strm.avail_in = (uInt) fread( data->inBuf, 1, GZIP_BUF_SIZE, data->fd );
+            strm.next_in  = data->inBuf;
+            if ( strm.avail_in == 0 )
+                goto end;
+        }
+        const int ret = inflate( &strm, Z_NO_FLUSH );
+        if ( ret == Z_STREAM_END )
+            break;
+        if ( ret != Z_OK )
+            goto end;
+    }
+    if ( strm.avail_out == 0 )
+        rc = ADF_RC_OK;
+
+end:
+    if ( rc != ADF_RC_OK )
+        adfEnv.eFct( "%s: error decompressing from offset %llu", __func__,
+                     (unsigned long long) p->out );
+    inflateEnd( &strm );
+    return rc;
+}
+
+
+/*
+ * gzipIndexSave_
+ *
+ * header: magic, compressed size, decompressed size (uint64), number of points,
+ *         the gzip trailer (CRC32, ISIZE), the image mtime (uint64);
+ * points: out, in (uint64), bits, window length (uint32), window
+ * (all big-endian)
+ */
+static ADF_RETCODE gzipIndexSave_( const struct DevGzipData * const  data,
+                                   const char * const                indexName )
+{
+    FILE * const f = fopen( indexName, "wb" );
+    if ( f == NULL )
+        return ADF_RC_ERROR;
+
+    uint8_t buf[ GZIP_INDEX_HEADER_SIZE ];
+    memcpy( buf, GZIP_INDEX_MAGIC, GZIP_INDEX_MAGIC_LEN );
+    gzipPut64_( buf + GZIP_INDEX_MAGIC_LEN,      data->compressedSize );
+    gzipPut64_( buf + GZIP_INDEX_MAGIC_LEN + 8,  data->size );
+    swapUint32ToPtr( buf + GZIP_INDEX_MAGIC_LEN + 16, data->nPoints );
+    memcpy( buf + GZIP_INDEX_MAGIC_LEN + 20, data->trailer, GZIP_TRAILER_SIZE );
+    gzipPut64_( buf + GZIP_INDEX_MAGIC_LEN + 28, (uint64_t) data->mtime );
+    bool ok = ( fwrite( buf, GZIP_INDEX_HEADER_SIZE, 1, f ) == 1 );
+
+    for ( uint32_t i = 0 ; ok && i < data->nPoints ; i++ ) {
+        const struct GzipPoint * const p = &data->points[ i ];
+        gzipPut64_( buf,      p->out );
+        gzipPut64_( buf + 8,  p->in );
+        swapUint32ToPtr( buf + 16, p->bits );
+        swapUint32ToPtr( buf + 20, p->windowLen );
+        ok = ( fwrite( buf, GZIP_INDEX_POINT_SIZE, 1, f ) == 1 &&
+               ( p->windowLen == 0 || fwrite( p->window, p->windowLen, 1, f ) == 1 ) );
+    }
+
+    if ( fclose( f ) != 0 || ! ok ) {
+        remove( indexName );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * gzipIndexLoad_
+ *
+ * (fails if the index does not match the image: the compressed size,
+ * the gzip trailer and the modification time must be the same)
+ */
+static ADF_RETCODE gzipIndexLoad_( struct DevGzipData * const  data,
+                                   const char * const          indexName )
+{
+    FILE * const f = fopen( indexName, "rb" );
+    if ( f == NULL )
+        return ADF_RC_ERROR;
+
+    uint8_t buf[ GZIP_INDEX_HEADER_SIZE ];
+    if ( fread( buf, GZIP_INDEX_HEADER_SIZE, 1, f ) != 1 ||
+         memcmp( buf, GZIP_INDEX_MAGIC, GZIP_INDEX_MAGIC_LEN ) != 0 ||
+         gzipGet64_( buf + GZIP_INDEX_MAGIC_LEN ) != data->compressedSize ||
+         memcmp( buf + GZIP_INDEX_MAGIC_LEN + 20, data->trailer, GZIP_TRAILER_SIZE ) != 0 ||
+         gzipGet64_( buf + GZIP_INDEX_MAGIC_LEN + 28 ) != (uint64_t) data->mtime )
+    {
+        fclose( f );
+        return ADF_RC_ERROR;
+    }
+    data->size = gzipGet64_( buf + GZIP_INDEX_MAGIC_LEN + 8 );
+    const uint32_t nPoints = swapUint32fromPtr( buf + GZIP_INDEX_MAGIC_LEN + 16 );
+
+    ADF_RETCODE rc = ( nPoints > 0 ) ? ADF_RC_OK : ADF_RC_ERROR;
+    for ( uint32_t i = 0 ; rc == ADF_RC_OK && i < nPoints ; i++ ) {
+        if ( fread( buf, GZIP_INDEX_POINT_SIZE, 1, f ) != 1 ) {
+            rc = ADF_RC_ERROR;
+            break;
+        }
+        const uint64_t out       = gzipGet64_( buf ),
+                       in        = gzipGet64_( buf + 8 );
+        const uint32_t bits      = swapUint32fromPtr( buf + 16 ),
+                       windowLen = swapUint32fromPtr( buf + 20 );
+        if ( bits > 7 || windowLen > GZIP_WINDOW_SIZE || in > data->compressedSize ||
+             out > data->size || ( i > 0 && out <= data->points[ i - 1 ].out ) ||
+             ( i == 0 && out != 0 ) )
+        {
+            rc = ADF_RC_ERROR;
+            break;
+        }
+
+        // (the window is read directly to a new point)
+        rc = gzipAddPoint_( data, 0, in, bits, NULL );
+        if ( rc != ADF_RC_OK )
+            break;
+        struct GzipPoint * const p = &data->points[ data->nPoints - 1 ];
+        p->out = out;
+        if ( windowLen > 0 ) {
+            p->window = malloc( windowLen );
+            if ( p->window == NULL ||
+                 fread( p->window, windowLen, 1, f ) != 1 )
+                rc = ADF_RC_ERROR;
+            else
+                p->windowLen = windowLen;
+        }
+    }
+    fclose( f );
+
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.wFct( "%s: invalid index '%s', rebuilding", __func__, indexName );
+        gzipIndexFree_( data );
+    }
+    return rc;
+}
+
+
+static void gzipPut64_( uint8_t * const  buf,
+                        const uint64_t   val )
+{
+    swapUint32ToPtr( buf,     (uint32_t) ( val >> 32 ) );
+    swapUint32ToPtr( buf + 4, (uint32_t) val );
+}
+
+static uint64_t gzipGet64_( const uint8_t * const  buf )
+{
+    return ( (uint64_t) swapUint32fromPtr( buf ) << 32 ) |
+        swapUint32fromPtr( buf + 4 );
+}
+
+#else  /* HAVE_ZLIB */
+
+static struct AdfDevice * gzipOpen( const char * const   name,
+                                    const AdfAccessMode  mode )
+{
+    (void) mode;
+    adfEnv.eFct( "%s: cannot open '%s' - built without zlib", __func__, name );
+    return NULL;
+}
+
+static ADF_RETCODE gzipRelease( struct AdfDevice * const  dev )
+{
+    (void) dev;
+    return ADF_RC_ERROR;
+}
+
+static ADF_RETCODE gzipReadSectors( const struct AdfDevice * const  dev,
+                                    const uint32_t                  block,
+                                    const uint32_t                  lenBlocks,
+                                    uint8_t * const                 buf )
+{
+    (void) dev, (void) block, (void) lenBlocks, (void) buf;
+    return ADF_RC_ERROR;
+}
+
+#endif  /* HAVE_ZLIB */
+
+
+/*
+ * gzipWriteSectors
+ *
+ */
+static ADF_RETCODE gzipWriteSectors( const struct AdfDevice * const  dev,
+                                     const uint32_t                  block,
+                                     const uint32_t                  lenBlocks,
+                                     const uint8_t * const           buf )
+{
+    (void) block, (void) lenBlocks, (void) buf;
+    adfEnv.eFct( "%s: compressed image '%s' is read-only", __func__, dev->name );
+    return ADF_RC_ERROR;
+}
+
+
+const struct AdfDeviceDriver adfDeviceDriverGzip = {
+    .name         = "gzip",
+    .data         = NULL,
+    .createDev    = NULL,
+    .openDev      = gzipOpen,
+    .closeDev     = gzipRelease,
+    .readSectors  = gzipReadSectors,
+    .writeSectors = gzipWriteSectors,
+    .isNative     = gzipIsDevNative,
+    .isDevice     = gzipIsDevice
+};
@@ -0,0 +1,61 @@
+/*
+ *  adf_dev_driver_gzip.h - compressed (gzip) image device driver
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_DEV_DRIVER_GZIP_H
+#define ADF_DEV_DRIVER_GZIP_H
+
+#include "adf_dev_driver.h"
+#include "adf_err.h"
+#include "adf_prefix.h"
+
+/*
+ * The gzip device reads gzip (or zlib) compressed images (.adz, .hdz, .gz)
+ * without decompressing them to a file (read-only; requires zlib).
+ *
+ * When opened, the image is decompressed once to build an index of access
+ * points (every "spacing" bytes of decompressed data, with the 32 KiB
+ * of the data preceding each); reads decompress only from the nearest access
+ * point. The most recently decompressed parts are cached.
+ *
+ * Optionally, the index is saved next to the image (the image name
+ * + ADF_GZIP_INDEX_EXT) and used when the image is opened again (if the
+ * image has not changed - the same size, gzip trailer and modification time).
+ */
+extern const struct AdfDeviceDriver adfDeviceDriverGzip;
+
+#define ADF_GZIP_INDEX_EXT        ".gzidx"
+
+#define ADF_GZIP_SPACING_MIN      32768
+#define ADF_GZIP_SPACING_DEFAULT  ( 1024 * 1024 )
+
+/* decompressed parts (between access points) kept in memory */
+#define ADF_GZIP_CACHE_PARTS      8
+
+/* the spacing of access points for images opened later (not used
+   for indexes loaded from a file) */
+ADF_PREFIX ADF_RETCODE adfGzipSetIndexSpacing( const uint32_t  spacing );
+
+/* save (and use saved) indexes */
+ADF_PREFIX void adfGzipSetIndexSaving( const bool  enabled );
+
+#endif  /* ADF_DEV_DRIVER_GZIP_H */
@@ -30,4 +30,24 @@
 
 ADF_PREFIX extern const struct  AdfDeviceDriver adfDeviceDriverNative;
 
+/*
+ * I/O mode of a native device
+ *
+ * - ADF_NATIVE_IO_CACHED      - through the host page cache (default)
+ * - ADF_NATIVE_IO_DROP_BEHIND - cached, but the accessed blocks are dropped
+ *                               from the cache (for a single pass over a big
+ *                               device, eg. copying or hashing)
+ * - ADF_NATIVE_IO_DIRECT      - bypassing the page cache (O_DIRECT on Linux)
+ *
+ * Not all modes are available on all platforms (an error is returned then).
+ */
+typedef enum {
+    ADF_NATIVE_IO_CACHED,
+    ADF_NATIVE_IO_DROP_BEHIND,
+    ADF_NATIVE_IO_DIRECT
+} AdfNativeIoMode;
+
+ADF_PREFIX ADF_RETCODE adfNativeSetIoMode( struct AdfDevice * const  dev,
+                                           const AdfNativeIoMode     mode );
+
 #endif  /* ADF_DEV_DRIVER_NATIV_H */
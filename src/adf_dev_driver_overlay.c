@@ -0,0 +1,634 @@
+/*
+ *  adf_dev_driver_overlay.c - copy-on-write overlay device driver
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* fseeko(), ftello() */
+#endif
+
+#include "adf_dev_driver_overlay.h"
+
+#include "adf_dev_drivers.h"
+#include "adf_dev_type.h"
+#include "adf_env.h"
+#include "adf_limits.h"
+#include "adf_thread.h"
+#include "adf_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * The delta file:
+ * - header: magic (8 bytes), the size of the base (in blocks)
+ *   and the block size (big-endian uint32),
+ * - records (in the order of the first write of each block):
+ *   the block number (big-endian uint32) and the block data.
+ *
+ * The index of the records (sorted by block) is kept in memory.
+ */
+#define OVERLAY_MAGIC        "ADFDELTA"
+#define OVERLAY_MAGIC_LEN    8
+#define OVERLAY_HEADER_SIZE  ( OVERLAY_MAGIC_LEN + 8 )
+
+/* blocks written to the base at once when committing */
+#define OVERLAY_COMMIT_RUN   64
+
+struct OverlayIndexEntry {
+    uint32_t block,
+             record;
+};
+
+struct DevOverlayData {
+    struct AdfDevice *          base;       /* opened read-only */
+    FILE *                      delta;      /* NULL - no delta (read-only) */
+    char *                      deltaName;
+
+    struct OverlayIndexEntry *  index;
+    uint32_t                    nBlocks,
+                                capacity;
+};
+
+static struct AdfDevice * overlayOpenBase_( const char * const   name,
+                                            const AdfAccessMode  mode );
+static void overlayCloseBase_( struct AdfDevice * const  base );
+
+static ADF_RETCODE overlayDeltaCreate_( struct DevOverlayData * const   data,
+                                        const struct AdfDevice * const  dev );
+static ADF_RETCODE overlayDeltaLoad_( struct DevOverlayData * const  data,
+                                      const struct AdfDevice * const  dev );
+
+static uint32_t overlayFind_( const struct DevOverlayData * const  data,
+                              const uint32_t                       block );
+static ADF_RETCODE overlayInsert_( struct DevOverlayData * const  data,
+                                   const uint32_t                 pos,
+                                   const uint32_t                 block,
+                                   const uint32_t                 record );
+
+static AdfFileOffset overlayRecordOffset_( const uint32_t  record,
+                                           const unsigned  blockSize );
+
+static ADF_RETCODE overlayRelease( struct AdfDevice * const  dev );
+
+
+/*
+ * overlayOpen
+ *
+ */
+static struct AdfDevice * overlayOpen( const char * const   name,
+                                       const AdfAccessMode  mode )
+{
+    struct AdfDevice * const  dev = ( struct AdfDevice * )
+        malloc( sizeof ( struct AdfDevice ) );
+    if ( dev == NULL ) {
+        adfEnv.eFct( "%s: malloc error", __func__ );
+        return NULL;
+    }
+
+    struct DevOverlayData * const data = malloc( sizeof ( struct DevOverlayData ) );
+    if ( data == NULL ) {
+        adfEnv.eFct( "%s: malloc data error", __func__ );
+        free( dev );
+        return NULL;
+    }
+    data->base      = NULL;
+    data->delta     = NULL;
+    data->index     = NULL;
+    data->nBlocks   = 0;
+    data->capacity  = 0;
+    data->deltaName = malloc( strlen( name ) + sizeof ADF_OVERLAY_DELTA_EXT );
+    if ( data->deltaName == NULL ) {
+        adfEnv.eFct( "%s: malloc data error", __func__ );
+        free( data );
+        free( dev );
+        return NULL;
+    }
+    strcpy( data->deltaName, name );
+    strcat( data->deltaName, ADF_OVERLAY_DELTA_EXT );
+
+    dev->drvData  = data;
+    dev->name     = strdup( name );
+    dev->readOnly = ( mode != ADF_ACCESS_MODE_READWRITE );
+    dev->drv      = &adfDeviceDriverOverlay;
+
+    data->base = overlayOpenBase_( name, ADF_ACCESS_MODE_READONLY );
+    if ( data->base == NULL || dev->name == NULL ) {
+        overlayRelease( dev );
+        return NULL;
+    }
+
+    dev->geometry   = data->base->geometry;
+    dev->sizeBlocks = data->base->sizeBlocks;
+    dev->type       = data->base->type;
+    dev->dev_class  = data->base->dev_class;
+    dev->nVol       = 0;
+    dev->volList    = NULL;
+    dev->mounted    = false;
+
+    // an existing delta is used, a new one created only if it can be written
+    data->delta = fopen( data->deltaName, dev->readOnly ? "rb" : "rb+" );
+    if ( data->delta != NULL ) {
+        if ( overlayDeltaLoad_( data, dev ) != ADF_RC_OK ) {
+            overlayRelease( dev );
+            return NULL;
+        }
+    } else if ( ! dev->readOnly && overlayDeltaCreate_( data, dev ) != ADF_RC_OK ) {
+        overlayRelease( dev );
+        return NULL;
+    }
+
+    return dev;
+}
+
+
+/*
+ * overlayRelease
+ *
+ * (an empty delta file is removed)
+ */
+static ADF_RETCODE overlayRelease( struct AdfDevice * const  dev )
+{
+    struct DevOverlayData * const data = dev->drvData;
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    if ( data->delta != NULL ) {
+        if ( fclose( data->delta ) != 0 )
+            rc = ADF_RC_ERROR;
+        if ( data->nBlocks == 0 && ! dev->readOnly )
+            remove( data->deltaName );
+    }
+    if ( data->base != NULL )
+        overlayCloseBase_( data->base );
+
+    free( data->index );
+    free( data->deltaName );
+    free( data );
+    free( dev->name );
+    free( dev );
+    return rc;
+}
+
+
+/*
+ * overlayReadSectors
+ *
+ * (runs of blocks not in the delta are read from the base at once)
+ */
+static ADF_RETCODE overlayReadSectors( const struct AdfDevice * const  dev,
+                                       const uint32_t                  block,
+                                       const uint32_t                  lenBlocks,
+                                       uint8_t * const                 buf )
+{
+    if ( block + lenBlocks > dev->sizeBlocks )
+        return ADF_RC_ERROR;
+
+    const struct DevOverlayData * const data = dev->drvData;
+    struct AdfDevice * const base = data->base;
+    if ( base == NULL )
+        return ADF_RC_ERROR;    // (lost after a failed commit)
+
+    const unsigned blockSize = dev->geometry.blockSize;
+    const uint32_t end = block + lenBlocks;
+
+    uint32_t pos   = overlayFind_( data, block ),
+             first = block;     // of the run to read from the base
+    for ( ; pos < data->nBlocks && data->index[ pos ].block < end ; pos++ ) {
+        const struct OverlayIndexEntry * const entry = &data->index[ pos ];
+        if ( entry->block > first &&
+             base->drv->readSectors( base, first, entry->block - first,
+                                     buf + ( first - block ) * blockSize ) != ADF_RC_OK )
+            return ADF_RC_ERROR;
+
+        if ( adfFSeek( data->delta, overlayRecordOffset_( entry->record, blockSize ) + 4,
+                       SEEK_SET ) != 0 ||
+             fread( buf + ( entry->block - block ) * blockSize,
+                    blockSize, 1, data->delta ) != 1 )
+        {
+            adfEnv.eFct( "%s: error reading block %u from the delta '%s'",
+                         __func__, entry->block, data->deltaName );
+            return ADF_RC_ERROR;
+        }
+        first = entry->block + 1;
+    }
+
+    if ( first < end )
+        return base->drv->readSectors( base, first, end - first,
+                                       buf + ( first - block ) * blockSize );
+    return ADF_RC_OK;
+}
+
+
+/*
+ * overlayWriteSectors
+ *
+ * (a block already in the delta is overwritten, a new one appended)
+ */
+static ADF_RETCODE overlayWriteSectors( const struct AdfDevice * const  dev,
+                                        const uint32_t                  block,
+                                        const uint32_t                  lenBlocks,
+                                        const uint8_t * const           buf )
+{
+    if ( block + lenBlocks > dev->sizeBlocks || dev->readOnly )
+        return ADF_RC_ERROR;
+
+    struct DevOverlayData * const data = dev->drvData;
+    const unsigned blockSize = dev->geometry.blockSize;
+
+    uint32_t pos = overlayFind_( data, block );
+    for ( uint32_t i = 0 ; i < lenBlocks ; i++ ) {
+        const uint32_t sect = block + i;
+        while ( pos < data->nBlocks && data->index[ pos ].block < sect )
+            pos++;
+
+        const bool inDelta = ( pos < data->nBlocks && data->index[ pos ].block == sect );
+        const uint32_t record = inDelta ? data->index[ pos ].record : data->nBlocks;
+
+        uint8_t tag[ 4 ];
+        swapUint32ToPtr( tag, sect );
+        if ( adfFSeek( data->delta, overlayRecordOffset_( record, blockSize ),
+                       SEEK_SET ) != 0 ||
+             fwrite( tag, sizeof tag, 1, data->delta ) != 1 ||
+             fwrite( buf + i * blockSize, blockSize, 1, data->delta ) != 1 )
+        {
+            adfEnv.eFct( "%s: error writing block %u to the delta '%s'",
+                         __func__, sect, data->deltaName );
+            return ADF_RC_ERROR;
+        }
+
+        if ( ! inDelta && overlayInsert_( data, pos, sect, record ) != ADF_RC_OK )
+            return ADF_RC_MALLOC;
+    }
+
+    return ADF_RC_OK;
+}
+
+
+/*
+ * overlaySync
+ *
+ */
+static ADF_RETCODE overlaySync( const struct AdfDevice * const  dev )
+{
+    const struct DevOverlayData * const data = dev->drvData;
+    if ( data->delta == NULL )
+        return ADF_RC_OK;
+    return ( fflush( data->delta ) == 0 ) ? ADF_RC_OK : ADF_RC_ERROR;
+}
+
+
+static bool overlayIsDevNative( void )
+{
+    return false;
+}
+
+
+const struct AdfDeviceDriver adfDeviceDriverOverlay = {
+    .name         = "overlay",
+    .data         = NULL,
+    .createDev    = NULL,
+    .openDev      = overlayOpen,
+    .closeDev     = overlayRelease,
+    .readSectors  = overlayReadSectors,
+    .writeSectors = overlayWriteSectors,
+    .isNative     = overlayIsDevNative,
+    .isDevice     = NULL,
+    .sync         = overlaySync
+};
+
+
+/*
+ * adfOverlayCommit
+ *
+ * The base is reopened for writing only for the time of the commit.
+ */
+ADF_RETCODE adfOverlayCommit( struct AdfDevice * const  dev )
+{
+    if ( dev->drv != &adfDeviceDriverOverlay ) {
+        adfEnv.eFct( "%s: '%s' is not an overlay device", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+    if ( dev->readOnly ) {
+        adfEnv.eFct( "%s: overlay '%s' is read-only", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+
+    struct DevOverlayData * const data = dev->drvData;
+    if ( data->base == NULL ) {
+        adfEnv.eFct( "%s: no base image '%s'", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+
+    ADF_RETCODE rc = adfDevFlush( dev );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    adfMutexLock( dev->ioLock );
+
+    const unsigned blockSize = dev->geometry.blockSize;
+
+    uint8_t * const runBuf = malloc( (size_t) blockSize * OVERLAY_COMMIT_RUN );
+    if ( runBuf == NULL ) {
+        adfEnv.eFct( "%s: malloc error", __func__ );
+        rc = ADF_RC_MALLOC;
+        goto unlock;
+    }
+
+    overlayCloseBase_( data->base );
+    data->base = overlayOpenBase_( dev->name, ADF_ACCESS_MODE_READWRITE );
+    if ( data->base == NULL || data->base->readOnly ) {
+        adfEnv.eFct( "%s: cannot open base image '%s' for writing",
+                     __func__, dev->name );
+        rc = ADF_RC_ERROR;
+        goto reopen_base;
+    }
+
+    // runs of consecutive blocks, in ascending order
+    for ( uint32_t pos = 0 ; pos < data->nBlocks && rc == ADF_RC_OK ; ) {
+        const uint32_t first = data->index[ pos ].block;
+        uint32_t n = 0;
+        for ( ; pos < data->nBlocks && n < OVERLAY_COMMIT_RUN &&
+                  data->index[ pos ].block == first + n ; pos++, n++ )
+        {
+            if ( adfFSeek( data->delta,
+                           overlayRecordOffset_( data->index[ pos ].record, blockSize ) + 4,
+                           SEEK_SET ) != 0 ||
+                 fread( runBuf + n * blockSize, blockSize, 1, data->delta ) != 1 )
+            {
+                adfEnv.eFct( "%s: error reading the delta '%s'", __func__, data->deltaName );
+                rc = ADF_RC_ERROR;
+                break;
+            }
+        }
+        if ( rc == ADF_RC_OK )
+            rc = data->base->drv->writeSectors( data->base, first, n, runBuf );
+    }
+
+    if ( rc == ADF_RC_OK && data->base->drv->sync != NULL )
+        rc = data->base->drv->sync( data->base );
+
+    // (the delta is kept if the base was not fully updated)
+    if ( rc == ADF_RC_OK )
+        rc = overlayDeltaCreate_( data, dev );
+
+reopen_base:
+    if ( data->base != NULL )
+        overlayCloseBase_( data->base );
+    data->base = overlayOpenBase_( dev->name, ADF_ACCESS_MODE_READONLY );
+    if ( data->base == NULL ) {
+        // (the device remains, but it cannot be used anymore)
+        adfEnv.eFct( "%s: cannot reopen base image '%s'", __func__, dev->name );
+        rc = ADF_RC_ERROR;
+    }
+    free( runBuf );
+
+unlock:
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+/*
+ * adfOverlayDiscard
+ *
+ */
+ADF_RETCODE adfOverlayDiscard( struct AdfDevice * const  dev )
+{
+    if ( dev->drv != &adfDeviceDriverOverlay ) {
+        adfEnv.eFct( "%s: '%s' is not an overlay device", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+    if ( dev->readOnly ) {
+        adfEnv.eFct( "%s: overlay '%s' is read-only", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+
+    // (the buffered writes are discarded too - going to the delta first)
+    ADF_RETCODE rc = adfDevFlush( dev );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    adfMutexLock( dev->ioLock );
+    rc = overlayDeltaCreate_( dev->drvData, dev );
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+/*
+ * adfOverlayChangedBlocks
+ *
+ */
+uint32_t adfOverlayChangedBlocks( const struct AdfDevice * const  dev )
+{
+    if ( dev->drv != &adfDeviceDriverOverlay )
+        return 0;
+    return ( (const struct DevOverlayData *) dev->drvData )->nBlocks;
+}
+
+
+/*
+ * overlayOpenBase_
+ *
+ * (at driver level - the base is accessed only with its driver functions)
+ */
+static struct AdfDevice * overlayOpenBase_( const char * const   name,
+                                            const AdfAccessMode  mode )
+{
+    const struct AdfDeviceDriver * const driver = adfGetDeviceDriverByDevName( name );
+    if ( driver == NULL || driver->openDev == NULL ) {
+        adfEnv.eFct( "%s: no driver to open base image '%s'", __func__, name );
+        return NULL;
+    }
+
+    struct AdfDevice * const base = driver->openDev( name, mode );
+    if ( base == NULL ) {
+        adfEnv.eFct( "%s: cannot open base image '%s'", __func__, name );
+        return NULL;
+    }
+    base->ioLock     = NULL;
+    base->wBuf       = NULL;
+    base->syncPolicy = ADF_SYNC_NONE;
+    base->rdb.block  = NULL;
+    return base;
+}
+
+
+static void overlayCloseBase_( struct AdfDevice * const  base )
+{
+    base->drv->closeDev( base );
+}
+
+
+/*
+ * overlayDeltaCreate_
+ *
+ * create a new, empty delta (or empty an existing one)
+ */
+static ADF_RETCODE overlayDeltaCreate_( struct DevOverlayData * const   data,
+                                        const struct AdfDevice * const  dev )
+{
+    if ( data->delta != NULL )
+        fclose( data->delta );
+    data->nBlocks = 0;
+
+    data->delta = fopen( data->deltaName, "wb+" );
+    if ( data->delta == NULL ) {
+        adfEnv.eFct( "%s: cannot create delta '%s'", __func__, data->deltaName );
+        return ADF_RC_ERROR;
+    }
+
+    uint8_t header[ OVERLAY_HEADER_SIZE ];
+    memcpy( header, OVERLAY_MAGIC, OVERLAY_MAGIC_LEN );
+    swapUint32ToPtr( header + OVERLAY_MAGIC_LEN,     dev->sizeBlocks );
+    swapUint32ToPtr( header + OVERLAY_MAGIC_LEN + 4, dev->geometry.blockSize );
+    if ( fwrite( header, sizeof header, 1, data->delta ) != 1 ) {
+        adfEnv.eFct( "%s: error writing delta '%s'", __func__, data->deltaName );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * overlayDeltaLoad_
+ *
+ * check the header of an existing delta and index its records
+ */
+static ADF_RETCODE overlayDeltaLoad_( struct DevOverlayData * const   data,
+                                      const struct AdfDevice * const  dev )
+{
+    const unsigned blockSize = dev->geometry.blockSize;
+
+    uint8_t header[ OVERLAY_HEADER_SIZE ];
+    if ( fread( header, sizeof header, 1, data->delta ) != 1 ||
+         memcmp( header, OVERLAY_MAGIC, OVERLAY_MAGIC_LEN ) != 0 )
+    {
+        adfEnv.eFct( "%s: '%s' is not a delta file", __func__, data->deltaName );
+        return ADF_RC_ERROR;
+    }
+    if ( swapUint32fromPtr( header + OVERLAY_MAGIC_LEN ) != dev->sizeBlocks ||
+         swapUint32fromPtr( header + OVERLAY_MAGIC_LEN + 4 ) != blockSize )
+    {
+        adfEnv.eFct( "%s: delta '%s' does not match the base image",
+                     __func__, data->deltaName );
+        return ADF_RC_ERROR;
+    }
+
+    // (an incomplete last record - from an interrupted write - is ignored
+    //  and will be overwritten)
+    AdfFileOffset size = -1;
+    if ( adfFSeek( data->delta, 0, SEEK_END ) == 0 )
+        size = adfFTell( data->delta );
+    if ( size < OVERLAY_HEADER_SIZE ) {
+        adfEnv.eFct( "%s: cannot get the size of delta '%s'", __func__, data->deltaName );
+        return ADF_RC_ERROR;
+    }
+    const uint64_t nRecords = (uint64_t) ( size - OVERLAY_HEADER_SIZE ) / ( 4 + blockSize );
+    if ( nRecords > dev->sizeBlocks ) {
+        adfEnv.eFct( "%s: delta '%s' too big", __func__, data->deltaName );
+        return ADF_RC_ERROR;
+    }
+
+    uint8_t tag[ 4 ];
+    for ( uint32_t record = 0 ; record < nRecords ; record++ ) {
+        if ( adfFSeek( data->delta, overlayRecordOffset_( record, blockSize ),
+                       SEEK_SET ) != 0 ||
+             fread( tag, sizeof tag, 1, data->delta ) != 1 )
+        {
+            adfEnv.eFct( "%s: error reading delta '%s'", __func__, data->deltaName );
+            return ADF_RC_ERROR;
+        }
+
+        const uint32_t block = swapUint32fromPtr( tag );
+        const uint32_t pos = overlayFind_( data, block );
+        if ( block >= dev->sizeBlocks ||
+             ( pos < data->nBlocks && data->index[ pos ].block == block ) )
+        {
+            adfEnv.eFct( "%s: invalid record %u (block %u) in delta '%s'",
+                         __func__, record, block, data->deltaName );
+            return ADF_RC_ERROR;
+        }
+        if ( overlayInsert_( data, pos, block, record ) != ADF_RC_OK )
+            return ADF_RC_MALLOC;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * overlayFind_
+ *
+ * returns the index position of the first entry with block >= the given one
+ */
+static uint32_t overlayFind_( const struct DevOverlayData * const  data,
+                              const uint32_t                       block )
+{
+    uint32_t lo = 0,
+             hi = data->nBlocks;
+    while ( lo < hi ) {
+        const uint32_t mid = lo + ( hi - lo ) / 2;
+        if ( data->index[ mid ].block < block )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+/*
+ * overlayInsert_
+ *
+ */
+static ADF_RETCODE overlayInsert_( struct DevOverlayData * const  data,
+                                   const uint32_t                 pos,
+                                   const uint32_t                 block,
+                                   const uint32_t                 record )
+{
+    if ( data->nBlocks == data->capacity ) {
+        const uint32_t capacity = ( data->capacity > 0 ) ? data->capacity * 2 : 256;
+        struct OverlayIndexEntry * const index =
+            realloc( data->index, sizeof ( struct OverlayIndexEntry ) * capacity );
+        if ( index == NULL ) {
+            adfEnv.eFct( "%s: malloc error", __func__ );
+            return ADF_RC_MALLOC;
+        }
+        data->index    = index;
+        data->capacity = capacity;
+    }
+
+    memmove( &data->index[ pos + 1 ], &data->index[ pos ],
+             sizeof ( struct OverlayIndexEntry ) * ( data->nBlocks - pos ) );
+    data->index[ pos ].block  = block;
+    data->index[ pos ].record = record;
+    data->nBlocks++;
+    return ADF_RC_OK;
+}
+
+
+static AdfFileOffset overlayRecordOffset_( const uint32_t  record,
+                                           const unsigned  blockSize )
+{
+    return OVERLAY_HEADER_SIZE + (AdfFileOffset) record * ( 4 + blockSize );
+}
@@ -0,0 +1,55 @@
+/*
+ *  adf_dev_driver_overlay.h - copy-on-write overlay device driver
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_DEV_DRIVER_OVERLAY_H
+#define ADF_DEV_DRIVER_OVERLAY_H
+
+#include "adf_dev_driver.h"
+#include "adf_err.h"
+#include "adf_prefix.h"
+
+/*
+ * The overlay device opens a base image read-only (with the driver matching
+ * its name, like adfDevOpen) and keeps the written blocks in a delta file
+ * (the image name + ADF_OVERLAY_DELTA_EXT):
+ *
+ *   adfDevOpenWithDriver( "overlay", baseImage, mode )
+ *
+ * The base image is not changed until adfOverlayCommit() merges the delta
+ * into it; adfOverlayDiscard() drops the changes. The delta file is kept
+ * when the device is closed (and used when opened again), unless empty.
+ */
+extern const struct AdfDeviceDriver adfDeviceDriverOverlay;
+
+#define ADF_OVERLAY_DELTA_EXT  ".delta"
+
+/* write the changed blocks to the base image, empty the delta */
+ADF_PREFIX ADF_RETCODE adfOverlayCommit( struct AdfDevice * const  dev );
+
+/* drop all changes (empty the delta) */
+ADF_PREFIX ADF_RETCODE adfOverlayDiscard( struct AdfDevice * const  dev );
+
+/* the number of blocks in the delta */
+ADF_PREFIX uint32_t adfOverlayChangedBlocks( const struct AdfDevice * const  dev );
+
+#endif  /* ADF_DEV_DRIVER_OVERLAY_H */
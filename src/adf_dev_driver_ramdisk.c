@@ -22,13 +22,36 @@
  *
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "adf_dev_driver_ramdisk.h"
+#include "adf_dev.h"
 #include "adf_dev_type.h"
 #include "adf_env.h"
 #include "adf_limits.h"
+#include "adf_thread.h"
+#include "adf_util.h"
+
+
+/* granularity of the tracking of changed data (blocks) */
+#define RAMDISK_DIRTY_CHUNK  64
+
+struct DevRamdiskData {
+    uint8_t *   data;
+    bool        loaded;      /* from an image file (dev->name) */
+    uint32_t *  dirty;       /* bitmap of changed chunks */
+    uint32_t    nChunks;
+};
+
+static struct DevRamdiskData * ramdiskDataCreate( const uint32_t  sizeBlocks,
+                                                  const unsigned  blockSize );
+
+static ADF_RETCODE ramdiskWriteBack( const struct AdfDevice * const  dev );
+
+static bool ramdiskIsDirty( const struct DevRamdiskData * const  data );
+
 
 static struct AdfDevice * ramdiskCreate( const char * const  name,
                                          const uint32_t      cylinders,
@@ -49,9 +72,8 @@ static struct AdfDevice * ramdiskCreate( const char * const  name,
     dev->geometry.blockSize = ADF_DEV_BLOCK_SIZE;
     dev->sizeBlocks         = cylinders * heads * sectors;
 
-    dev->drvData = malloc( (size_t) dev->sizeBlocks * dev->sizeBlocks );
+    dev->drvData = ramdiskDataCreate( dev->sizeBlocks, dev->geometry.blockSize );
     if ( dev->drvData == NULL ) {
-        adfEnv.eFct( "%s: malloc data error", __func__ );
         free( dev );
         return NULL;
     }
@@ -72,12 +94,106 @@ static struct AdfDevice * ramdiskCreate( const char * const  name,
 }
 
 
+/*
+ * ramdiskOpen
+ *
+ * load an image file into memory (with one read)
+ */
+static struct AdfDevice * ramdiskOpen( const char * const   name,
+                                       const AdfAccessMode  mode )
+{
+    FILE * const fd = fopen( name, "rb" );
+    if ( fd == NULL ) {
+        adfEnv.eFct( "%s: fopen '%s'", __func__, name );
+        return NULL;
+    }
+
+    AdfFileOffset size = -1;
+    if ( adfFSeek( fd, 0, SEEK_END ) == 0 ) {
+        size = adfFTell( fd );
+        if ( adfFSeek( fd, 0, SEEK_SET ) != 0 )
+            size = -1;
+    }
+    if ( size < 0 ) {
+        adfEnv.eFct( "%s: cannot get the size of '%s'", __func__, name );
+        fclose( fd );
+        return NULL;
+    }
+
+    struct AdfDevice * const  dev = ( struct AdfDevice * )
+        malloc( sizeof ( struct AdfDevice ) );
+    if ( dev == NULL ) {
+        adfEnv.eFct( "%s: malloc error", __func__ );
+        fclose( fd );
+        return NULL;
+    }
+
+    dev->readOnly           = ( mode != ADF_ACCESS_MODE_READWRITE );
+    dev->geometry.blockSize = ADF_DEV_BLOCK_SIZE;
+
+    uint64_t sizeBlocks = (uint64_t) size / dev->geometry.blockSize;
+    if ( sizeBlocks > ADF_DEV_SIZE_MAX_BLOCKS ) {
+        adfEnv.wFct( "%s: '%s' is bigger (%llu blocks) than supported, "
+                     "only the first %llu blocks are loaded",
+                     __func__, name, (unsigned long long) sizeBlocks,
+                     (unsigned long long) ADF_DEV_SIZE_MAX_BLOCKS );
+        sizeBlocks = ADF_DEV_SIZE_MAX_BLOCKS;
+    }
+    dev->sizeBlocks = (uint32_t) sizeBlocks;
+
+    struct DevRamdiskData * const data =
+        ramdiskDataCreate( dev->sizeBlocks, dev->geometry.blockSize );
+    if ( data == NULL ) {
+        free( dev );
+        fclose( fd );
+        return NULL;
+    }
+    dev->drvData = data;
+
+    const size_t sizeBytes = (size_t) dev->sizeBlocks * dev->geometry.blockSize;
+    if ( fread( data->data, 1, sizeBytes, fd ) != sizeBytes ) {
+        adfEnv.eFct( "%s: error reading '%s'", __func__, name );
+        free( data->dirty );
+        free( data->data );
+        free( data );
+        free( dev );
+        fclose( fd );
+        return NULL;
+    }
+    fclose( fd );
+    data->loaded = true;
+
+    dev->dev_class = adfDevGetClassBySizeBlocks( dev->sizeBlocks );
+    dev->type      = ADF_DEVTYPE_UNKNOWN; // geometry unknown
+    dev->nVol      = 0;
+    dev->volList   = NULL;
+    dev->mounted   = false;
+    dev->name      = strdup( name );
+    dev->drv       = &adfDeviceDriverRamdisk;
+
+    return dev;
+}
+
+
+/*
+ * ramdiskRelease
+ *
+ * (the changes of a loaded image are saved back to it)
+ */
 static ADF_RETCODE ramdiskRelease( struct AdfDevice * const  dev )
 {
-    free( dev->drvData );
+    struct DevRamdiskData * const data = dev->drvData;
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    if ( data->loaded && ! dev->readOnly && ramdiskIsDirty( data ) )
+        rc = ramdiskWriteBack( dev );
+
+    free( data->dirty );
+    free( data->data );
+    free( data );
     free( dev->name );
     free( dev );
-    return ADF_RC_OK;
+    return rc;
 }
 
 
@@ -89,8 +205,9 @@ static ADF_RETCODE ramdiskReadSectors( const struct AdfDevice * const  dev,
     if ( block + lenBlocks > dev->sizeBlocks )
         return ADF_RC_ERROR;
 
-    memcpy( buf, &( (uint8_t *) dev->drvData )[ block * dev->geometry.blockSize ],
-            dev->geometry.blockSize * lenBlocks  );
+    const struct DevRamdiskData * const data = dev->drvData;
+    memcpy( buf, &data->data[ (size_t) block * dev->geometry.blockSize ],
+            (size_t) dev->geometry.blockSize * lenBlocks );
     return ADF_RC_OK;
 }
 
@@ -102,9 +219,16 @@ static ADF_RETCODE ramdiskWriteSectors( const struct AdfDevice * const  dev,
 {
     if ( block + lenBlocks > dev->sizeBlocks )
         return ADF_RC_ERROR;
+    if ( lenBlocks == 0 )
+        return ADF_RC_OK;
+
+    struct DevRamdiskData * const data = dev->drvData;
+    memcpy( &data->data[ (size_t) block * dev->geometry.blockSize ], buf,
+            (size_t) dev->geometry.blockSize * lenBlocks );
 
-    memcpy( &( (uint8_t *) dev->drvData )[ block * dev->geometry.blockSize ], buf,
-            dev->geometry.blockSize * lenBlocks );
+    const uint32_t lastChunk = ( block + lenBlocks - 1 ) / RAMDISK_DIRTY_CHUNK;
+    for ( uint32_t chunk = block / RAMDISK_DIRTY_CHUNK ; chunk <= lastChunk ; chunk++ )
+        data->dirty[ chunk / 32 ] |= 1u << ( chunk % 32 );
     return ADF_RC_OK;
 }
 
@@ -119,10 +243,143 @@ const struct AdfDeviceDriver adfDeviceDriverRamdisk = {
     .name         = "ramdisk",
     .data         = NULL,
     .createDev    = ramdiskCreate,
-    .openDev      = NULL,
+    .openDev      = ramdiskOpen,
     .closeDev     = ramdiskRelease,
     .readSectors  = ramdiskReadSectors,
     .writeSectors = ramdiskWriteSectors,
     .isNative     = ramdiskIsDevNative,
     .isDevice     = NULL
 };
+
+
+/*
+ * adfRamdiskSave
+ *
+ */
+ADF_RETCODE adfRamdiskSave( struct AdfDevice * const  dev,
+                            const char * const        path )
+{
+    if ( dev == NULL || dev->drv != &adfDeviceDriverRamdisk ) {
+        adfEnv.eFct( "%s: not a ramdisk device", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    struct DevRamdiskData * const data = dev->drvData;
+    ADF_RETCODE rc = adfDevFlush( dev );    // (buffered writes)
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    adfMutexLock( dev->ioLock );
+    if ( path == NULL ) {
+        if ( ! data->loaded ) {
+            adfEnv.eFct( "%s: ramdisk '%s' was not loaded from an image",
+                         __func__, dev->name );
+            rc = ADF_RC_ERROR;
+        } else if ( ramdiskIsDirty( data ) ) {
+            rc = ramdiskWriteBack( dev );
+        }
+    } else {
+        // the whole image (with one write)
+        const size_t sizeBytes = (size_t) dev->sizeBlocks * dev->geometry.blockSize;
+        FILE * const fd = fopen( path, "wb" );
+        if ( fd == NULL ) {
+            adfEnv.eFct( "%s: fopen '%s'", __func__, path );
+            rc = ADF_RC_ERROR;
+        } else {
+            if ( fwrite( data->data, 1, sizeBytes, fd ) != sizeBytes ) {
+                adfEnv.eFct( "%s: error writing '%s'", __func__, path );
+                rc = ADF_RC_ERROR;
+            }
+            if ( fclose( fd ) != 0 )
+                rc = ADF_RC_ERROR;
+        }
+    }
+    adfMutexUnlock( dev->ioLock );
+    return rc;
+}
+
+
+/*
+ * ramdiskDataCreate
+ *
+ * allocate the (zeroed) data and the tracking of changes
+ */
+static struct DevRamdiskData * ramdiskDataCreate( const uint32_t  sizeBlocks,
+                                                  const unsigned  blockSize )
+{
+    struct DevRamdiskData * const data = malloc( sizeof(struct DevRamdiskData) );
+    if ( data == NULL ) {
+        adfEnv.eFct( "%s: malloc data error", __func__ );
+        return NULL;
+    }
+
+    data->loaded  = false;
+    data->nChunks = ( sizeBlocks + RAMDISK_DIRTY_CHUNK - 1 ) / RAMDISK_DIRTY_CHUNK;
+    data->data    = calloc( sizeBlocks > 0 ? sizeBlocks : 1, blockSize );
+    data->dirty   = calloc( data->nChunks / 32 + 1, sizeof(uint32_t) );
+    if ( data->data == NULL || data->dirty == NULL ) {
+        adfEnv.eFct( "%s: malloc data error (%u blocks)", __func__, sizeBlocks );
+        free( data->dirty );
+        free( data->data );
+        free( data );
+        return NULL;
+    }
+    return data;
+}
+
+
+static bool ramdiskIsDirty( const struct DevRamdiskData * const  data )
+{
+    for ( uint32_t i = 0 ; i <= data->nChunks / 32 ; i++ )
+        if ( data->dirty[ i ] != 0 )
+            return true;
+    return false;
+}
+
+
+/*
+ * ramdiskWriteBack
+ *
+ * write the changed ranges (runs of consecutive changed chunks) back
+ * to the image file the ramdisk was loaded from
+ */
+static ADF_RETCODE ramdiskWriteBack( const struct AdfDevice * const  dev )
+{
+    struct DevRamdiskData * const data = dev->drvData;
+
+    FILE * const fd = fopen( dev->name, "rb+" );
+    if ( fd == NULL ) {
+        adfEnv.eFct( "%s: fopen '%s'", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+
+    const size_t chunkBytes = (size_t) RAMDISK_DIRTY_CHUNK * dev->geometry.blockSize,
+                 sizeBytes  = (size_t) dev->sizeBlocks * dev->geometry.blockSize;
+    ADF_RETCODE rc = ADF_RC_OK;
+    for ( uint32_t chunk = 0, nRun ; chunk < data->nChunks ; chunk += nRun ) {
+        nRun = 1;
+        if ( ( data->dirty[ chunk / 32 ] & ( 1u << ( chunk % 32 ) ) ) == 0 )
+            continue;
+        while ( chunk + nRun < data->nChunks &&
+                ( data->dirty[ ( chunk + nRun ) / 32 ] & ( 1u << ( ( chunk + nRun ) % 32 ) ) ) )
+            nRun++;
+
+        const size_t offset = chunk * chunkBytes,
+                     len    = ( offset + nRun * chunkBytes > sizeBytes ) ?
+                                  sizeBytes - offset : nRun * chunkBytes;
+        if ( adfFSeek( fd, (AdfFileOffset) offset, SEEK_SET ) != 0 ||
+             fwrite( &data->data[ offset ], 1, len, fd ) != len )
+        {
+            adfEnv.eFct( "%s: error writing '%s' at offset %zu",
+                         __func__, dev->name, offset );
+            rc = ADF_RC_ERROR;
+            break;
+        }
+    }
+
+    if ( fclose( fd ) != 0 )
+        rc = ADF_RC_ERROR;
+    if ( rc == ADF_RC_OK )
+        memset( data->dirty, 0, ( data->nChunks / 32 + 1 ) * sizeof(uint32_t) );
+    return rc;
+}
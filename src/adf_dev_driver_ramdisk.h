@@ -25,7 +25,23 @@
 #define ADF_DEV_DRIVER_RAMDISK_H
 
 #include "adf_dev_driver.h"
+#include "adf_err.h"
+#include "adf_prefix.h"
 
+/*
+ * The ramdisk device keeps all data in memory.
+ *
+ * It is either created empty (adfDevCreate) or loaded from an image file
+ * with one read (adfDevOpenWithDriver( "ramdisk", imageFile, mode )).
+ * Changes of a loaded image (tracked in ranges of blocks) are written back
+ * to it when the device is closed (unless opened read-only), or earlier
+ * with adfRamdiskSave().
+ */
 extern const struct AdfDeviceDriver adfDeviceDriverRamdisk;
 
+/* path == NULL: write the changed ranges back to the loaded image,
+   otherwise: write the whole device to a (new) image file path */
+ADF_PREFIX ADF_RETCODE adfRamdiskSave( struct AdfDevice * const  dev,
+                                       const char * const        path );
+
 #endif  /* ADF_DEV_DRIVER_RAMDISK_H */
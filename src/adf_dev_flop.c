@@ -59,6 +59,7 @@ ADF_RETCODE adfMountFlop( struct AdfDevice * const  dev )
     vol->dev        = dev;
     vol->volName    = NULL;
     vol->mounted    = false;
+    vol->stats      = NULL;
 
     /* set filesystem info (read from bootblock) */
     struct AdfBootBlock boot;
@@ -30,12 +30,16 @@
 #include "adf_util.h"
 #include "adf_vol.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
 
 static void adfFreeTmpVolList( struct AdfList * const  root );
 
+static ADF_RETCODE adfMountHdReadBootBlocks_( struct AdfDevice * const      dev,
+                                              const struct AdfList * const  vList );
+
 
 /*
  * adfCreateHd
@@ -230,21 +234,6 @@ ADF_RETCODE adfMountHd( struct AdfDevice * const  dev )
         vol->lastBlock  = ( part.highCyl + 1 ) * (int32_t) rdsk.cylBlocks - 1;
         vol->blockSize  = part.blockSize * 4;
 
-        /* set filesystem info (read from bootblock) */
-        struct AdfBootBlock boot;
-        rc = adfDevReadBlock( dev, (uint32_t) vol->firstBlock, 512, (uint8_t *) &boot );
-        if ( rc != ADF_RC_OK ) {
-            adfEnv.eFct( "%s: error reading BootBlock, device %s, volume %d",
-                         __func__, dev->name, dev->nVol - 1 );
-            adfFreeTmpVolList( listRoot );
-            free( vol );
-            return rc;
-        }
-        memcpy( vol->fs.id, boot.dosType, 3 );
-        vol->fs.id[ 3 ]    = '\0';
-        vol->fs.type       = (uint8_t) boot.dosType[ 3 ];
-        vol->datablockSize = adfVolIsOFS( vol ) ? 488 : 512;
-
         /* set volume name (from partition info) */
         const unsigned len = (unsigned) min( 31, part.nameLen );
         vol->volName = (char *) malloc( len + 1 );
@@ -258,6 +247,7 @@ ADF_RETCODE adfMountHd( struct AdfDevice * const  dev )
         vol->volName[ len ] = '\0';
 
         vol->mounted = false;
+        vol->stats   = NULL;
 
         /* stores temporaly the volumes in a linked list */
         if ( listRoot == NULL )
@@ -271,11 +261,16 @@ ADF_RETCODE adfMountHd( struct AdfDevice * const  dev )
             return ADF_RC_MALLOC;
         }
 
-        vol->rootBlock = ( adfVolIsDosFS( vol ) ? adfVolCalcRootBlk( vol ) : -1 );
-
         next = part.next;
     }
 
+    /* set filesystem info (read from bootblocks, all at once) */
+    rc = adfMountHdReadBootBlocks_( dev, listRoot );
+    if ( rc != ADF_RC_OK ) {
+        adfFreeTmpVolList( listRoot );
+        return rc;
+    }
+
     /* stores the list in an array */
     dev->volList = (struct AdfVolume **) malloc(
         sizeof(struct AdfVolume *) * (unsigned) dev->nVol );
@@ -732,6 +727,65 @@ ADF_RETCODE adfWriteBADBblock( const struct AdfDevice * const  dev,
 
 /*##########################################################################*/
 
+/*
+ * adfMountHdReadBootBlocks_
+ *
+ * read bootblocks of all partitions (in a sorted, coalesced read)
+ * and set filesystem info of the volumes
+ */
+static ADF_RETCODE adfMountHdReadBootBlocks_( struct AdfDevice * const      dev,
+                                              const struct AdfList * const  vList )
+{
+    const unsigned nVol = (unsigned) dev->nVol;
+    if ( nVol < 1 )
+        return ADF_RC_OK;
+
+    const uint32_t blockSize = dev->geometry.blockSize;
+    uint32_t * const  sectors = (uint32_t *) malloc( sizeof(uint32_t) * nVol );
+    uint8_t ** const  bufs    = (uint8_t **) malloc( sizeof(uint8_t *) * nVol );
+    uint8_t * const   data    = (uint8_t *) malloc( (size_t) blockSize * nVol );
+    if ( sectors == NULL || bufs == NULL || data == NULL ) {
+        free( data );
+        free( bufs );
+        free( sectors );
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+
+    unsigned i = 0;
+    for ( const struct AdfList * cell = vList ; cell != NULL ; cell = cell->next ) {
+        const struct AdfVolume * const vol = (struct AdfVolume *) cell->content;
+        sectors[ i ] = (uint32_t) vol->firstBlock;
+        bufs[ i ]    = data + (size_t) i * blockSize;
+        i++;
+    }
+    assert( i == nVol );
+
+    ADF_RETCODE rc = adfDevReadBlocks( dev, nVol, sectors, bufs );
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error reading BootBlocks, device %s",
+                     __func__, dev->name );
+    } else {
+        i = 0;
+        for ( const struct AdfList * cell = vList ; cell != NULL ; cell = cell->next ) {
+            struct AdfVolume * const vol = (struct AdfVolume *) cell->content;
+            const struct AdfBootBlock * const boot =
+                (const struct AdfBootBlock *) bufs[ i++ ];
+            memcpy( vol->fs.id, boot->dosType, 3 );
+            vol->fs.id[ 3 ]    = '\0';
+            vol->fs.type       = (uint8_t) boot->dosType[ 3 ];
+            vol->datablockSize = adfVolIsOFS( vol ) ? 488 : 512;
+            vol->rootBlock = ( adfVolIsDosFS( vol ) ? adfVolCalcRootBlk( vol ) : -1 );
+        }
+    }
+
+    free( data );
+    free( bufs );
+    free( sectors );
+    return rc;
+}
+
+
 /*
  * adfFreeTmpVolList
  *
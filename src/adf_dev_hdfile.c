@@ -94,6 +94,7 @@ ADF_RETCODE adfMountHdFile( struct AdfDevice * const  dev )
     vol->dev        = dev;
     vol->volName    = NULL;
     vol->mounted    = false;
+    vol->stats      = NULL;
     vol->blockSize  = 512;
 
     vol->firstBlock = 0;
@@ -126,7 +127,7 @@ ADF_RETCODE adfMountHdFile( struct AdfDevice * const  dev )
         uint8_t buf[ 512 ];
         bool found = false;
         do {
-            rc = dev->drv->readSectors( dev, (uint32_t) vol->rootBlock, 1, buf );
+            rc = adfDevReadBlock( dev, (uint32_t) vol->rootBlock, 512, buf );
             if ( rc != ADF_RC_OK ) {
                 free( dev->volList );
                 dev->volList = NULL;
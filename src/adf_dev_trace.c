@@ -0,0 +1,204 @@
+/*
+ *  adf_dev_trace.c - device access trace
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "adf_dev_trace.h"
+
+#include "adf_env.h"
+#include "adf_thread.h"
+#include "adf_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ADF_TRACE_MAGIC  "ADFTRACE"
+
+struct AdfDevTrace {
+    FILE *    file;
+    uint64_t  startNs;
+    bool      error;      /* writing failed (no more records written) */
+};
+
+
+/*
+ * adfDevTraceStart
+ *
+ */
+ADF_RETCODE adfDevTraceStart( struct AdfDevice * const  dev,
+                              const char * const        path )
+{
+    if ( dev->trace != NULL ) {
+        adfEnv.eFct( "%s: device '%s' is already traced", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+
+    struct AdfDevTrace * const trace = malloc( sizeof(struct AdfDevTrace) );
+    if ( trace == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+    trace->file = fopen( path, "wb" );
+    if ( trace->file == NULL ) {
+        adfEnv.eFct( "%s: cannot create trace file '%s'", __func__, path );
+        free( trace );
+        return ADF_RC_ERROR;
+    }
+
+    uint8_t header[ ADF_TRACE_HEADER_SIZE ];
+    memcpy( header, ADF_TRACE_MAGIC, 8 );
+    swapUint32ToPtr( header + 8,  ADF_TRACE_VERSION );
+    swapUint32ToPtr( header + 12, dev->geometry.blockSize );
+    swapUint32ToPtr( header + 16, dev->geometry.cylinders );
+    swapUint32ToPtr( header + 20, dev->geometry.heads );
+    swapUint32ToPtr( header + 24, dev->geometry.sectors );
+    if ( fwrite( header, 1, sizeof header, trace->file ) != sizeof header ) {
+        adfEnv.eFct( "%s: error writing trace file '%s'", __func__, path );
+        fclose( trace->file );
+        free( trace );
+        return ADF_RC_ERROR;
+    }
+    trace->error   = false;
+    trace->startNs = adfStatsClockNs();
+
+    adfMutexLock( dev->ioLock );
+    dev->trace = trace;
+    adfMutexUnlock( dev->ioLock );
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfDevTraceStop
+ *
+ */
+ADF_RETCODE adfDevTraceStop( struct AdfDevice * const  dev )
+{
+    adfMutexLock( dev->ioLock );
+    struct AdfDevTrace * const trace = dev->trace;
+    dev->trace = NULL;
+    adfMutexUnlock( dev->ioLock );
+
+    if ( trace == NULL )
+        return ADF_RC_ERROR;
+
+    ADF_RETCODE rc = trace->error ? ADF_RC_ERROR : ADF_RC_OK;
+    if ( fclose( trace->file ) != 0 ) {
+        adfEnv.eFct( "%s: error closing the trace file", __func__ );
+        rc = ADF_RC_ERROR;
+    }
+    free( trace );
+    return rc;
+}
+
+
+/*
+ * adfTraceReadHeader
+ *
+ */
+ADF_RETCODE adfTraceReadHeader( FILE * const                   file,
+                                struct AdfTraceHeader * const  header )
+{
+    uint8_t buf[ ADF_TRACE_HEADER_SIZE ];
+    if ( fread( buf, 1, sizeof buf, file ) != sizeof buf ||
+         memcmp( buf, ADF_TRACE_MAGIC, 8 ) != 0 )
+    {
+        adfEnv.eFct( "%s: not a trace file", __func__ );
+        return ADF_RC_ERROR;
+    }
+    header->version   = swapUint32fromPtr( buf + 8 );
+    header->blockSize = swapUint32fromPtr( buf + 12 );
+    header->cylinders = swapUint32fromPtr( buf + 16 );
+    header->heads     = swapUint32fromPtr( buf + 20 );
+    header->sectors   = swapUint32fromPtr( buf + 24 );
+    if ( header->version != ADF_TRACE_VERSION ) {
+        adfEnv.eFct( "%s: unsupported trace version %u",
+                     __func__, header->version );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfTraceReadRecord
+ *
+ */
+bool adfTraceReadRecord( FILE * const                   file,
+                         struct AdfTraceRecord * const  record )
+{
+    uint8_t buf[ ADF_TRACE_RECORD_SIZE ];
+    if ( fread( buf, 1, sizeof buf, file ) != sizeof buf )
+        return false;
+
+    record->timeNs     = (uint64_t) swapUint32fromPtr( buf ) << 32 |
+                         swapUint32fromPtr( buf + 4 );
+    record->sector     = swapUint32fromPtr( buf + 8 );
+    record->nBlocks    = swapUint32fromPtr( buf + 12 );
+    record->durationNs = swapUint32fromPtr( buf + 16 );
+    record->op         = (AdfTraceOp) buf[ 20 ];
+    record->blockType  = (AdfStatsBlockType) buf[ 21 ];
+    record->source     = (AdfTraceSource) buf[ 22 ];
+    record->flags      = buf[ 23 ];
+    return true;
+}
+
+
+/*
+ * adfDevTraceAdd
+ *
+ */
+void adfDevTraceAdd( const struct AdfDevice * const  dev,
+                     const AdfTraceOp                op,
+                     const uint32_t                  sector,
+                     const uint32_t                  nBlocks,
+                     const AdfStatsBlockType         blockType,
+                     const AdfTraceSource            source,
+                     const uint64_t                  startNs,
+                     const uint64_t                  endNs,
+                     const ADF_RETCODE               rc )
+{
+    struct AdfDevTrace * const trace = dev->trace;
+    if ( trace == NULL || trace->error )
+        return;
+
+    const uint64_t time     = ( startNs > trace->startNs ) ? startNs - trace->startNs : 0,
+                   duration = ( endNs > startNs ) ? endNs - startNs : 0;
+    const uint32_t duration32 = ( duration < UINT32_MAX ) ? (uint32_t) duration :
+                                                            UINT32_MAX;
+
+    uint8_t buf[ ADF_TRACE_RECORD_SIZE ];
+    swapUint32ToPtr( buf,      (uint32_t) ( time >> 32 ) );
+    swapUint32ToPtr( buf + 4,  (uint32_t) time );
+    swapUint32ToPtr( buf + 8,  sector );
+    swapUint32ToPtr( buf + 12, nBlocks );
+    swapUint32ToPtr( buf + 16, duration32 );
+    buf[ 20 ] = (uint8_t) op;
+    buf[ 21 ] = (uint8_t) blockType;
+    buf[ 22 ] = (uint8_t) source;
+    buf[ 23 ] = ( rc != ADF_RC_OK ) ? ADF_TRACE_FLAG_ERROR : 0;
+
+    if ( fwrite( buf, 1, sizeof buf, trace->file ) != sizeof buf ) {
+        adfEnv.eFct( "%s: error writing the trace of device '%s' (stopped)",
+                     __func__, dev->name );
+        trace->error = true;
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ *  adf_dev_trace.h - device access trace
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_DEV_TRACE_H
+#define ADF_DEV_TRACE_H
+
+#include "adf_dev.h"
+#include "adf_err.h"
+#include "adf_prefix.h"
+#include "adf_stats.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Device access trace
+ *
+ * When tracing, each block read/write requested from the device
+ * (with adfDevReadBlock/adfDevWriteBlock, also by volumes, and with
+ * adfDevAsync* functions) is recorded in a trace file - without the data,
+ * so a trace of any image can be shared and replayed (eg. with
+ * tests/bench/bench_trace_replay) on another device.
+ *
+ * The file (all numbers big-endian) has a header of ADF_TRACE_HEADER_SIZE
+ * bytes:
+ *   "ADFTRACE", version, block size, cylinders, heads, sectors (uint32)
+ * followed by records of ADF_TRACE_RECORD_SIZE bytes:
+ *   time (uint64, ns since the start of the trace), sector, number
+ *   of blocks, duration (uint32, ns), operation, block type, source,
+ *   flags (uint8)
+ *
+ * Asynchronous requests are recorded when submitted, without a duration.
+ */
+
+#define ADF_TRACE_VERSION       1
+#define ADF_TRACE_HEADER_SIZE  28
+#define ADF_TRACE_RECORD_SIZE  24
+
+typedef enum {
+    ADF_TRACE_OP_READ,
+    ADF_TRACE_OP_WRITE
+} AdfTraceOp;
+
+/* the layer which requested the access */
+typedef enum {
+    ADF_TRACE_SRC_DEVICE,     /* device code (RDB, partitions, mounting)
+                                 or the user, with adfDevRead/WriteBlock */
+    ADF_TRACE_SRC_VOLUME,     /* volume / filesystem code (see the block type) */
+    ADF_TRACE_SRC_ASYNC       /* adfDevAsync* */
+} AdfTraceSource;
+
+#define ADF_TRACE_FLAG_ERROR  0x01
+
+struct AdfTraceHeader {
+    uint32_t  version,
+              blockSize,
+              cylinders,
+              heads,
+              sectors;
+};
+
+struct AdfTraceRecord {
+    uint64_t           timeNs;
+    uint32_t           sector,
+                       nBlocks,
+                       durationNs;
+    AdfTraceOp         op;
+    AdfStatsBlockType  blockType;
+    AdfTraceSource     source;
+    uint8_t            flags;
+};
+
+/* start recording the accesses of the device to a (new) trace file */
+ADF_PREFIX ADF_RETCODE adfDevTraceStart( struct AdfDevice * const  dev,
+                                         const char * const        path );
+
+/* stop recording; returns an error if writing the trace failed
+   (stopped also when the device is closed) */
+ADF_PREFIX ADF_RETCODE adfDevTraceStop( struct AdfDevice * const  dev );
+
+/* reading a trace file (opened in binary mode) */
+ADF_PREFIX ADF_RETCODE adfTraceReadHeader( FILE * const                   file,
+                                           struct AdfTraceHeader * const  header );
+
+/* returns false at the end of the file (or if it cannot be read) */
+ADF_PREFIX bool adfTraceReadRecord( FILE * const                   file,
+                                    struct AdfTraceRecord * const  record );
+
+/* (internal) record an access (dev->ioLock must be locked) */
+void adfDevTraceAdd( const struct AdfDevice * const  dev,
+                     const AdfTraceOp                op,
+                     const uint32_t                  sector,
+                     const uint32_t                  nBlocks,
+                     const AdfStatsBlockType         blockType,
+                     const AdfTraceSource            source,
+                     const uint64_t                  startNs,
+                     const uint64_t                  endNs,
+                     const ADF_RETCODE               rc );
+
+#endif  /* ADF_DEV_TRACE_H */
@@ -29,6 +29,7 @@
 #include "adf_cache.h"
 #include "adf_env.h"
 #include "adf_file_block.h"
+#include "adf_link.h"
 #include "adf_raw.h"
 #include "adf_util.h"
 
@@ -47,6 +48,18 @@ static void adfStrToUpper( uint8_t * const        nstr,
 static unsigned adfGetHashValue( const uint8_t * const  name,
                                  const bool             intl );
 
+struct AdfDirLink_ {
+    ADF_SECTNUM  link,
+                 real;
+};
+
+static unsigned adfDirCollectLinks_( const struct AdfVolume * const  vol,
+                                     const struct AdfList *          list,
+                                     struct AdfDirLink_ * const      links );
+
+static int adfDirLinkCmpReal_( const void * const  a,
+                               const void * const  b );
+
 
 /*
  * adfToRootDir
@@ -75,10 +88,8 @@ ADF_RETCODE adfChangeDir( struct AdfVolume * const  vol,
     if ( nSect == -1 )
         return ADF_RC_ERROR;
 
-    // if current entry is a hard-link - load entry of the hard-linked directory
-    rc = adfReadEntryBlock( vol, nSect, &entry );
-    if ( rc != ADF_RC_OK )
-        return rc;
+    // if current entry is a hard-link - get the sector of the hard-linked
+    // directory (the block is already read by adfNameToEntryBlk())
     if ( entry.realEntry )  {
         nSect = entry.realEntry;
     }
@@ -222,6 +233,109 @@ void adfFreeDirList( struct AdfList * const  list )
     adfListFree( root );
 }
 
+
+/*
+ * adfDirResolveLinks
+ *
+ * Read the real entries of all hard links on the list (and its subdirs)
+ * in one batch, sorted by sector, and put them into the link cache.
+ * Links already cached are skipped.
+ */
+ADF_RETCODE adfDirResolveLinks( struct AdfVolume * const      vol,
+                                const struct AdfList * const  list )
+{
+    const unsigned nLinks = adfDirCollectLinks_( vol, list, NULL );
+    if ( nLinks == 0 )
+        return ADF_RC_OK;
+
+    ADF_RETCODE rc = ADF_RC_OK;
+    struct AdfDirLink_ * const links = malloc( sizeof(struct AdfDirLink_) * nLinks );
+    uint32_t * const           sects = malloc( sizeof(uint32_t) * nLinks );
+    uint8_t ** const           bufs  = malloc( sizeof(uint8_t *) * nLinks );
+    uint8_t * const            data  = malloc( (size_t) 512 * nLinks );
+    if ( links == NULL || sects == NULL || bufs == NULL || data == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        rc = ADF_RC_MALLOC;
+        goto free_buffers;
+    }
+
+    adfDirCollectLinks_( vol, list, links );
+    qsort( links, nLinks, sizeof(struct AdfDirLink_), adfDirLinkCmpReal_ );
+
+    /* each real entry is read once (even if more links point to it) */
+    unsigned nSects = 0;
+    for ( unsigned i = 0 ; i < nLinks ; i++ ) {
+        if ( nSects > 0 && sects[ nSects - 1 ] == (uint32_t) links[ i ].real )
+            continue;
+        sects[ nSects ] = (uint32_t) links[ i ].real;
+        bufs[ nSects ]  = data + 512 * nSects;
+        nSects++;
+    }
+
+    rc = adfVolReadBlocksOfType( vol, nSects, sects, bufs, ADF_STATS_BLOCK_HEADER );
+    if ( rc != ADF_RC_OK )
+        goto free_buffers;
+
+    /* a block that cannot be decoded is just not cached */
+    unsigned iLink = 0;
+    for ( unsigned iSect = 0 ; iSect < nSects ; iSect++ ) {
+        struct AdfEntryBlock real;
+        const ADF_SECTNUM    realSect = (ADF_SECTNUM) sects[ iSect ];
+        const bool decoded =
+            ( adfDecodeEntryBlock( vol, realSect, bufs[ iSect ], &real ) == ADF_RC_OK );
+        for ( ; iLink < nLinks && links[ iLink ].real == realSect ; iLink++ )
+            if ( decoded )
+                adfLinkCacheAdd( vol, links[ iLink ].link, realSect, &real );
+    }
+
+free_buffers:
+    free( data );
+    free( bufs );
+    free( sects );
+    free( links );
+    return rc;
+}
+
+
+/*
+ * adfDirCollectLinks_
+ *
+ * count (and, if links is not NULL, store) hard links not yet in the cache
+ */
+static unsigned adfDirCollectLinks_( const struct AdfVolume * const  vol,
+                                     const struct AdfList *          list,
+                                     struct AdfDirLink_ * const      links )
+{
+    unsigned n = 0;
+    for ( ; list != NULL ; list = list->next ) {
+        const struct AdfEntry * const entry = list->content;
+        if ( entry != NULL &&
+             ( entry->type == ADF_ST_LFILE || entry->type == ADF_ST_LDIR ) &&
+             entry->real != 0 &&
+             ! adfLinkCacheHas( vol, entry->sector, entry->real ) )
+        {
+            if ( links != NULL ) {
+                links[ n ].link = entry->sector;
+                links[ n ].real = entry->real;
+            }
+            n++;
+        }
+        if ( list->subdir != NULL )
+            n += adfDirCollectLinks_( vol, list->subdir,
+                                      links != NULL ? links + n : NULL );
+    }
+    return n;
+}
+
+
+static int adfDirLinkCmpReal_( const void * const  a,
+                               const void * const  b )
+{
+    const ADF_SECTNUM ra = ( (const struct AdfDirLink_ *) a )->real,
+                      rb = ( (const struct AdfDirLink_ *) b )->real;
+    return ( ra > rb ) - ( ra < rb );
+}
+
 /*
  * adfFreeEntry
  *
@@ -926,10 +1040,25 @@ ADF_RETCODE adfReadEntryBlock( const struct AdfVolume * const  vol,
 {
     uint8_t  buf[ 512 ];
 
-    ADF_RETCODE rc = adfVolReadBlock( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, (uint32_t) nSect, buf,
+                                            ADF_STATS_BLOCK_HEADER );
     if ( rc != ADF_RC_OK )
         return rc;
 
+    return adfDecodeEntryBlock( vol, nSect, buf, ent );
+}
+
+
+/*
+ * adfDecodeEntryBlock
+ *
+ * decode (and check) raw entry block buf (read from sector nSect)
+ */
+ADF_RETCODE adfDecodeEntryBlock( const struct AdfVolume * const  vol,
+                                 const ADF_SECTNUM               nSect,
+                                 const uint8_t * const           buf,
+                                 struct AdfEntryBlock * const    ent )
+{
     memcpy( ent, buf, 512 );
 #ifdef LITT_ENDIAN
     int32_t  secType = (int32_t) swapUint32fromPtr( (uint8_t *) &ent->secType );
@@ -938,6 +1067,10 @@ ADF_RETCODE adfReadEntryBlock( const struct AdfVolume * const  vol,
          secType == ADF_ST_LSOFT  )
     {
         adfSwapEndian( (uint8_t *) ent, ADF_SWBL_LINK );
+    } else if ( secType == ADF_ST_ROOT ) {
+        /* root block pointers to bitmap pages are where an entry has
+           its comment, so must be swapped (and written back) as such */
+        adfSwapEndian( (uint8_t *) ent, ADF_SWBL_ROOT );
     } else {
         adfSwapEndian( (uint8_t *) ent, ADF_SWBL_ENTRY );
     }
@@ -984,7 +1117,7 @@ ADF_RETCODE adfReadEntryBlock( const struct AdfVolume * const  vol,
  * adfWriteEntryBlock
  *
  */
-ADF_RETCODE adfWriteEntryBlock( const struct AdfVolume * const      vol,
+ADF_RETCODE adfWriteEntryBlock( struct AdfVolume * const            vol,
                                 const ADF_SECTNUM                   nSect,
                                 const struct AdfEntryBlock * const  ent )
 {
@@ -994,12 +1127,13 @@ ADF_RETCODE adfWriteEntryBlock( const struct AdfVolume * const      vol,
     memcpy( buf, ent, sizeof(struct AdfEntryBlock) );
 
 #ifdef LITT_ENDIAN
-    adfSwapEndian( buf, ADF_SWBL_ENTRY );
+    adfSwapEndian( buf, ( ent->secType == ADF_ST_ROOT ) ? ADF_SWBL_ROOT :
+                                                          ADF_SWBL_ENTRY );
 #endif
     newSum = adfNormalSum( buf, 20, sizeof(struct AdfEntryBlock) );
     swapUint32ToPtr( buf + 20, newSum );
 
-    return adfVolWriteBlock( vol, (uint32_t) nSect, buf );
+    return adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf, ADF_STATS_BLOCK_HEADER );
 }
 
 
@@ -1007,7 +1141,7 @@ ADF_RETCODE adfWriteEntryBlock( const struct AdfVolume * const      vol,
  * adfWriteDirBlock
  *
  */
-ADF_RETCODE adfWriteDirBlock( const struct AdfVolume * const  vol,
+ADF_RETCODE adfWriteDirBlock( struct AdfVolume * const        vol,
                               const ADF_SECTNUM               nSect,
                               struct AdfDirBlock * const      dir )
 {
@@ -1028,7 +1162,8 @@ ADF_RETCODE adfWriteDirBlock( const struct AdfVolume * const  vol,
     newSum = adfNormalSum( buf, 20, sizeof(struct AdfDirBlock) );
     swapUint32ToPtr( buf + 20, newSum );
 
-    if ( adfVolWriteBlock( vol, (uint32_t) nSect, buf ) != ADF_RC_OK )
+    if ( adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf,
+                                 ADF_STATS_BLOCK_HEADER ) != ADF_RC_OK )
         return ADF_RC_ERROR;
 
     return ADF_RC_OK;
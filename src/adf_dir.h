@@ -73,6 +73,12 @@ ADF_PREFIX struct AdfList * adfGetRDirEnt( const struct AdfVolume * const  vol,
                                            const bool                      recurs );
 
 ADF_PREFIX void adfFreeDirList( struct AdfList * const  list );
+
+/* read the real entries of all hard links on a list (in one sector-sorted
+   batch) into the link cache, so that following the links (adfFileOpen(),
+   adfChangeDir()) does not read them one by one */
+ADF_PREFIX ADF_RETCODE adfDirResolveLinks( struct AdfVolume * const      vol,
+                                           const struct AdfList * const  list );
 ADF_PREFIX void adfFreeEntry( struct AdfEntry * const  entry );
 
 /* get entry by name */
@@ -144,11 +150,16 @@ ADF_PREFIX ADF_RETCODE adfReadEntryBlock( const struct AdfVolume * const  vol,
                                           const ADF_SECTNUM               nSect,
                                           struct AdfEntryBlock * const    ent );
 
-ADF_RETCODE adfWriteEntryBlock( const struct AdfVolume * const      vol,
+ADF_RETCODE adfDecodeEntryBlock( const struct AdfVolume * const  vol,
+                                 const ADF_SECTNUM               nSect,
+                                 const uint8_t * const           buf,
+                                 struct AdfEntryBlock * const    ent );
+
+ADF_RETCODE adfWriteEntryBlock( struct AdfVolume * const            vol,
                                 const ADF_SECTNUM                   nSect,
                                 const struct AdfEntryBlock * const  ent );
 
-ADF_RETCODE adfWriteDirBlock( const struct AdfVolume * const  vol,
+ADF_RETCODE adfWriteDirBlock( struct AdfVolume * const        vol,
                               const ADF_SECTNUM               nSect,
                               struct AdfDirBlock * const      dir );
 
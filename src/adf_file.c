@@ -31,21 +31,58 @@
 #include "adf_env.h"
 #include "adf_file_block.h"
 #include "adf_file_util.h"
+#include "adf_link.h"
 #include "adf_raw.h"
 #include "adf_str.h"
 #include "adf_util.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 
-static ADF_RETCODE adfFileReadNextBlock( struct AdfFile * const  file );
-static ADF_RETCODE adfFileCreateNextBlock( struct AdfFile * const  file );
+static ADF_RETCODE adfFileReadNextBlockFFS_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileReadNextBlockOFS_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileCreateNextBlockFFS_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileCreateNextBlockOFS_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileWriteDataBlockFFS_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileWriteDataBlockOFS_( struct AdfFile * const  file );
+static void adfFileInitDataBlockFFS_( const struct AdfFile * const  file,
+                                      const unsigned                nDataBlock,
+                                      const ADF_SECTNUM             nextData,
+                                      void * const                  data );
+static void adfFileInitDataBlockOFS_( const struct AdfFile * const  file,
+                                      const unsigned                nDataBlock,
+                                      const ADF_SECTNUM             nextData,
+                                      void * const                  data );
 
 static unsigned adfFileWriteFilled( struct AdfFile * const  file,
                                     const uint8_t           fillValue,
                                     uint32_t                size );
+static uint32_t adfFileAppendTail_( struct AdfFile * const  file,
+                                    const uint32_t          size,
+                                    AdfFileDataSource       source,
+                                    void * const            ctx );
+
+/* the state of a file restored when appending fails */
+struct AdfFileAppendUndo_ {
+    struct AdfFileHeaderBlock  fhdr;
+    struct AdfFileExtBlock     ext;         /* the current ext. block */
+    unsigned                   nDataMapped,
+                               nExtMapped;
+};
+
+static void adfFileAppendUndo_( struct AdfFile * const                   file,
+                                const struct AdfFileAppendUndo_ * const  undo,
+                                ADF_SECTNUM * const                      sectors,
+                                const unsigned                           nSectors );
+static void adfFileFreeBlocks_( struct AdfVolume * const  vol,
+                                ADF_SECTNUM * const       sectors,
+                                const unsigned            nSectors );
+static int adfSectNumCmp_( const void * const  a,
+                           const void * const  b );
 
 static ADF_RETCODE adfFileSeekStart_( struct AdfFile * const  file );
 static ADF_RETCODE adfFileSeekEOF_( struct AdfFile * const  file );
@@ -54,6 +91,104 @@ static ADF_RETCODE adfFileSeekOFS_( struct AdfFile * const  file,
 static ADF_RETCODE adfFileSeekExt_( struct AdfFile * const  file,
                                     uint32_t                pos );
 
+static ADF_RETCODE adfFileReadDataBlock_( struct AdfFile * const  file,
+                                          const unsigned          nDataBlock,
+                                          const ADF_SECTNUM       nSect );
+static ADF_RETCODE adfFileReadExtBlock_( struct AdfFile * const          file,
+                                         const ADF_SECTNUM               nSect,
+                                         struct AdfFileExtBlock * const  fext );
+static void adfFileReadAheadFree_( struct AdfFileReadAhead * const  ra );
+
+static ADF_RETCODE adfFileWriteCurrentExt_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileDirtyStash_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileDirtyWriteBack_( struct AdfFile * const  file );
+static const struct AdfFileDirtyBlock * adfFileDirtyFind_(
+    const struct AdfFile * const  file,
+    const unsigned                nDataBlock );
+static void adfFileDirtyRemove_( struct AdfFile * const                  file,
+                                 const struct AdfFileDirtyBlock * const  dirty );
+static void adfFileDirtyDrop_( struct AdfFile * const  file,
+                               const unsigned          nDataBlocks );
+static int adfFileDirtyCmpSect_( const void * const  a,
+                                 const void * const  b );
+
+/* a cursor over buffers of a scatter/gather operation */
+struct AdfIoVecCursor_ {
+    const struct AdfIoVec *  iov;
+    unsigned                 iovcnt,
+                             index;     /* current buffer */
+    uint32_t                 offset;    /* position in the current buffer */
+};
+
+static uint32_t adfIoVecLength_( const struct AdfIoVec * const  iov,
+                                 const unsigned                 iovcnt );
+static void adfIoVecScatter_( struct AdfIoVecCursor_ * const  cur,
+                              const uint8_t *                 data,
+                              uint32_t                        len );
+static void adfIoVecGather_( struct AdfIoVecCursor_ * const  cur,
+                             uint8_t *                       data,
+                             uint32_t                        len );
+static uint32_t adfFileOverwrite_( struct AdfFile * const          file,
+                                   const uint32_t                  offset,
+                                   const uint32_t                  n,
+                                   struct AdfIoVecCursor_ * const  cur );
+
+static ADF_RETCODE adfFileBlockMapReserve_( struct AdfFileBlockMap * const  map,
+                                            const unsigned                  capacity );
+static ADF_RETCODE adfFileBlockMapSet_( struct AdfFileBlockMap * const  map,
+                                        const unsigned                  index,
+                                        const ADF_SECTNUM               nSect );
+static void adfFileBlockMapTrim_( struct AdfFileBlockMap * const  map,
+                                  const unsigned                  nItems );
+static void adfFileBlockMapFree_( struct AdfFileBlockMap * const  map );
+static ADF_RETCODE adfFileBlockMapAddHdr_( struct AdfFile * const  file );
+static ADF_RETCODE adfFileBlockMapAddExt_(
+    struct AdfFile * const                file,
+    const unsigned                        extIndex,
+    const struct AdfFileExtBlock * const  fext );
+static ADF_RETCODE adfFileBlockMapFind_( struct AdfFile * const          file,
+                                         const unsigned                  nDataBlock,
+                                         struct AdfFileExtBlock * const  fext,
+                                         ADF_SECTNUM * const             nSect );
+
+
+/* file operations specific to the filesystem type (bound on file opening) */
+struct AdfFileOps {
+    unsigned     dataOffset;    /* offset of file data in a data block */
+
+    ADF_RETCODE  (*readNextBlock)( struct AdfFile * const  file );
+    ADF_RETCODE  (*createNextBlock)( struct AdfFile * const  file );
+    ADF_RETCODE  (*writeDataBlock)( struct AdfFile * const  file );
+
+    /* prepare (in memory) data block nDataBlock of the file to be
+       written entirely with new data */
+    void         (*initDataBlock)( const struct AdfFile * const  file,
+                                   const unsigned                nDataBlock,
+                                   const ADF_SECTNUM             nextData,
+                                   void * const                  data );
+};
+
+/* FFS: data blocks contain only data, addressed by the block pointers
+   (stored in the file header and ext. blocks) */
+static const struct AdfFileOps adfFileOpsFFS = {
+    .dataOffset      = 0,
+    .readNextBlock   = adfFileReadNextBlockFFS_,
+    .createNextBlock = adfFileCreateNextBlockFFS_,
+    .writeDataBlock  = adfFileWriteDataBlockFFS_,
+    .initDataBlock   = adfFileInitDataBlockFFS_
+};
+
+/* OFS: data blocks have a header (with a sequence number, data size
+   and a pointer to the next data block) */
+static const struct AdfFileOps adfFileOpsOFS = {
+    .dataOffset      = offsetof( struct AdfOFSDataBlock, data ),
+    .readNextBlock   = adfFileReadNextBlockOFS_,
+    .createNextBlock = adfFileCreateNextBlockOFS_,
+    .writeDataBlock  = adfFileWriteDataBlockOFS_,
+    .initDataBlock   = adfFileInitDataBlockOFS_
+};
+
+
 // debugging
 //#define DEBUG_ADF_FILE
 #ifdef DEBUG_ADF_FILE
@@ -104,8 +239,9 @@ struct AdfFile * adfFileOpen( struct AdfVolume * const  vol,
     if ( adfReadEntryBlock(vol, vol->curDirPtr, &parent) != ADF_RC_OK )
         return NULL;
 
-    bool fileAlreadyExists =
-        ( adfNameToEntryBlk( vol, parent.hashTable, name, &entry, NULL ) != -1 );
+    const ADF_SECTNUM entrySect =
+        adfNameToEntryBlk( vol, parent.hashTable, name, &entry, NULL );
+    bool fileAlreadyExists = ( entrySect != -1 );
 
     if ( modeRead && ( ! modeWrite ) && ( ! fileAlreadyExists ) ) {
         adfEnv.wFct( "%s: file \"%s\" not found.", __func__, name );
@@ -113,7 +249,7 @@ struct AdfFile * adfFileOpen( struct AdfVolume * const  vol,
         return NULL;
     }
 
-    if ( modeRead && adfAccHasR( entry.access ) ) {
+    if ( fileAlreadyExists && modeRead && adfAccHasR( entry.access ) ) {
         adfEnv.wFct( "%s: read access denied to '%s'", __func__, name );
         return NULL;
     }
@@ -134,8 +270,9 @@ struct AdfFile * adfFileOpen( struct AdfVolume * const  vol,
 
     if ( fileAlreadyExists ) {
         if ( entry.realEntry )  {  // ... and it is a hard-link...
-            // ... load entry of the hard-linked file
-            ADF_RETCODE rc = adfReadEntryBlock( vol, entry.realEntry, &entry );
+            // ... load entry of the hard-linked file (possibly cached)
+            ADF_RETCODE rc = adfLinkGetTarget( vol, entrySect, entry.realEntry,
+                                               &entry );
             if ( rc != ADF_RC_OK ) return NULL;
             rc = adfReadEntryBlock( vol, entry.parent, &parent );
             if ( rc != ADF_RC_OK ) return NULL;
@@ -173,6 +310,8 @@ struct AdfFile * adfFileOpen( struct AdfVolume * const  vol,
     }
 
     file->volume                  = vol;
+    file->ops                     = adfVolIsOFS( vol ) ? &adfFileOpsOFS :
+                                                         &adfFileOpsFFS;
     file->pos                     = 0;
     file->posInExtBlk             = 0;
     file->posInDataBlk            = 0;
@@ -180,8 +319,19 @@ struct AdfFile * adfFileOpen( struct AdfVolume * const  vol,
     file->nDataBlock              = 0;
     file->curDataPtr              = 0;
     file->currentDataBlockChanged = false;
+    file->currentExtChanged       = false;
+    file->fileHdrChanged          = false;
+    file->dirtyBlocks             = (struct AdfFileDirtyBlocks) { NULL, 0 };
     file->modeRead                = modeRead;
     file->modeWrite               = modeWrite;
+    file->dataBlockMap            = (struct AdfFileBlockMap) { NULL, 0, 0 };
+    file->extBlockMap             = (struct AdfFileBlockMap) { NULL, 0, 0 };
+    file->readAhead               = (struct AdfFileReadAhead) {
+        .next      = UINT_MAX,
+        .windowMin = ADF_FILE_READAHEAD_MIN,
+        .windowMax = ADF_FILE_READAHEAD_MAX
+    };
+    file->stats                   = (struct AdfFileStats) { 0, 0, 0, 0 };
 
     if ( ! modeWrite ) {
         /* read-only mode */
@@ -216,6 +366,10 @@ struct AdfFile * adfFileOpen( struct AdfVolume * const  vol,
     return file;
 
 adfOpenFile_error:
+    adfFileBlockMapFree_( &file->dataBlockMap );
+    adfFileBlockMapFree_( &file->extBlockMap );
+    adfFileReadAheadFree_( &file->readAhead );
+    free( file->currentExt );
     free( file->currentData );
     free( file->fileHdr );
     free( file );
@@ -233,14 +387,25 @@ void adfFileClose( struct AdfFile * const  file )
         return;
 /*puts("adfCloseFile in");*/
 
-    adfFileFlush( file );
+    if ( adfFileFlush( file ) == ADF_RC_OK && file->modeWrite &&
+         adfDevSyncPoint( file->volume->dev, ADF_SYNC_FILE_CLOSE ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: error syncing file '%s'",
+                     __func__, file->fileHdr->fileName );
+    }
 
     if ( file->currentExt )
         free( file->currentExt );
 
+    free( file->dirtyBlocks.blocks );
+
     if ( file->currentData )
         free( file->currentData );
 
+    adfFileBlockMapFree_( &file->dataBlockMap );
+    adfFileBlockMapFree_( &file->extBlockMap );
+    adfFileReadAheadFree_( &file->readAhead );
+
     free( file->fileHdr );
     free( file );
 
@@ -269,10 +434,8 @@ uint32_t adfFileRead( struct AdfFile * const  file,
     if ( file->pos + n > file->fileHdr->byteSize )
         n = file->fileHdr->byteSize - file->pos;
 
-    uint8_t * const dataPtr = ( adfVolIsOFS( file->volume ) ) ?
-        //(uint8_t*)(file->currentData)+24 :
-        ( (struct AdfOFSDataBlock *) file->currentData )->data :
-        file->currentData;
+    const uint8_t * const dataPtr =
+        (uint8_t *) file->currentData + file->ops->dataOffset;
 
     uint32_t bytesRead = 0;
     uint8_t *bufPtr    = buffer;
@@ -280,7 +443,7 @@ uint32_t adfFileRead( struct AdfFile * const  file,
     while ( bytesRead < n ) {
 
         if ( file->posInDataBlk == blockSize ) {
-            ADF_RETCODE rc = adfFileReadNextBlock( file );
+            ADF_RETCODE rc = file->ops->readNextBlock( file );
             if ( rc != ADF_RC_OK ) {
                 adfEnv.eFct( "%s: error reading next data block, "
                              "file '%s', pos %d, data block %d",
@@ -289,8 +452,7 @@ uint32_t adfFileRead( struct AdfFile * const  file,
                 file->curDataPtr = 0;  // invalidate data ptr
                 return bytesRead;
             }
-            file->posInDataBlk            = 0;
-            file->currentDataBlockChanged = false;
+            file->posInDataBlk = 0;
         }
 
         unsigned size = min( n - bytesRead, blockSize - file->posInDataBlk );
@@ -320,9 +482,8 @@ uint32_t adfFileWrite( struct AdfFile * const  file,
 /*puts("adfWriteFile");*/
     const unsigned blockSize = file->volume->datablockSize;
 
-    uint8_t * const dataPtr = ( adfVolIsOFS( file->volume ) ) ?
-        ( (struct AdfOFSDataBlock *) file->currentData )->data :
-        file->currentData;
+    uint8_t * const dataPtr =
+        (uint8_t *) file->currentData + file->ops->dataOffset;
 
     uint32_t       bytesWritten = 0;
     const uint8_t *bufPtr       = buffer;
@@ -332,26 +493,22 @@ uint32_t adfFileWrite( struct AdfFile * const  file,
 
             if ( file->pos == file->fileHdr->byteSize ) {   // at EOF ?
                 // ...  create a new block
-                ADF_RETCODE rc = adfFileCreateNextBlock( file );
-                file->currentDataBlockChanged = false;
+                ADF_RETCODE rc = file->ops->createNextBlock( file );
                 if ( rc != ADF_RC_OK ) {
                     /* bug found by Rikard */
                     adfEnv.wFct( "%s: no more free sectors available", __func__ );
                     //file->curDataPtr = 0; // invalidate data ptr
+                    // (the current block, if changed, is still to be written)
                     return bytesWritten;
                 }
+                file->currentDataBlockChanged = false;
             }
             else if ( file->posInDataBlk == blockSize ) {
                 // inside the existing data (at the end of a data block )
 
-                // write the block stored currently in the memory
-                if ( file->currentDataBlockChanged ) {
-                    adfFileFlush( file ); // to optimize (?)
-                    file->currentDataBlockChanged = false;
-                }
-
-                // - and read the next block
-                ADF_RETCODE rc = adfFileReadNextBlock( file );
+                // read the next block (the current one, if changed,
+                // is kept in the dirty set)
+                ADF_RETCODE rc = file->ops->readNextBlock( file );
                 if ( rc != ADF_RC_OK ) {
                     adfEnv.eFct( "%s: error reading next data block, "
                                  "file '%s', pos %d, data block %d",
@@ -373,12 +530,7 @@ uint32_t adfFileWrite( struct AdfFile * const  file,
         bytesWritten                 += size;
         file->posInDataBlk           += size;
         file->currentDataBlockChanged = true;
-
-        if ( adfVolIsOFS( file->volume ) ) {
-            struct AdfOFSDataBlock *ofsData =
-                (struct AdfOFSDataBlock *) file->currentData;
-            ofsData->dataSize = max( ofsData->dataSize, file->posInDataBlk );
-        }
+        file->fileHdrChanged          = true;
 
         // update file size in the header
         file->fileHdr->byteSize = max( file->fileHdr->byteSize,
@@ -413,9 +565,13 @@ ADF_RETCODE adfFileSeek( struct AdfFile * const  file,
         return ADF_RC_OK;
     }
 
-    if ( file->modeWrite && file->currentDataBlockChanged ) {
-        adfFileFlush( file );
-        file->currentDataBlockChanged = false;
+    if ( file->modeWrite ) {
+        // (the current ext. block can be replaced by another one)
+        ADF_RETCODE rc = adfFileDirtyStash_( file );
+        if ( rc == ADF_RC_OK )
+            rc = adfFileWriteCurrentExt_( file );
+        if ( rc != ADF_RC_OK )
+            return rc;
     }
 
     if ( pos == 0 )
@@ -449,7 +605,7 @@ ADF_RETCODE adfFileSeek( struct AdfFile * const  file,
  *
  * the algorithm (for shrinking):
  * 1. make list of blocks (data and ext.) to remove
- * 2. seek to the requested position (size)
+ * 2. seek to the last byte of the truncated file (the new last data block)
  * 3. update metadata (ie. block pointers) in blocks
  *    - file header
  *      - file size (byteSize)
@@ -465,8 +621,10 @@ ADF_RETCODE adfFileSeek( struct AdfFile * const  file,
  *    - additionally for OFS
  *      - set no next data block in data block header
  *      - set the new data size
- *  4. mark blocks to remove (adfSetBlockFree())
+ *  4. mark blocks to remove (adfSetBlockRangeFree())
  *  5. update block allocation bitmap (adfUpdateBitmap())
+ *
+ * enlarging - see adfFileAppend()
  */
 
 ADF_RETCODE adfFileTruncate( struct AdfFile * const  file,
@@ -481,36 +639,31 @@ ADF_RETCODE adfFileTruncate( struct AdfFile * const  file,
 
     const unsigned fileSizeOld = file->fileHdr->byteSize;
 
-    if ( fileSizeNew > fileSizeOld ) {
-        const unsigned enlargeSize = fileSizeNew - fileSizeOld;
-        ADF_RETCODE rc = adfFileSeek( file, fileSizeOld );
-        if ( rc != ADF_RC_OK )
-            return rc;
-        assert( adfFileAtEOF( file ) == true );
-        const unsigned bytesWritten = adfFileWriteFilled( file, 0, enlargeSize );
-        if ( enlargeSize != bytesWritten )
-            return ADF_RC_ERROR;
-        return ADF_RC_OK;
-    }
+    if ( fileSizeNew > fileSizeOld )
+        return adfFileAppend( file, fileSizeNew - fileSizeOld, NULL, NULL );
+
+    // 1. (the block lists are read from the volume - write the changed ones first)
+    ADF_RETCODE rc = adfFileFlush( file );
+    if ( rc != ADF_RC_OK )
+        return rc;
 
-    // 1.
     struct AdfVectorSectors blocksToRemove = adfVectorSectorsCreate( 0 );
-    ADF_RETCODE rc = adfFileTruncateGetBlocksToRemove( file, fileSizeNew,
-                                                       &blocksToRemove );
+    rc = adfFileTruncateGetBlocksToRemove( file, fileSizeNew, &blocksToRemove );
     assert( blocksToRemove.itemSize == sizeof(ADF_SECTNUM) );
     if ( rc != ADF_RC_OK )
         return rc;
 
-    // 2. seek to the new EOF
-    rc = adfFileSeek( file, fileSizeNew );
+    // 2. seek to the new last byte, to have the new last data and ext. blocks
+    //    loaded (the new EOF can be the first byte of a block to remove)
+    rc = adfFileSeek( file, ( fileSizeNew > 0 ) ? fileSizeNew - 1 : 0 );
     if ( rc != ADF_RC_OK ) {
         blocksToRemove.destroy( &blocksToRemove );
         return rc;
     }
-    assert( file->pos == fileSizeNew );
 
     // 3.
     file->fileHdr->byteSize = fileSizeNew;
+    file->fileHdrChanged    = true;
     if ( fileSizeNew == 0 ) {
         // the new file is an empty file
 
@@ -575,14 +728,27 @@ ADF_RETCODE adfFileTruncate( struct AdfFile * const  file,
             file->fileHdr->extension = 0;
         } else {
             file->currentExt->extension = 0;
+            file->currentExtChanged     = true;
         }
+
+        // the new EOF (as in adfFileSeekEOF_())
+        file->pos = fileSizeNew;
+        file->posInDataBlk =
+            ( fileSizeNew % file->volume->datablockSize == 0 ) ?
+            file->volume->datablockSize :
+            fileSizeNew % file->volume->datablockSize;
     }
 
+    // the removed blocks are no longer file's blocks
+    const unsigned nDataBlocksNew = adfFileSize2Datablocks(
+        fileSizeNew, file->volume->datablockSize );
+    adfFileBlockMapTrim_( &file->dataBlockMap, nDataBlocksNew );
+    adfFileBlockMapTrim_( &file->extBlockMap,
+                          adfFileDatablocks2Extblocks( nDataBlocksNew ) );
+    adfFileDirtyDrop_( file, nDataBlocksNew );
+
     // 4.
-    // todo: add sorting blocksToRemove (to optimize disk access)
-    for ( unsigned i = 0 ; i < blocksToRemove.nItems ; ++i ) {
-        adfSetBlockFree( file->volume, blocksToRemove.sectors[i] );
-    }
+    adfFileFreeBlocks_( file->volume, blocksToRemove.sectors, blocksToRemove.nItems );
     blocksToRemove.destroy( &blocksToRemove );
 
     assert( file->pos == fileSizeNew );
@@ -595,47 +761,27 @@ ADF_RETCODE adfFileTruncate( struct AdfFile * const  file,
 /*
  * adfFileFlush
  *
+ * write the changed data blocks and, only if anything in the file changed,
+ * the current ext. block and the header (with the modification date)
  */
 ADF_RETCODE adfFileFlush( struct AdfFile * const  file )
 {
     if ( ! file->modeWrite )
         return ADF_RC_OK;
 
-    ADF_RETCODE rc = ADF_RC_OK;
-
-    //
-    // write current ext. block
-    //
-    if ( file->currentExt ) {
-        rc = adfWriteFileExtBlock( file->volume,
-                                   file->currentExt->headerKey,
-                                   file->currentExt );
-        if ( rc != ADF_RC_OK ) {
-            adfEnv.eFct( "%s: error writing ext block 0x%x (%d), file '%s'",
-                         __func__, file->currentExt->headerKey,
-                         file->currentExt->headerKey,
-                         file->fileHdr->fileName );
-            return rc;
-        }
-    }
+    ADF_RETCODE rc = adfFileDirtyWriteBack_( file );
+    if ( rc != ADF_RC_OK )
+        return rc;
 
     //
     // update (OFS header, if the case) and write the current data block
     //
-    if ( file->fileHdr->byteSize > 0 &&
+    if ( file->currentDataBlockChanged &&
+         file->fileHdr->byteSize > 0 &&
          file->currentData != NULL &&
          file->curDataPtr != 0 )
     {
-        if ( adfVolIsOFS( file->volume ) ) {
-            struct AdfOFSDataBlock * const data =
-                (struct AdfOFSDataBlock *) file->currentData;
-            assert( file->posInDataBlk <= file->volume->datablockSize );
-            data->dataSize = file->posInDataBlk;
-        }
-
-        rc = adfWriteDataBlock( file->volume,
-                                file->curDataPtr,
-                                file->currentData );
+        rc = file->ops->writeDataBlock( file );
         if ( rc != ADF_RC_OK ) {
             adfEnv.eFct( "%s: error writing data block 0x%x (%u), file '%s'",
                          __func__, file->curDataPtr, file->curDataPtr,
@@ -643,6 +789,17 @@ ADF_RETCODE adfFileFlush( struct AdfFile * const  file )
             return rc;
         }
     }
+    file->currentDataBlockChanged = false;
+
+    //
+    // write current ext. block
+    //
+    rc = adfFileWriteCurrentExt_( file );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    if ( ! file->fileHdrChanged )
+        return ADF_RC_OK;
 
     //
     // update and write file header block
@@ -693,10 +850,235 @@ ADF_RETCODE adfFileFlush( struct AdfFile * const  file )
         return rc;
     }
 
+    file->fileHdrChanged = false;
     return rc;
 }
 
 
+/*
+ * adfFileSetReadAhead
+ *
+ */
+ADF_RETCODE adfFileSetReadAhead( struct AdfFile * const  file,
+                                 const unsigned          windowMin,
+                                 const unsigned          windowMax )
+{
+    if ( windowMax > 0 && ( windowMin < 2 || windowMin > windowMax ) ) {
+        adfEnv.eFct( "%s: invalid read-ahead window %u - %u",
+                     __func__, windowMin, windowMax );
+        return ADF_RC_ERROR;
+    }
+
+    struct AdfFileReadAhead * const ra = &file->readAhead;
+    ra->windowMin = windowMin;
+    ra->windowMax = windowMax;
+    ra->window    = min( ra->window, windowMax );
+    if ( windowMax == 0 )
+        adfFileReadAheadFree_( ra );
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfFileReadv
+ *
+ * read (scatter) file data from the current position to the buffers,
+ * advancing the position
+ */
+uint32_t adfFileReadv( struct AdfFile * const         file,
+                       const struct AdfIoVec * const  iov,
+                       const unsigned                 iovcnt )
+{
+    const uint32_t bytesRead = adfFilePread( file, file->pos, iov, iovcnt );
+    if ( bytesRead > 0 &&
+         adfFileSeek( file, file->pos + bytesRead ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: error seeking to %u, file '%s'",
+                     __func__, file->pos + bytesRead, file->fileHdr->fileName );
+    }
+    return bytesRead;
+}
+
+
+/*
+ * adfFileWritev
+ *
+ * write (gather) data from the buffers at the current position,
+ * advancing the position
+ */
+uint32_t adfFileWritev( struct AdfFile * const         file,
+                        const struct AdfIoVec * const  iov,
+                        const unsigned                 iovcnt )
+{
+    const uint32_t pos          = file->pos;
+    const uint32_t bytesWritten = adfFilePwrite( file, pos, iov, iovcnt );
+    if ( bytesWritten > 0 &&
+         adfFileSeek( file, pos + bytesWritten ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: error seeking to %u, file '%s'",
+                     __func__, pos + bytesWritten, file->fileHdr->fileName );
+    }
+    return bytesWritten;
+}
+
+
+/*
+ * adfFilePread
+ *
+ * read file data at offset to the buffers, without using or changing
+ * the file position (the file handle is not modified)
+ *
+ * the sectors of all data blocks to read are resolved first (from the block
+ * map or, for blocks not mapped yet, from the file header and ext. blocks),
+ * then the blocks are read in batches of coalesced device reads
+ */
+uint32_t adfFilePread( const struct AdfFile * const   file,
+                       const uint32_t                 offset,
+                       const struct AdfIoVec * const  iov,
+                       const unsigned                 iovcnt )
+{
+    const uint32_t fileSize = file->fileHdr->byteSize;
+    if ( ( ! file->modeRead ) || offset >= fileSize )
+        return 0;
+
+    const uint32_t n = min( adfIoVecLength_( iov, iovcnt ), fileSize - offset );
+    if ( n == 0 )
+        return 0;
+
+    struct AdfVolume * const vol = file->volume;
+    const unsigned blockSize  = vol->datablockSize,
+                   firstBlock = offset / blockSize,
+                   nBlocks    = ( offset + n - 1 ) / blockSize - firstBlock + 1,
+                   nBatch     = min( nBlocks, (unsigned) ADF_FILE_IOV_BATCH );
+
+    ADF_SECTNUM * const sectors = malloc( sizeof(ADF_SECTNUM) * nBlocks );
+    uint8_t * const     buffer  = malloc( 512 * nBatch );
+    uint32_t bytesRead = 0;
+    if ( sectors == NULL || buffer == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        goto free_mem;
+    }
+
+    if ( adfFileGetDataBlockSectors( file, firstBlock, nBlocks,
+                                     sectors ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: error getting data blocks %u-%u, file '%s'",
+                     __func__, firstBlock, firstBlock + nBlocks - 1,
+                     file->fileHdr->fileName );
+        goto free_mem;
+    }
+
+    uint8_t * bufs[ ADF_FILE_IOV_BATCH ];
+    for ( unsigned i = 0 ; i < nBatch ; i++ )
+        bufs[ i ] = buffer + 512 * i;
+
+    struct AdfIoVecCursor_ cur = { iov, iovcnt, 0, 0 };
+    struct AdfOFSDataBlock block;
+    for ( unsigned batch = 0 ; batch < nBlocks ; batch += nBatch ) {
+        const unsigned nRead = min( nBatch, nBlocks - batch );
+        if ( adfVolReadBlocksOfType( vol, nRead, (const uint32_t *) &sectors[ batch ],
+                                     bufs, ADF_STATS_BLOCK_DATA ) != ADF_RC_OK )
+            goto free_mem;
+
+        for ( unsigned i = 0 ; i < nRead ; i++ ) {
+            const unsigned    nDataBlock = firstBlock + batch + i;
+            const ADF_SECTNUM nSect      = sectors[ batch + i ];
+
+            // the current block of the handle (and other changed blocks)
+            // can have changes not written yet
+            const struct AdfFileDirtyBlock * const dirty =
+                adfFileDirtyFind_( file, nDataBlock );
+            const uint8_t * data;
+            if ( file->modeWrite &&
+                 file->curDataPtr == nSect &&
+                 file->nDataBlock == nDataBlock + 1 )
+            {
+                data = file->currentData;
+            } else if ( dirty != NULL ) {
+                data = dirty->data;
+            } else {
+                if ( adfDecodeDataBlock( vol, nSect, bufs[ i ],
+                                         &block ) != ADF_RC_OK )
+                    goto free_mem;
+                data = (const uint8_t *) &block;
+            }
+
+            const unsigned posInBlock = ( offset + bytesRead ) % blockSize;
+            const uint32_t size = min( n - bytesRead, blockSize - posInBlock );
+            adfIoVecScatter_( &cur, data + file->ops->dataOffset + posInBlock,
+                              size );
+            bytesRead += size;
+        }
+    }
+
+free_mem:
+    free( buffer );
+    free( sectors );
+    return bytesRead;
+}
+
+
+/*
+ * adfFilePwrite
+ *
+ * write data from the buffers at offset, without changing the file position
+ *
+ * existing data blocks are overwritten directly (only the first and the last
+ * block, if written partially, are read); data beyond EOF is appended
+ * (a gap between EOF and offset is filled with zeros)
+ */
+uint32_t adfFilePwrite( struct AdfFile * const         file,
+                        const uint32_t                 offset,
+                        const struct AdfIoVec * const  iov,
+                        const unsigned                 iovcnt )
+{
+    if ( ! file->modeWrite )
+        return 0;
+
+    const uint32_t n = min( adfIoVecLength_( iov, iovcnt ), UINT32_MAX - offset );
+    if ( n == 0 )
+        return 0;
+
+    struct AdfIoVecCursor_ cur = { iov, iovcnt, 0, 0 };
+    const uint32_t fileSize = file->fileHdr->byteSize;
+    uint32_t bytesWritten = 0;
+
+    if ( offset < fileSize ) {
+        const uint32_t nExisting = min( n, fileSize - offset );
+        bytesWritten = adfFileOverwrite_( file, offset, nExisting, &cur );
+        if ( bytesWritten < nExisting || bytesWritten == n )
+            return bytesWritten;
+    }
+
+    // append the rest (using the file position, restored at the end)
+    const uint32_t posSaved = file->pos;
+    if ( adfFileSeekEOF( file ) != ADF_RC_OK )
+        return bytesWritten;
+
+    if ( offset > fileSize ) {
+        const uint32_t gap = offset - fileSize;
+        if ( adfFileWriteFilled( file, 0, gap ) != gap )
+            goto restore_pos;
+    }
+
+    for ( ; cur.index < cur.iovcnt ; cur.index++, cur.offset = 0 ) {
+        const struct AdfIoVec * const v = &cur.iov[ cur.index ];
+        const uint32_t len = v->len - cur.offset;
+        const uint32_t written = adfFileWrite(
+            file, len, (const uint8_t *) v->base + cur.offset );
+        bytesWritten += written;
+        if ( written != len )
+            break;
+    }
+
+restore_pos:
+    if ( adfFileSeek( file, posSaved ) != ADF_RC_OK )
+        adfEnv.eFct( "%s: error restoring position %u, file '%s'",
+                     __func__, posSaved, file->fileHdr->fileName );
+    return bytesWritten;
+}
+
+
 /*****************************************************************************
  *
  * Public low-level functions
@@ -722,6 +1104,17 @@ ADF_RETCODE adfFileReadExtBlockN( const struct AdfFile * const    file,
         return ADF_RC_BLOCKOUTOFRANGE;
     }
 
+    // the sector of the block known (mapped) - read it directly
+    if ( (unsigned) extBlock < file->extBlockMap.nItems ) {
+        const ADF_SECTNUM nSect = file->extBlockMap.sectors[ extBlock ];
+        if ( adfReadFileExtBlock( file->volume, nSect, fext ) != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: error reading ext block %d, file '%s'",
+                         __func__, nSect, file->fileHdr->fileName );
+            return ADF_RC_BLOCKREAD;
+        }
+        return ADF_RC_OK;
+    }
+
     // traverse the ext. blocks until finding (and reading)
     // the requested one
     ADF_SECTNUM nSect = file->fileHdr->extension;
@@ -888,6 +1281,16 @@ ADF_RETCODE adfFileTruncateGetBlocksToRemove(
 
         // get blocks to remove from the following (if any remaining) ext. blocks
         while ( nextExt > 0 ) {
+            if ( extBlock_i >= nExtBlocksOld ) {
+                // more ext. blocks linked than the file size requires
+                adfEnv.eFct( "%s: invalid ext. block chain (more than %u blocks), "
+                             "file '%s'", __func__, nExtBlocksOld,
+                             file->fileHdr->fileName );
+                free( extBlock );
+                blocksToRemove->destroy( blocksToRemove );
+                return ADF_RC_ERROR;
+            }
+
             ADF_RETCODE rc = adfReadFileExtBlock(
                 file->volume, (ADF_SECTNUM) nextExt, extBlock );
             if ( rc != ADF_RC_OK ) {
@@ -956,101 +1359,139 @@ ADF_RETCODE adfFileTruncateGetBlocksToRemove(
  *****************************************************************************/
 
 /*
- * adfReadNextFileBlock
+ * adfFileReadBlockAt_
  *
+ * read the next data block (at sector nSect) of the file
  */
-static ADF_RETCODE adfFileReadNextBlock( struct AdfFile * const  file )
+static ADF_RETCODE adfFileReadBlockAt_( struct AdfFile * const  file,
+                                        const ADF_SECTNUM       nSect )
 {
-    ADF_RETCODE rc = ADF_RC_OK;
+    if ( nSect < 2 ) {
+        adfEnv.eFct( "%s: invalid data block address %u ( 0x%x ), "
+                     "data block %u, file '%s'",
+                     __func__, nSect, nSect,
+                     file->nDataBlock, file->fileHdr->fileName );
+        //printBacktrace();
+        return ADF_RC_ERROR;
+    }
 
-    struct AdfOFSDataBlock * const data = (struct AdfOFSDataBlock *) file->currentData;
+    // the current block, if changed, is kept to be written later
+    ADF_RETCODE rc = adfFileDirtyStash_( file );
+    if ( rc != ADF_RC_OK )
+        return rc;
 
-    ADF_SECTNUM nSect;
-    if ( file->nDataBlock == 0 ) {
-        nSect = file->fileHdr->firstData;
-    }
-    else if ( adfVolIsOFS( file->volume ) ) {
-        nSect = data->nextData;
-    }
-    else {
-        if ( file->nDataBlock < ADF_MAX_DATABLK )
-            nSect = file->fileHdr->dataBlocks[ ADF_MAX_DATABLK - 1 - file->nDataBlock ];
-        else {
-            if ( file->nDataBlock == ADF_MAX_DATABLK ) {
+    rc = adfFileReadDataBlock_( file, file->nDataBlock, nSect );
+    if ( rc != ADF_RC_OK )
+        adfEnv.eFct( "%s: error reading data block %d / %d, file '%s'",
+                     __func__, file->nDataBlock, nSect, file->fileHdr->fileName );
 
-                if ( file->currentExt == NULL ) {
-                    file->currentExt = (struct AdfFileExtBlock *)
-                        malloc( sizeof(struct AdfFileExtBlock) );
-                    if ( file->currentExt == NULL ) {
-                        adfEnv.eFct( "%s: malloc", __func__ );
-                        return ADF_RC_MALLOC;
-                    }
-                }
+    adfFileBlockMapSet_( &file->dataBlockMap, file->nDataBlock, nSect );
+    file->curDataPtr = nSect;
+    file->nDataBlock++;
 
-                rc = adfReadFileExtBlock( file->volume,
-                                          file->fileHdr->extension,
-                                          file->currentExt );
-                if ( rc != ADF_RC_OK ) {
-                    adfEnv.eFct( "%s: error reading ext block %d",
-                                 __func__, file->fileHdr->extension );
-                    return rc;
-                }
+    return rc;
+}
 
-                file->posInExtBlk = 0;
-            }
-            else if ( file->posInExtBlk == ADF_MAX_DATABLK ) {
 
-                rc = adfReadFileExtBlock( file->volume,
-                                          file->currentExt->extension,
-                                          file->currentExt );
-                if ( rc != ADF_RC_OK ) {
-                    adfEnv.eFct( "%s: error reading ext block %d",
-                                 __func__, file->currentExt->extension );
-                    return rc;
-                }
+/*
+ * adfFileReadNextBlockFFS_
+ *
+ */
+static ADF_RETCODE adfFileReadNextBlockFFS_( struct AdfFile * const  file )
+{
+    if ( file->nDataBlock < ADF_MAX_DATABLK )
+        return adfFileReadBlockAt_(
+            file, file->fileHdr->dataBlocks[ ADF_MAX_DATABLK - 1 - file->nDataBlock ] );
 
-                file->posInExtBlk = 0;
+    ADF_RETCODE rc;
+    if ( file->nDataBlock == ADF_MAX_DATABLK ) {
+
+        if ( file->currentExt == NULL ) {
+            file->currentExt = (struct AdfFileExtBlock *)
+                malloc( sizeof(struct AdfFileExtBlock) );
+            if ( file->currentExt == NULL ) {
+                adfEnv.eFct( "%s: malloc", __func__ );
+                return ADF_RC_MALLOC;
             }
-            nSect = file->currentExt->dataBlocks[ ADF_MAX_DATABLK - 1 - file->posInExtBlk ];
-            file->posInExtBlk++;
         }
+
+        rc = adfFileReadExtBlock_( file, file->fileHdr->extension,
+                                   file->currentExt );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: error reading ext block %d",
+                         __func__, file->fileHdr->extension );
+            return rc;
+        }
+        adfFileBlockMapAddExt_( file, 0, file->currentExt );
+
+        file->posInExtBlk = 0;
     }
+    else if ( file->posInExtBlk == ADF_MAX_DATABLK ) {
 
-    if ( nSect < 2 ) {
-        adfEnv.eFct( "%s: invalid data block address %u ( 0x%x ), "
-                     "data block %u, file '%s'",
-                     __func__, nSect, nSect,
-                     file->nDataBlock, file->fileHdr->fileName );
-        //printBacktrace();
-        return ADF_RC_ERROR;
+        rc = adfFileReadExtBlock_( file, file->currentExt->extension,
+                                   file->currentExt );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: error reading ext block %d",
+                         __func__, file->currentExt->extension );
+            return rc;
+        }
+        adfFileBlockMapAddExt_( file,
+                                file->nDataBlock / ADF_MAX_DATABLK - 1,
+                                file->currentExt );
+
+        file->posInExtBlk = 0;
     }
 
-    rc = adfReadDataBlock( file->volume, nSect, file->currentData );
-    if ( rc != ADF_RC_OK )
-        adfEnv.eFct( "%s: error reading data block %d / %d, file '%s'",
-                     __func__, file->nDataBlock, nSect, file->fileHdr->fileName );
+    const ADF_SECTNUM nSect =
+        file->currentExt->dataBlocks[ ADF_MAX_DATABLK - 1 - file->posInExtBlk ];
+    file->posInExtBlk++;
+
+    return adfFileReadBlockAt_( file, nSect );
+}
+
+
+/*
+ * adfFileReadNextBlockOFS_
+ *
+ */
+static ADF_RETCODE adfFileReadNextBlockOFS_( struct AdfFile * const  file )
+{
+    const struct AdfOFSDataBlock * const data =
+        (struct AdfOFSDataBlock *) file->currentData;
 
-    if ( adfVolIsOFS( file->volume ) &&
-         data->seqNum != file->nDataBlock + 1 )
+    const ADF_SECTNUM nSect = ( file->nDataBlock == 0 ) ?
+        file->fileHdr->firstData :
+        data->nextData;
+
+    const ADF_RETCODE rc = adfFileReadBlockAt_( file, nSect );
+    if ( rc == ADF_RC_OK &&
+         data->seqNum != file->nDataBlock )
     {
         adfEnv.wFct( "%s: seqnum incorrect", __func__ );
     }
-
-    file->curDataPtr = nSect;
-    file->nDataBlock++;
-
     return rc;
 }
 
 
 /*
- * adfCreateNextFileBlock
+ * adfFileAllocNextBlock_
  *
+ * allocate a new data block (and, if necessary, a new ext. block)
+ * and update the block pointers in the file header / ext. block
  */
-static ADF_RETCODE adfFileCreateNextBlock( struct AdfFile * const  file )
+static ADF_RETCODE adfFileAllocNextBlock_( struct AdfFile * const  file,
+                                           ADF_SECTNUM * const     nSectNew )
 {
-/*puts("adfCreateNextFileBlock");*/
-    unsigned int blockSize = file->volume->datablockSize;
+    /* make room for the new blocks in the block maps (before allocating
+       anything, so that updating the maps below cannot fail) */
+    if ( adfFileBlockMapReserve_( &file->dataBlockMap,
+                                  file->nDataBlock + 1 ) != ADF_RC_OK ||
+         adfFileBlockMapReserve_( &file->extBlockMap,
+                                  file->nDataBlock / ADF_MAX_DATABLK ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
 
     ADF_SECTNUM nSect;
     /* the first data blocks pointers are inside the file header block */
@@ -1072,6 +1513,9 @@ static ADF_RETCODE adfFileCreateNextBlock( struct AdfFile * const  file )
             if ( extSect == -1 )
                 return ADF_RC_VOLFULL;
 
+            adfFileBlockMapSet_( &file->extBlockMap,
+                                 file->nDataBlock / ADF_MAX_DATABLK - 1, extSect );
+
             /* the future block is the first file extension block */
             if ( file->nDataBlock == ADF_MAX_DATABLK ) {
                 file->currentExt = (struct AdfFileExtBlock *)
@@ -1111,36 +1555,37 @@ static ADF_RETCODE adfFileCreateNextBlock( struct AdfFile * const  file )
 
         file->currentExt->dataBlocks[ ADF_MAX_DATABLK - 1 - file->posInExtBlk ] = nSect;
         file->currentExt->highSeq++;
+        file->currentExtChanged = true;
         file->posInExtBlk++;
     }
 
-    /* builds OFS header */
-    if ( adfVolIsOFS( file->volume ) ) {
-        /* writes previous data block and link it  */
-        struct AdfOFSDataBlock * const data = file->currentData;
-        if ( file->pos >= blockSize ) {
-            data->nextData = nSect;
-            adfWriteDataBlock( file->volume,
-                               file->curDataPtr,
-                               file->currentData );
+    adfFileBlockMapSet_( &file->dataBlockMap, file->nDataBlock, nSect );
+
+    *nSectNew = nSect;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfFileCreateNextBlockFFS_
+ *
+ */
+static ADF_RETCODE adfFileCreateNextBlockFFS_( struct AdfFile * const  file )
+{
+/*puts("adfCreateNextFileBlock");*/
+    ADF_SECTNUM nSect;
+    ADF_RETCODE rc = adfFileAllocNextBlock_( file, &nSect );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    /* write the previous (full) data block */
+    if ( file->pos >= file->volume->datablockSize ) {
+        adfWriteDataBlock( file->volume,
+                           file->curDataPtr,
+                           file->currentData );
 /*printf ("writedata=%d\n",file->curDataPtr);*/
-        }
-        /* initialize a new data block */
-        for ( unsigned i = 0 ; i < blockSize ; i++ )
-            data->data[ i ] = 0;
-        data->seqNum    = file->nDataBlock+1;
-        data->dataSize  = 0;
-        data->nextData  = 0L;
-        data->headerKey = file->fileHdr->headerKey;
     }
-    else
-        if ( file->pos >= blockSize ) {
-            adfWriteDataBlock( file->volume,
-                               file->curDataPtr,
-                               file->currentData );
-/*printf ("writedata=%d\n",file->curDataPtr);*/
-            memset( file->currentData, 0, 512 );
-        }
+    memset( file->currentData, 0, 512 );
 
 /*printf("datablk=%d\n",nSect);*/
     file->curDataPtr = nSect;
@@ -1151,23 +1596,137 @@ static ADF_RETCODE adfFileCreateNextBlock( struct AdfFile * const  file )
 
 
 /*
- * adfFileSeek
+ * adfFileCreateNextBlockOFS_
  *
  */
-
-static ADF_RETCODE adfFileSeekStart_( struct AdfFile * const  file )
+static ADF_RETCODE adfFileCreateNextBlockOFS_( struct AdfFile * const  file )
 {
-    file->pos          = 0;
-    file->posInExtBlk  = 0;
-    file->posInDataBlk = 0;
-    file->nDataBlock   = 0;
+/*puts("adfCreateNextFileBlock");*/
+    ADF_SECTNUM nSect;
+    ADF_RETCODE rc = adfFileAllocNextBlock_( file, &nSect );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    /* write the previous (full) data block and link it */
+    struct AdfOFSDataBlock * const data = file->currentData;
+    const unsigned blockSize = file->volume->datablockSize;
+    if ( file->pos >= blockSize ) {
+        data->nextData = nSect;
+        data->dataSize = blockSize;
+        adfWriteDataBlock( file->volume,
+                           file->curDataPtr,
+                           file->currentData );
+/*printf ("writedata=%d\n",file->curDataPtr);*/
+    }
+
+    /* initialize a new data block */
+    memset( data->data, 0, blockSize );
+    data->seqNum    = file->nDataBlock + 1;
+    data->dataSize  = 0;
+    data->nextData  = 0L;
+    data->headerKey = file->fileHdr->headerKey;
+
+/*printf("datablk=%d\n",nSect);*/
+    file->curDataPtr = nSect;
+    file->nDataBlock++;
+
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfFileWriteDataBlockFFS_
+ *
+ * write the current data block
+ */
+static ADF_RETCODE adfFileWriteDataBlockFFS_( struct AdfFile * const  file )
+{
+    return adfWriteDataBlock( file->volume,
+                              file->curDataPtr,
+                              file->currentData );
+}
+
+
+/*
+ * adfFileWriteDataBlockOFS_
+ *
+ * update the header (data size - as stored in the block, according
+ * to the file size) and write the current data block
+ */
+static ADF_RETCODE adfFileWriteDataBlockOFS_( struct AdfFile * const  file )
+{
+    struct AdfOFSDataBlock * const data =
+        (struct AdfOFSDataBlock *) file->currentData;
+    const unsigned blockSize  = file->volume->datablockSize;
+    const uint32_t blockStart = ( file->nDataBlock - 1 ) * blockSize;
+
+    assert( file->nDataBlock > 0 );
+    data->dataSize = ( file->fileHdr->byteSize > blockStart ) ?
+        min( file->fileHdr->byteSize - blockStart, blockSize ) : 0;
+
+    return adfWriteDataBlock( file->volume,
+                              file->curDataPtr,
+                              file->currentData );
+}
+
+
+/*
+ * adfFileInitDataBlockFFS_
+ *
+ */
+static void adfFileInitDataBlockFFS_( const struct AdfFile * const  file,
+                                      const unsigned                nDataBlock,
+                                      const ADF_SECTNUM             nextData,
+                                      void * const                  data )
+{
+    (void) file;
+    (void) nDataBlock;
+    (void) nextData;
+    memset( data, 0, 512 );
+}
+
+
+/*
+ * adfFileInitDataBlockOFS_
+ *
+ * initialize the header (as for a block of the file with its current size)
+ */
+static void adfFileInitDataBlockOFS_( const struct AdfFile * const  file,
+                                      const unsigned                nDataBlock,
+                                      const ADF_SECTNUM             nextData,
+                                      void * const                  data )
+{
+    struct AdfOFSDataBlock * const block = (struct AdfOFSDataBlock *) data;
+    const unsigned blockSize  = file->volume->datablockSize;
+    const uint32_t blockStart = nDataBlock * blockSize;
+
+    memset( block, 0, sizeof(struct AdfOFSDataBlock) );
+    block->headerKey = file->fileHdr->headerKey;
+    block->seqNum    = nDataBlock + 1;
+    block->dataSize  = ( file->fileHdr->byteSize > blockStart ) ?
+        min( file->fileHdr->byteSize - blockStart, blockSize ) : 0;
+    block->nextData  = nextData;
+}
+
+
+/*
+ * adfFileSeek
+ *
+ */
+
+static ADF_RETCODE adfFileSeekStart_( struct AdfFile * const  file )
+{
+    file->pos          = 0;
+    file->posInExtBlk  = 0;
+    file->posInDataBlk = 0;
+    file->nDataBlock   = 0;
     file->curDataPtr   = 0;
 
     if ( file->fileHdr->byteSize == 0 )
         // an empty file - no data block to read
         return ADF_RC_OK;
 
-    ADF_RETCODE rc = adfFileReadNextBlock( file );
+    ADF_RETCODE rc = file->ops->readNextBlock( file );
     if ( rc != ADF_RC_OK ) {
         file->curDataPtr = 0;  // invalidate data ptr
     }
@@ -1200,10 +1759,6 @@ static ADF_RETCODE adfFileSeekEOF_( struct AdfFile * const  file )
 static ADF_RETCODE adfFileSeekOFS_( struct AdfFile * const  file,
                                     uint32_t                pos )
 {
-    adfFileSeekStart_( file );
-
-    unsigned blockSize = file->volume->datablockSize;
-
     file->pos = min( pos, file->fileHdr->byteSize );
 
     // EOF?
@@ -1211,23 +1766,38 @@ static ADF_RETCODE adfFileSeekOFS_( struct AdfFile * const  file,
         return adfFileSeekEOF_( file );
     }
 
-    uint32_t offset = 0;
-    while ( offset < pos ) {
-        unsigned size       = min( pos - offset,
-                                   (unsigned) ( blockSize - file->posInDataBlk ) );
-        file->pos          += size;
-        offset             += size;
-        file->posInDataBlk += size;
-        if ( file->posInDataBlk == blockSize && offset < pos ) {
-            if ( adfFileReadNextBlock ( file ) != ADF_RC_OK ) {
-                adfEnv.eFct( "%s: error reading next data block, pos %d",
-                             __func__, file->pos );
-                file->curDataPtr = 0;  // invalidate data ptr
-                return ADF_RC_ERROR;
-            }
-            file->posInDataBlk = 0;
-        }
+    const unsigned blockSize     = file->volume->datablockSize;
+    const unsigned nDataBlockReq = file->pos / blockSize;
+
+    // start from the requested or the farthest already known (mapped) block
+    // before it, then follow the data blocks chain (mapping the blocks read)
+    const unsigned nDataBlockStart =
+        ( file->dataBlockMap.nItems > 0 ) ?
+        min( nDataBlockReq, file->dataBlockMap.nItems - 1 ) : 0;
+    const ADF_SECTNUM nSect = ( file->dataBlockMap.nItems > 0 ) ?
+        file->dataBlockMap.sectors[ nDataBlockStart ] :
+        file->fileHdr->firstData;
+
+    file->posInExtBlk = 0;
+    file->curDataPtr  = nSect;
+    file->nDataBlock  = nDataBlockStart + 1;
+    ADF_RETCODE rc = ( nSect < 2 ) ?
+        ADF_RC_ERROR :
+        adfFileReadDataBlock_( file, nDataBlockStart, nSect );
+    if ( rc == ADF_RC_OK )
+        adfFileBlockMapSet_( &file->dataBlockMap, nDataBlockStart, nSect );
+
+    while ( rc == ADF_RC_OK && file->nDataBlock <= nDataBlockReq )
+        rc = file->ops->readNextBlock( file );
+
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error reading data block, pos %d, file '%s'",
+                     __func__, file->pos, file->fileHdr->fileName );
+        file->curDataPtr = 0;  // invalidate data ptr
+        return ADF_RC_ERROR;
     }
+
+    file->posInDataBlk = file->pos % blockSize;
     return ADF_RC_OK;
 }
 
@@ -1246,29 +1816,44 @@ static ADF_RETCODE adfFileSeekExt_( struct AdfFile * const  file,
                                                  &file->posInExtBlk,
                                                  &file->posInDataBlk,
                                                  &file->nDataBlock );
-    if ( extBlock == -1 ) {
-        file->curDataPtr = file->fileHdr->dataBlocks[
-            ADF_MAX_DATABLK - 1 - file->nDataBlock ];
-    } else {
+
+    if ( extBlock != -1 && ! file->currentExt ) {
+        file->currentExt = ( struct AdfFileExtBlock * )
+            malloc( sizeof ( struct AdfFileExtBlock ) );
         if ( ! file->currentExt ) {
-            file->currentExt = ( struct AdfFileExtBlock * )
-                malloc( sizeof ( struct AdfFileExtBlock ) );
-            if ( ! file->currentExt ) {
-                adfEnv.eFct( "%s: malloc", __func__ );
-                file->curDataPtr = 0;  // invalidate data ptr
-                return ADF_RC_MALLOC;
-            }
+            adfEnv.eFct( "%s: malloc", __func__ );
+            file->curDataPtr = 0;  // invalidate data ptr
+            return ADF_RC_MALLOC;
         }
+        file->currentExt->headerKey = 0;
+    }
+
+    // get the data block sector (reading ext. blocks not mapped yet, if any,
+    // to the current ext. block buffer)
+    ADF_RETCODE rc = adfFileBlockMapFind_( file, file->nDataBlock,
+                                           file->currentExt, &file->curDataPtr );
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: cannot find data block %u, pos %u, file '%s'",
+                     __func__, file->nDataBlock, file->pos,
+                     file->fileHdr->fileName );
+        file->curDataPtr = 0;  // invalidate data ptr
+        return rc;
+    }
 
-        if ( adfFileReadExtBlockN( file, extBlock, file->currentExt ) != ADF_RC_OK )  {
+    if ( extBlock != -1 ) {
+        // the current ext. block must be the one containing the data block
+        // (read only if another one is loaded)
+        const ADF_SECTNUM extSect = file->extBlockMap.sectors[ extBlock ];
+        if ( file->currentExt->headerKey != extSect &&
+             adfFileReadExtBlock_( file, extSect,
+                                   file->currentExt ) != ADF_RC_OK )
+        {
             adfEnv.eFct( "%s: error reading ext block 0x%x(%d), file '%s'",
                          __func__, extBlock, extBlock, file->fileHdr->fileName );
+            file->currentExt->headerKey = 0;
             file->curDataPtr = 0;  // invalidate data ptr
             return ADF_RC_ERROR;
         }
-
-        file->curDataPtr = file->currentExt->dataBlocks [
-            ADF_MAX_DATABLK - 1 - file->posInExtBlk ];
         file->posInExtBlk++;
     }
 
@@ -1276,12 +1861,11 @@ static ADF_RETCODE adfFileSeekExt_( struct AdfFile * const  file,
         // a data block can never be at 0-1 (bootblock)
         adfEnv.eFct( "%s: invalid data block address (%u), pos %u, file '%s'",
                      __func__, file->curDataPtr, file->pos, file->fileHdr->fileName );
+        file->curDataPtr = 0;  // invalidate data ptr
         return ADF_RC_ERROR;
     }
 
-    ADF_RETCODE rc = adfReadDataBlock( file->volume,
-                                       file->curDataPtr,
-                                       file->currentData );
+    rc = adfFileReadDataBlock_( file, file->nDataBlock, file->curDataPtr );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error reading data block %d, file '%s'",
                      __func__, file->curDataPtr, file->fileHdr->fileName );
@@ -1324,6 +1908,1032 @@ static unsigned adfFileWriteFilled( struct AdfFile * const  file,
 }
 
 
+/*
+ * adfFileAppend
+ *
+ * append size bytes (from source or, if it is NULL, zeros) to the file
+ *
+ * all new (data and ext.) blocks are allocated at once, block pointers are
+ * set in memory (in the file header and ext. blocks, each written once)
+ * and the new data blocks are written in runs of consecutive blocks
+ * (for FFS zeros - from a block of zeros shared by all files)
+ *
+ * the file position is left at the new EOF
+ */
+#define ADF_FILE_ZERO_RUN  64
+
+static const uint8_t adfFileZeroBlocks_[ ADF_FILE_ZERO_RUN * 512 ];
+
+ADF_RETCODE adfFileAppend( struct AdfFile * const  file,
+                           const uint32_t          size,
+                           AdfFileDataSource       source,
+                           void * const            ctx )
+{
+    if ( ! file->modeWrite )
+        return ADF_RC_ERROR;
+
+    const uint32_t fileSizeNew = file->fileHdr->byteSize + size;
+    if ( fileSizeNew < size ) {
+        adfEnv.eFct( "%s: file size too large", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    ADF_RETCODE rc = adfFileSeekEOF( file );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    // the rest of the last data block is filled through the usual write path
+    struct AdfVolume * const vol = file->volume;
+    const unsigned blockSize  = vol->datablockSize;
+    const unsigned posInBlock = file->pos % blockSize;
+    const uint32_t fillSize   = ( posInBlock == 0 ) ? 0 :
+        min( fileSizeNew - file->pos, blockSize - posInBlock );
+    if ( file->pos + fillSize == fileSizeNew )
+        return ( adfFileAppendTail_( file, fillSize, source, ctx ) == fillSize ) ?
+            ADF_RC_OK : ADF_RC_ERROR;
+
+    const unsigned
+        nDataBlocksOld = adfFileSize2Datablocks( file->pos, blockSize ),
+        nDataBlocksNew = adfFileSize2Datablocks( fileSizeNew, blockSize ),
+        nExtBlocksNew  = adfFileDatablocks2Extblocks( nDataBlocksNew ),
+        nBlocksAdd     = nDataBlocksNew - nDataBlocksOld +
+                         nExtBlocksNew - adfFileDatablocks2Extblocks( nDataBlocksOld );
+
+    // make room in the block maps (so that updating them cannot fail)
+    if ( adfFileBlockMapReserve_( &file->dataBlockMap, nDataBlocksNew ) != ADF_RC_OK ||
+         adfFileBlockMapReserve_( &file->extBlockMap, nExtBlocksNew ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+
+    if ( nExtBlocksNew > 0 && file->currentExt == NULL ) {
+        file->currentExt = (struct AdfFileExtBlock *)
+            malloc( sizeof(struct AdfFileExtBlock) );
+        if ( file->currentExt == NULL ) {
+            adfEnv.eFct( "%s: malloc", __func__ );
+            return ADF_RC_MALLOC;
+        }
+        file->currentExt->headerKey = 0;
+    }
+
+    const bool isOFS = adfVolIsOFS( vol );
+    ADF_SECTNUM * const sectors = malloc( sizeof(ADF_SECTNUM) * nBlocksAdd );
+    const bool          runBufNeeded = isOFS || source != NULL;
+    uint8_t * const     runBuf  = runBufNeeded ? malloc( 512 * ADF_FILE_ZERO_RUN ) : NULL;
+    if ( sectors == NULL || ( runBufNeeded && runBuf == NULL ) ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        rc = ADF_RC_MALLOC;
+        goto free_mem;
+    }
+
+    if ( nBlocksAdd > INT_MAX ||
+         ! adfGetFreeBlocks( vol, (int) nBlocksAdd, sectors ) )
+    {
+        adfEnv.wFct( "%s: no more free sectors available", __func__ );
+        rc = ADF_RC_VOLFULL;
+        goto free_mem;
+    }
+
+    // from now on, a failure frees the new blocks and restores the file
+    struct AdfFileHeaderBlock * const fhdr = file->fileHdr;
+    struct AdfFileExtBlock * const    ext  = file->currentExt;
+    struct AdfFileAppendUndo_ undo;
+    undo.fhdr        = *fhdr;
+    undo.nDataMapped = file->dataBlockMap.nItems;
+    undo.nExtMapped  = file->extBlockMap.nItems;
+    if ( ext != NULL )
+        undo.ext = *ext;
+
+    if ( adfFileAppendTail_( file, fillSize, source, ctx ) != fillSize ) {
+        rc = ADF_RC_ERROR;
+        goto undo_append;
+    }
+
+    // set pointers to the new blocks (in the order of allocation,
+    // as when written sequentially: an ext. block before its data blocks)
+    unsigned iSect = 0;
+    for ( unsigned nDataBlock = nDataBlocksOld ; nDataBlock < nDataBlocksNew ;
+          nDataBlock++ )
+    {
+        if ( nDataBlock >= ADF_MAX_DATABLK && nDataBlock % ADF_MAX_DATABLK == 0 ) {
+            const ADF_SECTNUM extSect = sectors[ iSect++ ];
+            if ( nDataBlock == ADF_MAX_DATABLK ) {
+                fhdr->extension = extSect;
+            } else {
+                // the previous ext. block is complete
+                ext->extension = extSect;
+                rc = adfWriteFileExtBlock( vol, ext->headerKey, ext );
+                if ( rc != ADF_RC_OK )
+                    goto undo_append;
+            }
+            memset( ext->dataBlocks, 0, sizeof(ext->dataBlocks) );
+            ext->headerKey = extSect;
+            ext->parent    = fhdr->headerKey;
+            ext->highSeq   = 0;
+            ext->extension = 0;
+            adfFileBlockMapSet_( &file->extBlockMap,
+                                 nDataBlock / ADF_MAX_DATABLK - 1, extSect );
+        }
+
+        const ADF_SECTNUM nSect = sectors[ iSect++ ];
+        if ( nDataBlock < ADF_MAX_DATABLK ) {
+            if ( nDataBlock == 0 )
+                fhdr->firstData = nSect;
+            fhdr->dataBlocks[ ADF_MAX_DATABLK - 1 - nDataBlock ] = nSect;
+            fhdr->highSeq++;
+        } else {
+            ext->dataBlocks[ ADF_MAX_DATABLK - 1 -
+                             nDataBlock % ADF_MAX_DATABLK ] = nSect;
+            ext->highSeq++;
+        }
+        adfFileBlockMapSet_( &file->dataBlockMap, nDataBlock, nSect );
+    }
+    fhdr->byteSize          = fileSizeNew;
+    file->fileHdrChanged    = true;
+    file->currentExtChanged = ( nExtBlocksNew > 0 );
+
+    // write the new data blocks
+    const ADF_SECTNUM * const dataSects = file->dataBlockMap.sectors;
+    for ( unsigned nDataBlock = nDataBlocksOld, nRun ; nDataBlock < nDataBlocksNew ;
+          nDataBlock += nRun )
+    {
+        nRun = 1;
+        while ( nDataBlock + nRun < nDataBlocksNew &&
+                nRun < ADF_FILE_ZERO_RUN &&
+                dataSects[ nDataBlock + nRun ] ==
+                    dataSects[ nDataBlock ] + (ADF_SECTNUM) nRun )
+            nRun++;
+
+        const uint8_t * buf = adfFileZeroBlocks_;
+        if ( isOFS ) {
+            struct AdfOFSDataBlock block;
+            for ( unsigned i = 0 ; i < nRun ; i++ ) {
+                const unsigned n = nDataBlock + i;
+                file->ops->initDataBlock( file, n, ( n + 1 < nDataBlocksNew ) ?
+                                          dataSects[ n + 1 ] : 0, &block );
+                if ( source != NULL &&
+                     source( ctx, block.data, block.dataSize ) != block.dataSize )
+                {
+                    rc = ADF_RC_ERROR;
+                    goto undo_append;
+                }
+                adfEncodeDataBlock( vol, &block, runBuf + 512 * i );
+            }
+            buf = runBuf;
+        } else if ( source != NULL ) {
+            // FFS: the payload is the whole block, read directly into the run
+            const uint32_t runStart = nDataBlock * blockSize,
+                           runSize  = min( nRun * blockSize, fileSizeNew - runStart );
+            if ( source( ctx, runBuf, runSize ) != runSize ) {
+                rc = ADF_RC_ERROR;
+                goto undo_append;
+            }
+            memset( runBuf + runSize, 0, nRun * blockSize - runSize );
+            buf = runBuf;
+        }
+
+        rc = adfVolWriteBlockRunOfType( vol, (uint32_t) dataSects[ nDataBlock ], nRun,
+                                        buf, ADF_STATS_BLOCK_DATA );
+        if ( rc != ADF_RC_OK )
+            goto undo_append;
+    }
+
+    // link the (previous) last data block, write it, the current ext. block
+    // and the header, then move to the new EOF
+    if ( isOFS && nDataBlocksOld > 0 ) {
+        ( (struct AdfOFSDataBlock *) file->currentData )->nextData =
+            dataSects[ nDataBlocksOld ];
+        file->currentDataBlockChanged = true;
+    }
+    rc = adfFileFlush( file );
+    if ( rc == ADF_RC_OK ) {
+        rc = adfFileSeek( file, fileSizeNew );
+        goto free_mem;
+    }
+
+undo_append:
+    adfEnv.eFct( "%s: error appending to '%s', the file is restored",
+                 __func__, fhdr->fileName );
+    adfFileAppendUndo_( file, &undo, sectors, nBlocksAdd );
+
+free_mem:
+    free( runBuf );
+    free( sectors );
+    return rc;
+}
+
+/*
+ * adfFileAppendTail_
+ *
+ * fill (from source or with zeros) the rest of the last data block
+ */
+static uint32_t adfFileAppendTail_( struct AdfFile * const  file,
+                                    const uint32_t          size,
+                                    AdfFileDataSource       source,
+                                    void * const            ctx )
+{
+    if ( source == NULL )
+        return adfFileWriteFilled( file, 0, size );
+
+    uint8_t buf[ 512 ];
+    assert( size <= sizeof(buf) );
+    if ( source( ctx, buf, size ) != size )
+        return 0;
+    return adfFileWrite( file, size, buf );
+}
+
+
+/*
+ * adfFileAppendUndo_
+ *
+ * free the blocks allocated by a failed append and restore the file (its size,
+ * block pointers and maps) on the disk and in memory
+ */
+static void adfFileAppendUndo_( struct AdfFile * const                   file,
+                                const struct AdfFileAppendUndo_ * const  undo,
+                                ADF_SECTNUM * const                      sectors,
+                                const unsigned                           nSectors )
+{
+    struct AdfVolume * const vol = file->volume;
+    adfFileFreeBlocks_( vol, sectors, nSectors );
+
+    *file->fileHdr = undo->fhdr;
+    file->fileHdrChanged = true;
+    adfFileBlockMapTrim_( &file->dataBlockMap, undo->nDataMapped );
+    adfFileBlockMapTrim_( &file->extBlockMap, undo->nExtMapped );
+
+    const uint32_t fileSize    = undo->fhdr.byteSize;
+    const unsigned nDataBlocks = adfFileSize2Datablocks( fileSize, vol->datablockSize );
+    adfFileDirtyDrop_( file, nDataBlocks );
+
+    // the last ext. block (possibly written with pointers to the new blocks)
+    if ( file->currentExt != NULL ) {
+        if ( adfFileDatablocks2Extblocks( nDataBlocks ) > 0 ) {
+            *file->currentExt = undo->ext;
+            file->currentExtChanged = true;
+        } else {
+            file->currentExt->headerKey = 0;
+            file->currentExtChanged = false;
+        }
+    }
+
+    // the last data block (possibly filled beyond the size)
+    if ( nDataBlocks > 0 ) {
+        if ( adfVolIsOFS( vol ) ) {
+            struct AdfOFSDataBlock * const data =
+                (struct AdfOFSDataBlock *) file->currentData;
+            data->dataSize = ( fileSize % vol->datablockSize == 0 ) ?
+                vol->datablockSize : fileSize % vol->datablockSize;
+            data->nextData = 0;
+        }
+        file->currentDataBlockChanged = true;
+    } else {
+        file->currentDataBlockChanged = false;
+    }
+
+    if ( adfFileFlush( file ) != ADF_RC_OK ||
+         adfFileSeek( file, fileSize ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: error restoring file '%s'", __func__,
+                     file->fileHdr->fileName );
+    }
+}
+
+
+/*
+ * adfFileFreeBlocks_
+ *
+ * mark blocks free (sorted, in runs of consecutive blocks)
+ */
+static void adfFileFreeBlocks_( struct AdfVolume * const  vol,
+                                ADF_SECTNUM * const       sectors,
+                                const unsigned            nSectors )
+{
+    qsort( sectors, nSectors, sizeof(ADF_SECTNUM), adfSectNumCmp_ );
+    for ( unsigned i = 0, nRun ; i < nSectors ; i += nRun ) {
+        const ADF_SECTNUM * const run = &sectors[ i ];
+        nRun = 1;
+        while ( i + nRun < nSectors &&
+                run[ nRun ] == run[ 0 ] + (ADF_SECTNUM) nRun )
+            nRun++;
+        adfSetBlockRangeFree( vol, run[ 0 ], nRun );
+    }
+}
+
+
+static int adfSectNumCmp_( const void * const  a,
+                           const void * const  b )
+{
+    const ADF_SECTNUM sa = *(const ADF_SECTNUM *) a,
+                      sb = *(const ADF_SECTNUM *) b;
+    return ( sa > sb ) - ( sa < sb );
+}
+
+
+/*
+ * adfFileReadDataBlock_
+ *
+ * read data block nDataBlock (of the file) at sector nSect to currentData,
+ * taking it from the read-ahead buffer or, if sequential access is detected,
+ * reading there also the following data blocks
+ */
+static ADF_RETCODE adfFileReadDataBlock_( struct AdfFile * const  file,
+                                          const unsigned          nDataBlock,
+                                          const ADF_SECTNUM       nSect )
+{
+    struct AdfFileReadAhead * const ra = &file->readAhead;
+    file->stats.blocksRead++;
+
+    // a changed block (not written yet) becomes the current one, still changed
+    file->currentDataBlockChanged = false;
+    const struct AdfFileDirtyBlock * const dirty =
+        adfFileDirtyFind_( file, nDataBlock );
+    if ( dirty != NULL && dirty->nSect == nSect ) {
+        memcpy( file->currentData, dirty->data, 512 );
+        file->currentDataBlockChanged = true;
+        adfFileDirtyRemove_( file, dirty );
+        return ADF_RC_OK;
+    }
+
+    if ( file->modeWrite || ra->windowMax == 0 )
+        return adfReadDataBlock( file->volume, nSect, file->currentData );
+
+    // adapt the window to the access pattern
+    const bool sequential = ( nDataBlock == ra->next );
+    if ( sequential ) {
+        if ( ra->window < ra->windowMin )
+            ra->window = ra->windowMin;
+    } else {
+        ra->window /= 2;
+        if ( ra->window < ra->windowMin )
+            ra->window = 0;
+    }
+    ra->next = nDataBlock + 1;
+
+    if ( nDataBlock >= ra->first &&
+         nDataBlock < ra->first + ra->nBlocks &&
+         file->dataBlockMap.sectors[ nDataBlock ] == nSect )
+    {
+        file->stats.blocksReadAhead++;
+        return adfDecodeDataBlock( file->volume, nSect,
+                                   ra->bufs[ nDataBlock - ra->first ],
+                                   file->currentData );
+    }
+
+    if ( ! sequential || ra->window == 0 )
+        return adfReadDataBlock( file->volume, nSect, file->currentData );
+
+    // the blocks to read - only those mapped (with known sectors;
+    // the following ext. block is read here, if necessary)
+    const unsigned nDataBlocksFile = adfFileSize2Datablocks(
+        file->fileHdr->byteSize, file->volume->datablockSize );
+    unsigned nBlocks = min( ra->window, nDataBlocksFile - nDataBlock );
+    if ( ra->ext == NULL ) {
+        ra->ext = malloc( sizeof(struct AdfFileExtBlock) );
+        if ( ra->ext != NULL )
+            ra->ext->headerKey = 0;
+    }
+    ADF_SECTNUM nSectLast;
+    adfFileBlockMapFind_( file, nDataBlock + nBlocks - 1, ra->ext, &nSectLast );
+    nBlocks = ( nDataBlock < file->dataBlockMap.nItems ) ?
+        min( nBlocks, file->dataBlockMap.nItems - nDataBlock ) : 0;
+    if ( nBlocks < 2 ||
+         file->dataBlockMap.sectors[ nDataBlock ] != nSect )
+    {
+        return adfReadDataBlock( file->volume, nSect, file->currentData );
+    }
+
+    if ( nBlocks > ra->capacity ) {
+        uint8_t * const buffer = realloc( ra->buffer, 512 * nBlocks );
+        if ( buffer != NULL )
+            ra->buffer = buffer;
+        uint8_t ** const bufs = realloc( ra->bufs, sizeof(uint8_t *) * nBlocks );
+        if ( bufs != NULL )
+            ra->bufs = bufs;
+        if ( buffer == NULL || bufs == NULL ) {
+            ra->nBlocks = 0;
+            return adfReadDataBlock( file->volume, nSect, file->currentData );
+        }
+        ra->capacity = nBlocks;
+    }
+    for ( unsigned i = 0 ; i < nBlocks ; i++ )
+        ra->bufs[ i ] = ra->buffer + 512 * i;
+
+    ra->first   = nDataBlock;
+    ra->nBlocks = 0;
+    ADF_RETCODE rc = adfVolReadBlocksOfType(
+        file->volume, nBlocks,
+        (const uint32_t *) &file->dataBlockMap.sectors[ nDataBlock ], ra->bufs,
+        ADF_STATS_BLOCK_DATA );
+    if ( rc != ADF_RC_OK )
+        return adfReadDataBlock( file->volume, nSect, file->currentData );
+
+    ra->nBlocks = nBlocks;
+    file->stats.readAheads++;
+    file->stats.blocksPrefetched += nBlocks;
+    file->stats.blocksReadAhead++;
+
+    // sequential access continues - next time read more
+    ra->window = min( 2 * ra->window, ra->windowMax );
+
+    return adfDecodeDataBlock( file->volume, nSect, ra->bufs[ 0 ],
+                               file->currentData );
+}
+
+
+/*
+ * adfFileReadExtBlock_
+ *
+ */
+static ADF_RETCODE adfFileReadExtBlock_( struct AdfFile * const          file,
+                                         const ADF_SECTNUM               nSect,
+                                         struct AdfFileExtBlock * const  fext )
+{
+    // already read by read-ahead?
+    const struct AdfFileExtBlock * const extReadAhead = file->readAhead.ext;
+    if ( extReadAhead != NULL &&
+         extReadAhead->headerKey == nSect &&
+         ! file->modeWrite )
+    {
+        memcpy( fext, extReadAhead, sizeof(struct AdfFileExtBlock) );
+        return ADF_RC_OK;
+    }
+    return adfReadFileExtBlock( file->volume, nSect, fext );
+}
+
+
+static void adfFileReadAheadFree_( struct AdfFileReadAhead * const  ra )
+{
+    free( ra->buffer );
+    free( ra->bufs );
+    free( ra->ext );
+    ra->buffer   = NULL;
+    ra->bufs     = NULL;
+    ra->ext      = NULL;
+    ra->capacity = 0;
+    ra->nBlocks  = 0;
+}
+
+
+/*
+ * adfFileWriteCurrentExt_
+ *
+ * write the current ext. block (if changed)
+ */
+static ADF_RETCODE adfFileWriteCurrentExt_( struct AdfFile * const  file )
+{
+    if ( ! file->currentExtChanged || file->currentExt == NULL )
+        return ADF_RC_OK;
+
+    const ADF_RETCODE rc = adfWriteFileExtBlock( file->volume,
+                                                 file->currentExt->headerKey,
+                                                 file->currentExt );
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error writing ext block 0x%x (%d), file '%s'",
+                     __func__, file->currentExt->headerKey,
+                     file->currentExt->headerKey, file->fileHdr->fileName );
+        return rc;
+    }
+    file->currentExtChanged = false;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfFileDirtyStash_
+ *
+ * keep the changed current data block in the dirty set (to be written later)
+ */
+static ADF_RETCODE adfFileDirtyStash_( struct AdfFile * const  file )
+{
+    if ( ! file->currentDataBlockChanged || file->curDataPtr == 0 )
+        return ADF_RC_OK;
+
+    struct AdfFileDirtyBlocks * const set = &file->dirtyBlocks;
+    if ( set->blocks == NULL ) {
+        set->blocks = malloc( sizeof(struct AdfFileDirtyBlock) * ADF_FILE_DIRTY_MAX );
+        if ( set->blocks == NULL ) {
+            // just write it
+            const ADF_RETCODE rc = file->ops->writeDataBlock( file );
+            if ( rc == ADF_RC_OK )
+                file->currentDataBlockChanged = false;
+            return rc;
+        }
+    }
+
+    if ( set->nItems == ADF_FILE_DIRTY_MAX ) {
+        const ADF_RETCODE rc = adfFileDirtyWriteBack_( file );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+
+    struct AdfFileDirtyBlock * const dirty = &set->blocks[ set->nItems++ ];
+    dirty->nDataBlock = file->nDataBlock - 1;
+    dirty->nSect      = file->curDataPtr;
+    memcpy( dirty->data, file->currentData, 512 );
+
+    file->currentDataBlockChanged = false;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfFileDirtyWriteBack_
+ *
+ * write all blocks of the dirty set, sorted by sector, in runs
+ * of consecutive sectors
+ */
+static ADF_RETCODE adfFileDirtyWriteBack_( struct AdfFile * const  file )
+{
+    struct AdfFileDirtyBlocks * const set = &file->dirtyBlocks;
+    if ( set->nItems == 0 )
+        return ADF_RC_OK;
+
+    struct AdfVolume * const vol = file->volume;
+    const unsigned blockSize = vol->datablockSize;
+    const bool     isOFS     = adfVolIsOFS( vol );
+
+    qsort( set->blocks, set->nItems, sizeof(struct AdfFileDirtyBlock),
+           adfFileDirtyCmpSect_ );
+
+    uint8_t  runBuf[ 512 * ADF_FILE_DIRTY_MAX ];
+    ADF_RETCODE rc = ADF_RC_OK;
+    for ( unsigned i = 0, nRun ; i < set->nItems ; i += nRun ) {
+        struct AdfFileDirtyBlock * const run = &set->blocks[ i ];
+        nRun = 1;
+        while ( i + nRun < set->nItems &&
+                run[ nRun ].nSect == run[ 0 ].nSect + (ADF_SECTNUM) nRun )
+            nRun++;
+
+        for ( unsigned j = 0 ; j < nRun ; j++ ) {
+            if ( isOFS ) {
+                // the data size - according to the current file size
+                struct AdfOFSDataBlock * const data =
+                    (struct AdfOFSDataBlock *) run[ j ].data;
+                const uint32_t blockStart = run[ j ].nDataBlock * blockSize;
+                data->dataSize = ( file->fileHdr->byteSize > blockStart ) ?
+                    min( file->fileHdr->byteSize - blockStart, blockSize ) : 0;
+            }
+            adfEncodeDataBlock( vol, run[ j ].data, runBuf + 512 * j );
+        }
+
+        rc = adfVolWriteBlockRunOfType( vol, (uint32_t) run[ 0 ].nSect, nRun, runBuf,
+                                        ADF_STATS_BLOCK_DATA );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: error writing data blocks %d-%d, file '%s'",
+                         __func__, run[ 0 ].nSect, run[ nRun - 1 ].nSect,
+                         file->fileHdr->fileName );
+            // keep the blocks not written
+            memmove( set->blocks, run,
+                     sizeof(struct AdfFileDirtyBlock) * ( set->nItems - i ) );
+            set->nItems -= i;
+            return rc;
+        }
+    }
+
+    set->nItems = 0;
+    return ADF_RC_OK;
+}
+
+
+static const struct AdfFileDirtyBlock * adfFileDirtyFind_(
+    const struct AdfFile * const  file,
+    const unsigned                nDataBlock )
+{
+    const struct AdfFileDirtyBlocks * const set = &file->dirtyBlocks;
+    for ( unsigned i = 0 ; i < set->nItems ; i++ )
+        if ( set->blocks[ i ].nDataBlock == nDataBlock )
+            return &set->blocks[ i ];
+    return NULL;
+}
+
+
+static void adfFileDirtyRemove_( struct AdfFile * const                  file,
+                                 const struct AdfFileDirtyBlock * const  dirty )
+{
+    struct AdfFileDirtyBlocks * const set = &file->dirtyBlocks;
+    const unsigned i = (unsigned) ( dirty - set->blocks );
+    set->nItems--;
+    if ( i != set->nItems )
+        memcpy( &set->blocks[ i ], &set->blocks[ set->nItems ],
+                sizeof(struct AdfFileDirtyBlock) );
+}
+
+
+/*
+ * adfFileDirtyDrop_
+ *
+ * forget changes of data blocks from nDataBlocks (removed from the file)
+ */
+static void adfFileDirtyDrop_( struct AdfFile * const  file,
+                               const unsigned          nDataBlocks )
+{
+    struct AdfFileDirtyBlocks * const set = &file->dirtyBlocks;
+    for ( unsigned i = set->nItems ; i > 0 ; i-- )
+        if ( set->blocks[ i - 1 ].nDataBlock >= nDataBlocks )
+            adfFileDirtyRemove_( file, &set->blocks[ i - 1 ] );
+}
+
+
+static int adfFileDirtyCmpSect_( const void * const  a,
+                                 const void * const  b )
+{
+    const ADF_SECTNUM sa = ( (const struct AdfFileDirtyBlock *) a )->nSect,
+                      sb = ( (const struct AdfFileDirtyBlock *) b )->nSect;
+    return ( sa > sb ) - ( sa < sb );
+}
+
+
+/*
+ * adfIoVec*
+ *
+ */
+static uint32_t adfIoVecLength_( const struct AdfIoVec * const  iov,
+                                 const unsigned                 iovcnt )
+{
+    uint32_t len = 0;
+    for ( unsigned i = 0 ; i < iovcnt ; i++ )
+        len = ( iov[ i ].len > UINT32_MAX - len ) ? UINT32_MAX : len + iov[ i ].len;
+    return len;
+}
+
+/* copy len bytes from data to the buffers */
+static void adfIoVecScatter_( struct AdfIoVecCursor_ * const  cur,
+                              const uint8_t *                 data,
+                              uint32_t                        len )
+{
+    while ( len > 0 && cur->index < cur->iovcnt ) {
+        const struct AdfIoVec * const v = &cur->iov[ cur->index ];
+        const uint32_t size = min( len, v->len - cur->offset );
+        memcpy( (uint8_t *) v->base + cur->offset, data, size );
+        data        += size;
+        len         -= size;
+        cur->offset += size;
+        if ( cur->offset == v->len ) {
+            cur->index++;
+            cur->offset = 0;
+        }
+    }
+}
+
+/* copy len bytes from the buffers to data */
+static void adfIoVecGather_( struct AdfIoVecCursor_ * const  cur,
+                             uint8_t *                       data,
+                             uint32_t                        len )
+{
+    while ( len > 0 && cur->index < cur->iovcnt ) {
+        const struct AdfIoVec * const v = &cur->iov[ cur->index ];
+        const uint32_t size = min( len, v->len - cur->offset );
+        memcpy( data, (const uint8_t *) v->base + cur->offset, size );
+        data        += size;
+        len         -= size;
+        cur->offset += size;
+        if ( cur->offset == v->len ) {
+            cur->index++;
+            cur->offset = 0;
+        }
+    }
+}
+
+
+/*
+ * adfFileGetDataBlockSectors
+ *
+ * get sectors of nBlocks data blocks of the file, starting from first,
+ * without modifying the file (blocks not in the block map are taken
+ * from the file header or ext. blocks read here)
+ */
+ADF_RETCODE adfFileGetDataBlockSectors( const struct AdfFile * const  file,
+                                        const unsigned                first,
+                                        const unsigned                nBlocks,
+                                        ADF_SECTNUM * const           sectors )
+{
+    const struct AdfFileHeaderBlock * const fhdr   = file->fileHdr;
+    const struct AdfFileBlockMap * const    map    = &file->dataBlockMap,
+                                 * const    extMap = &file->extBlockMap;
+    struct AdfFileExtBlock fext;
+    unsigned extIndex = UINT_MAX;   // index of the ext. block in fext
+
+    for ( unsigned i = 0 ; i < nBlocks ; i++ ) {
+        const unsigned nDataBlock = first + i;
+        if ( nDataBlock < map->nItems ) {
+            sectors[ i ] = map->sectors[ nDataBlock ];
+            continue;
+        }
+        if ( nDataBlock < ADF_MAX_DATABLK ) {
+            sectors[ i ] = fhdr->dataBlocks[ ADF_MAX_DATABLK - 1 - nDataBlock ];
+            continue;
+        }
+
+        // follow the chain of ext. blocks (from the farthest one known)
+        const unsigned extIndexReq = nDataBlock / ADF_MAX_DATABLK - 1;
+        while ( extIndex != extIndexReq ) {
+            unsigned    extIndexNext;
+            ADF_SECTNUM extSect;
+            if ( extIndexReq < extMap->nItems ) {
+                extIndexNext = extIndexReq;
+                extSect      = extMap->sectors[ extIndexReq ];
+            } else if ( extIndex != UINT_MAX && extIndex + 1 >= extMap->nItems ) {
+                extIndexNext = extIndex + 1;
+                extSect      = fext.extension;
+            } else if ( extMap->nItems > 0 ) {
+                extIndexNext = extMap->nItems - 1;
+                extSect      = extMap->sectors[ extIndexNext ];
+            } else {
+                extIndexNext = 0;
+                extSect      = fhdr->extension;
+            }
+
+            if ( extSect < 2 )
+                return ADF_RC_ERROR;
+            ADF_RETCODE rc = adfReadFileExtBlock( file->volume, extSect, &fext );
+            if ( rc != ADF_RC_OK )
+                return rc;
+            extIndex = extIndexNext;
+        }
+
+        sectors[ i ] = fext.dataBlocks[ ADF_MAX_DATABLK - 1 -
+                                        nDataBlock % ADF_MAX_DATABLK ];
+        if ( sectors[ i ] < 2 )
+            return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfFileOverwrite_
+ *
+ * overwrite n bytes of existing file data at offset with data from
+ * the buffers (without using the file position)
+ */
+static uint32_t adfFileOverwrite_( struct AdfFile * const          file,
+                                   const uint32_t                  offset,
+                                   const uint32_t                  n,
+                                   struct AdfIoVecCursor_ * const  cur )
+{
+    // changed blocks of the handle go to the disk first
+    // (the current block is re-read at the end, if overwritten)
+    if ( file->currentDataBlockChanged || file->dirtyBlocks.nItems > 0 ) {
+        if ( adfFileFlush( file ) != ADF_RC_OK )
+            return 0;
+    }
+    file->fileHdrChanged = true;   // (the modification date)
+
+    struct AdfVolume * const vol = file->volume;
+    const unsigned blockSize       = vol->datablockSize,
+                   nDataBlocksFile = adfFileSize2Datablocks(
+                       file->fileHdr->byteSize, blockSize ),
+                   firstBlock      = offset / blockSize,
+                   lastBlock       = ( offset + n - 1 ) / blockSize,
+                   // also the sector of the block following the last one
+                   // (the next data block pointer for OFS)
+                   nSectors        = min( lastBlock + 2, nDataBlocksFile ) -
+                                     firstBlock;
+
+    ADF_SECTNUM * const sectors = malloc( sizeof(ADF_SECTNUM) * nSectors );
+    if ( sectors == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return 0;
+    }
+
+    uint32_t bytesWritten = 0;
+    if ( adfFileGetDataBlockSectors( file, firstBlock, nSectors,
+                                      sectors ) != ADF_RC_OK )
+    {
+        adfEnv.eFct( "%s: error getting data blocks %u-%u, file '%s'",
+                     __func__, firstBlock, firstBlock + nSectors - 1,
+                     file->fileHdr->fileName );
+        goto free_mem;
+    }
+
+    // read (at once) the blocks written only partially - the first and the last
+    const uint32_t end = offset + n,
+                   fileSize = file->fileHdr->byteSize;
+    const bool firstPartial =
+        ( offset % blockSize != 0 ||
+          end < min( ( firstBlock + 1 ) * blockSize, fileSize ) );
+    const bool lastPartial =
+        ( lastBlock != firstBlock &&
+          end < min( ( lastBlock + 1 ) * blockSize, fileSize ) );
+
+    uint8_t  partial[ 2 ][ 512 ];
+    uint8_t * bufs[ 2 ] = { partial[ 0 ], partial[ 1 ] };
+    uint32_t  partialSects[ 2 ];
+    unsigned  nPartial = 0;
+    if ( firstPartial )
+        partialSects[ nPartial++ ] = (uint32_t) sectors[ 0 ];
+    if ( lastPartial )
+        partialSects[ nPartial++ ] = (uint32_t) sectors[ lastBlock - firstBlock ];
+    if ( nPartial > 0 &&
+         adfVolReadBlocksOfType( vol, nPartial, partialSects, bufs,
+                                 ADF_STATS_BLOCK_DATA ) != ADF_RC_OK )
+        goto free_mem;
+
+    bool curBlockOverwritten = false;
+    struct AdfOFSDataBlock block;
+    for ( unsigned nDataBlock = firstBlock ; nDataBlock <= lastBlock ; nDataBlock++ ) {
+        const ADF_SECTNUM nSect = sectors[ nDataBlock - firstBlock ];
+
+        ADF_RETCODE rc = ADF_RC_OK;
+        if ( nDataBlock == firstBlock && firstPartial )
+            rc = adfDecodeDataBlock( vol, nSect, partial[ 0 ], &block );
+        else if ( nDataBlock == lastBlock && lastPartial )
+            rc = adfDecodeDataBlock( vol, nSect, partial[ nPartial - 1 ], &block );
+        else {
+            const ADF_SECTNUM nextData = ( nDataBlock + 1 < nDataBlocksFile ) ?
+                sectors[ nDataBlock + 1 - firstBlock ] : 0;
+            file->ops->initDataBlock( file, nDataBlock, nextData, &block );
+        }
+        if ( rc != ADF_RC_OK )
+            break;
+
+        const unsigned posInBlock = ( offset + bytesWritten ) % blockSize;
+        const uint32_t size = min( n - bytesWritten, blockSize - posInBlock );
+        adfIoVecGather_( cur, (uint8_t *) &block + file->ops->dataOffset +
+                         posInBlock, size );
+
+        if ( adfWriteDataBlock( vol, nSect, &block ) != ADF_RC_OK )
+            break;
+        bytesWritten += size;
+        if ( nSect == file->curDataPtr )
+            curBlockOverwritten = true;
+    }
+
+    if ( curBlockOverwritten &&
+         adfReadDataBlock( vol, file->curDataPtr, file->currentData ) != ADF_RC_OK )
+    {
+        file->curDataPtr = 0;  // invalidate data ptr
+    }
+
+free_mem:
+    free( sectors );
+    return bytesWritten;
+}
+
+
+/*
+ * adfFileBlockMap*
+ *
+ * the block maps of a file (sectors of data and ext. blocks by their index)
+ * are filled lazily: when block pointers are read (from the file header,
+ * ext. blocks or, for OFS, data blocks) or when new blocks are allocated.
+ * Each ext. block is read at most once to map its data blocks, so
+ * a seek costs at most one data block (and one ext. block) read.
+ *
+ * The maps always contain blocks from index 0 (setting an item beyond
+ * the end of the map is ignored).
+ */
+
+static ADF_RETCODE adfFileBlockMapReserve_( struct AdfFileBlockMap * const  map,
+                                            const unsigned                  capacity )
+{
+    if ( capacity <= map->capacity )
+        return ADF_RC_OK;
+
+    const unsigned capacityNew = max( capacity,
+                                      max( 2 * map->capacity,
+                                           (unsigned) ADF_MAX_DATABLK ) );
+    ADF_SECTNUM * const sectors = realloc( map->sectors,
+                                           capacityNew * sizeof(ADF_SECTNUM) );
+    if ( sectors == NULL )
+        return ADF_RC_MALLOC;
+
+    map->sectors  = sectors;
+    map->capacity = capacityNew;
+    return ADF_RC_OK;
+}
+
+
+static ADF_RETCODE adfFileBlockMapSet_( struct AdfFileBlockMap * const  map,
+                                        const unsigned                  index,
+                                        const ADF_SECTNUM               nSect )
+{
+    if ( index > map->nItems )
+        return ADF_RC_OK;    // not contiguous - not mapped
+
+    ADF_RETCODE rc = adfFileBlockMapReserve_( map, index + 1 );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    map->sectors[ index ] = nSect;
+    if ( index == map->nItems )
+        map->nItems++;
+    return ADF_RC_OK;
+}
+
+
+static void adfFileBlockMapTrim_( struct AdfFileBlockMap * const  map,
+                                  const unsigned                  nItems )
+{
+    map->nItems = min( map->nItems, nItems );
+}
+
+
+static void adfFileBlockMapFree_( struct AdfFileBlockMap * const  map )
+{
+    free( map->sectors );
+    map->sectors  = NULL;
+    map->nItems   = 0;
+    map->capacity = 0;
+}
+
+
+static ADF_RETCODE adfFileBlockMapAddHdr_( struct AdfFile * const  file )
+{
+    const struct AdfFileHeaderBlock * const fhdr = file->fileHdr;
+    const unsigned nDataBlocks = adfFileSize2Datablocks(
+        fhdr->byteSize, file->volume->datablockSize );
+    const unsigned nHdrDataBlocks = min( nDataBlocks,
+                                         (unsigned) ADF_MAX_DATABLK );
+
+    for ( unsigned i = file->dataBlockMap.nItems ; i < nHdrDataBlocks ; i++ ) {
+        ADF_RETCODE rc = adfFileBlockMapSet_(
+            &file->dataBlockMap, i, fhdr->dataBlocks[ ADF_MAX_DATABLK - 1 - i ] );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+
+    if ( nDataBlocks > ADF_MAX_DATABLK && fhdr->extension != 0 )
+        return adfFileBlockMapSet_( &file->extBlockMap, 0, fhdr->extension );
+    return ADF_RC_OK;
+}
+
+
+static ADF_RETCODE adfFileBlockMapAddExt_(
+    struct AdfFile * const                file,
+    const unsigned                        extIndex,
+    const struct AdfFileExtBlock * const  fext )
+{
+    ADF_RETCODE rc = adfFileBlockMapSet_( &file->extBlockMap, extIndex,
+                                          fext->headerKey );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    const unsigned nDataBlocks = adfFileSize2Datablocks(
+        file->fileHdr->byteSize, file->volume->datablockSize );
+    const unsigned firstDataBlock = ( extIndex + 1 ) * ADF_MAX_DATABLK;
+    if ( firstDataBlock >= nDataBlocks )
+        return ADF_RC_OK;
+
+    const unsigned nExtDataBlocks = min( nDataBlocks - firstDataBlock,
+                                         (unsigned) ADF_MAX_DATABLK );
+    for ( unsigned i = 0 ; i < nExtDataBlocks ; i++ ) {
+        rc = adfFileBlockMapSet_( &file->dataBlockMap, firstDataBlock + i,
+                                  fext->dataBlocks[ ADF_MAX_DATABLK - 1 - i ] );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+
+    if ( firstDataBlock + ADF_MAX_DATABLK < nDataBlocks && fext->extension != 0 )
+        return adfFileBlockMapSet_( &file->extBlockMap, extIndex + 1,
+                                    fext->extension );
+    return ADF_RC_OK;
+}
+
+
+static ADF_RETCODE adfFileBlockMapFind_( struct AdfFile * const          file,
+                                         const unsigned                  nDataBlock,
+                                         struct AdfFileExtBlock * const  fext,
+                                         ADF_SECTNUM * const             nSect )
+{
+    ADF_RETCODE rc = adfFileBlockMapAddHdr_( file );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    // map ext. blocks (following the chain from the last mapped one,
+    // reading them to fext) until the requested data block is found
+    while ( nDataBlock >= file->dataBlockMap.nItems ) {
+        const unsigned nMapped = file->dataBlockMap.nItems;
+        if ( fext == NULL ||
+             nMapped < ADF_MAX_DATABLK || nMapped % ADF_MAX_DATABLK != 0 )
+            return ADF_RC_ERROR;    // beyond the blocks of the file
+
+        const unsigned extIndex = nMapped / ADF_MAX_DATABLK - 1;
+        if ( extIndex >= file->extBlockMap.nItems )
+            return ADF_RC_ERROR;    // no (more) ext. blocks
+
+        rc = adfReadFileExtBlock( file->volume,
+                                  file->extBlockMap.sectors[ extIndex ], fext );
+        if ( rc != ADF_RC_OK ) {
+            fext->headerKey = 0;
+            return rc;
+        }
+
+        rc = adfFileBlockMapAddExt_( file, extIndex, fext );
+        if ( rc != ADF_RC_OK )
+            return rc;
+
+        if ( file->dataBlockMap.nItems == nMapped )
+            return ADF_RC_ERROR;    // an empty ext. block
+    }
+
+    *nSect = file->dataBlockMap.sectors[ nDataBlock ];
+    return ADF_RC_OK;
+}
+
+
 /*###########################################################################*/
 
 #ifdef DEBUG_ADF_FILE
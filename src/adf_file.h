@@ -32,10 +32,69 @@
 
 /* ----- FILE ----- */
 
+/* sectors of file's blocks by their index in the file; filled lazily
+   (as block pointers are read or new blocks created), always from index 0 */
+struct AdfFileBlockMap {
+    ADF_SECTNUM * sectors;
+    unsigned      nItems,
+                  capacity;
+};
+
+/* sequential read-ahead (files opened read-only): on sequential access
+   upcoming data blocks are read in coalesced device reads, with the window
+   growing (doubled) from windowMin up to windowMax blocks; non-sequential
+   access halves the window (and stops read-ahead below windowMin) */
+#define ADF_FILE_READAHEAD_MIN    8
+#define ADF_FILE_READAHEAD_MAX  256
+
+struct AdfFileReadAhead {
+    uint8_t *    buffer;        /* raw data blocks read ahead */
+    uint8_t **   bufs;
+    unsigned     capacity;      /* (in blocks) */
+    unsigned     first,         /* index of the first data block in buffer */
+                 nBlocks;       /* number of data blocks in buffer */
+    unsigned     next;          /* index of the data block read next
+                                   if the access is sequential */
+    unsigned     window,
+                 windowMin,
+                 windowMax;     /* 0 -> read-ahead disabled */
+    struct AdfFileExtBlock *
+                 ext;           /* the last ext. block read ahead */
+};
+
+/* data blocks changed by a write handle, but not written yet (besides
+   the current one); written, sorted and coalesced, when the set is full,
+   on flush or before the file blocks are written directly */
+#define ADF_FILE_DIRTY_MAX  16
+
+struct AdfFileDirtyBlock {
+    unsigned     nDataBlock;
+    ADF_SECTNUM  nSect;
+    uint8_t      data[ 512 ];   /* as the current data block (decoded) */
+};
+
+struct AdfFileDirtyBlocks {
+    struct AdfFileDirtyBlock *
+                 blocks;        /* (allocated on first use) */
+    unsigned     nItems;
+};
+
+struct AdfFileStats {
+    uint32_t     blocksRead,        /* data blocks read (by the file) */
+                 blocksReadAhead,   /* ...of them taken from the read-ahead */
+                 readAheads,        /* read-ahead operations */
+                 blocksPrefetched;  /* data blocks read by read-ahead */
+};
+
+struct AdfFileOps;
+
 struct AdfFile {
     struct AdfVolume *
                  volume;
 
+    const struct AdfFileOps *
+                 ops;         /* filesystem-specific (OFS/FFS) operations */
+
     struct AdfFileHeaderBlock *
                  fileHdr;
 
@@ -56,14 +115,28 @@ struct AdfFile {
     bool         modeRead,
                  modeWrite;
 
-    bool         currentDataBlockChanged;
+    bool         currentDataBlockChanged,
+                 currentExtChanged,
+                 fileHdrChanged;  /* size, dates or block pointers */
+
+    struct AdfFileDirtyBlocks
+                 dirtyBlocks;
+
+    struct AdfFileBlockMap
+                 dataBlockMap,
+                 extBlockMap;
+
+    struct AdfFileReadAhead
+                 readAhead;
+    struct AdfFileStats
+                 stats;
 };
 
 
 typedef enum {
     ADF_FILE_MODE_READ      = 0x01,   /* 01 */
     ADF_FILE_MODE_WRITE     = 0x02,   /* 10 */
-    //ADF_FILE_MODE_READWRITE = 0x03    /* 11 */
+    ADF_FILE_MODE_READWRITE = 0x03    /* 11 */
 } AdfFileMode;
 
 
@@ -113,6 +186,53 @@ ADF_PREFIX ADF_RETCODE adfFileTruncate( struct AdfFile * const  file,
 
 ADF_PREFIX ADF_RETCODE adfFileFlush( struct AdfFile * const  file );
 
+/* set read-ahead window limits (in blocks); windowMax == 0 disables it */
+ADF_PREFIX ADF_RETCODE adfFileSetReadAhead( struct AdfFile * const  file,
+                                            const unsigned          windowMin,
+                                            const unsigned          windowMax );
+
+static inline const struct AdfFileStats * adfFileGetStats(
+    const struct AdfFile * const  file )
+{
+    return &file->stats;
+}
+
+
+/*****************************************************************************
+ * Scatter/gather I/O
+ *****************************************************************************/
+
+/* a buffer of a vectored read (filled) or write (written) */
+struct AdfIoVec {
+    void *    base;
+    uint32_t  len;
+};
+
+/* data blocks read at once by adfFilePread */
+#define ADF_FILE_IOV_BATCH  64
+
+/* read/write at the file position, advancing it */
+ADF_PREFIX uint32_t adfFileReadv( struct AdfFile * const         file,
+                                  const struct AdfIoVec * const  iov,
+                                  const unsigned                 iovcnt );
+
+ADF_PREFIX uint32_t adfFileWritev( struct AdfFile * const         file,
+                                   const struct AdfIoVec * const  iov,
+                                   const unsigned                 iovcnt );
+
+/* read/write at offset, leaving the file position unchanged;
+   adfFilePread does not modify the file handle, so several threads
+   can read (only with it) the same file opened read-only */
+ADF_PREFIX uint32_t adfFilePread( const struct AdfFile * const   file,
+                                  const uint32_t                 offset,
+                                  const struct AdfIoVec * const  iov,
+                                  const unsigned                 iovcnt );
+
+ADF_PREFIX uint32_t adfFilePwrite( struct AdfFile * const         file,
+                                   const uint32_t                 offset,
+                                   const struct AdfIoVec * const  iov,
+                                   const unsigned                 iovcnt );
+
 
 /*****************************************************************************
  * Low-level API
@@ -128,4 +248,24 @@ ADF_PREFIX ADF_RETCODE adfFileTruncateGetBlocksToRemove(
     const uint32_t                   fileSizeNew,
     struct AdfVectorSectors * const  blocksToRemove );
 
+/* sectors of nBlocks data blocks from the first (without modifying the file) */
+ADF_PREFIX ADF_RETCODE adfFileGetDataBlockSectors(
+    const struct AdfFile * const  file,
+    const unsigned                first,
+    const unsigned                nBlocks,
+    ADF_SECTNUM * const           sectors );
+
+/* source of data for adfFileAppend: fills buf with n bytes, returns
+   the number of bytes provided (less than n -> error) */
+typedef uint32_t (*AdfFileDataSource)( void * const     ctx,
+                                       uint8_t * const  buf,
+                                       const uint32_t   n );
+
+/* append size bytes (from source, or zeros if it is NULL) at EOF,
+   allocating all new blocks at once and writing data blocks in runs */
+ADF_PREFIX ADF_RETCODE adfFileAppend( struct AdfFile * const  file,
+                                      const uint32_t          size,
+                                      AdfFileDataSource       source,
+                                      void * const            ctx );
+
 #endif  /* ADF_FILE_H */
@@ -75,7 +75,7 @@ ADF_RETCODE adfGetFileBlocks( struct AdfVolume * const                 vol,
 
     /* add data blocks from file header block */
     fileBlocks->data = adfVectorSectorsCreate( dataItemsNum );
-    if ( fileBlocks->data.sectors == NULL ) {
+    if ( fileBlocks->data.sectors == NULL && dataItemsNum > 0 ) {
         adfEnv.eFct( "%s: malloc", __func__ );
         return ADF_RC_MALLOC;
     }
@@ -187,7 +187,7 @@ ADF_RETCODE adfWriteFileHdrBlock( struct AdfVolume * const           vol,
     swapUint32ToPtr( buf + 20, newSum );
 /*    *(uint32_t*)(buf+20) = swapUint32fromPtr((uint8_t*)&newSum);*/
 
-    return adfVolWriteBlock( vol, (uint32_t) nSect, buf );
+    return adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf, ADF_STATS_BLOCK_HEADER );
 }
 
 
@@ -208,13 +208,28 @@ ADF_RETCODE adfReadDataBlock( struct AdfVolume * const  vol,
 
     uint8_t buf[ 512 ];
 
-    ADF_RETCODE rc = adfVolReadBlock( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, (uint32_t) nSect, buf,
+                                            ADF_STATS_BLOCK_DATA );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error reading block %d, volume '%s'",
                      __func__, nSect, vol->volName );
         return rc;
     }
 
+    return adfDecodeDataBlock( vol, nSect, buf, data );
+}
+
+
+/*
+ * adfDecodeDataBlock
+ *
+ * decode (and, for OFS, check) a data block read (raw) from the volume
+ */
+ADF_RETCODE adfDecodeDataBlock( struct AdfVolume * const  vol,
+                                const ADF_SECTNUM         nSect,
+                                const uint8_t * const     buf,
+                                void * const              data )
+{
     memcpy( data, buf, 512 );
 
     if ( adfVolIsOFS( vol ) ) {
@@ -256,7 +271,33 @@ ADF_RETCODE adfReadDataBlock( struct AdfVolume * const  vol,
                          __func__, nSect, vol->volName );
     }
 
-    return rc;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfEncodeDataBlock
+ *
+ * encode a data block to the (raw) form written to the volume
+ * (for OFS: set the block type and checksum)
+ */
+void adfEncodeDataBlock( const struct AdfVolume * const  vol,
+                         void * const                    data,
+                         uint8_t * const                 buf )
+{
+    if ( adfVolIsOFS( vol ) )
+        ( (struct AdfOFSDataBlock *) data )->type = ADF_T_DATA;
+
+    memcpy( buf, data, 512 );
+
+    if ( adfVolIsOFS( vol ) ) {
+#ifdef LITT_ENDIAN
+        adfSwapEndian( buf, ADF_SWBL_DATA );
+#endif
+        const uint32_t newSum = adfNormalSum( buf, 20, 512 );
+        swapUint32ToPtr( buf + 20, newSum );
+/*        *(int32_t*)(buf+20) = swapUint32fromPtr((uint8_t*)&newSum);*/
+    }
 }
 
 
@@ -276,20 +317,11 @@ ADF_RETCODE adfWriteDataBlock( struct AdfVolume * const  vol,
 
     ADF_RETCODE rc;
     if ( adfVolIsOFS( vol ) ) {
-        struct AdfOFSDataBlock * const dataB = (struct AdfOFSDataBlock *) data;
-        dataB->type = ADF_T_DATA;
-
         uint8_t buf[ 512 ];
-        memcpy( buf, data, 512 );
-#ifdef LITT_ENDIAN
-        adfSwapEndian( buf, ADF_SWBL_DATA );
-#endif
-        const uint32_t newSum = adfNormalSum( buf, 20, 512 );
-        swapUint32ToPtr( buf + 20, newSum );
-/*        *(int32_t*)(buf+20) = swapUint32fromPtr((uint8_t*)&newSum);*/
-        rc = adfVolWriteBlock( vol, (uint32_t) nSect, buf );
+        adfEncodeDataBlock( vol, data, buf );
+        rc = adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf, ADF_STATS_BLOCK_DATA );
     } else {
-        rc = adfVolWriteBlock( vol, (uint32_t) nSect, data );
+        rc = adfVolWriteBlockOfType( vol, (uint32_t) nSect, data, ADF_STATS_BLOCK_DATA );
     }
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error writing block %d, volume '%s'",
@@ -310,13 +342,28 @@ ADF_RETCODE adfReadFileExtBlock( struct AdfVolume * const        vol,
                                  struct AdfFileExtBlock * const  fext )
 {
     uint8_t buf[ sizeof(struct AdfFileExtBlock) ];
-    ADF_RETCODE rc = adfVolReadBlock( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, (uint32_t) nSect, buf,
+                                            ADF_STATS_BLOCK_EXT );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error reading block %d, volume '%s'",
                      __func__, nSect, vol->volName );
         return rc;
     }
 /*printf("read fext=%d\n",nSect);*/
+    return adfDecodeFileExtBlock( vol, nSect, buf, fext );
+}
+
+
+/*
+ * adfDecodeFileExtBlock
+ *
+ * decode (and check) raw file ext. block buf (read from sector nSect)
+ */
+ADF_RETCODE adfDecodeFileExtBlock( const struct AdfVolume * const  vol,
+                                   const ADF_SECTNUM               nSect,
+                                   const uint8_t * const           buf,
+                                   struct AdfFileExtBlock * const  fext )
+{
     memcpy( fext, buf, sizeof(struct AdfFileExtBlock) );
 #ifdef LITT_ENDIAN
     adfSwapEndian( (uint8_t *) fext, ADF_SWBL_FEXT );
@@ -361,7 +408,7 @@ ADF_RETCODE adfReadFileExtBlock( struct AdfVolume * const        vol,
         adfEnv.wFct( "%s: extension out of range", __func__ );
     }
 
-    return rc;
+    return ADF_RC_OK;
 }
 
 
@@ -388,7 +435,8 @@ ADF_RETCODE adfWriteFileExtBlock( struct AdfVolume * const        vol,
     swapUint32ToPtr( buf + 20, newSum );
 /*    *(int32_t*)(buf+20) = swapUint32fromPtr((uint8_t*)&newSum);*/
 
-    ADF_RETCODE rc = adfVolWriteBlock( vol, (uint32_t) nSect, buf );
+    ADF_RETCODE rc = adfVolWriteBlockOfType( vol, (uint32_t) nSect, buf,
+                                             ADF_STATS_BLOCK_EXT );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error wriding block %d, volume '%s'",
                      __func__, nSect, vol->volName );
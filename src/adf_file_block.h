@@ -52,6 +52,15 @@ ADF_RETCODE adfReadDataBlock( struct AdfVolume * const  vol,
                               const ADF_SECTNUM         nSect,
                               void * const              data );
 
+ADF_RETCODE adfDecodeDataBlock( struct AdfVolume * const  vol,
+                                const ADF_SECTNUM         nSect,
+                                const uint8_t * const     buf,
+                                void * const              data );
+
+void adfEncodeDataBlock( const struct AdfVolume * const  vol,
+                         void * const                    data,
+                         uint8_t * const                 buf );
+
 ADF_RETCODE adfWriteDataBlock( struct AdfVolume * const  vol,
                                const ADF_SECTNUM         nSect,
                                void * const              data );
@@ -60,6 +69,11 @@ ADF_PREFIX ADF_RETCODE adfReadFileExtBlock( struct AdfVolume * const        vol,
                                             const ADF_SECTNUM               nSect,
                                             struct AdfFileExtBlock * const  fext );
 
+ADF_RETCODE adfDecodeFileExtBlock( const struct AdfVolume * const  vol,
+                                   const ADF_SECTNUM               nSect,
+                                   const uint8_t * const           buf,
+                                   struct AdfFileExtBlock * const  fext );
+
 ADF_PREFIX ADF_RETCODE adfWriteFileExtBlock( struct AdfVolume * const        vol,
                                              const ADF_SECTNUM               nSect,
                                              struct AdfFileExtBlock * const  fext );
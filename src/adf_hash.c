@@ -0,0 +1,847 @@
+/*
+ *  adf_hash.c - content hashing (CRC32, MD5, SHA-1, SHA-256) of files
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* clock_gettime() */
+#endif
+
+#include "adf_hash.h"
+
+#include "adf_blk.h"
+#include "adf_dev.h"
+#include "adf_dir.h"
+#include "adf_env.h"
+#include "adf_file_block.h"
+#include "adf_thread.h"
+#include "adf_util.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* data blocks read (and hashed) at once */
+#define ADF_HASH_BATCH  128
+
+
+/*
+ * Hash algorithms
+ */
+
+/* state of a Merkle-Damgard hash (MD5, SHA-1, SHA-256) - 64-byte blocks */
+struct AdfHashMd_ {
+    uint32_t  h[ 8 ];
+    uint64_t  len;
+    uint8_t   buf[ 64 ];
+    unsigned  nBuf;
+};
+
+typedef void (*AdfHashCompressFct_)( uint32_t * const       h,
+                                     const uint8_t * const  block );
+
+struct AdfHashCtx_ {
+    unsigned           algos;
+    uint32_t           size;
+    uint32_t           crc32;
+    struct AdfHashMd_  md5,
+                       sha1,
+                       sha256;
+};
+
+static const uint32_t crc32Table_[ 256 ] = {
+    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
+    0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
+    0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
+    0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
+    0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
+    0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
+    0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
+    0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
+    0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
+    0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
+    0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
+    0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
+    0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
+    0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
+    0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
+    0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
+    0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
+    0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
+    0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
+    0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
+    0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+};
+
+static const uint32_t md5K_[ 64 ] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint8_t md5R_[ 64 ] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static const uint32_t sha256K_[ 64 ] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void adfHashInit_( struct AdfHashCtx_ * const  ctx,
+                          const unsigned              algos );
+
+static void adfHashUpdate_( struct AdfHashCtx_ * const  ctx,
+                            const uint8_t *             data,
+                            const uint32_t              len );
+
+static void adfHashFinal_( struct AdfHashCtx_ * const  ctx,
+                           struct AdfHashes * const    hashes );
+
+static void adfHashMdUpdate_( struct AdfHashMd_ * const  st,
+                              const AdfHashCompressFct_  compress,
+                              const uint8_t *            data,
+                              uint32_t                   len );
+
+static void adfHashMdFinal_( struct AdfHashMd_ * const  st,
+                             const AdfHashCompressFct_  compress,
+                             const bool                 bigEndian );
+
+static void adfHashMd5Compress_( uint32_t * const       h,
+                                 const uint8_t * const  block );
+
+static void adfHashSha1Compress_( uint32_t * const       h,
+                                  const uint8_t * const  block );
+
+static void adfHashSha256Compress_( uint32_t * const       h,
+                                    const uint8_t * const  block );
+
+
+/*
+ * Volume-wide hashing
+ */
+
+struct AdfHashJob_ {
+    char *       path;
+    ADF_SECTNUM  sector;
+};
+
+/* state of a (possibly multithreaded) hashing of all files of a volume */
+struct AdfHashAll_ {
+    struct AdfVolume *    vol;
+    unsigned              algos;
+    AdfHashCallback       callback;
+    void *                ctx;
+    struct AdfMutex *     lock;
+
+    struct AdfHashJob_ *  jobs;
+    unsigned              nJobs,
+                          jobsSize,
+                          next;          /* the next job to take */
+
+    struct AdfHashStats   stats;
+    ADF_RETCODE           rc;
+};
+
+static ADF_RETCODE adfHashCollect_( struct AdfHashAll_ * const     all,
+                                    const struct AdfList *         list,
+                                    const char * const             dirPath );
+
+static int adfHashJobCmp_( const void * const  a,
+                           const void * const  b );
+
+static void adfHashWorker_( void * const  allArg );
+
+static double adfHashClock_( void );
+
+
+/*****************************************************************************
+ *
+ * Public functions
+ *
+ *****************************************************************************/
+
+/*
+ * adfHashData
+ *
+ */
+void adfHashData( const unsigned            algos,
+                  const uint8_t * const     data,
+                  const uint32_t            len,
+                  struct AdfHashes * const  hashes )
+{
+    struct AdfHashCtx_ ctx;
+    adfHashInit_( &ctx, algos );
+    adfHashUpdate_( &ctx, data, len );
+    adfHashFinal_( &ctx, hashes );
+}
+
+
+/*
+ * adfFileHash
+ *
+ * the data blocks are read in batches of ADF_HASH_BATCH (adfVolReadBlocks
+ * coalesces reads of consecutive ones); for OFS, they are decoded
+ * (and checked), for FFS - hashed as read
+ */
+ADF_RETCODE adfFileHash( struct AdfVolume * const  vol,
+                         const ADF_SECTNUM         fileSect,
+                         const unsigned            algos,
+                         struct AdfHashes * const  hashes )
+{
+    struct AdfFileHeaderBlock fhdr;
+    ADF_RETCODE rc = adfReadEntryBlock( vol, fileSect,
+                                        (struct AdfEntryBlock *) &fhdr );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    // a hard link - hash the real file (the link cache is not used here,
+    // it is not thread-safe)
+    if ( fhdr.secType == ADF_ST_LFILE ) {
+        const ADF_SECTNUM realSect = fhdr.real;
+        rc = adfReadEntryBlock( vol, realSect, (struct AdfEntryBlock *) &fhdr );
+        if ( rc != ADF_RC_OK )
+            return rc;
+    }
+    if ( fhdr.secType != ADF_ST_FILE ) {
+        adfEnv.eFct( "%s: block %d is not a file header", __func__, fileSect );
+        return ADF_RC_ERROR;
+    }
+
+    struct AdfFileBlocks fileBlocks;
+    rc = adfGetFileBlocks( vol, &fhdr, &fileBlocks );
+    if ( rc != ADF_RC_OK )
+        return rc;
+
+    uint8_t * const buf = malloc( ADF_HASH_BATCH * 512 );
+    if ( buf == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        rc = ADF_RC_MALLOC;
+        goto cleanup;
+    }
+
+    uint8_t * bufs[ ADF_HASH_BATCH ];
+    for ( unsigned i = 0 ; i < ADF_HASH_BATCH ; i++ )
+        bufs[ i ] = buf + i * 512;
+
+    struct AdfHashCtx_ ctx;
+    adfHashInit_( &ctx, algos );
+
+    const bool     ofs         = adfVolIsOFS( vol );
+    const unsigned nDataBlocks = fileBlocks.data.nItems;
+    uint32_t       remaining   = fhdr.byteSize;
+    for ( unsigned first = 0, nBatch ; first < nDataBlocks ; first += nBatch ) {
+        nBatch = min( (unsigned) ADF_HASH_BATCH, nDataBlocks - first );
+        rc = adfVolReadBlocksOfType( vol, nBatch,
+                                     (const uint32_t *) &fileBlocks.data.sectors[ first ],
+                                     bufs, ADF_STATS_BLOCK_DATA );
+        if ( rc != ADF_RC_OK )
+            goto cleanup;
+
+        for ( unsigned i = 0 ; i < nBatch && remaining > 0 ; i++ ) {
+            const uint8_t * data = bufs[ i ];
+            if ( ofs ) {
+                struct AdfOFSDataBlock dataBlock;
+                rc = adfDecodeDataBlock( vol, fileBlocks.data.sectors[ first + i ],
+                                         bufs[ i ], &dataBlock );
+                if ( rc != ADF_RC_OK )
+                    goto cleanup;
+                data = bufs[ i ] + offsetof( struct AdfOFSDataBlock, data );
+            }
+            const uint32_t len = min( remaining, (uint32_t) vol->datablockSize );
+            adfHashUpdate_( &ctx, data, len );
+            remaining -= len;
+        }
+    }
+
+    if ( remaining > 0 ) {
+        adfEnv.eFct( "%s: file %d: missing data blocks", __func__, fileSect );
+        rc = ADF_RC_ERROR;
+        goto cleanup;
+    }
+    adfHashFinal_( &ctx, hashes );
+
+cleanup:
+    free( buf );
+    fileBlocks.data.destroy( &fileBlocks.data );
+    fileBlocks.extens.destroy( &fileBlocks.extens );
+    return rc;
+}
+
+
+/*
+ * adfVolHashAllFiles
+ *
+ */
+ADF_RETCODE adfVolHashAllFiles( struct AdfVolume * const     vol,
+                                const unsigned               algos,
+                                const AdfHashCallback        callback,
+                                void * const                 ctx,
+                                const unsigned               nThreads,
+                                struct AdfHashStats * const  stats )
+{
+    const double start = adfHashClock_();
+
+    struct AdfHashAll_ all = {
+        .vol      = vol,
+        .algos    = algos,
+        .callback = callback,
+        .ctx      = ctx,
+        .lock     = NULL,
+        .jobs     = NULL,
+        .nJobs    = 0,
+        .jobsSize = 0,
+        .next     = 0,
+        .stats    = { 0 },
+        .rc       = ADF_RC_OK
+    };
+
+    // one traversal of the whole tree (an empty root gives NULL)
+    struct AdfList * const list = adfGetRDirEnt( vol, vol->rootBlock, true );
+    ADF_RETCODE rc = adfHashCollect_( &all, list, NULL );
+    adfFreeDirList( list );
+    if ( rc != ADF_RC_OK )
+        goto cleanup;
+
+    // hash in the order of the header blocks (closer reads)
+    qsort( all.jobs, all.nJobs, sizeof(struct AdfHashJob_), adfHashJobCmp_ );
+
+    unsigned nWorkers = ( nThreads < 1 ? 1 :
+                          nThreads > ADF_THREADS_MAX ? ADF_THREADS_MAX :
+                          nThreads );
+    nWorkers = min( nWorkers, max( all.nJobs, 1u ) );
+    if ( ! adfThreadsAvailable() || vol->dev->ioLock == NULL )
+        nWorkers = 1;
+
+    if ( nWorkers > 1 ) {
+        all.lock = adfMutexCreate();
+        if ( all.lock == NULL ) {
+            rc = ADF_RC_ERROR;
+            goto cleanup;
+        }
+    }
+
+    adfThreadsRun( nWorkers, adfHashWorker_, &all );
+    rc = all.rc;
+
+cleanup:
+    all.stats.seconds  = adfHashClock_() - start;
+    all.stats.mbPerSec = ( all.stats.seconds > 0.0 ) ?
+        (double) all.stats.nBytes / 1e6 / all.stats.seconds : 0.0;
+    if ( stats != NULL )
+        *stats = all.stats;
+
+    adfMutexDestroy( all.lock );
+    for ( unsigned i = 0 ; i < all.nJobs ; i++ )
+        free( all.jobs[ i ].path );
+    free( all.jobs );
+    return rc;
+}
+
+
+/*****************************************************************************
+ *
+ * Volume-wide hashing
+ *
+ *****************************************************************************/
+
+/*
+ * adfHashCollect_
+ *
+ * add all files of a (recursive) directory list to the jobs
+ */
+static ADF_RETCODE adfHashCollect_( struct AdfHashAll_ * const  all,
+                                    const struct AdfList *      list,
+                                    const char * const          dirPath )
+{
+    for ( const struct AdfList * cell = list ; cell != NULL ; cell = cell->next ) {
+        const struct AdfEntry * const entry = cell->content;
+        if ( entry->type != ADF_ST_FILE && entry->type != ADF_ST_DIR )
+            continue;   // links are hashed as their real entries
+
+        const size_t pathSize = ( dirPath ? strlen( dirPath ) + 1 : 0 ) +
+                                strlen( entry->name ) + 1;
+        char * const path = malloc( pathSize );
+        if ( path == NULL ) {
+            adfEnv.eFct( "%s: malloc", __func__ );
+            return ADF_RC_MALLOC;
+        }
+        if ( dirPath )
+            snprintf( path, pathSize, "%s/%s", dirPath, entry->name );
+        else
+            snprintf( path, pathSize, "%s", entry->name );
+
+        if ( entry->type == ADF_ST_DIR ) {
+            const ADF_RETCODE rc = adfHashCollect_( all, cell->subdir, path );
+            free( path );
+            if ( rc != ADF_RC_OK )
+                return rc;
+            continue;
+        }
+
+        if ( all->nJobs == all->jobsSize ) {
+            const unsigned newSize = all->jobsSize ? 2 * all->jobsSize : 64;
+            struct AdfHashJob_ * const jobs =
+                realloc( all->jobs, newSize * sizeof(struct AdfHashJob_) );
+            if ( jobs == NULL ) {
+                adfEnv.eFct( "%s: malloc", __func__ );
+                free( path );
+                return ADF_RC_MALLOC;
+            }
+            all->jobs     = jobs;
+            all->jobsSize = newSize;
+        }
+        all->jobs[ all->nJobs ].path   = path;
+        all->jobs[ all->nJobs ].sector = entry->sector;
+        all->nJobs++;
+    }
+    return ADF_RC_OK;
+}
+
+
+static int adfHashJobCmp_( const void * const  a,
+                           const void * const  b )
+{
+    const ADF_SECTNUM sa = ( (const struct AdfHashJob_ *) a )->sector,
+                      sb = ( (const struct AdfHashJob_ *) b )->sector;
+    return ( sa > sb ) - ( sa < sb );
+}
+
+
+/*
+ * adfHashWorker_
+ *
+ * take files (jobs) one by one and hash them, reporting the results
+ * (with the lock held)
+ */
+static void adfHashWorker_( void * const  allArg )
+{
+    struct AdfHashAll_ * const all = allArg;
+
+    adfMutexLock( all->lock );
+    while ( all->next < all->nJobs ) {
+        const struct AdfHashJob_ * const job = &all->jobs[ all->next++ ];
+        adfMutexUnlock( all->lock );
+
+        struct AdfHashes hashes;
+        const ADF_RETCODE rc = adfFileHash( all->vol, job->sector, all->algos,
+                                            &hashes );
+
+        adfMutexLock( all->lock );
+        if ( rc == ADF_RC_OK ) {
+            all->stats.nFiles++;
+            all->stats.nBytes += hashes.size;
+        } else {
+            all->stats.nErrors++;
+            if ( all->rc == ADF_RC_OK )
+                all->rc = rc;
+        }
+        if ( all->callback != NULL )
+            all->callback( all->ctx, job->path, job->sector, rc,
+                           ( rc == ADF_RC_OK ) ? &hashes : NULL );
+    }
+    adfMutexUnlock( all->lock );
+}
+
+
+/*
+ * adfHashClock_
+ *
+ * wall-clock time in seconds (from an arbitrary point)
+ */
+static double adfHashClock_( void )
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    if ( clock_gettime( CLOCK_MONOTONIC, &ts ) == 0 )
+        return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+#endif
+    return (double) time( NULL );
+}
+
+
+/*****************************************************************************
+ *
+ * Hash algorithms
+ *
+ *****************************************************************************/
+
+static inline uint32_t rol32_( const uint32_t  x,
+                               const unsigned  n )
+{
+    return ( x << n ) | ( x >> ( 32 - n ) );
+}
+
+static inline uint32_t ror32_( const uint32_t  x,
+                               const unsigned  n )
+{
+    return ( x >> n ) | ( x << ( 32 - n ) );
+}
+
+static inline uint32_t loadBE32_( const uint8_t * const  p )
+{
+    return (uint32_t) p[ 0 ] << 24 | (uint32_t) p[ 1 ] << 16 |
+           (uint32_t) p[ 2 ] << 8  | (uint32_t) p[ 3 ];
+}
+
+static inline uint32_t loadLE32_( const uint8_t * const  p )
+{
+    return (uint32_t) p[ 3 ] << 24 | (uint32_t) p[ 2 ] << 16 |
+           (uint32_t) p[ 1 ] << 8  | (uint32_t) p[ 0 ];
+}
+
+static void storeWords_( uint8_t * const         out,
+                         const uint32_t * const  words,
+                         const unsigned          nWords,
+                         const bool              bigEndian )
+{
+    for ( unsigned i = 0 ; i < nWords ; i++ )
+        for ( unsigned j = 0 ; j < 4 ; j++ )
+            out[ 4 * i + j ] = (uint8_t)
+                ( words[ i ] >> ( bigEndian ? 24 - 8 * j : 8 * j ) );
+}
+
+
+/*
+ * adfHashInit_
+ *
+ */
+static void adfHashInit_( struct AdfHashCtx_ * const  ctx,
+                          const unsigned              algos )
+{
+    static const uint32_t md5Init[ 4 ] = {
+        0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+    };
+    static const uint32_t sha1Init[ 5 ] = {
+        0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+    };
+    static const uint32_t sha256Init[ 8 ] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memset( ctx, 0, sizeof(struct AdfHashCtx_) );
+    ctx->algos = algos;
+    ctx->crc32 = 0xffffffff;
+    memcpy( ctx->md5.h,    md5Init,    sizeof(md5Init) );
+    memcpy( ctx->sha1.h,   sha1Init,   sizeof(sha1Init) );
+    memcpy( ctx->sha256.h, sha256Init, sizeof(sha256Init) );
+}
+
+
+/*
+ * adfHashUpdate_
+ *
+ */
+static void adfHashUpdate_( struct AdfHashCtx_ * const  ctx,
+                            const uint8_t *             data,
+                            const uint32_t              len )
+{
+    ctx->size += len;
+
+    if ( ctx->algos & ADF_HASH_CRC32 ) {
+        uint32_t crc = ctx->crc32;
+        for ( uint32_t i = 0 ; i < len ; i++ )
+            crc = crc32Table_[ ( crc ^ data[ i ] ) & 0xff ] ^ ( crc >> 8 );
+        ctx->crc32 = crc;
+    }
+    if ( ctx->algos & ADF_HASH_MD5 )
+        adfHashMdUpdate_( &ctx->md5, adfHashMd5Compress_, data, len );
+    if ( ctx->algos & ADF_HASH_SHA1 )
+        adfHashMdUpdate_( &ctx->sha1, adfHashSha1Compress_, data, len );
+    if ( ctx->algos & ADF_HASH_SHA256 )
+        adfHashMdUpdate_( &ctx->sha256, adfHashSha256Compress_, data, len );
+}
+
+
+/*
+ * adfHashFinal_
+ *
+ */
+static void adfHashFinal_( struct AdfHashCtx_ * const  ctx,
+                           struct AdfHashes * const    hashes )
+{
+    memset( hashes, 0, sizeof(struct AdfHashes) );
+    hashes->size = ctx->size;
+
+    if ( ctx->algos & ADF_HASH_CRC32 )
+        hashes->crc32 = ctx->crc32 ^ 0xffffffff;
+    if ( ctx->algos & ADF_HASH_MD5 ) {
+        adfHashMdFinal_( &ctx->md5, adfHashMd5Compress_, false );
+        storeWords_( hashes->md5, ctx->md5.h, 4, false );
+    }
+    if ( ctx->algos & ADF_HASH_SHA1 ) {
+        adfHashMdFinal_( &ctx->sha1, adfHashSha1Compress_, true );
+        storeWords_( hashes->sha1, ctx->sha1.h, 5, true );
+    }
+    if ( ctx->algos & ADF_HASH_SHA256 ) {
+        adfHashMdFinal_( &ctx->sha256, adfHashSha256Compress_, true );
+        storeWords_( hashes->sha256, ctx->sha256.h, 8, true );
+    }
+}
+
+
+/*
+ * adfHashMdUpdate_
+ *
+ */
+static void adfHashMdUpdate_( struct AdfHashMd_ * const  st,
+                              const AdfHashCompressFct_  compress,
+                              const uint8_t *            data,
+                              uint32_t                   len )
+{
+    st->len += len;
+
+    if ( st->nBuf > 0 ) {
+        const uint32_t n = min( len, 64 - st->nBuf );
+        memcpy( st->buf + st->nBuf, data, n );
+        st->nBuf += n;
+        data     += n;
+        len      -= n;
+        if ( st->nBuf < 64 )
+            return;
+        compress( st->h, st->buf );
+        st->nBuf = 0;
+    }
+
+    for ( ; len >= 64 ; data += 64, len -= 64 )
+        compress( st->h, data );
+
+    memcpy( st->buf, data, len );
+    st->nBuf = len;
+}
+
+
+/*
+ * adfHashMdFinal_
+ *
+ * pad the message (0x80, zeros, the length in bits - 64-bit big or little
+ * endian) and process the last block(s)
+ */
+static void adfHashMdFinal_( struct AdfHashMd_ * const  st,
+                             const AdfHashCompressFct_  compress,
+                             const bool                 bigEndian )
+{
+    const uint64_t nBits = st->len * 8;
+
+    st->buf[ st->nBuf++ ] = 0x80;
+    if ( st->nBuf > 56 ) {
+        memset( st->buf + st->nBuf, 0, 64 - st->nBuf );
+        compress( st->h, st->buf );
+        st->nBuf = 0;
+    }
+    memset( st->buf + st->nBuf, 0, 56 - st->nBuf );
+    for ( unsigned i = 0 ; i < 8 ; i++ )
+        st->buf[ 56 + i ] = (uint8_t)
+            ( nBits >> ( bigEndian ? 56 - 8 * i : 8 * i ) );
+    compress( st->h, st->buf );
+    st->nBuf = 0;
+}
+
+
+/*
+ * adfHashMd5Compress_
+ *
+ * (RFC 1321)
+ */
+static void adfHashMd5Compress_( uint32_t * const       h,
+                                 const uint8_t * const  block )
+{
+    uint32_t w[ 16 ];
+    for ( unsigned i = 0 ; i < 16 ; i++ )
+        w[ i ] = loadLE32_( block + 4 * i );
+
+    uint32_t a = h[ 0 ], b = h[ 1 ], c = h[ 2 ], d = h[ 3 ];
+    for ( unsigned i = 0 ; i < 64 ; i++ ) {
+        uint32_t f;
+        unsigned g;
+        if ( i < 16 ) {
+            f = ( b & c ) | ( ~b & d );
+            g = i;
+        } else if ( i < 32 ) {
+            f = ( d & b ) | ( ~d & c );
+            g = ( 5 * i + 1 ) % 16;
+        } else if ( i < 48 ) {
+            f = b ^ c ^ d;
+            g = ( 3 * i + 5 ) % 16;
+        } else {
+            f = c ^ ( b | ~d );
+            g = ( 7 * i ) % 16;
+        }
+        const uint32_t tmp = d;
+        d = c;
+        c = b;
+        b = b + rol32_( a + f + md5K_[ i ] + w[ g ], md5R_[ i ] );
+        a = tmp;
+    }
+    h[ 0 ] += a;
+    h[ 1 ] += b;
+    h[ 2 ] += c;
+    h[ 3 ] += d;
+}
+
+
+/*
+ * adfHashSha1Compress_
+ *
+ * (FIPS 180-4)
+ */
+static void adfHashSha1Compress_( uint32_t * const       h,
+                                  const uint8_t * const  block )
+{
+    uint32_t w[ 80 ];
+    for ( unsigned i = 0 ; i < 16 ; i++ )
+        w[ i ] = loadBE32_( block + 4 * i );
+    for ( unsigned i = 16 ; i < 80 ; i++ )
+        w[ i ] = rol32_( w[ i - 3 ] ^ w[ i - 8 ] ^ w[ i - 14 ] ^ w[ i - 16 ], 1 );
+
+    uint32_t a = h[ 0 ], b = h[ 1 ], c = h[ 2 ], d = h[ 3 ], e = h[ 4 ];
+    for ( unsigned i = 0 ; i < 80 ; i++ ) {
+        uint32_t f, k;
+        if ( i < 20 ) {
+            f = ( b & c ) | ( ~b & d );
+            k = 0x5a827999;
+        } else if ( i < 40 ) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if ( i < 60 ) {
+            f = ( b & c ) | ( b & d ) | ( c & d );
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        const uint32_t tmp = rol32_( a, 5 ) + f + e + k + w[ i ];
+        e = d;
+        d = c;
+        c = rol32_( b, 30 );
+        b = a;
+        a = tmp;
+    }
+    h[ 0 ] += a;
+    h[ 1 ] += b;
+    h[ 2 ] += c;
+    h[ 3 ] += d;
+    h[ 4 ] += e;
+}
+
+
+/*
+ * adfHashSha256Compress_
+ *
+ * (FIPS 180-4)
+ */
+static void adfHashSha256Compress_( uint32_t * const       h,
+                                    const uint8_t * const  block )
+{
+    uint32_t w[ 64 ];
+    for ( unsigned i = 0 ; i < 16 ; i++ )
+        w[ i ] = loadBE32_( block + 4 * i );
+    for ( unsigned i = 16 ; i < 64 ; i++ ) {
+        const uint32_t s0 = ror32_( w[ i - 15 ], 7 ) ^ ror32_( w[ i - 15 ], 18 ) ^
+                            ( w[ i - 15 ] >> 3 ),
+                       s1 = ror32_( w[ i - 2 ], 17 ) ^ ror32_( w[ i - 2 ], 19 ) ^
+                            ( w[ i - 2 ] >> 10 );
+        w[ i ] = w[ i - 16 ] + s0 + w[ i - 7 ] + s1;
+    }
+
+    uint32_t a = h[ 0 ], b = h[ 1 ], c = h[ 2 ], d = h[ 3 ],
+             e = h[ 4 ], f = h[ 5 ], g = h[ 6 ], hh = h[ 7 ];
+    for ( unsigned i = 0 ; i < 64 ; i++ ) {
+        const uint32_t S1  = ror32_( e, 6 ) ^ ror32_( e, 11 ) ^ ror32_( e, 25 ),
+                       ch  = ( e & f ) ^ ( ~e & g ),
+                       t1  = hh + S1 + ch + sha256K_[ i ] + w[ i ],
+                       S0  = ror32_( a, 2 ) ^ ror32_( a, 13 ) ^ ror32_( a, 22 ),
+                       maj = ( a & b ) ^ ( a & c ) ^ ( b & c ),
+                       t2  = S0 + maj;
+        hh = g;
+        g  = f;
+        f  = e;
+        e  = d + t1;
+        d  = c;
+        c  = b;
+        b  = a;
+        a  = t1 + t2;
+    }
+    h[ 0 ] += a;
+    h[ 1 ] += b;
+    h[ 2 ] += c;
+    h[ 3 ] += d;
+    h[ 4 ] += e;
+    h[ 5 ] += f;
+    h[ 6 ] += g;
+    h[ 7 ] += hh;
+}
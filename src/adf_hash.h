@@ -0,0 +1,103 @@
+/*
+ *  adf_hash.h - content hashing (CRC32, MD5, SHA-1, SHA-256) of files
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_HASH_H
+#define ADF_HASH_H
+
+#include "adf_err.h"
+#include "adf_prefix.h"
+#include "adf_types.h"
+#include "adf_vol.h"
+
+#include <stdint.h>
+
+/* hash algorithms (a mask - any combination is computed in one pass) */
+typedef enum {
+    ADF_HASH_CRC32  = 0x01,
+    ADF_HASH_MD5    = 0x02,
+    ADF_HASH_SHA1   = 0x04,
+    ADF_HASH_SHA256 = 0x08,
+    ADF_HASH_ALL    = 0x0f
+} AdfHashAlgo;
+
+/* digests (only those requested are set, the others are zeroed) */
+struct AdfHashes {
+    uint32_t  size;            /* bytes hashed */
+    uint32_t  crc32;
+    uint8_t   md5[ 16 ];
+    uint8_t   sha1[ 20 ];
+    uint8_t   sha256[ 32 ];
+};
+
+/* hash a memory buffer */
+ADF_PREFIX void adfHashData( const unsigned            algos,
+                             const uint8_t * const     data,
+                             const uint32_t            len,
+                             struct AdfHashes * const  hashes );
+
+/*
+ * Hash the data of the file with the header block in sector fileSect
+ * (a hard link is followed). The data blocks are read in sector-coalesced
+ * batches (see adfVolReadBlocks).
+ */
+ADF_PREFIX ADF_RETCODE adfFileHash( struct AdfVolume * const  vol,
+                                    const ADF_SECTNUM         fileSect,
+                                    const unsigned            algos,
+                                    struct AdfHashes * const  hashes );
+
+
+/*
+ * Volume-wide hashing
+ *
+ * The directory tree is traversed once, then files (not links to them)
+ * are hashed in the order of their header blocks, by up to nThreads
+ * threads (if available, see adf_thread.h).
+ *
+ * The callback is called for each file (also a failed one - with rc set,
+ * then hashes is NULL); the calls are serialized (never concurrent).
+ * The path is relative to the root directory ("dir/subdir/name").
+ */
+typedef void (*AdfHashCallback)( void * const                    ctx,
+                                 const char * const              path,
+                                 const ADF_SECTNUM               fileSect,
+                                 const ADF_RETCODE               rc,
+                                 const struct AdfHashes * const  hashes );
+
+struct AdfHashStats {
+    unsigned  nFiles,
+              nErrors;
+    uint64_t  nBytes;
+    double    seconds,
+              mbPerSec;        /* throughput (bytes hashed / 10^6 / seconds) */
+};
+
+/* returns ADF_RC_OK if all files were hashed (otherwise, the error of
+   the first file which failed), stats (can be NULL) are set in any case */
+ADF_PREFIX ADF_RETCODE adfVolHashAllFiles( struct AdfVolume * const     vol,
+                                           const unsigned               algos,
+                                           const AdfHashCallback        callback,
+                                           void * const                 ctx,
+                                           const unsigned               nThreads,
+                                           struct AdfHashStats * const  stats );
+
+#endif  /* ADF_HASH_H */
@@ -38,16 +38,18 @@
    The primary limitation of max dev size comes from using stdio for accessing
    devices (ie. fseek uses 'long int' as offset).
 
-   Some more modern systems allow to mitigate this limitation with fseeko,
-   but, for instance, VBCC does not have that, so using it would limit portability.
+   The dump driver uses 64-bit offsets where available (fseeko with
+   _FILE_OFFSET_BITS=64, or _fseeki64 on Windows), but, for instance, VBCC
+   does not have these, so stdio fseek remains the fall-back.
 
    Note that this depends on the platform: 64bit systems (with 64bit long!)
-   will be able to handle very large devices, while 32bit will be limited to 2GiB
-   (max value of long int meaning int32_t).
+   or ones with fseeko will be able to handle very large devices, while other
+   32bit ones will be limited to 2GiB (max value of long int meaning int32_t).
 */
 
-#if ( LONG_MAX / ADF_DEV_BLOCK_SIZE + 1 ) < UINT32_MAX
-// long int is 32bit -> 2GiB limit(!)
+#if ( LONG_MAX / ADF_DEV_BLOCK_SIZE + 1 ) < UINT32_MAX && \
+    ! defined HAVE_FSEEKO && ! defined _WIN32
+// long int is 32bit and no 64-bit fseek -> 2GiB limit(!)
 #define ADF_DEV_SIZE_MAX_BLOCKS  ( LONG_MAX / ADF_DEV_BLOCK_SIZE + 1 )
 #else
 // the type of struct AdfDevice.sizeBlocks (uint32_t) makes the limit
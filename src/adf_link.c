@@ -25,6 +25,7 @@
 
 
 #include<string.h>
+#include <stdlib.h>
 
 #include"adf_str.h"
 #include"adf_link.h"
@@ -32,6 +33,130 @@
 #include "adf_env.h"
 
 
+struct AdfLinkCacheEntry {
+    ADF_SECTNUM           link,       /* 0 -> free slot */
+                          real;
+    struct AdfEntryBlock  realBlock;
+};
+
+struct AdfLinkCache {
+    struct AdfLinkCacheEntry  entries[ ADF_LINK_CACHE_SIZE ];
+    unsigned                  nItems;
+};
+
+
+/*
+ * adfLinkGetTarget
+ *
+ */
+ADF_RETCODE adfLinkGetTarget( struct AdfVolume * const      vol,
+                              const ADF_SECTNUM             linkSect,
+                              const ADF_SECTNUM             realSect,
+                              struct AdfEntryBlock * const  real )
+{
+    const struct AdfLinkCache * const cache = vol->linkCache;
+    if ( cache != NULL ) {
+        const struct AdfLinkCacheEntry * const entry =
+            &cache->entries[ (uint32_t) linkSect % ADF_LINK_CACHE_SIZE ];
+        if ( entry->link == linkSect && entry->real == realSect ) {
+            memcpy( real, &entry->realBlock, sizeof(struct AdfEntryBlock) );
+            return ADF_RC_OK;
+        }
+    }
+
+    ADF_RETCODE rc = adfReadEntryBlock( vol, realSect, real );
+    if ( rc != ADF_RC_OK )
+        return rc;
+    adfLinkCacheAdd( vol, linkSect, realSect, real );
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfLinkCacheAdd
+ *
+ * (if the cache cannot be allocated - nothing is cached)
+ */
+void adfLinkCacheAdd( struct AdfVolume * const            vol,
+                      const ADF_SECTNUM                   linkSect,
+                      const ADF_SECTNUM                   realSect,
+                      const struct AdfEntryBlock * const  real )
+{
+    if ( linkSect == 0 )
+        return;
+
+    if ( vol->linkCache == NULL ) {
+        vol->linkCache = calloc( 1, sizeof(struct AdfLinkCache) );
+        if ( vol->linkCache == NULL )
+            return;
+    }
+
+    struct AdfLinkCache * const cache = vol->linkCache;
+    struct AdfLinkCacheEntry * const entry =
+        &cache->entries[ (uint32_t) linkSect % ADF_LINK_CACHE_SIZE ];
+    if ( entry->link == 0 )
+        cache->nItems++;
+    entry->link = linkSect;
+    entry->real = realSect;
+    memcpy( &entry->realBlock, real, sizeof(struct AdfEntryBlock) );
+}
+
+
+/*
+ * adfLinkCacheHas
+ *
+ */
+bool adfLinkCacheHas( const struct AdfVolume * const  vol,
+                      const ADF_SECTNUM               linkSect,
+                      const ADF_SECTNUM               realSect )
+{
+    const struct AdfLinkCache * const cache = vol->linkCache;
+    if ( cache == NULL )
+        return false;
+    const struct AdfLinkCacheEntry * const entry =
+        &cache->entries[ (uint32_t) linkSect % ADF_LINK_CACHE_SIZE ];
+    return ( entry->link == linkSect && entry->real == realSect );
+}
+
+
+/*
+ * adfLinkCacheInvalidate
+ *
+ */
+void adfLinkCacheInvalidate( struct AdfVolume * const        vol,
+                             const ADF_SECTNUM               nSect,
+                             const unsigned                  nBlocks )
+{
+    struct AdfLinkCache * const cache = vol->linkCache;
+    if ( cache == NULL || cache->nItems == 0 )
+        return;
+
+    const uint32_t first = (uint32_t) nSect;
+    for ( unsigned i = 0 ; i < ADF_LINK_CACHE_SIZE ; i++ ) {
+        struct AdfLinkCacheEntry * const entry = &cache->entries[ i ];
+        if ( entry->link == 0 )
+            continue;
+        if ( (uint32_t) entry->link - first < nBlocks ||
+             (uint32_t) entry->real - first < nBlocks )
+        {
+            entry->link = 0;
+            cache->nItems--;
+        }
+    }
+}
+
+
+/*
+ * adfLinkCacheFree
+ *
+ */
+void adfLinkCacheFree( struct AdfVolume * const  vol )
+{
+    free( vol->linkCache );
+    vol->linkCache = NULL;
+}
+
+
 #if defined (__ANY_IDEA_WHAT_IS_THIS_FOR__)
 // the code below is not used anywhere and seems unfinished
 // (not clear what it was meant for...)
@@ -26,10 +26,47 @@
 #ifndef ADF_LINK_H
 #define ADF_LINK_H
 
+#include "adf_blk.h"
 #include "adf_prefix.h"
 #include "adf_types.h"
 #include "adf_vol.h"
 
+
+/*
+ * Hard link target cache (per volume)
+ *
+ * Maps sectors of hard links (ADF_ST_LFILE, ADF_ST_LDIR) to the real entries
+ * (their sectors and blocks), so that resolving a link does not read
+ * the real entry block every time. The cache is direct-mapped (a new target
+ * replaces the one in its slot) and allocated on first use. An entry is
+ * dropped when the link or the real entry block is written.
+ */
+
+#define ADF_LINK_CACHE_SIZE  256
+
+/* get the real entry block of a link (its sector is realSect) */
+ADF_RETCODE adfLinkGetTarget( struct AdfVolume * const      vol,
+                              const ADF_SECTNUM             linkSect,
+                              const ADF_SECTNUM             realSect,
+                              struct AdfEntryBlock * const  real );
+
+/* put a (just read) real entry block of a link in the cache */
+void adfLinkCacheAdd( struct AdfVolume * const            vol,
+                      const ADF_SECTNUM                   linkSect,
+                      const ADF_SECTNUM                   realSect,
+                      const struct AdfEntryBlock * const  real );
+
+bool adfLinkCacheHas( const struct AdfVolume * const  vol,
+                      const ADF_SECTNUM               linkSect,
+                      const ADF_SECTNUM               realSect );
+
+/* drop entries of nBlocks blocks from nSect (being written) */
+void adfLinkCacheInvalidate( struct AdfVolume * const        vol,
+                             const ADF_SECTNUM               nSect,
+                             const unsigned                  nBlocks );
+
+void adfLinkCacheFree( struct AdfVolume * const  vol );
+
 #if defined (__ANY_IDEA_WHAT_IS_THIS_FOR__)
 // the code below is not used anywhere and seems unfinished
 // (not clear what it was meant for...)
@@ -116,7 +116,7 @@ ADF_RETCODE adfReadRootBlock( struct AdfVolume * const     vol,
 {
     uint8_t buf[ ADF_LOGICAL_BLOCK_SIZE ];
 
-    ADF_RETCODE rc = adfVolReadBlock( vol, nSect, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, nSect, buf, ADF_STATS_BLOCK_ROOT );
     if ( rc != ADF_RC_OK )
         return rc;
 
@@ -183,7 +183,7 @@ ADF_RETCODE adfWriteRootBlock( struct AdfVolume * const     vol,
     swapUint32ToPtr( buf + 20, newSum );
 /*	*(uint32_t*)(buf+20) = swapUint32fromPtr((uint8_t*)&newSum);*/
 /* 	dumpBlock(buf);*/
-    return adfVolWriteBlock( vol, nSect, buf );
+    return adfVolWriteBlockOfType( vol, nSect, buf, ADF_STATS_BLOCK_ROOT );
 }
 
 
@@ -198,11 +198,11 @@ ADF_RETCODE adfReadBootBlock( struct AdfVolume * const     vol,
     uint8_t buf[ 1024 ];
 	
 /*puts("22");*/
-    ADF_RETCODE rc = adfVolReadBlock( vol, 0, buf );
+    ADF_RETCODE rc = adfVolReadBlockOfType( vol, 0, buf, ADF_STATS_BLOCK_BOOT );
     if ( rc != ADF_RC_OK )
         return rc;
 /*puts("11");*/
-    rc = adfVolReadBlock( vol, 1, buf + ADF_LOGICAL_BLOCK_SIZE );
+    rc = adfVolReadBlockOfType( vol, 1, buf + ADF_LOGICAL_BLOCK_SIZE, ADF_STATS_BLOCK_BOOT );
     if ( rc != ADF_RC_OK )
         return rc;
 
@@ -275,11 +275,11 @@ ADF_RETCODE adfWriteBootBlock( struct AdfVolume * const     vol,
 	dumpBlock(buf+512);
 */
 
-    ADF_RETCODE rc = adfVolWriteBlock( vol, 0, buf );
+    ADF_RETCODE rc = adfVolWriteBlockOfType( vol, 0, buf, ADF_STATS_BLOCK_BOOT );
     if ( rc != ADF_RC_OK )
         return rc;
 
-    rc = adfVolWriteBlock( vol, 1, buf + 512 );
+    rc = adfVolWriteBlockOfType( vol, 1, buf + 512, ADF_STATS_BLOCK_BOOT );
     if (rc != ADF_RC_OK )
         return rc;
 
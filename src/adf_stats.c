@@ -0,0 +1,97 @@
+/*
+ *  adf_stats.c - I/O statistics
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* clock_gettime() */
+#endif
+
+#include "adf_stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <time.h>
+
+
+/*
+ * adfStatsBlockTypeName
+ *
+ */
+const char * adfStatsBlockTypeName( const AdfStatsBlockType  type )
+{
+    static const char * const names[ ADF_STATS_BLOCK_TYPES ] = {
+        "boot", "root", "bitmap", "header", "ext", "data", "dircache", "other"
+    };
+    return ( (unsigned) type < ADF_STATS_BLOCK_TYPES ) ? names[ type ] : "???";
+}
+
+
+/*
+ * adfStatsClockNs
+ *
+ */
+uint64_t adfStatsClockNs( void )
+{
+#if defined _WIN32
+    LARGE_INTEGER freq, count;
+    if ( QueryPerformanceFrequency( &freq ) && QueryPerformanceCounter( &count ) )
+        return (uint64_t) ( (double) count.QuadPart * 1e9 / (double) freq.QuadPart );
+#elif defined HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    if ( clock_gettime( CLOCK_MONOTONIC, &ts ) == 0 )
+        return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+    return (uint64_t) ( (double) clock() * 1e9 / CLOCKS_PER_SEC );
+}
+
+
+/*
+ * adfIoStatsAdd
+ *
+ */
+void adfIoStatsAdd( struct AdfIoStats * const  stats,
+                    const uint32_t             nBlocks,
+                    const uint32_t             blockSize,
+                    const uint64_t             startNs,
+                    const ADF_RETCODE          rc )
+{
+    const uint64_t endNs = adfStatsClockNs(),
+                   ns    = ( endNs > startNs ) ? endNs - startNs : 0;
+
+    stats->ops++;
+    if ( nBlocks == 1 )
+        stats->singleOps++;
+    stats->blocks += nBlocks;
+    stats->bytes  += (uint64_t) nBlocks * blockSize;
+    if ( rc != ADF_RC_OK )
+        stats->errors++;
+    stats->timeNs += ns;
+    if ( ns > stats->maxNs )
+        stats->maxNs = ns;
+
+    unsigned bucket = 0;
+    for ( uint64_t us = ns / 1000 ; us > 0 && bucket < ADF_STATS_LATENCY_BUCKETS - 1 ;
+          us >>= 1 )
+        bucket++;
+    stats->latency[ bucket ]++;
+}
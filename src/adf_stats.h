@@ -0,0 +1,95 @@
+/*
+ *  adf_stats.h - I/O statistics
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_STATS_H
+#define ADF_STATS_H
+
+#include "adf_err.h"
+#include "adf_prefix.h"
+
+#include <stdint.h>
+
+/*
+ * I/O statistics of a device (counted at the driver calls, ie. the real
+ * I/O, after the write-back buffer) and of a volume (counted at block
+ * reads/writes of the volume, ie. as requested by the library).
+ *
+ * See adfDevGetStats() / adfDevResetStats() and
+ *     adfVolGetStats() / adfVolResetStats().
+ */
+
+/* latency histogram: latency[ 0 ] counts operations shorter than 1 us,
+   latency[ i ] - those of 2^(i-1) to 2^i us, the last one - all longer */
+#define ADF_STATS_LATENCY_BUCKETS  24
+
+struct AdfIoStats {
+    uint64_t  ops,             /* operations (calls) */
+              singleOps,       /* ...of them, of a single block (the others
+                                  transfer more, coalesced, blocks at once) */
+              blocks,          /* blocks transferred */
+              bytes,
+              errors,          /* operations which failed */
+              timeNs,          /* total time of all operations */
+              maxNs;           /* the longest operation */
+    uint64_t  latency[ ADF_STATS_LATENCY_BUCKETS ];
+};
+
+/* types of volume's blocks (as accessed by the library) */
+typedef enum {
+    ADF_STATS_BLOCK_BOOT,
+    ADF_STATS_BLOCK_ROOT,
+    ADF_STATS_BLOCK_BITMAP,      /* bitmap and bitmap extension blocks */
+    ADF_STATS_BLOCK_HEADER,      /* file, directory and link headers */
+    ADF_STATS_BLOCK_EXT,         /* file extension blocks */
+    ADF_STATS_BLOCK_DATA,
+    ADF_STATS_BLOCK_DIRCACHE,
+    ADF_STATS_BLOCK_OTHER,       /* not known (eg. accessed directly with
+                                    adfVolReadBlock/adfVolWriteBlock) */
+    ADF_STATS_BLOCK_TYPES
+} AdfStatsBlockType;
+
+struct AdfDevStats {
+    struct AdfIoStats  read,
+                       write;
+};
+
+struct AdfVolStats {
+    struct AdfIoStats  read,
+                       write;
+    uint64_t           blocksRead[ ADF_STATS_BLOCK_TYPES ],
+                       blocksWritten[ ADF_STATS_BLOCK_TYPES ];
+};
+
+ADF_PREFIX const char * adfStatsBlockTypeName( const AdfStatsBlockType  type );
+
+/* (internal) a monotonic clock, in nanoseconds (from an arbitrary point) */
+uint64_t adfStatsClockNs( void );
+
+/* (internal) count an operation started at startNs (with adfStatsClockNs) */
+void adfIoStatsAdd( struct AdfIoStats * const  stats,
+                    const uint32_t             nBlocks,
+                    const uint32_t             blockSize,
+                    const uint64_t             startNs,
+                    const ADF_RETCODE          rc );
+
+#endif  /* ADF_STATS_H */
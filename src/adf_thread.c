@@ -0,0 +1,284 @@
+/*
+ *  adf_thread.c - minimal threading support (internal)
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "adf_thread.h"
+
+#include <stdlib.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+struct AdfMutex {
+    pthread_mutex_t  mutex;
+};
+
+struct AdfCond {
+    pthread_cond_t  cond;
+};
+#endif
+
+
+/*
+ * adfMutexCreate
+ *
+ */
+struct AdfMutex * adfMutexCreate( void )
+{
+#ifdef HAVE_PTHREAD
+    struct AdfMutex * const mutex = (struct AdfMutex *)
+        malloc( sizeof(struct AdfMutex) );
+    if ( mutex == NULL )
+        return NULL;
+    if ( pthread_mutex_init( &mutex->mutex, NULL ) != 0 ) {
+        free( mutex );
+        return NULL;
+    }
+    return mutex;
+#else
+    return NULL;
+#endif
+}
+
+
+/*
+ * adfMutexDestroy
+ *
+ */
+void adfMutexDestroy( struct AdfMutex * const  mutex )
+{
+#ifdef HAVE_PTHREAD
+    if ( mutex == NULL )
+        return;
+    pthread_mutex_destroy( &mutex->mutex );
+    free( mutex );
+#else
+    (void) mutex;
+#endif
+}
+
+
+/*
+ * adfMutexLock
+ *
+ */
+void adfMutexLock( struct AdfMutex * const  mutex )
+{
+#ifdef HAVE_PTHREAD
+    if ( mutex != NULL )
+        pthread_mutex_lock( &mutex->mutex );
+#else
+    (void) mutex;
+#endif
+}
+
+
+/*
+ * adfMutexUnlock
+ *
+ */
+void adfMutexUnlock( struct AdfMutex * const  mutex )
+{
+#ifdef HAVE_PTHREAD
+    if ( mutex != NULL )
+        pthread_mutex_unlock( &mutex->mutex );
+#else
+    (void) mutex;
+#endif
+}
+
+
+/*
+ * adfCondCreate
+ *
+ */
+struct AdfCond * adfCondCreate( void )
+{
+#ifdef HAVE_PTHREAD
+    struct AdfCond * const cond = (struct AdfCond *)
+        malloc( sizeof(struct AdfCond) );
+    if ( cond == NULL )
+        return NULL;
+    if ( pthread_cond_init( &cond->cond, NULL ) != 0 ) {
+        free( cond );
+        return NULL;
+    }
+    return cond;
+#else
+    return NULL;
+#endif
+}
+
+
+/*
+ * adfCondDestroy
+ *
+ */
+void adfCondDestroy( struct AdfCond * const  cond )
+{
+#ifdef HAVE_PTHREAD
+    if ( cond == NULL )
+        return;
+    pthread_cond_destroy( &cond->cond );
+    free( cond );
+#else
+    (void) cond;
+#endif
+}
+
+
+/*
+ * adfCondWait
+ *
+ */
+void adfCondWait( struct AdfCond * const   cond,
+                  struct AdfMutex * const  mutex )
+{
+#ifdef HAVE_PTHREAD
+    if ( cond != NULL && mutex != NULL )
+        pthread_cond_wait( &cond->cond, &mutex->mutex );
+#else
+    (void) cond;
+    (void) mutex;
+#endif
+}
+
+
+/*
+ * adfCondBroadcast
+ *
+ */
+void adfCondBroadcast( struct AdfCond * const  cond )
+{
+#ifdef HAVE_PTHREAD
+    if ( cond != NULL )
+        pthread_cond_broadcast( &cond->cond );
+#else
+    (void) cond;
+#endif
+}
+
+
+#ifdef HAVE_PTHREAD
+
+struct AdfThreadStart {
+    AdfThreadFct  fct;
+    void *        arg;
+};
+
+static void * adfThreadStart_( void * const  start )
+{
+    const struct AdfThreadStart * const s = start;
+    s->fct( s->arg );
+    return NULL;
+}
+
+#endif
+
+
+/*
+ * adfThreadsRun
+ *
+ */
+unsigned adfThreadsRun( const unsigned      nThreads,
+                        const AdfThreadFct  fct,
+                        void * const        arg )
+{
+#ifdef HAVE_PTHREAD
+    struct AdfThreadStart start = { .fct = fct, .arg = arg };
+    pthread_t threads[ ADF_THREADS_MAX ];
+
+    unsigned nStarted = 0;
+    const unsigned nToStart = ( nThreads > ADF_THREADS_MAX ?
+                                ADF_THREADS_MAX : nThreads );
+    while ( nStarted + 1 < nToStart ) {
+        if ( pthread_create( &threads[ nStarted ], NULL,
+                             adfThreadStart_, &start ) != 0 )
+            break;     /* continue with the threads already started */
+        nStarted++;
+    }
+
+    fct( arg );
+
+    for ( unsigned i = 0 ; i < nStarted ; i++ )
+        pthread_join( threads[ i ], NULL );
+
+    return nStarted + 1;
+#else
+    (void) nThreads;
+    fct( arg );
+    return 1;
+#endif
+}
+
+
+#ifdef HAVE_PTHREAD
+struct AdfThread {
+    pthread_t              thread;
+    struct AdfThreadStart  start;
+};
+#endif
+
+
+/*
+ * adfThreadStart
+ *
+ */
+struct AdfThread * adfThreadStart( const AdfThreadFct  fct,
+                                   void * const        arg )
+{
+#ifdef HAVE_PTHREAD
+    struct AdfThread * const thread = (struct AdfThread *)
+        malloc( sizeof(struct AdfThread) );
+    if ( thread == NULL )
+        return NULL;
+    thread->start.fct = fct;
+    thread->start.arg = arg;
+    if ( pthread_create( &thread->thread, NULL,
+                         adfThreadStart_, &thread->start ) != 0 )
+    {
+        free( thread );
+        return NULL;
+    }
+    return thread;
+#else
+    (void) fct, (void) arg;
+    return NULL;
+#endif
+}
+
+
+/*
+ * adfThreadJoin
+ *
+ */
+void adfThreadJoin( struct AdfThread * const  thread )
+{
+#ifdef HAVE_PTHREAD
+    if ( thread == NULL )
+        return;
+    pthread_join( thread->thread, NULL );
+    free( thread );
+#else
+    (void) thread;
+#endif
+}
@@ -0,0 +1,93 @@
+/*
+ *  adf_thread.h - minimal threading support (internal)
+ *
+ *  Copyright (C) 2023-2025 Tomasz Wolak
+ *
+ *  This file is part of ADFLib.
+ *
+ *  ADFLib is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ADFLib is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ADFLib; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ADF_THREAD_H
+#define ADF_THREAD_H
+
+#include <stdbool.h>
+
+/*
+ * Threads are used only if the library is built with pthreads (HAVE_PTHREAD).
+ * Otherwise all operations below are no-ops (mutexes and conditions are NULL)
+ * and adfThreadsRun() simply calls the function once, in the caller's thread.
+ *
+ * All functions accept NULL mutex/condition (then do nothing), so code using
+ * them does not need any conditional compilation.
+ */
+
+/* max. number of threads started by adfThreadsRun() */
+#define ADF_THREADS_MAX  64
+
+struct AdfMutex;
+struct AdfCond;
+struct AdfThread;
+
+typedef void (*AdfThreadFct)( void * const  arg );
+
+
+static inline bool adfThreadsAvailable( void )
+{
+#ifdef HAVE_PTHREAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+struct AdfMutex * adfMutexCreate( void );
+void adfMutexDestroy( struct AdfMutex * const  mutex );
+void adfMutexLock( struct AdfMutex * const  mutex );
+void adfMutexUnlock( struct AdfMutex * const  mutex );
+
+struct AdfCond * adfCondCreate( void );
+void adfCondDestroy( struct AdfCond * const  cond );
+void adfCondWait( struct AdfCond * const   cond,
+                  struct AdfMutex * const  mutex );
+void adfCondBroadcast( struct AdfCond * const  cond );
+
+
+/*
+ * adfThreadsRun
+ *
+ * Runs fct( arg ) in nThreads (max. ADF_THREADS_MAX) threads (the caller's
+ * thread is one of them) and waits until all of them finish.
+ *
+ * Returns the number of threads that actually run fct() (at least 1).
+ */
+unsigned adfThreadsRun( const unsigned      nThreads,
+                        const AdfThreadFct  fct,
+                        void * const        arg );
+
+
+/*
+ * adfThreadStart / adfThreadJoin
+ *
+ * Starts fct( arg ) in a new (background) thread; returns NULL if failed
+ * (always without pthreads - then the caller must do the work itself).
+ * adfThreadJoin() waits until the thread finishes (and frees it).
+ */
+struct AdfThread * adfThreadStart( const AdfThreadFct  fct,
+                                   void * const        arg );
+void adfThreadJoin( struct AdfThread * const  thread );
+
+#endif  /* ADF_THREAD_H */
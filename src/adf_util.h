@@ -33,7 +33,11 @@
 #include "config.h"   // include config. header generated by autotools
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>   // for min(), max() on Windows/MSVC
+#if defined HAVE_FSEEKO && ! defined _WIN32
+#include <sys/types.h>
+#endif
 
 struct DateTime {
     int year, mon, day, hour, min, sec;
@@ -68,6 +72,22 @@ struct DateTime {
 #endif
 
 
+/* stdio with 64-bit file offsets, where available (see adf_limits.h) */
+#if defined _WIN32
+typedef __int64  AdfFileOffset;
+#define adfFSeek  _fseeki64
+#define adfFTell  _ftelli64
+#elif defined HAVE_FSEEKO
+typedef off_t    AdfFileOffset;
+#define adfFSeek  fseeko
+#define adfFTell  ftello
+#else
+typedef long     AdfFileOffset;
+#define adfFSeek  fseek
+#define adfFTell  ftell
+#endif
+
+
 /* swap short and swap long macros for little endian machines */
 
 static inline uint16_t swapUint16( const uint16_t n ) {
@@ -28,7 +28,9 @@
 #include "adf_cache.h"
 #include "adf_dev.h"
 #include "adf_env.h"
+#include "adf_link.h"
 #include "adf_raw.h"
+#include "adf_thread.h"
 #include "adf_util.h"
 
 #include <limits.h>
@@ -36,6 +38,14 @@
 #include <string.h>
 
 
+static void adfVolStatsAdd_( const struct AdfVolume * const  vol,
+                             const bool                      write,
+                             const unsigned                  nBlocks,
+                             const uint64_t                  startNs,
+                             const ADF_RETCODE               rc,
+                             const AdfStatsBlockType         type );
+
+
 uint32_t bitMask[ 32 ] = {
     0x1, 0x2, 0x4, 0x8,
     0x10, 0x20, 0x40, 0x80,
@@ -83,6 +93,8 @@ struct AdfVolume * adfVolCreate( struct AdfDevice * const  dev,
     vol->curDirPtr = vol->rootBlock;
     vol->readOnly  = dev->readOnly;
     vol->mounted   = true;
+    vol->linkCache = NULL;
+    vol->stats     = NULL;     /* (only of mounted volumes) */
     vol->volName   = strndup( volName,
                               min( strlen( volName ),
                                    (unsigned) ADF_MAX_NAME_LEN ) );
@@ -231,7 +243,9 @@ struct AdfVolume * adfVolMount( struct AdfDevice * const  dev,
         return NULL;
     }
 
-    vol->mounted = true;
+    vol->mounted   = true;
+    vol->linkCache = NULL;
+    vol->stats     = calloc( 1, sizeof(struct AdfVolStats) );
 
 /*printf("first=%ld last=%ld root=%ld\n",vol->firstBlock,
  vol->lastBlock, vol->rootBlock);
@@ -246,19 +260,13 @@ struct AdfVolume * adfVolMount( struct AdfDevice * const  dev,
     struct AdfRootBlock root;
     if ( adfReadRootBlock( vol, (uint32_t) vol->rootBlock, &root ) != ADF_RC_OK ) {
         adfEnv.eFct( "%s: invalid RootBlock, sector %u", __func__, vol->rootBlock );
+        free( vol->stats );
+        vol->stats   = NULL;
         vol->mounted = false;
         return NULL;
     }
 
-    ADF_RETCODE rc = adfBitmapAllocate( vol );
-    if ( rc != ADF_RC_OK ) {
-            adfEnv.eFct( "%s: adfBitmapAllocate() returned error %d, "
-                         "mounting volume %s failed", __func__, rc, vol->volName );
-            adfVolUnMount( vol );
-            return NULL;
-    }
-
-    rc = adfReadBitmap( vol, &root );
+    ADF_RETCODE rc = adfReadBitmap( vol, &root );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: adfReadBitmap() returned error %d, "
                      "mounting volume %s failed", __func__, rc, vol->volName );
@@ -266,6 +274,17 @@ struct AdfVolume * adfVolMount( struct AdfDevice * const  dev,
         return NULL;
     }
 
+    /* read-only: bitmap pages are read when (if) needed */
+    if ( ! vol->readOnly ) {
+        rc = adfBitmapLoad( vol );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: adfBitmapLoad() returned error %d, "
+                         "mounting volume %s failed", __func__, rc, vol->volName );
+            adfVolUnMount( vol );
+            return NULL;
+        }
+    }
+
     /*
     if ( root.bmFlag != ADF_BM_VALID ) {
         if ( vol->readOnly == true ) {
@@ -314,6 +333,13 @@ ADF_RETCODE adfVolRemount( struct AdfVolume *   vol,
                          "volume '%s' read-write", __func__, vol->volName );
             return ADF_RC_ERROR;
         }
+        /* the whole bitmap must be available for writing */
+        const ADF_RETCODE rc = adfBitmapLoad( vol );
+        if ( rc != ADF_RC_OK ) {
+            adfEnv.eFct( "%s: cannot read bitmap of volume '%s', error %d",
+                         __func__, vol->volName, rc );
+            return rc;
+        }
         vol->readOnly = false;
     } else if ( mode == ADF_ACCESS_MODE_READONLY ) {
         vol->readOnly = true;
@@ -338,11 +364,37 @@ void adfVolUnMount( struct AdfVolume * const  vol )
         return;
     }
 
+    if ( vol->bitmap.updatesDeferred > 0 ) {
+        adfEnv.wFct( "%s: committing deferred bitmap updates", __func__ );
+        vol->bitmap.updatesDeferred = 0;
+        if ( adfUpdateBitmap( vol ) != ADF_RC_OK )
+            adfEnv.eFct( "%s: error writing the bitmap", __func__ );
+    }
+
     adfFreeBitmap( vol );
+    adfLinkCacheFree( vol );
+    free( vol->stats );
+    vol->stats = NULL;
+
+    if ( ! vol->readOnly ) {
+        if ( adfDevFlush( vol->dev ) != ADF_RC_OK )
+            adfEnv.eFct( "%s: error writing buffered blocks", __func__ );
+        if ( adfDevSyncPoint( vol->dev, ADF_SYNC_UNMOUNT ) != ADF_RC_OK )
+            adfEnv.eFct( "%s: error syncing volume '%s'", __func__, vol->volName );
+    }
 
     vol->mounted = false;
 }
 
+/*
+ * adfVolSync
+ *
+ */
+ADF_RETCODE adfVolSync( struct AdfVolume * const  vol )
+{
+    return adfDevSync( vol->dev );
+}
+
 /*
  * adfVolInstallBootBlock
  *
@@ -395,6 +447,18 @@ bool adfVolIsSectNumValid( const struct AdfVolume * const  vol,
 ADF_RETCODE adfVolReadBlock( const struct AdfVolume * const  vol,
                              const uint32_t                  nSect,
                              uint8_t * const                 buf )
+{
+    return adfVolReadBlockOfType( vol, nSect, buf, ADF_STATS_BLOCK_OTHER );
+}
+
+/*
+ * adfVolReadBlockOfType
+ *
+ */
+ADF_RETCODE adfVolReadBlockOfType( const struct AdfVolume * const  vol,
+                                   const uint32_t                  nSect,
+                                   uint8_t * const                 buf,
+                                   const AdfStatsBlockType         type )
 {
     if ( ! vol->mounted ) {
         adfEnv.eFct( "%s: volume not mounted", __func__ );
@@ -419,7 +483,9 @@ ADF_RETCODE adfVolReadBlock( const struct AdfVolume * const  vol,
         return ADF_RC_BLOCKOUTOFRANGE;
     }
 
-    ADF_RETCODE rc = adfDevReadBlock( vol->dev, pSect, 512, buf );
+    const uint64_t start = adfStatsClockNs();
+    ADF_RETCODE rc = adfDevReadBlockOfType( vol->dev, pSect, 512, buf, type );
+    adfVolStatsAdd_( vol, false, 1, start, rc, type );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error reading block %d, volume '%s'",
                      __func__, nSect, vol->volName );
@@ -427,13 +493,88 @@ ADF_RETCODE adfVolReadBlock( const struct AdfVolume * const  vol,
     return rc;
 }
 
+/*
+ * adfVolReadBlocks
+ *
+ * read nBlocks (not necessarily consecutive) blocks, in as few device
+ * reads as possible (see adfDevReadBlocks)
+ */
+ADF_RETCODE adfVolReadBlocks( const struct AdfVolume * const  vol,
+                              const unsigned                  nBlocks,
+                              const uint32_t * const          nSects,
+                              uint8_t * const * const         bufs )
+{
+    return adfVolReadBlocksOfType( vol, nBlocks, nSects, bufs, ADF_STATS_BLOCK_OTHER );
+}
+
+/*
+ * adfVolReadBlocksOfType
+ *
+ */
+ADF_RETCODE adfVolReadBlocksOfType( const struct AdfVolume * const  vol,
+                                    const unsigned                  nBlocks,
+                                    const uint32_t * const          nSects,
+                                    uint8_t * const * const         bufs,
+                                    const AdfStatsBlockType         type )
+{
+    if ( ! vol->mounted ) {
+        adfEnv.eFct( "%s: volume not mounted", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    uint32_t * const pSects = (uint32_t *) malloc( sizeof(uint32_t) * nBlocks );
+    if ( pSects == NULL ) {
+        adfEnv.eFct( "%s: malloc", __func__ );
+        return ADF_RC_MALLOC;
+    }
+
+    /* translate logical sect to physical sect */
+    for ( unsigned i = 0 ; i < nBlocks ; i++ ) {
+        pSects[ i ] = nSects[ i ] + (unsigned) vol->firstBlock;
+
+        if ( adfEnv.useRWAccess )
+            adfEnv.rwhAccess( (ADF_SECTNUM) pSects[ i ], (ADF_SECTNUM) nSects[ i ], false );
+
+        if ( pSects[ i ] < (unsigned) vol->firstBlock ||
+             pSects[ i ] > (unsigned) vol->lastBlock )
+        {
+            adfEnv.wFct( "%s: nSect %u out of range", __func__, nSects[ i ] );
+            free( pSects );
+            return ADF_RC_BLOCKOUTOFRANGE;
+        }
+    }
+
+    const uint64_t start = adfStatsClockNs();
+    ADF_RETCODE rc = adfDevReadBlocksOfType( vol->dev, nBlocks, pSects, bufs, type );
+    adfVolStatsAdd_( vol, false, nBlocks, start, rc, type );
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error reading %u blocks, volume '%s'",
+                     __func__, nBlocks, vol->volName );
+    }
+    free( pSects );
+    return rc;
+}
+
+
 /*
  * adfVolWriteBlock
  *
  */
-ADF_RETCODE adfVolWriteBlock( const struct AdfVolume * const  vol,
+ADF_RETCODE adfVolWriteBlock( struct AdfVolume * const        vol,
                               const uint32_t                  nSect,
                               const uint8_t * const           buf )
+{
+    return adfVolWriteBlockOfType( vol, nSect, buf, ADF_STATS_BLOCK_OTHER );
+}
+
+/*
+ * adfVolWriteBlockOfType
+ *
+ */
+ADF_RETCODE adfVolWriteBlockOfType( struct AdfVolume * const        vol,
+                                    const uint32_t                  nSect,
+                                    const uint8_t * const           buf,
+                                    const AdfStatsBlockType         type )
 {
     if ( ! vol->mounted ) {
         adfEnv.eFct( "%s: volume not mounted", __func__ );
@@ -458,7 +599,11 @@ ADF_RETCODE adfVolWriteBlock( const struct AdfVolume * const  vol,
         return ADF_RC_BLOCKOUTOFRANGE;
     }
 
-    ADF_RETCODE rc = adfDevWriteBlock( vol->dev, pSect, 512, buf );
+    adfLinkCacheInvalidate( vol, (ADF_SECTNUM) nSect, 1 );
+
+    const uint64_t start = adfStatsClockNs();
+    ADF_RETCODE rc = adfDevWriteBlockOfType( vol->dev, pSect, 512, buf, type );
+    adfVolStatsAdd_( vol, true, 1, start, rc, type );
     if ( rc != ADF_RC_OK ) {
         adfEnv.eFct( "%s: error writing block %d, volume '%s'",
                      __func__, nSect, vol->volName );
@@ -466,6 +611,122 @@ ADF_RETCODE adfVolWriteBlock( const struct AdfVolume * const  vol,
     return rc;
 }
 
+
+/*
+ * adfVolWriteBlockRun
+ *
+ * write nBlocks consecutive blocks (in one device write)
+ */
+ADF_RETCODE adfVolWriteBlockRun( struct AdfVolume * const        vol,
+                                 const uint32_t                  nSect,
+                                 const unsigned                  nBlocks,
+                                 const uint8_t * const           buf )
+{
+    return adfVolWriteBlockRunOfType( vol, nSect, nBlocks, buf, ADF_STATS_BLOCK_OTHER );
+}
+
+/*
+ * adfVolWriteBlockRunOfType
+ *
+ */
+ADF_RETCODE adfVolWriteBlockRunOfType( struct AdfVolume * const        vol,
+                                       const uint32_t                  nSect,
+                                       const unsigned                  nBlocks,
+                                       const uint8_t * const           buf,
+                                       const AdfStatsBlockType         type )
+{
+    if ( ! vol->mounted ) {
+        adfEnv.eFct( "%s: volume not mounted", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    if ( vol->readOnly ) {
+        adfEnv.wFct( "%s: can't write blocks, read only volume", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    const unsigned pSect = nSect + (unsigned) vol->firstBlock;
+
+    if ( adfEnv.useRWAccess )
+        for ( unsigned i = 0 ; i < nBlocks ; i++ )
+            adfEnv.rwhAccess( (ADF_SECTNUM) ( pSect + i ),
+                              (ADF_SECTNUM) ( nSect + i ), true );
+
+    if ( nBlocks == 0 ||
+         pSect < (unsigned) vol->firstBlock ||
+         pSect + nBlocks - 1 > (unsigned) vol->lastBlock )
+    {
+        adfEnv.wFct( "%s: blocks %u-%u out of range",
+                     __func__, nSect, nSect + nBlocks - 1 );
+        return ADF_RC_BLOCKOUTOFRANGE;
+    }
+
+    adfLinkCacheInvalidate( vol, (ADF_SECTNUM) nSect, nBlocks );
+
+    const uint64_t start = adfStatsClockNs();
+    ADF_RETCODE rc = adfDevWriteBlockOfType( vol->dev, pSect, 512 * nBlocks, buf, type );
+    adfVolStatsAdd_( vol, true, nBlocks, start, rc, type );
+    if ( rc != ADF_RC_OK ) {
+        adfEnv.eFct( "%s: error writing blocks %u-%u, volume '%s'",
+                     __func__, nSect, nSect + nBlocks - 1, vol->volName );
+    }
+    return rc;
+}
+
+/*
+ * adfVolGetStats
+ *
+ */
+ADF_RETCODE adfVolGetStats( const struct AdfVolume * const  vol,
+                            struct AdfVolStats * const      stats )
+{
+    if ( vol->stats == NULL ) {
+        memset( stats, 0, sizeof(struct AdfVolStats) );
+        return ADF_RC_ERROR;
+    }
+    adfMutexLock( vol->dev->ioLock );
+    *stats = *vol->stats;
+    adfMutexUnlock( vol->dev->ioLock );
+    return ADF_RC_OK;
+}
+
+/*
+ * adfVolResetStats
+ *
+ */
+void adfVolResetStats( struct AdfVolume * const  vol )
+{
+    if ( vol->stats == NULL )
+        return;
+    adfMutexLock( vol->dev->ioLock );
+    memset( vol->stats, 0, sizeof(struct AdfVolStats) );
+    adfMutexUnlock( vol->dev->ioLock );
+}
+
+/*
+ * adfVolStatsAdd_
+ *
+ * count a read/write of nBlocks blocks of the given type
+ * (under dev->ioLock - blocks are read also by worker threads)
+ */
+static void adfVolStatsAdd_( const struct AdfVolume * const  vol,
+                             const bool                      write,
+                             const unsigned                  nBlocks,
+                             const uint64_t                  startNs,
+                             const ADF_RETCODE               rc,
+                             const AdfStatsBlockType         type )
+{
+    struct AdfVolStats * const stats = vol->stats;
+    if ( stats == NULL )
+        return;
+    adfMutexLock( vol->dev->ioLock );
+    adfIoStatsAdd( write ? &stats->write : &stats->read,
+                   nBlocks, vol->blockSize, startNs, rc );
+    if ( rc == ADF_RC_OK )
+        ( write ? stats->blocksWritten : stats->blocksRead )[ type ] += nBlocks;
+    adfMutexUnlock( vol->dev->ioLock );
+}
+
 /*
  * adfVolGetFsStr
  *
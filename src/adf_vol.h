@@ -29,6 +29,7 @@
 #include "adf_types.h"
 #include "adf_err.h"
 #include "adf_prefix.h"
+#include "adf_stats.h"
 #include "adf_str.h"
 
 #include <string.h>
@@ -37,11 +38,18 @@
 
 struct AdfBitmap {
     uint32_t                  size;         /* in blocks */
-    ADF_SECTNUM *             blocks;       /* bitmap blocks pointers */
-    struct AdfBitmapBlock **  table;
+    ADF_SECTNUM *             blocks;       /* bitmap blocks pointers
+                                               (0 - not read yet) */
+    struct AdfBitmapBlock **  table;        /* NULL - page not read yet */
     bool *                    blocksChg;
+    ADF_SECTNUM               extBlock;     /* 1st bitmap ext. block */
+    unsigned                  updatesDeferred;  /* > 0 -> adfUpdateBitmap()
+                                                   only keeps changes in memory
+                                                   (see adfBitmapDeferUpdates()) */
 };
 
+struct AdfLinkCache;
+
 struct AdfVolume {
     struct AdfDevice *
                  dev;
@@ -69,6 +77,13 @@ struct AdfVolume {
                  bitmap;
 
     ADF_SECTNUM  curDirPtr;
+
+    struct AdfLinkCache *
+                 linkCache;      /* hard link targets (see adf_link.h) */
+
+    struct AdfVolStats *
+                 stats;          /* I/O statistics (NULL if not collected),
+                                    see adfVolGetStats */
 };
 
 
@@ -91,6 +106,10 @@ ADF_PREFIX ADF_RETCODE adfVolRemount( struct AdfVolume *   vol,
 /* unmount a volume */
 ADF_PREFIX void adfVolUnMount( struct AdfVolume * const  vol );
 
+/* make the data written on the volume durable - see adfDevSync()
+   (and AdfSyncPolicy for syncing done automatically) */
+ADF_PREFIX ADF_RETCODE adfVolSync( struct AdfVolume * const  vol );
+
 /* write the provided bootblock to volume */
 ADF_PREFIX ADF_RETCODE adfVolInstallBootBlock( struct AdfVolume * const  vol,
                                                const uint8_t * const     code );
@@ -104,11 +123,60 @@ ADF_PREFIX ADF_RETCODE adfVolReadBlock( const struct AdfVolume * const  vol,
                                         const uint32_t                  nSect,
                                         uint8_t * const                 buf );
 
+/* read volume's blocks (any, coalescing reads of those close to each other) */
+ADF_PREFIX ADF_RETCODE adfVolReadBlocks( const struct AdfVolume * const  vol,
+                                         const unsigned                  nBlocks,
+                                         const uint32_t * const          nSects,
+                                         uint8_t * const * const         bufs );
+
 /* write volume's block */
-ADF_PREFIX ADF_RETCODE adfVolWriteBlock( const struct AdfVolume * const  vol,
+ADF_PREFIX ADF_RETCODE adfVolWriteBlock( struct AdfVolume * const        vol,
                                          const uint32_t                  nSect,
                                          const uint8_t * const           buf );
 
+/* write nBlocks consecutive volume's blocks, starting from nSect */
+ADF_PREFIX ADF_RETCODE adfVolWriteBlockRun( struct AdfVolume * const        vol,
+                                            const uint32_t                  nSect,
+                                            const unsigned                  nBlocks,
+                                            const uint8_t * const           buf );
+
+/* (internal) the above, with the type of the blocks (for the stats) */
+ADF_RETCODE adfVolReadBlockOfType( const struct AdfVolume * const  vol,
+                                   const uint32_t                  nSect,
+                                   uint8_t * const                 buf,
+                                   const AdfStatsBlockType         type );
+
+ADF_RETCODE adfVolReadBlocksOfType( const struct AdfVolume * const  vol,
+                                    const unsigned                  nBlocks,
+                                    const uint32_t * const          nSects,
+                                    uint8_t * const * const         bufs,
+                                    const AdfStatsBlockType         type );
+
+ADF_RETCODE adfVolWriteBlockOfType( struct AdfVolume * const        vol,
+                                    const uint32_t                  nSect,
+                                    const uint8_t * const           buf,
+                                    const AdfStatsBlockType         type );
+
+ADF_RETCODE adfVolWriteBlockRunOfType( struct AdfVolume * const        vol,
+                                       const uint32_t                  nSect,
+                                       const unsigned                  nBlocks,
+                                       const uint8_t * const           buf,
+                                       const AdfStatsBlockType         type );
+
+/*
+ * I/O statistics of a mounted volume
+ *
+ * Block reads and writes of the volume (since mounted or the stats were
+ * reset), with the time of the device's reads/writes (including
+ * the write-back buffer) and blocks counted by their type. As the volume
+ * itself, they are not protected from access by more threads.
+ * adfVolGetStats returns ADF_RC_ERROR if the stats are not available.
+ */
+ADF_PREFIX ADF_RETCODE adfVolGetStats( const struct AdfVolume * const  vol,
+                                       struct AdfVolStats * const      stats );
+
+ADF_PREFIX void adfVolResetStats( struct AdfVolume * const  vol );
+
 /* get volume's size in blocks */
 static inline uint32_t adfVolGetSizeInBlocks( const struct AdfVolume * const  vol )
 {
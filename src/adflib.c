@@ -31,6 +31,8 @@
 #include "adf_byteorder.h"
 #include "adf_dev_drivers.h"
 #include "adf_dev_driver_dump.h"
+#include "adf_dev_driver_gzip.h"
+#include "adf_dev_driver_overlay.h"
 #include "adf_dev_driver_ramdisk.h"
 
 #include <stdlib.h>
@@ -55,6 +57,8 @@ ADF_RETCODE adfLibInit(void)
     adfEnvInitDefault();
     adfAddDeviceDriver( &adfDeviceDriverDump );
     adfAddDeviceDriver( &adfDeviceDriverRamdisk );
+    adfAddDeviceDriver( &adfDeviceDriverOverlay );
+    adfAddDeviceDriver( &adfDeviceDriverGzip );
 
     return ADF_RC_OK;
 }
@@ -52,15 +52,19 @@ ADF_PREFIX void adfLibCleanUp(void);
 /* file */
 #include "adf_file.h"
 #include "adf_file_block.h"
+#include "adf_copy.h"
+#include "adf_hash.h"
 
 /* volume */
 #include "adf_vol.h"
 
 /* device */
 #include "adf_dev.h"
+#include "adf_dev_async.h"
 #include "adf_dev_flop.h"
 #include "adf_dev_hd.h"
 #include "adf_dev_hdfile.h"
+#include "adf_dev_trace.h"
 
 /* device drivers */
 #include "adf_dev_drivers.h"
@@ -117,4 +117,24 @@ const struct AdfDeviceDriver  adfDeviceDriverNative = {
 };
 
 
+/*
+ * adfNativeSetIoMode
+ *
+ * (only the cached mode is available)
+ */
+ADF_RETCODE adfNativeSetIoMode( struct AdfDevice * const  dev,
+                                const AdfNativeIoMode     mode )
+{
+    if ( dev->drv != &adfDeviceDriverNative ) {
+        adfEnv.eFct( "%s: '%s' is not a native device", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+    if ( mode != ADF_NATIVE_IO_CACHED ) {
+        adfEnv.eFct( "%s: I/O mode %d not supported", __func__, mode );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
+
+
 /*##########################################################################*/
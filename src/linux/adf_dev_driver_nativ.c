@@ -21,6 +21,11 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* O_DIRECT */
+#endif
+
+#include <errno.h>
 #include <fcntl.h>
 //#include <libgen.h>
 #include <linux/fs.h>
@@ -37,14 +42,49 @@
 #include "adf_dev_type.h"
 #include "adf_env.h"
 #include "adf_limits.h"
+#include "adf_util.h"
+
 
+/* aligned buffer for unaligned transfers with O_DIRECT */
+#define NATIVE_BOUNCE_SIZE   65536
+#define NATIVE_BOUNCE_ALIGN  4096
+
+/* consecutive accesses changing the read-ahead hint */
+#define NATIVE_SEQ_THRESHOLD  4
 
 struct AdfNativeDevice {
-    int fd;
+    int              fd;
+    AdfNativeIoMode  ioMode;
+    unsigned         alignment;     /* logical sector size (O_DIRECT) */
+    uint8_t *        bounceBuf;     /* allocated with O_DIRECT enabled */
+
+    /* access pattern (updated with the device I/O lock held) */
+    uint32_t         nextBlock;
+    unsigned         nSeq,
+                     nRandom;
+    int              advice;        /* current hint (0 - none given) */
 };
 
 static bool adfLinuxIsBlockDevice( const char * const  devName );
 
+static ADF_RETCODE adfLinuxPRead_( const int        fd,
+                                   uint8_t *        buf,
+                                   size_t           len,
+                                   off_t            offset );
+static ADF_RETCODE adfLinuxPWrite_( const int        fd,
+                                    const uint8_t *  buf,
+                                    size_t           len,
+                                    off_t            offset );
+static ADF_RETCODE adfLinuxDirectIo_( struct AdfNativeDevice * const  ndev,
+                                      const bool                      write,
+                                      uint8_t *                       buf,
+                                      size_t                          len,
+                                      off_t                           offset );
+static void adfLinuxAccessHint_( struct AdfNativeDevice * const  ndev,
+                                 const uint32_t                  block,
+                                 const uint32_t                  lenBlocks,
+                                 const unsigned                  blockSize );
+
 /*
  * adfLinuxInitDevice
  *
@@ -73,7 +113,16 @@ static struct AdfDevice * adfLinuxInitDevice( const char * const   name,
         return NULL;
     }
 
-    int * const fd = &( ( (struct AdfNativeDevice *) dev->drvData )->fd );
+    struct AdfNativeDevice * const ndev = (struct AdfNativeDevice *) dev->drvData;
+    ndev->ioMode     = ADF_NATIVE_IO_CACHED;
+    ndev->alignment  = ADF_DEV_BLOCK_SIZE;
+    ndev->bounceBuf  = NULL;
+    ndev->nextBlock  = 0;
+    ndev->nSeq       = 0;
+    ndev->nRandom    = 0;
+    ndev->advice     = 0;
+
+    int * const fd = &ndev->fd;
 
     if ( ! dev->readOnly ) {
         *fd = open( name, O_RDWR );
@@ -94,32 +143,45 @@ static struct AdfDevice * adfLinuxInitDevice( const char * const   name,
     // set block size (always 512, add checking that the device returns the same)
     dev->geometry.blockSize = ADF_DEV_BLOCK_SIZE;
 
+    // logical sector size (the alignment required for O_DIRECT)
+    int sectorSize = 0;
+    if ( ioctl( *fd, BLKSSZGET, &sectorSize ) == 0 &&
+         sectorSize > ADF_DEV_BLOCK_SIZE &&
+         sectorSize <= NATIVE_BOUNCE_ALIGN &&
+         ( sectorSize & ( sectorSize - 1 ) ) == 0 )
+    {
+        ndev->alignment = (unsigned) sectorSize;
+    }
+
     //
     // Get size in blocks
     //
-    unsigned long sizeBlocks = 0;
-    if ( ioctl ( *fd, BLKGETSIZE, &sizeBlocks ) < 0 ) {
+    // (BLKGETSIZE64 returns bytes - BLKGETSIZE, counting 512-byte sectors
+    //  in an unsigned long, overflows for devices over 2 TiB on 32-bit hosts)
+    uint64_t size = 0;
+    if ( ioctl( *fd, BLKGETSIZE64, &size ) < 0 ) {
         // fall-back to lseek
-        const unsigned long size = (unsigned long) lseek( *fd, 0, SEEK_END );
+        const off_t end = lseek( *fd, 0, SEEK_END );
         lseek( *fd, 0, SEEK_SET );
-        sizeBlocks = size / dev->geometry.blockSize;
-        if ( sizeBlocks * dev->geometry.blockSize != size ) {
-            adfEnv.eFct( "%s: the size of device '%s' (%lu) is unaligned to %u-byte blocks,"
-                         "%u bytes outside of the last block",
-                         __func__, name, size, dev->geometry.blockSize,
-                         size % dev->geometry.blockSize );
-        }
+        size = ( end > 0 ) ? (uint64_t) end : 0;
     }
 
-    /*unsigned long long size = 0;
-    if ( ioctl( *fd, BLKGETSIZE64, &size ) < 0 ) {
-        // fall-back to lseek
-        size = ( unsigned long long ) lseek( *fd, 0, SEEK_END );
-        lseek( *fd, 0, SEEK_SET );
-    }*/
-    //dev->size = (uint32_t) size;
+    uint64_t sizeBlocks = size / dev->geometry.blockSize;
+    if ( sizeBlocks * dev->geometry.blockSize != size ) {
+        adfEnv.wFct( "%s: the size of device '%s' (%llu) is unaligned to %u-byte blocks, "
+                     "%u bytes outside of the last block",
+                     __func__, name, (unsigned long long) size, dev->geometry.blockSize,
+                     (unsigned) ( size % dev->geometry.blockSize ) );
+    }
+    if ( sizeBlocks > ADF_DEV_SIZE_MAX_BLOCKS ) {
+        adfEnv.wFct( "%s: device '%s' is bigger (%llu blocks) than supported, "
+                     "only the first %llu blocks are accessible",
+                     __func__, name, (unsigned long long) sizeBlocks,
+                     (unsigned long long) ADF_DEV_SIZE_MAX_BLOCKS );
+        sizeBlocks = ADF_DEV_SIZE_MAX_BLOCKS;
+    }
+    dev->sizeBlocks = (uint32_t) sizeBlocks;
 
-    
     //
     // Get geometry
     //
@@ -171,7 +233,9 @@ static struct AdfDevice * adfLinuxInitDevice( const char * const   name,
  */
 static ADF_RETCODE adfLinuxReleaseDevice( struct AdfDevice * const  dev )
 {
-    close( ( (struct AdfNativeDevice *) dev->drvData )->fd );
+    struct AdfNativeDevice * const ndev = (struct AdfNativeDevice *) dev->drvData;
+    close( ndev->fd );
+    free( ndev->bounceBuf );
     free( dev->drvData );
     free( dev->name );
     free( dev );
@@ -191,17 +255,17 @@ static ADF_RETCODE adfLinuxReadSectors( const struct AdfDevice * const  dev,
     if ( block + lenBlocks > dev->sizeBlocks )
         return ADF_RC_ERROR;
 
-    const int fd = ( (struct AdfNativeDevice *) dev->drvData )->fd;
+    struct AdfNativeDevice * const ndev = (struct AdfNativeDevice *) dev->drvData;
 
-    off_t offset = (off_t) dev->geometry.blockSize * block;
-    if ( lseek( fd, offset, SEEK_SET ) != offset )
-        return ADF_RC_ERROR;
+    const off_t  offset = (off_t) dev->geometry.blockSize * block;
+    const size_t len    = (size_t) dev->geometry.blockSize * lenBlocks;
 
-    const size_t len = (size_t) dev->geometry.blockSize * lenBlocks;
-    if ( read( fd, buf, len ) != (ssize_t) len )
-        return ADF_RC_ERROR;
+    const ADF_RETCODE rc = ( ndev->ioMode == ADF_NATIVE_IO_DIRECT ) ?
+        adfLinuxDirectIo_( ndev, false, buf, len, offset ) :
+        adfLinuxPRead_( ndev->fd, buf, len, offset );
 
-    return ADF_RC_OK;   
+    adfLinuxAccessHint_( ndev, block, lenBlocks, dev->geometry.blockSize );
+    return rc;
 }
 
 
@@ -217,18 +281,46 @@ static ADF_RETCODE adfLinuxWriteSectors( const struct AdfDevice * const  dev,
     if ( block + lenBlocks > dev->sizeBlocks )
         return ADF_RC_ERROR;
 
-    const int fd = ( (struct AdfNativeDevice *) dev->drvData )->fd;
+    struct AdfNativeDevice * const ndev = (struct AdfNativeDevice *) dev->drvData;
 
-    off_t offset = (off_t) dev->geometry.blockSize * block;
-    if ( lseek( fd, offset, SEEK_SET ) != offset )
-        return ADF_RC_ERROR;
+    const off_t  offset = (off_t) dev->geometry.blockSize * block;
+    const size_t len    = (size_t) dev->geometry.blockSize * lenBlocks;
 
-    const size_t len = (size_t) dev->geometry.blockSize * lenBlocks;
-    if ( write( fd, buf, len ) != (ssize_t) len ) {
-        return ADF_RC_ERROR;
-    }
+    // (the buffer is not modified, only the direct I/O path is shared with reads)
+    const ADF_RETCODE rc = ( ndev->ioMode == ADF_NATIVE_IO_DIRECT ) ?
+        adfLinuxDirectIo_( ndev, true, (uint8_t *) buf, len, offset ) :
+        adfLinuxPWrite_( ndev->fd, buf, len, offset );
 
-    return ADF_RC_OK;
+    adfLinuxAccessHint_( ndev, block, lenBlocks, dev->geometry.blockSize );
+    return rc;
+}
+
+
+/*
+ * adfLinuxGetHostFd
+ *
+ * (with O_DIRECT, the I/O must go through the driver to be aligned)
+ */
+static int adfLinuxGetHostFd( const struct AdfDevice * const  dev )
+{
+    const struct AdfNativeDevice * const ndev =
+        (const struct AdfNativeDevice *) dev->drvData;
+    return ( ndev->ioMode == ADF_NATIVE_IO_DIRECT ) ? -1 : ndev->fd;
+}
+
+
+/*
+ * adfLinuxSync
+ *
+ */
+static ADF_RETCODE adfLinuxSync( const struct AdfDevice * const  dev )
+{
+    const int fd = ( (struct AdfNativeDevice *) dev->drvData )->fd;
+#ifdef HAVE_FDATASYNC
+    return ( fdatasync( fd ) == 0 ) ? ADF_RC_OK : ADF_RC_ERROR;
+#else
+    return ( fsync( fd ) == 0 ) ? ADF_RC_OK : ADF_RC_ERROR;
+#endif
 }
 
 
@@ -269,5 +361,209 @@ const struct AdfDeviceDriver  adfDeviceDriverNative = {
     .readSectors  = adfLinuxReadSectors,
     .writeSectors = adfLinuxWriteSectors,
     .isNative     = adfLinuxIsDevNative,
-    .isDevice     = adfLinuxIsBlockDevice
+    .isDevice     = adfLinuxIsBlockDevice,
+    .getHostFd    = adfLinuxGetHostFd,
+    .sync         = adfLinuxSync
 };
+
+
+/*
+ * adfNativeSetIoMode
+ *
+ */
+ADF_RETCODE adfNativeSetIoMode( struct AdfDevice * const  dev,
+                                const AdfNativeIoMode     mode )
+{
+    if ( dev->drv != &adfDeviceDriverNative ) {
+        adfEnv.eFct( "%s: '%s' is not a native device", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+
+    struct AdfNativeDevice * const ndev = (struct AdfNativeDevice *) dev->drvData;
+    if ( mode == ndev->ioMode )
+        return ADF_RC_OK;
+
+    if ( mode == ADF_NATIVE_IO_DIRECT && ndev->bounceBuf == NULL ) {
+        void * bounceBuf;
+        if ( posix_memalign( &bounceBuf, NATIVE_BOUNCE_ALIGN, NATIVE_BOUNCE_SIZE ) != 0 ) {
+            adfEnv.eFct( "%s: malloc error", __func__ );
+            return ADF_RC_MALLOC;
+        }
+        ndev->bounceBuf = bounceBuf;
+    }
+
+    const int flags = fcntl( ndev->fd, F_GETFL );
+    if ( flags < 0 ) {
+        adfEnv.eFct( "%s: cannot get file status flags, errno %d", __func__, errno );
+        return ADF_RC_ERROR;
+    }
+    const int newFlags = ( mode == ADF_NATIVE_IO_DIRECT ) ?
+        ( flags | O_DIRECT ) : ( flags & ~O_DIRECT );
+    if ( newFlags != flags && fcntl( ndev->fd, F_SETFL, newFlags ) < 0 ) {
+        adfEnv.eFct( "%s: cannot %s O_DIRECT, errno %d", __func__,
+                     ( mode == ADF_NATIVE_IO_DIRECT ) ? "enable" : "disable", errno );
+        return ADF_RC_ERROR;
+    }
+
+    if ( ndev->ioMode == ADF_NATIVE_IO_DIRECT ) {
+        free( ndev->bounceBuf );
+        ndev->bounceBuf = NULL;
+    }
+    ndev->ioMode = mode;
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfLinuxPRead_
+ *
+ */
+static ADF_RETCODE adfLinuxPRead_( const int        fd,
+                                   uint8_t *        buf,
+                                   size_t           len,
+                                   off_t            offset )
+{
+    while ( len > 0 ) {
+        const ssize_t n = pread( fd, buf, len, offset );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return ADF_RC_ERROR;
+        buf    += n;
+        len    -= (size_t) n;
+        offset += n;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfLinuxPWrite_
+ *
+ */
+static ADF_RETCODE adfLinuxPWrite_( const int        fd,
+                                    const uint8_t *  buf,
+                                    size_t           len,
+                                    off_t            offset )
+{
+    while ( len > 0 ) {
+        const ssize_t n = pwrite( fd, buf, len, offset );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return ADF_RC_ERROR;
+        buf    += n;
+        len    -= (size_t) n;
+        offset += n;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfLinuxDirectIo_
+ *
+ * transfer with O_DIRECT: aligned requests go directly, others through
+ * the bounce buffer (partially written sectors are read first)
+ */
+static ADF_RETCODE adfLinuxDirectIo_( struct AdfNativeDevice * const  ndev,
+                                      const bool                      write,
+                                      uint8_t *                       buf,
+                                      size_t                          len,
+                                      off_t                           offset )
+{
+    const unsigned align = ndev->alignment;
+
+    if ( (uintptr_t) buf % NATIVE_BOUNCE_ALIGN == 0 &&
+         (size_t) offset % align == 0 &&
+         len % align == 0 )
+    {
+        return write ? adfLinuxPWrite_( ndev->fd, buf, len, offset ) :
+                       adfLinuxPRead_( ndev->fd, buf, len, offset );
+    }
+
+    while ( len > 0 ) {
+        const off_t  alignedOffset = offset - (off_t) ( (size_t) offset % align );
+        const size_t skip   = (size_t) ( offset - alignedOffset ),
+                     n      = min( len, (size_t) NATIVE_BOUNCE_SIZE - skip ),
+                     nAlign = ( skip + n + align - 1 ) / align * align;
+
+        if ( write ) {
+            // read-modify-write of the partial sectors
+            if ( ( skip != 0 || nAlign != skip + n ) &&
+                 adfLinuxPRead_( ndev->fd, ndev->bounceBuf, nAlign,
+                                 alignedOffset ) != ADF_RC_OK )
+            {
+                return ADF_RC_ERROR;
+            }
+            memcpy( ndev->bounceBuf + skip, buf, n );
+            if ( adfLinuxPWrite_( ndev->fd, ndev->bounceBuf, nAlign,
+                                  alignedOffset ) != ADF_RC_OK )
+                return ADF_RC_ERROR;
+        } else {
+            if ( adfLinuxPRead_( ndev->fd, ndev->bounceBuf, nAlign,
+                                 alignedOffset ) != ADF_RC_OK )
+                return ADF_RC_ERROR;
+            memcpy( buf, ndev->bounceBuf + skip, n );
+        }
+
+        buf    += n;
+        len    -= n;
+        offset += (off_t) n;
+    }
+    return ADF_RC_OK;
+}
+
+
+/*
+ * adfLinuxAccessHint_
+ *
+ * read-ahead hints for the kernel following the access pattern:
+ * sequential after NATIVE_SEQ_THRESHOLD consecutive accesses, random after
+ * as many non-consecutive ones; in drop-behind mode the accessed range
+ * is released from the page cache
+ */
+static void adfLinuxAccessHint_( struct AdfNativeDevice * const  ndev,
+                                 const uint32_t                  block,
+                                 const uint32_t                  lenBlocks,
+                                 const unsigned                  blockSize )
+{
+#ifdef HAVE_POSIX_FADVISE
+    if ( ndev->ioMode == ADF_NATIVE_IO_DIRECT )
+        return;     // (no page cache)
+
+    if ( block == ndev->nextBlock ) {
+        ndev->nRandom = 0;
+        if ( ndev->nSeq < NATIVE_SEQ_THRESHOLD )
+            ndev->nSeq++;
+        if ( ndev->nSeq == NATIVE_SEQ_THRESHOLD &&
+             ndev->advice != POSIX_FADV_SEQUENTIAL )
+        {
+            posix_fadvise( ndev->fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+            ndev->advice = POSIX_FADV_SEQUENTIAL;
+        }
+    } else {
+        ndev->nSeq = 0;
+        if ( ndev->nRandom < NATIVE_SEQ_THRESHOLD )
+            ndev->nRandom++;
+        if ( ndev->nRandom == NATIVE_SEQ_THRESHOLD &&
+             ndev->advice != POSIX_FADV_RANDOM )
+        {
+            posix_fadvise( ndev->fd, 0, 0, POSIX_FADV_RANDOM );
+            ndev->advice = POSIX_FADV_RANDOM;
+        }
+    }
+    ndev->nextBlock = block + lenBlocks;
+
+    if ( ndev->ioMode == ADF_NATIVE_IO_DROP_BEHIND ) {
+        // (dirty pages are not dropped - only start writing them back)
+        posix_fadvise( ndev->fd, (off_t) blockSize * block,
+                       (off_t) blockSize * lenBlocks, POSIX_FADV_DONTNEED );
+    }
+#else
+    (void) ndev;
+    (void) block;
+    (void) lenBlocks;
+    (void) blockSize;
+#endif
+}
@@ -187,6 +187,19 @@ static ADF_RETCODE Win32WriteSectors( const struct AdfDevice * const  dev,
 }
 
 
+static ADF_RETCODE Win32Sync( const struct AdfDevice * const  dev )
+{
+    void * const hDrv = ( (struct AdfNativeDevice *) dev->drvData )->hDrv;
+
+    if ( ! FlushFileBuffers( hDrv ) ) {
+        adfEnv.eFct( "%s: FlushFileBuffers", __func__ );
+        return ADF_RC_ERROR;
+    }
+
+    return ADF_RC_OK;
+}
+
+
 static bool Win32IsDevNative(void)
 {
     return true;
@@ -208,5 +221,26 @@ const struct AdfDeviceDriver adfDeviceDriverNative = {
     .readSectors  = Win32ReadSectors,
     .writeSectors = Win32WriteSectors,
     .isNative     = Win32IsDevNative,
-    .isDevice     = Win32IsDevice
+    .isDevice     = Win32IsDevice,
+    .sync         = Win32Sync
 };
+
+
+/*
+ * adfNativeSetIoMode
+ *
+ * (only the cached mode is available)
+ */
+ADF_RETCODE adfNativeSetIoMode( struct AdfDevice * const  dev,
+                                const AdfNativeIoMode     mode )
+{
+    if ( dev->drv != &adfDeviceDriverNative ) {
+        adfEnv.eFct( "%s: '%s' is not a native device", __func__, dev->name );
+        return ADF_RC_ERROR;
+    }
+    if ( mode != ADF_NATIVE_IO_CACHED ) {
+        adfEnv.eFct( "%s: I/O mode %d not supported", __func__, mode );
+        return ADF_RC_ERROR;
+    }
+    return ADF_RC_OK;
+}
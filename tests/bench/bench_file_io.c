@@ -0,0 +1,136 @@
+/*
+ * bench_file_io.c
+ *
+ * measures the cost of file reading and writing (per byte) for OFS and FFS
+ * (on a ramdisk, so mostly the cost of the library code)
+ *
+ * usage: bench_file_io [file_size_kib [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adflib.h"
+
+
+#define FILE_SIZE_KIB_DEFAULT   700
+#define ITERATIONS_DEFAULT      200
+
+
+static double seconds ( const clock_t start )
+{
+    return (double) ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+
+static int bench ( const uint8_t   fstype,
+                   const unsigned  fileSize,
+                   const unsigned  iterations,
+                   uint8_t * const buffer )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "bench", 80, 2, 11 );
+    if ( dev == NULL )
+        return 1;
+
+    int status = 1;
+    if ( adfCreateFlop ( dev, "bench", fstype ) != ADF_RC_OK )
+        goto bench_close_dev;
+
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    if ( vol == NULL )
+        goto bench_close_dev;
+
+    // writing
+    clock_t start = clock();
+    for ( unsigned i = 0 ; i < iterations ; i++ ) {
+        struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+        if ( file == NULL ||
+             adfFileWrite ( file, fileSize, buffer ) != fileSize )
+        {
+            fprintf ( stderr, "error writing file\n" );
+            adfFileClose ( file );
+            goto bench_unmount;
+        }
+        adfFileClose ( file );
+        if ( i < iterations - 1 &&
+             adfRemoveEntry ( vol, vol->curDirPtr, "file" ) != ADF_RC_OK )
+        {
+            fprintf ( stderr, "error removing file\n" );
+            goto bench_unmount;
+        }
+    }
+    const double timeWrite = seconds ( start );
+
+    // reading
+    uint8_t * const readBuf = malloc ( fileSize );
+    if ( readBuf == NULL )
+        goto bench_unmount;
+    start = clock();
+    for ( unsigned i = 0 ; i < iterations ; i++ ) {
+        struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+        if ( file == NULL ||
+             adfFileRead ( file, fileSize, readBuf ) != fileSize )
+        {
+            fprintf ( stderr, "error reading file\n" );
+            adfFileClose ( file );
+            free ( readBuf );
+            goto bench_unmount;
+        }
+        adfFileClose ( file );
+    }
+    const double timeRead = seconds ( start );
+
+    if ( memcmp ( buffer, readBuf, fileSize ) != 0 ) {
+        fprintf ( stderr, "data read differs from written\n" );
+        free ( readBuf );
+        goto bench_unmount;
+    }
+    free ( readBuf );
+
+    const double nBytes = (double) fileSize * iterations;
+    printf ( "%s  write: %7.3f ns/byte (%8.2f MiB/s)"
+             "  read: %7.3f ns/byte (%8.2f MiB/s)\n",
+             adfVolIsOFS ( vol ) ? "OFS" : "FFS",
+             timeWrite * 1e9 / nBytes, nBytes / ( 1 << 20 ) / timeWrite,
+             timeRead * 1e9 / nBytes, nBytes / ( 1 << 20 ) / timeRead );
+    status = 0;
+
+bench_unmount:
+    adfVolUnMount ( vol );
+
+bench_close_dev:
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+    return status;
+}
+
+
+int main ( int     argc,
+           char ** argv )
+{
+    const unsigned fileSize = 1024 * (unsigned)
+        ( argc > 1 ? strtoul ( argv[ 1 ], NULL, 10 ) : FILE_SIZE_KIB_DEFAULT );
+    const unsigned iterations = (unsigned)
+        ( argc > 2 ? strtoul ( argv[ 2 ], NULL, 10 ) : ITERATIONS_DEFAULT );
+    if ( fileSize < 1 || iterations < 1 ) {
+        fprintf ( stderr, "usage: %s [file_size_kib [iterations]]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    uint8_t * const buffer = malloc ( fileSize );
+    if ( buffer == NULL )
+        return 1;
+    for ( unsigned i = 0 ; i < fileSize ; i++ )
+        buffer[ i ] = (uint8_t) rand();
+
+    adfLibInit();
+    printf ( "file size %u bytes, %u iterations\n", fileSize, iterations );
+    const int status = bench ( ADF_DOSFS_OFS, fileSize, iterations, buffer ) ||
+                       bench ( ADF_DOSFS_FFS, fileSize, iterations, buffer );
+    adfLibCleanUp();
+
+    free ( buffer );
+    return status;
+}
@@ -0,0 +1,122 @@
+/*
+ * bench_sync_policy.c
+ *
+ * measures the cost of the durability policies (AdfSyncPolicy): writes
+ * small files (and a directory for each 10 files) on a dump device
+ * with each policy
+ *
+ * usage: bench_sync_policy [n_files [image_path]]
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* clock_gettime() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "adflib.h"
+
+
+#define N_FILES_DEFAULT  100
+#define FILE_SIZE        2000
+#define IMAGE_DEFAULT    "bench_sync_policy.adf"
+
+
+static double now ( void )
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    if ( clock_gettime ( CLOCK_MONOTONIC, &ts ) == 0 )
+        return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+#endif
+    return (double) clock() / CLOCKS_PER_SEC;
+}
+
+
+static int bench ( const AdfSyncPolicy  policy,
+                   const char * const   policyName,
+                   const unsigned       nFiles,
+                   const char * const   image )
+{
+    static uint8_t data[ FILE_SIZE ];
+
+    struct AdfDevice * const dev = adfDevCreate ( "dump", image, 80, 2, 11 );
+    if ( dev == NULL )
+        return 1;
+
+    int status = 1;
+    if ( adfCreateFlop ( dev, "bench", ADF_DOSFS_FFS ) != ADF_RC_OK )
+        goto bench_close_dev;
+    adfDevSetSyncPolicy ( dev, policy );
+
+    const double start = now();
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    if ( vol == NULL )
+        goto bench_close_dev;
+
+    for ( unsigned i = 0 ; i < nFiles ; i++ ) {
+        char name[ 16 ];
+        if ( i % 10 == 0 ) {
+            snprintf ( name, sizeof name, "dir%u", i / 10 );
+            if ( adfToRootDir ( vol ) != ADF_RC_OK ||
+                 adfCreateDir ( vol, vol->curDirPtr, name ) != ADF_RC_OK ||
+                 adfChangeDir ( vol, name ) != ADF_RC_OK )
+            {
+                fprintf ( stderr, "error creating directory %s\n", name );
+                goto bench_unmount;
+            }
+        }
+        snprintf ( name, sizeof name, "file%u", i );
+        struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+        if ( file == NULL ||
+             adfFileWrite ( file, FILE_SIZE, data ) != FILE_SIZE )
+        {
+            fprintf ( stderr, "error writing file %s\n", name );
+            adfFileClose ( file );
+            goto bench_unmount;
+        }
+        adfFileClose ( file );
+    }
+    status = 0;
+
+bench_unmount:
+    adfVolUnMount ( vol );
+    if ( status == 0 ) {
+        const double seconds = now() - start;
+        printf ( "%-12s  %8.3f s  %8.3f ms/file\n",
+                 policyName, seconds, seconds * 1e3 / nFiles );
+    }
+
+bench_close_dev:
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+    unlink ( image );
+    return status;
+}
+
+
+int main ( int     argc,
+           char ** argv )
+{
+    const unsigned nFiles = (unsigned)
+        ( argc > 1 ? strtoul ( argv[ 1 ], NULL, 10 ) : N_FILES_DEFAULT );
+    const char * const image = ( argc > 2 ) ? argv[ 2 ] : IMAGE_DEFAULT;
+    if ( nFiles < 1 || nFiles > 500 ) {
+        fprintf ( stderr, "usage: %s [n_files (1-500) [image_path]]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    adfLibInit();
+    printf ( "%u files of %u bytes, image %s\n", nFiles, FILE_SIZE, image );
+    const int status =
+        bench ( ADF_SYNC_NONE,       "none",       nFiles, image ) ||
+        bench ( ADF_SYNC_UNMOUNT,    "unmount",    nFiles, image ) ||
+        bench ( ADF_SYNC_FILE_CLOSE, "file close", nFiles, image ) ||
+        bench ( ADF_SYNC_METADATA,   "metadata",   nFiles, image );
+    adfLibCleanUp();
+    return status;
+}
@@ -0,0 +1,315 @@
+/*
+ * bench_trace_replay.c
+ *
+ * replays a device access trace (recorded with adfDevTraceStart) on
+ * a device created with any driver, optionally behind a fake driver adding
+ * a latency to each driver call, and reports the throughput and latency
+ * percentiles of the reads and writes (as done by the trace, with no pauses
+ * between them - so the results are comparable between runs)
+ *
+ * usage: bench_trace_replay [-d driver] [-l op_us] [-b block_us]
+ *                           [-w write_buffer_blocks] trace_file [image_path]
+ *
+ *   -d  the driver of the device (default: ramdisk); the image (default:
+ *       bench_trace_replay.adf) is created and removed after the replay
+ *   -l  latency added to each driver call (in microseconds)
+ *   -b  latency added for each block transferred (in microseconds)
+ *   -w  use a write-back buffer of the given size (see adfDevSetWriteBuffer)
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* clock_gettime(), nanosleep(), getopt() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "adflib.h"
+
+
+#define IMAGE_DEFAULT   "bench_trace_replay.adf"
+#define DRIVER_DEFAULT  "ramdisk"
+
+
+static double now ( void )
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    if ( clock_gettime ( CLOCK_MONOTONIC, &ts ) == 0 )
+        return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+#endif
+    return (double) clock() / CLOCKS_PER_SEC;
+}
+
+
+/*
+ * the latency-injecting fake driver: calls of the wrapped driver,
+ * with a delay added to reads and writes
+ */
+static const struct AdfDeviceDriver * latencyBase = NULL;
+static unsigned latencyOpUs    = 0,
+                latencyBlockUs = 0;
+
+static void latency_delay ( const uint32_t  nBlocks )
+{
+    const unsigned long us = latencyOpUs + (unsigned long) latencyBlockUs * nBlocks;
+#ifdef HAVE_CLOCK_GETTIME
+    const struct timespec ts = { (time_t) ( us / 1000000 ),
+                                 (long) ( us % 1000000 ) * 1000 };
+    nanosleep ( &ts, NULL );
+#else
+    const double end = now() + (double) us / 1e6;
+    while ( now() < end )
+        ;
+#endif
+}
+
+static ADF_RETCODE latency_read ( const struct AdfDevice * const  dev,
+                                  const uint32_t                  block,
+                                  const uint32_t                  lenBlocks,
+                                  uint8_t * const                 buf )
+{
+    latency_delay ( lenBlocks );
+    return latencyBase->readSectors ( dev, block, lenBlocks, buf );
+}
+
+static ADF_RETCODE latency_write ( const struct AdfDevice * const  dev,
+                                   const uint32_t                  block,
+                                   const uint32_t                  lenBlocks,
+                                   const uint8_t * const           buf )
+{
+    latency_delay ( lenBlocks );
+    return latencyBase->writeSectors ( dev, block, lenBlocks, buf );
+}
+
+static ADF_RETCODE latency_close ( struct AdfDevice * const  dev )
+{
+    return latencyBase->closeDev ( dev );
+}
+
+static struct AdfDeviceDriver latencyDriver = {
+    .name         = "latency",
+    .data         = NULL,
+    .createDev    = NULL,
+    .openDev      = NULL,
+    .closeDev     = latency_close,
+    .readSectors  = latency_read,
+    .writeSectors = latency_write,
+    .isNative     = NULL,
+    .isDevice     = NULL,
+    .getHostFd    = NULL,
+    .sync         = NULL
+};
+
+
+/* latencies of the operations of one type */
+struct OpStats {
+    double *  latency;     /* seconds */
+    unsigned  n,
+              capacity;
+    uint64_t  blocks;
+    double    time;
+};
+
+static int op_stats_add ( struct OpStats * const  stats,
+                          const uint32_t          nBlocks,
+                          const double            seconds )
+{
+    if ( stats->n == stats->capacity ) {
+        const unsigned capacity = stats->capacity > 0 ? stats->capacity * 2 : 1024;
+        double * const latency = realloc ( stats->latency, sizeof(double) * capacity );
+        if ( latency == NULL )
+            return 1;
+        stats->latency  = latency;
+        stats->capacity = capacity;
+    }
+    stats->latency[ stats->n++ ] = seconds;
+    stats->blocks += nBlocks;
+    stats->time   += seconds;
+    return 0;
+}
+
+static int cmp_double ( const void * const  a,
+                        const void * const  b )
+{
+    const double da = *(const double *) a,
+                 db = *(const double *) b;
+    return ( da > db ) - ( da < db );
+}
+
+static double percentile ( const struct OpStats * const  stats,
+                           const double                  p )
+{
+    const unsigned i = (unsigned) ( p / 100.0 * ( stats->n - 1 ) + 0.5 );
+    return stats->latency[ i ];
+}
+
+static void op_stats_print ( const char * const      name,
+                             struct OpStats * const  stats,
+                             const unsigned          blockSize )
+{
+    if ( stats->n == 0 ) {
+        printf ( "%-6s  -\n", name );
+        return;
+    }
+    qsort ( stats->latency, stats->n, sizeof(double), cmp_double );
+    printf ( "%-6s  %8u ops %10llu blocks %9.2f MB/s   "
+             "latency us: p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f\n",
+             name, stats->n, (unsigned long long) stats->blocks,
+             stats->time > 0 ? (double) stats->blocks * blockSize / 1e6 / stats->time : 0,
+             percentile ( stats, 50 ) * 1e6, percentile ( stats, 90 ) * 1e6,
+             percentile ( stats, 99 ) * 1e6, stats->latency[ stats->n - 1 ] * 1e6 );
+}
+
+
+static int replay ( FILE * const                         trace,
+                    const struct AdfTraceHeader * const  header,
+                    const char * const                   driver,
+                    const unsigned                       wBufBlocks,
+                    const char * const                   image )
+{
+    struct AdfDevice * const dev = adfDevCreate ( driver, image, header->cylinders,
+                                                  header->heads, header->sectors );
+    if ( dev == NULL ) {
+        fprintf ( stderr, "cannot create device '%s' with driver %s\n", image, driver );
+        return 1;
+    }
+    if ( latencyBase != NULL ) {
+        latencyDriver.isNative = latencyBase->isNative;
+        latencyDriver.sync     = latencyBase->sync;
+        dev->drv = &latencyDriver;
+    }
+
+    int status = 1;
+    if ( wBufBlocks > 0 &&
+         adfDevSetWriteBuffer ( dev, wBufBlocks ) != ADF_RC_OK )
+        goto replay_close_dev;
+
+    struct OpStats reads  = { NULL, 0, 0, 0, 0 },
+                   writes = { NULL, 0, 0, 0, 0 };
+    uint8_t * buf = NULL;
+    uint32_t bufBlocks = 0;
+    unsigned nSkipped = 0;
+    struct AdfTraceRecord rec;
+    while ( adfTraceReadRecord ( trace, &rec ) ) {
+        if ( rec.nBlocks < 1 || rec.sector >= dev->sizeBlocks ||
+             rec.nBlocks > dev->sizeBlocks - rec.sector )
+        {
+            nSkipped++;
+            continue;
+        }
+        if ( rec.nBlocks > bufBlocks ) {
+            uint8_t * const newBuf = realloc ( buf, (size_t) rec.nBlocks * header->blockSize );
+            if ( newBuf == NULL )
+                goto replay_free;
+            buf = newBuf;
+            for ( size_t i = (size_t) bufBlocks * header->blockSize ;
+                  i < (size_t) rec.nBlocks * header->blockSize ; i++ )
+                buf[ i ] = (uint8_t) i;
+            bufBlocks = rec.nBlocks;
+        }
+
+        const uint32_t size  = rec.nBlocks * header->blockSize;
+        const double   start = now();
+        const ADF_RETCODE rc = ( rec.op == ADF_TRACE_OP_WRITE ) ?
+            adfDevWriteBlock ( dev, rec.sector, size, buf ) :
+            adfDevReadBlock ( dev, rec.sector, size, buf );
+        const double   seconds = now() - start;
+        if ( rc != ADF_RC_OK ) {
+            fprintf ( stderr, "error %s blocks %u-%u\n",
+                      rec.op == ADF_TRACE_OP_WRITE ? "writing" : "reading",
+                      rec.sector, rec.sector + rec.nBlocks - 1 );
+            goto replay_free;
+        }
+        if ( op_stats_add ( rec.op == ADF_TRACE_OP_WRITE ? &writes : &reads,
+                            rec.nBlocks, seconds ) != 0 )
+            goto replay_free;
+    }
+    if ( adfDevFlush ( dev ) != ADF_RC_OK )
+        goto replay_free;
+    status = 0;
+
+    op_stats_print ( "read", &reads, header->blockSize );
+    op_stats_print ( "write", &writes, header->blockSize );
+    struct AdfDevStats devStats;
+    if ( adfDevGetStats ( dev, &devStats ) == ADF_RC_OK )
+        printf ( "driver  %8llu reads %8llu writes (%llu / %llu single-block)\n",
+                 (unsigned long long) devStats.read.ops,
+                 (unsigned long long) devStats.write.ops,
+                 (unsigned long long) devStats.read.singleOps,
+                 (unsigned long long) devStats.write.singleOps );
+    if ( nSkipped > 0 )
+        printf ( "%u records out of the device skipped\n", nSkipped );
+
+replay_free:
+    free ( buf );
+    free ( reads.latency );
+    free ( writes.latency );
+
+replay_close_dev:
+    adfDevClose ( dev );
+    unlink ( image );
+    return status;
+}
+
+
+int main ( int     argc,
+           char ** argv )
+{
+    const char * driver = DRIVER_DEFAULT;
+    unsigned wBufBlocks = 0;
+    int opt;
+    while ( ( opt = getopt ( argc, argv, "d:l:b:w:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'd': driver         = optarg;                                  break;
+        case 'l': latencyOpUs    = (unsigned) strtoul ( optarg, NULL, 10 ); break;
+        case 'b': latencyBlockUs = (unsigned) strtoul ( optarg, NULL, 10 ); break;
+        case 'w': wBufBlocks     = (unsigned) strtoul ( optarg, NULL, 10 ); break;
+        default:
+            optind = argc;
+        }
+    }
+    if ( optind >= argc ) {
+        fprintf ( stderr, "usage: %s [-d driver] [-l op_us] [-b block_us] "
+                  "[-w write_buffer_blocks] trace_file [image_path]\n", argv[ 0 ] );
+        return 1;
+    }
+    const char * const tracePath = argv[ optind ],
+               * const image     = ( optind + 1 < argc ) ? argv[ optind + 1 ] : IMAGE_DEFAULT;
+
+    FILE * const trace = fopen ( tracePath, "rb" );
+    if ( trace == NULL ) {
+        fprintf ( stderr, "cannot open trace file '%s'\n", tracePath );
+        return 1;
+    }
+
+    adfLibInit();
+    int status = 1;
+    struct AdfTraceHeader header;
+    if ( adfTraceReadHeader ( trace, &header ) != ADF_RC_OK )
+        goto main_close;
+    if ( header.blockSize != ADF_DEV_BLOCK_SIZE ) {
+        fprintf ( stderr, "unsupported block size %u\n", header.blockSize );
+        goto main_close;
+    }
+    if ( latencyOpUs > 0 || latencyBlockUs > 0 ) {
+        latencyBase = adfGetDeviceDriverByName ( driver );
+        if ( latencyBase == NULL ) {
+            fprintf ( stderr, "unknown driver %s\n", driver );
+            goto main_close;
+        }
+    }
+
+    printf ( "trace %s (device %u/%u/%u), driver %s, latency %u us + %u us/block, "
+             "write buffer %u blocks\n", tracePath, header.cylinders, header.heads,
+             header.sectors, driver, latencyOpUs, latencyBlockUs, wBufBlocks );
+    status = replay ( trace, &header, driver, wBufBlocks, image );
+
+main_close:
+    adfLibCleanUp();
+    fclose ( trace );
+    return status;
+}
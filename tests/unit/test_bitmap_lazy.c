@@ -0,0 +1,208 @@
+#include <check.h>
+#include <stdlib.h>
+#include <unistd.h>   // for unlink()
+
+#include "adflib.h"
+
+
+/* 1024 * 4 * 32 blocks = 64 MiB, 33 bitmap pages (25 in the root block,
+   the remaining in a bitmap extension block) */
+#define HDF_CYLINDERS  1024
+#define HDF_HEADS      4
+#define HDF_SECTORS    32
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             adfname;
+    char *             volname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    uint32_t           freeBlocks;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static unsigned count_pages_loaded ( const struct AdfVolume * const vol )
+{
+    unsigned n = 0;
+    for ( unsigned i = 0 ; i < vol->bitmap.size ; i++ )
+        if ( vol->bitmap.table[ i ] != NULL )
+            n++;
+    return n;
+}
+
+
+static void test_bitmap_lazy ( test_data_t * const tdata )
+{
+    struct AdfVolume * vol = adfVolMount ( tdata->device, 0,
+                                           ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_uint_eq ( vol->bitmap.size, 33 );
+
+    // nothing read on mount
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), 0 );
+
+    // files can be read without the bitmap
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    uint8_t buf[ 100 ];
+    ck_assert_uint_eq ( adfFileRead ( file, sizeof ( buf ), buf ), sizeof ( buf ) );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), 0 );
+
+    // a block status query reads only the page containing the block,
+    // (here - a page pointed by the bitmap extension block)
+    const ADF_SECTNUM blockInPage30 = 2 + 30 * ADF_BM_MAP_SIZE * 32 + 100;
+    ck_assert ( adfIsBlockFree ( vol, blockInPage30 ) );
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), 1 );
+    ck_assert_ptr_nonnull ( vol->bitmap.table[ 30 ] );
+
+    // free space query reads all
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), tdata->freeBlocks );
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), vol->bitmap.size );
+    adfVolUnMount ( vol );
+
+    // remounting read-write reads the whole bitmap
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), 0 );
+    ck_assert_int_eq ( adfVolRemount ( vol, ADF_ACCESS_MODE_READWRITE ), ADF_RC_OK );
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), vol->bitmap.size );
+
+    file = adfFileOpen ( vol, "file2", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof ( buf ), buf ), sizeof ( buf ) );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), tdata->freeBlocks - 2 );
+    adfVolUnMount ( vol );
+
+    // a read-write mount reads the whole bitmap
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_uint_eq ( count_pages_loaded ( vol ), vol->bitmap.size );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), tdata->freeBlocks - 2 );
+    adfVolUnMount ( vol );
+
+    // verification (salvage) of a read-only mounted volume
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfBitmapCheck check;
+    ck_assert_int_eq ( adfVerifyBitmap ( vol, 1, &check ), ADF_RC_OK );
+    ck_assert_uint_eq ( check.usedUnreferenced.nItems, 0 );
+    ck_assert_uint_eq ( check.referencedFree.nItems, 0 );
+    adfFreeBitmapCheck ( &check );
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_bitmap_lazy_ofs )
+{
+    test_data_t test_data = {
+        .adfname = "test_bitmap_lazy_ofs.hdf",
+        .volname = "Test_bitmap_lazy_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_bitmap_lazy ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_bitmap_lazy_ffs )
+{
+    test_data_t test_data = {
+        .adfname = "test_bitmap_lazy_ffs.hdf",
+        .volname = "Test_bitmap_lazy_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_bitmap_lazy ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_bitmap_lazy_ofs" );
+    tcase_add_test ( tc, test_bitmap_lazy_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_bitmap_lazy_ffs" );
+    tcase_add_test ( tc, test_bitmap_lazy_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "dump", tdata->adfname,
+                                   HDF_CYLINDERS, HDF_HEADS, HDF_SECTORS );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateHdFile ( tdata->device, tdata->volname, tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateHdFile error creating volume: %s\n",
+                  tdata->volname );
+        exit(1);
+    }
+
+    struct AdfVolume * const vol = adfVolMount ( tdata->device, 0,
+                                                 ADF_ACCESS_MODE_READWRITE );
+    if ( ! vol ) {
+        exit(1);
+    }
+    struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    if ( ! file ) {
+        exit(1);
+    }
+    uint8_t buf[ 1000 ] = { 0x55 };
+    adfFileWrite ( file, sizeof ( buf ), buf );
+    adfFileClose ( file );
+    tdata->freeBlocks = adfCountFreeBlocks ( vol );
+    adfVolUnMount ( vol );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+    unlink ( tdata->adfname );
+}
@@ -0,0 +1,259 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             driver;   // "ramdisk" or "dump"
+    char *             adfname;
+    char *             volname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void create_test_tree ( struct AdfVolume * const vol )
+{
+    static const unsigned filesizes[] = { 0, 1, 488, 513, 5000, 40000 };
+    const unsigned nfilesizes = sizeof ( filesizes ) / sizeof ( unsigned );
+
+    uint8_t * const buffer = malloc ( 40000 );
+    ck_assert_ptr_nonnull ( buffer );
+    pattern_random ( buffer, 40000 );
+
+    for ( unsigned d = 0 ; d < 4 ; d++ ) {
+        char dirname[ 16 ];
+        snprintf ( dirname, sizeof ( dirname ), "dir%u", d );
+        ck_assert_int_eq ( adfCreateDir ( vol, vol->curDirPtr, dirname ), ADF_RC_OK );
+        ck_assert_int_eq ( adfChangeDir ( vol, dirname ), ADF_RC_OK );
+
+        for ( unsigned f = 0 ; f < nfilesizes ; f++ ) {
+            char filename[ 16 ];
+            snprintf ( filename, sizeof ( filename ), "file%u", f );
+            struct AdfFile * const file = adfFileOpen ( vol, filename,
+                                                        ADF_FILE_MODE_WRITE );
+            ck_assert_ptr_nonnull ( file );
+            ck_assert_uint_eq ( adfFileWrite ( file, filesizes[ f ], buffer ),
+                                filesizes[ f ] );
+            adfFileClose ( file );
+        }
+
+        // a subdirectory (so that there are more levels to traverse)
+        ck_assert_int_eq ( adfCreateDir ( vol, vol->curDirPtr, "subdir" ), ADF_RC_OK );
+        ck_assert_int_eq ( adfToRootDir ( vol ), ADF_RC_OK );
+    }
+    free ( buffer );
+}
+
+
+static void verify_bitmap ( struct AdfVolume * const vol,
+                            const unsigned           nThreads,
+                            const unsigned           nUsedUnreferenced,
+                            const unsigned           nReferencedFree )
+{
+    struct AdfBitmapCheck check;
+    ck_assert_int_eq ( adfVerifyBitmap ( vol, nThreads, &check ), ADF_RC_OK );
+    ck_assert_uint_eq ( check.usedUnreferenced.nItems, nUsedUnreferenced );
+    ck_assert_uint_eq ( check.referencedFree.nItems, nReferencedFree );
+    adfFreeBitmapCheck ( &check );
+}
+
+
+static void test_bitmap_verify ( test_data_t * const tdata )
+{
+    struct AdfVolume * vol = adfVolMount ( tdata->device, 0,
+                                           ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    create_test_tree ( vol );
+    const uint32_t freeBlocks = adfCountFreeBlocks ( vol );
+
+    // a consistent volume
+    verify_bitmap ( vol, 1, 0, 0 );
+    verify_bitmap ( vol, 4, 0, 0 );
+
+    if ( strcmp ( tdata->driver, "dump" ) == 0 ) {
+        // with threads, the blocks are read with pread() on the host fd
+        // (not with the driver)
+        counting_start ( tdata->device );
+        verify_bitmap ( vol, 1, 0, 0 );
+        const unsigned readsSerial = counting.reads;
+        ck_assert_uint_gt ( readsSerial, 0 );
+
+        counting_reset();
+        verify_bitmap ( vol, 4, 0, 0 );
+#ifdef HAVE_PTHREAD
+        ck_assert_uint_lt ( counting.reads, readsSerial );
+#else
+        ck_assert_uint_eq ( counting.reads, readsSerial );
+#endif
+        counting_stop ( tdata->device );
+    }
+
+    // damage the bitmap: a free block marked used, a file block marked free
+    ck_assert_int_eq ( adfChangeDir ( vol, "dir2" ), ADF_RC_OK );
+    struct AdfFile * const file = adfFileOpen ( vol, "file5", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    const ADF_SECTNUM fileDataBlock =
+        file->fileHdr->dataBlocks[ ADF_MAX_DATABLK - 1 ];
+    adfFileClose ( file );
+    ck_assert_int_eq ( adfToRootDir ( vol ), ADF_RC_OK );
+    ck_assert_int_gt ( fileDataBlock, 1 );
+
+    const ADF_SECTNUM freeBlock = adfGet1FreeBlock ( vol );   // marks it used
+    ck_assert_int_gt ( freeBlock, 1 );
+    adfSetBlockFree ( vol, fileDataBlock );
+
+    for ( unsigned nThreads = 1 ; nThreads <= 8 ; nThreads *= 2 ) {
+        struct AdfBitmapCheck check;
+        ck_assert_int_eq ( adfVerifyBitmap ( vol, nThreads, &check ), ADF_RC_OK );
+        ck_assert_uint_eq ( check.usedUnreferenced.nItems, 1 );
+        ck_assert_int_eq ( check.usedUnreferenced.sectors[ 0 ], freeBlock );
+        ck_assert_uint_eq ( check.referencedFree.nItems, 1 );
+        ck_assert_int_eq ( check.referencedFree.sectors[ 0 ], fileDataBlock );
+        adfFreeBitmapCheck ( &check );
+    }
+
+    // repair with a parallel reconstruction
+    struct AdfRootBlock root;
+    ck_assert_int_eq ( adfReadRootBlock ( vol, (uint32_t) vol->rootBlock, &root ),
+                       ADF_RC_OK );
+    ck_assert_int_eq ( adfReconstructBitmapParallel ( vol, &root, 4 ), ADF_RC_OK );
+    ck_assert_int_eq ( adfUpdateBitmap ( vol ), ADF_RC_OK );
+
+    verify_bitmap ( vol, 4, 0, 0 );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), freeBlocks );
+
+    // and the repaired bitmap is on the disk
+    adfVolUnMount ( vol );
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    verify_bitmap ( vol, 2, 0, 0 );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), freeBlocks );
+
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_bitmap_verify_ofs )
+{
+    test_data_t test_data = {
+        .driver  = "ramdisk",
+        .adfname = "test_bitmap_verify_ofs.adf",
+        .volname = "Test_bitmap_verify_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_bitmap_verify ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_bitmap_verify_ffs )
+{
+    test_data_t test_data = {
+        .driver  = "ramdisk",
+        .adfname = "test_bitmap_verify_ffs.adf",
+        .volname = "Test_bitmap_verify_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_bitmap_verify ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_bitmap_verify_dump )
+{
+    test_data_t test_data = {
+        .driver  = "dump",
+        .adfname = "test_bitmap_verify_dump.adf",
+        .volname = "Test_bitmap_verify_dump",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_bitmap_verify ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_bitmap_verify_ofs" );
+    tcase_add_test ( tc, test_bitmap_verify_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_bitmap_verify_ffs" );
+    tcase_add_test ( tc, test_bitmap_verify_ffs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_bitmap_verify_dump" );
+    tcase_add_test ( tc, test_bitmap_verify_dump );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( tdata->driver, tdata->adfname, 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, tdata->volname, tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume: %s\n",
+                  tdata->volname );
+        exit(1);
+    }
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+    if ( strcmp ( tdata->driver, "dump" ) == 0 )
+        unlink ( tdata->adfname );
+}
@@ -0,0 +1,196 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define IMAGE     "test_dev_async.adf"
+#define NREQS     64
+#define REQ_SIZE  4       // blocks
+#define DEPTH     16
+
+
+static uint8_t  data[ NREQS ][ REQ_SIZE * 512 ],
+                readBuf[ NREQS ][ REQ_SIZE * 512 ];
+static unsigned nCompleted[ NREQS ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+/* request i is on blocks from ( i * 7 ) % NREQS * REQ_SIZE (not in order) */
+static uint32_t req_block ( const unsigned  i )
+{
+    return ( i * 7 ) % NREQS * REQ_SIZE;
+}
+
+static void collect ( struct AdfDevAsync * const  aio,
+                      const unsigned              min )
+{
+    struct AdfDevAsyncCompletion completions[ DEPTH ];
+    const unsigned nInFlight = adfDevAsyncInFlight ( aio ),
+                   n = adfDevAsyncWait ( aio, completions, DEPTH, min );
+    ck_assert_uint_ge ( n, min < nInFlight ? min : nInFlight );
+    for ( unsigned i = 0 ; i < n ; i++ ) {
+        ck_assert_int_eq ( completions[ i ].rc, ADF_RC_OK );
+        ck_assert_uint_lt ( completions[ i ].tag, NREQS );
+        nCompleted[ completions[ i ].tag ]++;
+    }
+}
+
+static void test_async ( struct AdfDevice * const  dev,
+                         const AdfDevAsyncBackend  backend )
+{
+    struct AdfDevAsync * const aio = adfDevAsyncCreate ( dev, DEPTH );
+    ck_assert_ptr_nonnull ( aio );
+    // (synchronous - if built without threads)
+    const AdfDevAsyncBackend used = adfDevAsyncGetBackend ( aio );
+    ck_assert ( used == backend || used == ADF_DEV_ASYNC_SYNC );
+
+    pattern_random ( &data[ 0 ][ 0 ], sizeof data );
+    adfDevResetStats ( dev );
+
+    // writes (more than the queue depth)
+    memset ( nCompleted, 0, sizeof nCompleted );
+    for ( unsigned i = 0 ; i < NREQS ; i++ ) {
+        if ( adfDevAsyncInFlight ( aio ) == DEPTH )
+            collect ( aio, 1 );
+        ck_assert_int_eq ( adfDevAsyncWrite ( aio, req_block ( i ), REQ_SIZE,
+                                              data[ i ], i ), ADF_RC_OK );
+    }
+    while ( adfDevAsyncInFlight ( aio ) > 0 )
+        collect ( aio, 1 );
+    for ( unsigned i = 0 ; i < NREQS ; i++ )
+        ck_assert_uint_eq ( nCompleted[ i ], 1 );
+
+    // written data is on the device
+    uint8_t buf[ REQ_SIZE * 512 ];
+    for ( unsigned i = 0 ; i < NREQS ; i++ ) {
+        for ( unsigned b = 0 ; b < REQ_SIZE ; b++ )
+            ck_assert_int_eq ( adfDevReadBlock ( dev, req_block ( i ) + b, 512,
+                                                 buf + b * 512 ), ADF_RC_OK );
+        ck_assert_mem_eq ( buf, data[ i ], sizeof buf );
+    }
+
+    // reads
+    memset ( nCompleted, 0, sizeof nCompleted );
+    memset ( readBuf, 0, sizeof readBuf );
+    for ( unsigned i = 0 ; i < NREQS ; i++ ) {
+        if ( adfDevAsyncInFlight ( aio ) == DEPTH )
+            collect ( aio, DEPTH / 2 );
+        ck_assert_int_eq ( adfDevAsyncRead ( aio, req_block ( i ), REQ_SIZE,
+                                             readBuf[ i ], i ), ADF_RC_OK );
+    }
+    collect ( aio, DEPTH );     // (all in flight - no more than that)
+    ck_assert_uint_eq ( adfDevAsyncInFlight ( aio ), 0 );
+    for ( unsigned i = 0 ; i < NREQS ; i++ ) {
+        ck_assert_uint_eq ( nCompleted[ i ], 1 );
+        ck_assert_mem_eq ( readBuf[ i ], data[ i ], sizeof readBuf[ i ] );
+    }
+
+    // full queue, out of range
+    for ( unsigned i = 0 ; i < DEPTH ; i++ )
+        ck_assert_int_eq ( adfDevAsyncRead ( aio, req_block ( i ), REQ_SIZE,
+                                             readBuf[ i ], i ), ADF_RC_OK );
+    ck_assert_int_ne ( adfDevAsyncRead ( aio, 0, 1, readBuf[ 0 ], 0 ), ADF_RC_OK );
+    collect ( aio, 1 );
+    ck_assert_int_ne ( adfDevAsyncRead ( aio, dev->sizeBlocks - 1, 2,
+                                         readBuf[ 0 ], 0 ), ADF_RC_OK );
+    ck_assert_int_ne ( adfDevAsyncRead ( aio, 0, 0, readBuf[ 0 ], 0 ), ADF_RC_OK );
+
+    // (destroyed with requests in flight)
+    adfDevAsyncDestroy ( aio );
+
+    // all requests (and the direct reads) are counted in the stats
+    struct AdfDevStats stats;
+    ck_assert_int_eq ( adfDevGetStats ( dev, &stats ), ADF_RC_OK );
+    ck_assert_uint_eq ( stats.write.ops, NREQS );
+    ck_assert_uint_eq ( stats.write.blocks, NREQS * REQ_SIZE );
+    ck_assert_uint_eq ( stats.write.errors, 0 );
+    ck_assert_uint_eq ( stats.read.ops, NREQS * REQ_SIZE + NREQS + DEPTH );
+    ck_assert_uint_eq ( stats.read.blocks, ( 2 * NREQS + DEPTH ) * REQ_SIZE );
+    ck_assert_uint_eq ( stats.read.errors, 0 );
+}
+
+
+START_TEST ( test_async_dump )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "dump", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+#ifdef HAVE_IO_URING
+    // (io_uring can be disabled in the kernel - then the pool is used)
+    struct AdfDevAsync * const aio = adfDevAsyncCreate ( dev, DEPTH );
+    const AdfDevAsyncBackend backend = adfDevAsyncGetBackend ( aio );
+    adfDevAsyncDestroy ( aio );
+#else
+    const AdfDevAsyncBackend backend = ADF_DEV_ASYNC_THREADS;
+#endif
+    test_async ( dev, backend );
+    adfDevClose ( dev );
+
+    // read-only
+    struct AdfDevice * const devRO = adfDevOpen ( IMAGE, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( devRO );
+    struct AdfDevAsync * const aioRO = adfDevAsyncCreate ( devRO, DEPTH );
+    ck_assert_ptr_nonnull ( aioRO );
+    ck_assert_int_ne ( adfDevAsyncWrite ( aioRO, 0, 1, data[ 0 ], 0 ), ADF_RC_OK );
+    adfDevAsyncDestroy ( aioRO );
+    adfDevClose ( devRO );
+
+    unlink ( IMAGE );
+}
+END_TEST
+
+
+START_TEST ( test_async_ramdisk )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "async", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    test_async ( dev, ADF_DEV_ASYNC_THREADS );
+    adfDevClose ( dev );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_async_dump" );
+    tcase_add_test ( tc, test_async_dump );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_async_ramdisk" );
+    tcase_add_test ( tc, test_async_ramdisk );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
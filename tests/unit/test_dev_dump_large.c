@@ -0,0 +1,121 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+/* a sparse 8 GiB hardfile (16384 * 16 * 64 blocks) */
+#define IMAGE      "test_dev_dump_large.hdf"
+#define CYLINDERS  16384
+#define HEADS      16
+#define SECTORS    64
+#define SIZE_BLOCKS  ( (uint32_t) CYLINDERS * HEADS * SECTORS )
+
+
+/* block pairs across the 2 GiB and 4 GiB offsets, up to the last block */
+static const uint32_t testBlocks[] = {
+    4194303,            // (across 2 GiB)
+    8388607,            // (across 4 GiB)
+    12345678,
+    SIZE_BLOCKS - 1000,
+    SIZE_BLOCKS - 2
+};
+#define N_TEST_BLOCKS  ( sizeof testBlocks / sizeof testBlocks[ 0 ] )
+
+static uint8_t data[ N_TEST_BLOCKS ][ 2 * 512 ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void check_data ( struct AdfDevice * const  dev )
+{
+    uint8_t buf[ 2 * 512 ];
+    for ( unsigned i = 0 ; i < N_TEST_BLOCKS ; i++ ) {
+        memset ( buf, 0, sizeof buf );
+        ck_assert_int_eq ( adfDevReadBlock ( dev, testBlocks[ i ], sizeof buf, buf ),
+                           ADF_RC_OK );
+        ck_assert_mem_eq ( buf, data[ i ], sizeof buf );
+    }
+
+    // not written - zeros (a hole)
+    static const uint8_t zeros[ 512 ];
+    ck_assert_int_eq ( adfDevReadBlock ( dev, SIZE_BLOCKS - 3000, 512, buf ), ADF_RC_OK );
+    ck_assert_mem_eq ( buf, zeros, 512 );
+}
+
+
+START_TEST ( test_dump_large )
+{
+    struct AdfDevice * dev = adfDevCreate ( "dump", IMAGE, CYLINDERS, HEADS, SECTORS );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( dev->sizeBlocks, SIZE_BLOCKS );
+
+    // the last block (written when creating) is empty
+    uint8_t buf[ 512 ];
+    static const uint8_t zeros[ 512 ];
+    ck_assert_int_eq ( adfDevReadBlock ( dev, SIZE_BLOCKS - 1, 512, buf ), ADF_RC_OK );
+    ck_assert_mem_eq ( buf, zeros, 512 );
+
+    pattern_random ( &data[ 0 ][ 0 ], sizeof data );
+    for ( unsigned i = 0 ; i < N_TEST_BLOCKS ; i++ )
+        ck_assert_int_eq ( adfDevWriteBlock ( dev, testBlocks[ i ], sizeof data[ i ],
+                                              data[ i ] ), ADF_RC_OK );
+    check_data ( dev );
+
+    // out of range
+    ck_assert_int_ne ( adfDevWriteBlock ( dev, SIZE_BLOCKS - 1, 1024, data[ 0 ] ),
+                       ADF_RC_OK );
+    ck_assert_int_ne ( adfDevReadBlock ( dev, SIZE_BLOCKS, 512, buf ), ADF_RC_OK );
+    adfDevClose ( dev );
+
+    // the size of an existing image
+    dev = adfDevOpen ( IMAGE, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( dev->sizeBlocks, SIZE_BLOCKS );
+    check_data ( dev );
+    adfDevClose ( dev );
+
+    unlink ( IMAGE );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_dump_large" );
+    tcase_add_test ( tc, test_dump_large );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
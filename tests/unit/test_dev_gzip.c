@@ -0,0 +1,342 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "adflib.h"
+#include "adf_dev_driver_gzip.h"
+#include "test_util.h"
+
+
+#define IMAGE       "test_dev_gzip.adf"
+#define IMAGE_GZ    "test_dev_gzip.adz"
+#define INDEX       IMAGE_GZ ADF_GZIP_INDEX_EXT
+#define NBLOCKS     ( 80 * 2 * 11 )
+
+static uint8_t image[ NBLOCKS * 512 ],
+               randomData[ 300000 ],
+               text[ 200000 ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+#ifdef HAVE_ZLIB
+
+static void write_image_gz ( const char * const  mode );
+
+/* a floppy with a random (incompressible) and a text (compressible) file,
+   compressed with gzip */
+static void create_image ( void )
+{
+    pattern_random ( randomData, sizeof randomData );
+    for ( unsigned i = 0 ; i < sizeof text ; i++ )
+        text[ i ] = (uint8_t) "abcdefghij \n"[ ( i * 7 + i / 13 ) % 12 ];
+
+    struct AdfDevice * const dev = adfDevCreate ( "dump", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "gzip", ADF_DOSFS_FFS ), ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * file = adfFileOpen ( vol, "random", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof randomData, randomData ),
+                        sizeof randomData );
+    adfFileClose ( file );
+    file = adfFileOpen ( vol, "text", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof text, text ), sizeof text );
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    FILE * const f = fopen ( IMAGE, "rb" );
+    ck_assert_ptr_nonnull ( f );
+    ck_assert_uint_eq ( fread ( image, 1, sizeof image, f ), sizeof image );
+    fclose ( f );
+    unlink ( IMAGE );
+    unlink ( INDEX );
+
+    write_image_gz ( "wb9" );
+}
+
+
+static void write_image_gz ( const char * const  mode )
+{
+    gzFile gz = gzopen ( IMAGE_GZ, mode );
+    ck_assert_ptr_nonnull ( gz );
+    ck_assert_int_eq ( gzwrite ( gz, image, sizeof image ), (int) sizeof image );
+    ck_assert_int_eq ( gzclose ( gz ), Z_OK );
+}
+
+
+/* the whole file (to free), its length in len */
+static uint8_t * read_file ( const char * const  name,
+                             size_t * const      len )
+{
+    FILE * const f = fopen ( name, "rb" );
+    ck_assert_ptr_nonnull ( f );
+    ck_assert_int_eq ( fseek ( f, 0, SEEK_END ), 0 );
+    *len = (size_t) ftell ( f );
+    ck_assert_int_eq ( fseek ( f, 0, SEEK_SET ), 0 );
+    uint8_t * const buf = malloc ( *len );
+    ck_assert_ptr_nonnull ( buf );
+    ck_assert_uint_eq ( fread ( buf, 1, *len, f ), *len );
+    fclose ( f );
+    return buf;
+}
+
+
+/* true if the index file is (still) the one in idx */
+static bool index_is ( const uint8_t * const  idx,
+                       const size_t           len )
+{
+    size_t lenNow;
+    uint8_t * const idxNow = read_file ( INDEX, &lenNow );
+    const bool same = ( lenNow == len && memcmp ( idxNow, idx, len ) == 0 );
+    free ( idxNow );
+    return same;
+}
+
+
+static void check_device ( struct AdfDevice * const  dev )
+{
+    ck_assert_ptr_eq ( dev->drv, &adfDeviceDriverGzip );
+    ck_assert ( dev->readOnly );
+    ck_assert_uint_eq ( dev->sizeBlocks, NBLOCKS );
+
+    // blocks in a scattered order (single ones and runs across access points)
+    static uint8_t buf[ 200 * 512 ];
+    for ( unsigned i = 0 ; i < NBLOCKS ; i++ ) {
+        const uint32_t block = ( i * 97 ) % NBLOCKS;
+        ck_assert_int_eq ( adfDevReadBlock ( dev, block, 512, buf ), ADF_RC_OK );
+        ck_assert_mem_eq ( buf, image + block * 512, 512 );
+    }
+    for ( uint32_t block = NBLOCKS - 200 ; block > 0 ; block = block > 150 ? block - 150 : 0 ) {
+        ck_assert_int_eq ( adfDevReadBlock ( dev, block, sizeof buf, buf ), ADF_RC_OK );
+        ck_assert_mem_eq ( buf, image + block * 512, sizeof buf );
+    }
+    ck_assert_int_ne ( adfDevReadBlock ( dev, NBLOCKS, 512, buf ), ADF_RC_OK );
+    ck_assert_int_ne ( adfDevWriteBlock ( dev, 0, 512, buf ), ADF_RC_OK );
+
+    // the volume
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_uint_eq ( verify_file_data ( vol, "random", randomData,
+                                           sizeof randomData, 10 ), 0 );
+    ck_assert_uint_eq ( verify_file_data ( vol, "text", text, sizeof text, 10 ), 0 );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+}
+
+
+START_TEST ( test_gzip )
+{
+    create_image();
+    ck_assert_int_ne ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_MIN - 1 ), ADF_RC_OK );
+    ck_assert_int_eq ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_MIN ), ADF_RC_OK );
+
+    struct AdfDevice * dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    check_device ( dev );
+    adfDevClose ( dev );
+
+    // opened for writing - read-only
+    dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( dev );
+    check_device ( dev );
+    adfDevClose ( dev );
+    ck_assert ( access ( INDEX, F_OK ) != 0 );
+
+    ck_assert_int_eq ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_DEFAULT ), ADF_RC_OK );
+    unlink ( IMAGE_GZ );
+}
+END_TEST
+
+
+START_TEST ( test_gzip_index_file )
+{
+    create_image();
+    ck_assert_int_eq ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_MIN ), ADF_RC_OK );
+    adfGzipSetIndexSaving ( true );
+
+    // saved
+    struct AdfDevice * dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    adfDevClose ( dev );
+    ck_assert ( access ( INDEX, F_OK ) == 0 );
+
+    // loaded
+    dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    check_device ( dev );
+    adfDevClose ( dev );
+
+    // invalid (truncated) - rebuilt
+    ck_assert_int_eq ( truncate ( INDEX, 100 ), 0 );
+    dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    check_device ( dev );
+    adfDevClose ( dev );
+
+    adfGzipSetIndexSaving ( false );
+    ck_assert_int_eq ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_DEFAULT ), ADF_RC_OK );
+    unlink ( INDEX );
+    unlink ( IMAGE_GZ );
+}
+END_TEST
+
+
+START_TEST ( test_gzip_index_stale )
+{
+    // (stored, not compressed - the compressed size depends only on the data size)
+    create_image();
+    write_image_gz ( "wb0" );
+    ck_assert_int_eq ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_MIN ), ADF_RC_OK );
+    adfGzipSetIndexSaving ( true );
+
+    struct AdfDevice * dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    adfDevClose ( dev );
+    size_t idxLen, gzLen, gzLenNew;
+    uint8_t * idx = read_file ( INDEX, &idxLen );
+    free ( read_file ( IMAGE_GZ, &gzLen ) );
+    struct stat st;
+    ck_assert_int_eq ( stat ( IMAGE_GZ, &st ), 0 );
+    struct utimbuf times = { .actime = st.st_atime, .modtime = st.st_mtime };
+
+    // another image of the same compressed size and time - the index rebuilt
+    for ( unsigned i = 0 ; i < 512 ; i++ )
+        image[ 512 + i ] ^= 0xff;       // (the boot code)
+    write_image_gz ( "wb0" );
+    free ( read_file ( IMAGE_GZ, &gzLenNew ) );
+    ck_assert_uint_eq ( gzLenNew, gzLen );
+    ck_assert_int_eq ( utime ( IMAGE_GZ, &times ), 0 );
+
+    dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    check_device ( dev );
+    adfDevClose ( dev );
+    ck_assert ( ! index_is ( idx, idxLen ) );
+    free ( idx );
+
+    // the same image, modified later - the index rebuilt
+    idx = read_file ( INDEX, &idxLen );
+    times.modtime += 10;
+    ck_assert_int_eq ( utime ( IMAGE_GZ, &times ), 0 );
+    dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    adfDevClose ( dev );
+    ck_assert ( ! index_is ( idx, idxLen ) );
+    free ( idx );
+
+    // not changed - the index used (not saved again)
+    const struct utimbuf idxTimes = { .actime = 1000, .modtime = 1000 };
+    ck_assert_int_eq ( utime ( INDEX, &idxTimes ), 0 );
+    dev = adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    check_device ( dev );
+    adfDevClose ( dev );
+    ck_assert_int_eq ( stat ( INDEX, &st ), 0 );
+    ck_assert_int_eq ( st.st_mtime, 1000 );
+
+    adfGzipSetIndexSaving ( false );
+    ck_assert_int_eq ( adfGzipSetIndexSpacing ( ADF_GZIP_SPACING_DEFAULT ), ADF_RC_OK );
+    unlink ( INDEX );
+    unlink ( IMAGE_GZ );
+}
+END_TEST
+
+
+START_TEST ( test_gzip_invalid )
+{
+    // not compressed
+    FILE * const f = fopen ( IMAGE_GZ, "wb" );
+    ck_assert_ptr_nonnull ( f );
+    ck_assert_uint_eq ( fwrite ( image, 1, 10000, f ), 10000 );
+    fclose ( f );
+    ck_assert_ptr_null ( adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY ) );
+
+    // truncated
+    create_image();
+    ck_assert_int_eq ( truncate ( IMAGE_GZ, 20000 ), 0 );
+    ck_assert_ptr_null ( adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY ) );
+    unlink ( IMAGE_GZ );
+}
+END_TEST
+
+#else
+
+START_TEST ( test_gzip )
+{
+    // (built without zlib - compressed images cannot be opened)
+    FILE * const f = fopen ( IMAGE_GZ, "wb" );
+    ck_assert_ptr_nonnull ( f );
+    ck_assert_uint_eq ( fwrite ( image, 1, sizeof image, f ), sizeof image );
+    fclose ( f );
+    ck_assert_ptr_null ( adfDevOpen ( IMAGE_GZ, ADF_ACCESS_MODE_READONLY ) );
+    unlink ( IMAGE_GZ );
+}
+END_TEST
+
+#endif
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_gzip" );
+    tcase_add_test ( tc, test_gzip );
+    suite_add_tcase ( s, tc );
+
+#ifdef HAVE_ZLIB
+    tc = tcase_create ( "adflib test_gzip_index_file" );
+    tcase_add_test ( tc, test_gzip_index_file );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_gzip_index_stale" );
+    tcase_add_test ( tc, test_gzip_index_stale );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_gzip_invalid" );
+    tcase_add_test ( tc, test_gzip_invalid );
+    suite_add_tcase ( s, tc );
+#endif
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
@@ -0,0 +1,178 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>   // for unlink()
+
+#include "adflib.h"
+
+
+#define N_PARTITIONS  4
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static uint32_t file_size ( const int nPart )
+{
+    return 1000u * (uint32_t) ( nPart + 1 );
+}
+
+
+static struct AdfDevice * create_hd ( const char * const  devname,
+                                      const uint8_t       fstype )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "dump", devname, 200, 4, 32 );
+    ck_assert_ptr_nonnull ( dev );
+
+    struct AdfPartition parts[ N_PARTITIONS ];
+    const struct AdfPartition * partList[ N_PARTITIONS ];
+    char names[ N_PARTITIONS ][ 8 ];
+    for ( int i = 0 ; i < N_PARTITIONS ; i++ ) {
+        snprintf ( names[ i ], sizeof ( names[ i ] ), "part%d", i );
+        parts[ i ] = ( struct AdfPartition ) {
+            .startCyl = 2 + i * 48,
+            .lenCyl   = 48,
+            .volName  = names[ i ],
+            .volType  = fstype
+        };
+        partList[ i ] = &parts[ i ];
+    }
+    ck_assert_int_eq ( adfCreateHd ( dev, N_PARTITIONS, partList ), ADF_RC_OK );
+
+    // a file of different size on each volume
+    uint8_t * const buf = calloc ( 1, file_size ( N_PARTITIONS ) );
+    ck_assert_ptr_nonnull ( buf );
+    for ( int i = 0 ; i < N_PARTITIONS ; i++ ) {
+        struct AdfVolume * const vol = adfVolMount ( dev, i, ADF_ACCESS_MODE_READWRITE );
+        ck_assert_ptr_nonnull ( vol );
+        struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+        ck_assert_ptr_nonnull ( file );
+        ck_assert_uint_eq ( adfFileWrite ( file, file_size ( i ), buf ), file_size ( i ) );
+        adfFileClose ( file );
+        adfVolUnMount ( vol );
+    }
+    free ( buf );
+
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    struct AdfDevice * const hd = adfDevOpen ( devname, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( hd );
+    ck_assert_int_eq ( adfDevMount ( hd ), ADF_RC_OK );
+    ck_assert_int_eq ( hd->nVol, N_PARTITIONS );
+    return hd;
+}
+
+
+static ADF_RETCODE check_file ( struct AdfVolume * const  vol,
+                                const int                 nPart,
+                                void * const              data )
+{
+    uint32_t * const freeBlocks = data;
+    freeBlocks[ nPart ] = adfCountFreeBlocks ( vol );
+
+    struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    if ( file == NULL )
+        return ADF_RC_ERROR;
+    const uint32_t size = adfFileGetSize ( file );
+    adfFileClose ( file );
+    return ( size == file_size ( nPart ) ) ? ADF_RC_OK : ADF_RC_ERROR;
+}
+
+
+static void test_mount_all ( const char * const  devname,
+                             const uint8_t       fstype,
+                             const unsigned      nThreads )
+{
+    struct AdfDevice * const dev = create_hd ( devname, fstype );
+
+    ADF_RETCODE status[ N_PARTITIONS ];
+    ck_assert_int_eq ( adfDevMountAll ( dev, ADF_ACCESS_MODE_READONLY,
+                                        nThreads, status ), ADF_RC_OK );
+    for ( int i = 0 ; i < N_PARTITIONS ; i++ ) {
+        ck_assert_int_eq ( status[ i ], ADF_RC_OK );
+        ck_assert ( dev->volList[ i ]->mounted );
+        ck_assert ( dev->volList[ i ]->readOnly );
+    }
+
+    // already mounted - nothing to do
+    ck_assert_int_eq ( adfDevMountAll ( dev, ADF_ACCESS_MODE_READONLY,
+                                        nThreads, NULL ), ADF_RC_OK );
+
+    uint32_t freeBlocks[ N_PARTITIONS ];
+    memset ( freeBlocks, 0, sizeof ( freeBlocks ) );
+    ck_assert_int_eq ( adfDevForEachVolume ( dev, nThreads, check_file,
+                                             freeBlocks, status ), ADF_RC_OK );
+    for ( int i = 0 ; i < N_PARTITIONS ; i++ ) {
+        ck_assert_int_eq ( status[ i ], ADF_RC_OK );
+        ck_assert_uint_eq ( freeBlocks[ i ], adfCountFreeBlocks ( dev->volList[ i ] ) );
+    }
+    // volumes with a bigger file have less free space
+    for ( int i = 1 ; i < N_PARTITIONS ; i++ )
+        ck_assert_uint_lt ( freeBlocks[ i ], freeBlocks[ i - 1 ] );
+
+    // unmounting the device unmounts volumes
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+    unlink ( devname );
+}
+
+
+START_TEST ( test_dev_mount_all_serial )
+{
+    test_mount_all ( "test_dev_mount_all_serial.hdf", ADF_DOSFS_OFS, 1 );
+}
+END_TEST
+
+
+START_TEST ( test_dev_mount_all_parallel )
+{
+    test_mount_all ( "test_dev_mount_all_parallel.hdf", ADF_DOSFS_FFS, 4 );
+}
+END_TEST
+
+
+START_TEST ( test_dev_mount_all_many_threads )
+{
+    test_mount_all ( "test_dev_mount_all_many_threads.hdf", ADF_DOSFS_FFS, 16 );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_dev_mount_all" );
+    tcase_add_test ( tc, test_dev_mount_all_serial );
+    tcase_add_test ( tc, test_dev_mount_all_parallel );
+    tcase_add_test ( tc, test_dev_mount_all_many_threads );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
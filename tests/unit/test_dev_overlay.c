@@ -0,0 +1,237 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "adf_dev_driver_overlay.h"
+#include "test_util.h"
+
+
+#define BASE   "test_dev_overlay.adf"
+#define DELTA  BASE ADF_OVERLAY_DELTA_EXT
+#define IMAGE_SIZE  ( 80 * 2 * 11 * 512 )
+
+
+static uint8_t baseImage[ IMAGE_SIZE ],
+               data1[ 20000 ],
+               data2[ 30000 ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void read_image ( uint8_t * const  buf )
+{
+    FILE * const f = fopen ( BASE, "rb" );
+    ck_assert_ptr_nonnull ( f );
+    ck_assert_uint_eq ( fread ( buf, 1, IMAGE_SIZE, f ), IMAGE_SIZE );
+    fclose ( f );
+}
+
+static bool file_exists ( const char * const  name )
+{
+    return access ( name, F_OK ) == 0;
+}
+
+static void write_file ( struct AdfVolume * const  vol,
+                         const char * const        name,
+                         const uint8_t * const     data,
+                         const unsigned            size )
+{
+    struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, size, data ), size );
+    adfFileClose ( file );
+}
+
+/* mounts the overlay (or the base), checks which of the files are present */
+static void check_files ( const char * const  driver,
+                          const bool          file2 )
+{
+    struct AdfDevice * const dev = adfDevOpenWithDriver ( driver, BASE,
+                                                          ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+
+    ck_assert_uint_eq ( verify_file_data ( vol, "file1", data1, sizeof data1, 10 ), 0 );
+    if ( file2 )
+        ck_assert_uint_eq ( verify_file_data ( vol, "file2", data2, sizeof data2, 10 ), 0 );
+    else
+        ck_assert_ptr_null ( adfFileOpen ( vol, "file2", ADF_FILE_MODE_READ ) );
+
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+}
+
+/* writes file2 on the overlay */
+static struct AdfDevice * overlay_change ( void )
+{
+    struct AdfDevice * const dev = adfDevOpenWithDriver ( "overlay", BASE,
+                                                          ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( adfOverlayChangedBlocks ( dev ), 0 );
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    write_file ( vol, "file2", data2, sizeof data2 );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    ck_assert_uint_gt ( adfOverlayChangedBlocks ( dev ), sizeof data2 / 512 );
+    return dev;
+}
+
+
+START_TEST ( test_overlay )
+{
+    // a base image with one file
+    pattern_random ( data1, sizeof data1 );
+    pattern_random ( data2, sizeof data2 );
+    struct AdfDevice * dev = adfDevCreate ( "dump", BASE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "overlay", ADF_DOSFS_FFS ), ADF_RC_OK );
+    struct AdfVolume * vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    write_file ( vol, "file1", data1, sizeof data1 );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+    read_image ( baseImage );
+
+    // changes go to the delta only (kept when closed)
+    dev = overlay_change();
+    const uint32_t nChanged = adfOverlayChangedBlocks ( dev );
+    adfDevClose ( dev );
+    static uint8_t image[ IMAGE_SIZE ];
+    read_image ( image );
+    ck_assert_mem_eq ( image, baseImage, IMAGE_SIZE );
+    ck_assert ( file_exists ( DELTA ) );
+
+    check_files ( "dump", false );
+    check_files ( "overlay", true );
+
+    // discard
+    dev = adfDevOpenWithDriver ( "overlay", BASE, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( adfOverlayChangedBlocks ( dev ), nChanged );
+    ck_assert_int_eq ( adfOverlayDiscard ( dev ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfOverlayChangedBlocks ( dev ), 0 );
+    adfDevClose ( dev );
+    ck_assert ( ! file_exists ( DELTA ) );
+    check_files ( "overlay", false );
+
+    // commit
+    dev = overlay_change();
+    ck_assert_int_eq ( adfOverlayCommit ( dev ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfOverlayChangedBlocks ( dev ), 0 );
+    adfDevClose ( dev );
+    ck_assert ( ! file_exists ( DELTA ) );
+    check_files ( "dump", true );
+
+    unlink ( BASE );
+}
+END_TEST
+
+
+START_TEST ( test_overlay_blocks )
+{
+    struct AdfDevice * dev = adfDevCreate ( "dump", BASE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    static uint8_t buf[ 100 * 512 ];
+    for ( unsigned i = 0 ; i < 100 ; i++ )
+        memset ( buf + i * 512, (int) i, 512 );
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, 0, sizeof buf, buf ), ADF_RC_OK );
+    adfDevClose ( dev );
+
+    dev = adfDevOpenWithDriver ( "overlay", BASE, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( dev->sizeBlocks, 80 * 2 * 11 );
+
+    // scattered (descending) and overwritten blocks
+    uint8_t block[ 512 ];
+    for ( unsigned i = 90 ; i >= 10 ; i -= 10 ) {
+        memset ( block, (int) ( 0x80 + i ), 512 );
+        memset ( buf + i * 512, (int) ( 0x80 + i ), 512 );
+        ck_assert_int_eq ( adfDevWriteBlock ( dev, i, 512, block ), ADF_RC_OK );
+    }
+    memset ( buf + 50 * 512, 0xff, 3 * 512 );
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, 50, 3 * 512, buf + 50 * 512 ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfOverlayChangedBlocks ( dev ), 11 );
+
+    // reads mixing the base and the delta
+    static uint8_t rbuf[ 100 * 512 ];
+    ck_assert_int_eq ( adfDevReadBlock ( dev, 0, sizeof rbuf, rbuf ), ADF_RC_OK );
+    ck_assert_mem_eq ( rbuf, buf, sizeof buf );
+    ck_assert_int_eq ( adfDevReadBlock ( dev, 51, 512, rbuf ), ADF_RC_OK );
+    ck_assert_mem_eq ( rbuf, buf + 51 * 512, 512 );
+    adfDevClose ( dev );
+
+    // the delta reopened (read-only)
+    dev = adfDevOpenWithDriver ( "overlay", BASE, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( adfOverlayChangedBlocks ( dev ), 11 );
+    memset ( rbuf, 0, sizeof rbuf );
+    ck_assert_int_eq ( adfDevReadBlock ( dev, 0, sizeof rbuf, rbuf ), ADF_RC_OK );
+    ck_assert_mem_eq ( rbuf, buf, sizeof buf );
+    ck_assert_int_ne ( adfDevWriteBlock ( dev, 0, 512, block ), ADF_RC_OK );
+    ck_assert_int_ne ( adfOverlayCommit ( dev ), ADF_RC_OK );
+    adfDevClose ( dev );
+    ck_assert ( file_exists ( DELTA ) );
+
+    // a delta not matching the base
+    unlink ( BASE );
+    dev = adfDevCreate ( "dump", BASE, 80, 2, 22 );
+    ck_assert_ptr_nonnull ( dev );
+    adfDevClose ( dev );
+    ck_assert_ptr_null ( adfDevOpenWithDriver ( "overlay", BASE,
+                                                ADF_ACCESS_MODE_READWRITE ) );
+
+    unlink ( DELTA );
+    unlink ( BASE );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_overlay" );
+    tcase_add_test ( tc, test_overlay );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_overlay_blocks" );
+    tcase_add_test ( tc, test_overlay_blocks );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
@@ -0,0 +1,182 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "adf_dev_driver_ramdisk.h"
+#include "test_util.h"
+
+
+#define IMAGE      "test_dev_ramdisk.adf"
+#define IMAGE_NEW  "test_dev_ramdisk_new.adf"
+#define FILE_SIZE  20000
+#define IMAGE_SIZE ( 80 * 2 * 11 * 512 )
+
+
+static unsigned char  buffer[ FILE_SIZE ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void write_file ( struct AdfDevice * const  dev,
+                         const char * const        name )
+{
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, buffer ), FILE_SIZE );
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+}
+
+static void check_file ( struct AdfDevice * const  dev,
+                         const char * const        name )
+{
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_uint_eq ( verify_file_data ( vol, name, buffer, FILE_SIZE, 10 ), 0 );
+    adfVolUnMount ( vol );
+}
+
+static unsigned char * read_image ( const char * const  path )
+{
+    unsigned char * const image = malloc ( IMAGE_SIZE );
+    ck_assert_ptr_nonnull ( image );
+    FILE * const f = fopen ( path, "rb" );
+    ck_assert_ptr_nonnull ( f );
+    ck_assert_uint_eq ( fread ( image, 1, IMAGE_SIZE, f ), IMAGE_SIZE );
+    fclose ( f );
+    return image;
+}
+
+
+START_TEST ( test_ramdisk_create_size )
+{
+    // (a hardfile - data is allocated, but not touched)
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "hdf", 2000, 4, 32 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_uint_eq ( dev->sizeBlocks, 2000 * 4 * 32 );
+
+    uint8_t block[ 512 ];
+    memset ( block, 0xaa, sizeof block );
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, dev->sizeBlocks - 1, 512, block ),
+                       ADF_RC_OK );
+    memset ( block, 0, sizeof block );
+    ck_assert_int_eq ( adfDevReadBlock ( dev, dev->sizeBlocks - 1, 512, block ),
+                       ADF_RC_OK );
+    ck_assert_uint_eq ( block[ 511 ], 0xaa );
+    adfDevClose ( dev );
+}
+END_TEST
+
+
+START_TEST ( test_ramdisk_load_save )
+{
+    pattern_random ( buffer, FILE_SIZE );
+
+    // an image on disk
+    struct AdfDevice * dev = adfDevCreate ( "dump", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "Test_ramdisk", ADF_DOSFS_FFS ),
+                       ADF_RC_OK );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    // loaded into memory: changes are not written...
+    dev = adfDevOpenWithDriver ( "ramdisk", IMAGE, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    unsigned char * const orig = read_image ( IMAGE );
+    write_file ( dev, "file1" );
+    unsigned char * image = read_image ( IMAGE );
+    ck_assert_mem_eq ( image, orig, IMAGE_SIZE );
+    free ( image );
+
+    // ... until saved
+    ck_assert_int_eq ( adfRamdiskSave ( dev, NULL ), ADF_RC_OK );
+    image = read_image ( IMAGE );
+    ck_assert ( memcmp ( image, orig, IMAGE_SIZE ) != 0 );
+    free ( image );
+    free ( orig );
+
+    // ... or closed
+    write_file ( dev, "file2" );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    dev = adfDevOpen ( IMAGE, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    check_file ( dev, "file1" );
+    check_file ( dev, "file2" );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    // saved as another image
+    dev = adfDevOpenWithDriver ( "ramdisk", IMAGE, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfRamdiskSave ( dev, IMAGE_NEW ), ADF_RC_OK );
+    adfDevClose ( dev );
+
+    dev = adfDevOpen ( IMAGE_NEW, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    check_file ( dev, "file2" );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    // a created ramdisk has no image to save back to
+    dev = adfDevCreate ( "ramdisk", "new", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_ne ( adfRamdiskSave ( dev, NULL ), ADF_RC_OK );
+    adfDevClose ( dev );
+
+    unlink ( IMAGE );
+    unlink ( IMAGE_NEW );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_ramdisk_create_size" );
+    tcase_add_test ( tc, test_ramdisk_create_size );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_ramdisk_load_save" );
+    tcase_add_test ( tc, test_ramdisk_load_save );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
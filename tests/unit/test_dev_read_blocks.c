@@ -0,0 +1,138 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static struct AdfDevice * create_device ( void )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "test_dev_read_blocks",
+                                                  80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+
+    // each block filled with its number
+    uint8_t buf[ 512 ];
+    for ( uint32_t i = 0 ; i < dev->sizeBlocks ; i++ ) {
+        memset ( buf, (int) ( i & 0xff ), sizeof ( buf ) );
+        memcpy ( buf, &i, sizeof ( i ) );
+        ck_assert_int_eq ( adfDevWriteBlock ( dev, i, 512, buf ), ADF_RC_OK );
+    }
+
+    counting_start ( dev );
+    return dev;
+}
+
+
+static void check_blocks ( struct AdfDevice * const  dev,
+                           const unsigned            nBlocks,
+                           const uint32_t * const    sectors,
+                           const unsigned            nReadsExpected )
+{
+    uint8_t * const data = malloc ( 512 * nBlocks );
+    uint8_t ** const bufs = malloc ( sizeof ( uint8_t * ) * nBlocks );
+    ck_assert_ptr_nonnull ( data );
+    ck_assert_ptr_nonnull ( bufs );
+    for ( unsigned i = 0 ; i < nBlocks ; i++ )
+        bufs[ i ] = data + 512 * i;
+
+    counting_reset();
+    ck_assert_int_eq ( adfDevReadBlocks ( dev, nBlocks, sectors, bufs ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.reads, nReadsExpected );
+
+    for ( unsigned i = 0 ; i < nBlocks ; i++ ) {
+        uint32_t blockNum;
+        memcpy ( &blockNum, bufs[ i ], sizeof ( blockNum ) );
+        ck_assert_uint_eq ( blockNum, sectors[ i ] );
+        ck_assert_uint_eq ( bufs[ i ][ 511 ], sectors[ i ] & 0xff );
+    }
+
+    free ( bufs );
+    free ( data );
+}
+
+
+START_TEST ( test_dev_read_blocks_unsorted )
+{
+    struct AdfDevice * const dev = create_device();
+
+    // sorted: 3 3 | 50 55 | 100 101 102 | 1759
+    static const uint32_t sectors[] = { 100, 3, 101, 50, 3, 102, 1759, 55 };
+    check_blocks ( dev, sizeof ( sectors ) / sizeof ( uint32_t ), sectors, 4 );
+
+    // a single block
+    check_blocks ( dev, 1, &sectors[ 6 ], 1 );
+
+    // nothing to read
+    counting_reset();
+    ck_assert_int_eq ( adfDevReadBlocks ( dev, 0, NULL, NULL ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.reads, 0 );
+
+    counting_stop ( dev );
+    adfDevClose ( dev );
+}
+END_TEST
+
+
+START_TEST ( test_dev_read_blocks_long_run )
+{
+    struct AdfDevice * const dev = create_device();
+
+    // consecutive blocks, in reversed order, split in runs of max. length
+    enum { N = 3 * ADF_DEV_READ_RUN_MAX + 1 };
+    uint32_t sectors[ N ];
+    for ( unsigned i = 0 ; i < N ; i++ )
+        sectors[ i ] = 1000 + N - 1 - i;
+    check_blocks ( dev, N, sectors, 4 );
+
+    // gaps too big to coalesce
+    for ( unsigned i = 0 ; i < 10 ; i++ )
+        sectors[ i ] = 10 + i * ( ADF_DEV_READ_GAP_MAX + 1 );
+    check_blocks ( dev, 10, sectors, 10 );
+
+    counting_stop ( dev );
+    adfDevClose ( dev );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_dev_read_blocks" );
+    tcase_add_test ( tc, test_dev_read_blocks_unsorted );
+    tcase_add_test ( tc, test_dev_read_blocks_long_run );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
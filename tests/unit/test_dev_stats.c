@@ -0,0 +1,226 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define IMAGE  "test_dev_stats.adf"
+
+static uint8_t data[ 50000 ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static uint64_t latency_sum ( const struct AdfIoStats * const  stats )
+{
+    uint64_t sum = 0;
+    for ( unsigned i = 0 ; i < ADF_STATS_LATENCY_BUCKETS ; i++ )
+        sum += stats->latency[ i ];
+    return sum;
+}
+
+static void check_io_stats ( const struct AdfIoStats * const  stats )
+{
+    ck_assert_uint_gt ( stats->ops, 0 );
+    ck_assert_uint_le ( stats->singleOps, stats->ops );
+    ck_assert_uint_ge ( stats->blocks, stats->ops );
+    ck_assert_uint_eq ( stats->bytes, stats->blocks * 512 );
+    ck_assert_uint_eq ( stats->errors, 0 );
+    ck_assert_uint_ge ( stats->timeNs, stats->maxNs );
+    ck_assert_uint_eq ( latency_sum ( stats ), stats->ops );
+}
+
+
+static void check_vol_stats ( const struct AdfVolStats * const  stats )
+{
+    uint64_t blocksRead = 0;
+    for ( unsigned i = 0 ; i < ADF_STATS_BLOCK_TYPES ; i++ )
+        blocksRead += stats->blocksRead[ i ];
+    ck_assert_uint_eq ( blocksRead, stats->read.blocks );
+    ck_assert_uint_eq ( latency_sum ( &stats->read ), stats->read.ops );
+}
+
+
+START_TEST ( test_dev_stats )
+{
+    pattern_random ( data, sizeof data );
+
+    struct AdfDevice * const dev = adfDevCreate ( "dump", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "stats", ADF_DOSFS_FFS ), ADF_RC_OK );
+
+    struct AdfDevStats devStats;
+    ck_assert_int_eq ( adfDevGetStats ( dev, &devStats ), ADF_RC_OK );
+    check_io_stats ( &devStats.write );
+    adfDevResetStats ( dev );
+    ck_assert_int_eq ( adfDevGetStats ( dev, &devStats ), ADF_RC_OK );
+    ck_assert_uint_eq ( devStats.read.ops, 0 );
+    ck_assert_uint_eq ( devStats.write.ops, 0 );
+
+    // a file written, with writes buffered (written in runs)
+    ck_assert_int_eq ( adfDevSetWriteBuffer ( dev, ADF_DEV_WRITE_BUFFER_BLOCKS ),
+                       ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * const file = adfFileOpen ( vol, "data", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof data, data ), sizeof data );
+    adfFileClose ( file );
+    ck_assert_int_eq ( adfDevFlush ( dev ), ADF_RC_OK );
+
+    struct AdfVolStats volStats;
+    ck_assert_int_eq ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+    check_io_stats ( &volStats.read );
+    check_io_stats ( &volStats.write );
+    ck_assert_uint_ge ( volStats.blocksWritten[ ADF_STATS_BLOCK_DATA ],
+                        sizeof data / 512 );
+    ck_assert_uint_gt ( volStats.blocksWritten[ ADF_STATS_BLOCK_HEADER ], 0 );
+    ck_assert_uint_gt ( volStats.blocksWritten[ ADF_STATS_BLOCK_BITMAP ], 0 );
+    ck_assert_uint_gt ( volStats.blocksRead[ ADF_STATS_BLOCK_ROOT ], 0 );
+    ck_assert_uint_eq ( volStats.blocksRead[ ADF_STATS_BLOCK_OTHER ], 0 );
+    uint64_t blocksWritten = 0;
+    for ( unsigned i = 0 ; i < ADF_STATS_BLOCK_TYPES ; i++ )
+        blocksWritten += volStats.blocksWritten[ i ];
+    ck_assert_uint_eq ( blocksWritten, volStats.write.blocks );
+
+    ck_assert_int_eq ( adfDevGetStats ( dev, &devStats ), ADF_RC_OK );
+    check_io_stats ( &devStats.read );
+    check_io_stats ( &devStats.write );
+    ck_assert_uint_lt ( devStats.write.ops, volStats.write.ops );
+    ck_assert_uint_lt ( devStats.write.singleOps, devStats.write.ops );
+
+    // reading the file
+    adfVolResetStats ( vol );
+    ck_assert_int_eq ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+    ck_assert_uint_eq ( volStats.read.ops, 0 );
+    ck_assert_uint_eq ( volStats.blocksRead[ ADF_STATS_BLOCK_DATA ], 0 );
+    ck_assert_uint_eq ( verify_file_data ( vol, "data", data, sizeof data, 10 ), 0 );
+    ck_assert_int_eq ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+    check_io_stats ( &volStats.read );
+    ck_assert_uint_ge ( volStats.blocksRead[ ADF_STATS_BLOCK_DATA ], sizeof data / 512 );
+    ck_assert_uint_eq ( volStats.write.ops, 0 );
+
+    // (a direct read - of an unknown type)
+    uint8_t buf[ 512 ];
+    ck_assert_int_eq ( adfVolReadBlock ( vol, 0, buf ), ADF_RC_OK );
+    ck_assert_int_eq ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+    ck_assert_uint_eq ( volStats.blocksRead[ ADF_STATS_BLOCK_OTHER ], 1 );
+
+    ck_assert_str_eq ( adfStatsBlockTypeName ( ADF_STATS_BLOCK_DIRCACHE ), "dircache" );
+
+    adfVolUnMount ( vol );
+    ck_assert_int_ne ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+    unlink ( IMAGE );
+}
+END_TEST
+
+
+/* the volume stats updated concurrently by worker threads */
+START_TEST ( test_vol_stats_threads )
+{
+    pattern_random ( data, sizeof data );
+
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "stats", ADF_DOSFS_FFS ), ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    for ( unsigned i = 0 ; i < 16 ; i++ ) {
+        char name[ 16 ];
+        snprintf ( name, sizeof name, "file%u", i );
+        struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+        ck_assert_ptr_nonnull ( file );
+        const uint32_t size = 1000 + i * 2000;
+        ck_assert_uint_eq ( adfFileWrite ( file, size, data ), size );
+        adfFileClose ( file );
+    }
+
+    // hashing all files: single-threaded, then with workers (repeated)
+    struct AdfHashStats hashStats;
+    struct AdfVolStats expected, volStats;
+    adfVolResetStats ( vol );
+    ck_assert_int_eq ( adfVolHashAllFiles ( vol, ADF_HASH_CRC32, NULL, NULL, 1,
+                                            &hashStats ), ADF_RC_OK );
+    ck_assert_int_eq ( adfVolGetStats ( vol, &expected ), ADF_RC_OK );
+    check_vol_stats ( &expected );
+    ck_assert_uint_ge ( expected.blocksRead[ ADF_STATS_BLOCK_DATA ], 16 );
+
+    for ( unsigned i = 0 ; i < 20 ; i++ ) {
+        adfVolResetStats ( vol );
+        ck_assert_int_eq ( adfVolHashAllFiles ( vol, ADF_HASH_CRC32, NULL, NULL, 8,
+                                                &hashStats ), ADF_RC_OK );
+        ck_assert_int_eq ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+        check_vol_stats ( &volStats );
+        ck_assert_uint_eq ( volStats.read.blocks, expected.read.blocks );
+        for ( unsigned t = 0 ; t < ADF_STATS_BLOCK_TYPES ; t++ )
+            ck_assert_uint_eq ( volStats.blocksRead[ t ], expected.blocksRead[ t ] );
+    }
+
+    // verifying the bitmap: single-threaded, then with workers
+    struct AdfBitmapCheck check;
+    adfVolResetStats ( vol );
+    ck_assert_int_eq ( adfVerifyBitmap ( vol, 1, &check ), ADF_RC_OK );
+    adfFreeBitmapCheck ( &check );
+    ck_assert_int_eq ( adfVolGetStats ( vol, &expected ), ADF_RC_OK );
+    check_vol_stats ( &expected );
+
+    for ( unsigned i = 0 ; i < 20 ; i++ ) {
+        adfVolResetStats ( vol );
+        ck_assert_int_eq ( adfVerifyBitmap ( vol, 8, &check ), ADF_RC_OK );
+        adfFreeBitmapCheck ( &check );
+        ck_assert_int_eq ( adfVolGetStats ( vol, &volStats ), ADF_RC_OK );
+        check_vol_stats ( &volStats );
+        ck_assert_uint_eq ( volStats.read.blocks, expected.read.blocks );
+    }
+
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_dev_stats" );
+    tcase_add_test ( tc, test_dev_stats );
+    tcase_add_test ( tc, test_vol_stats_threads );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
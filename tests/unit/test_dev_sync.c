@@ -0,0 +1,170 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define IMAGE  "test_dev_sync.adf"
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void write_file ( struct AdfVolume * const  vol,
+                         const char * const        name )
+{
+    static uint8_t data[ 2000 ];
+    struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof data, data ), sizeof data );
+    adfFileClose ( file );
+}
+
+
+/* returns the number of syncs done by write_file() on a device with policy */
+static unsigned syncs_on_file_write ( const AdfSyncPolicy  policy,
+                                      unsigned * const     nSyncsUnmount )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "sync", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    counting_start ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "Test_sync", ADF_DOSFS_FFS ), ADF_RC_OK );
+    adfDevSetSyncPolicy ( dev, policy );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    counting_reset();
+    write_file ( vol, "file" );
+    const unsigned nSyncsWrite = counting.syncs;
+
+    // (reading does not sync)
+    counting_reset();
+    struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( counting.syncs, 0 );
+
+    // explicit
+    ck_assert_int_eq ( adfVolSync ( vol ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.syncs, 1 );
+
+    counting_reset();
+    adfVolUnMount ( vol );
+    *nSyncsUnmount = counting.syncs;
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+    return nSyncsWrite;
+}
+
+
+START_TEST ( test_sync_policy )
+{
+    unsigned nSyncsUnmount;
+    ck_assert_uint_eq ( syncs_on_file_write ( ADF_SYNC_NONE, &nSyncsUnmount ), 0 );
+    ck_assert_uint_eq ( nSyncsUnmount, 0 );
+
+    ck_assert_uint_eq ( syncs_on_file_write ( ADF_SYNC_UNMOUNT, &nSyncsUnmount ), 0 );
+    ck_assert_uint_eq ( nSyncsUnmount, 1 );
+
+    ck_assert_uint_eq ( syncs_on_file_write ( ADF_SYNC_FILE_CLOSE, &nSyncsUnmount ), 1 );
+    ck_assert_uint_eq ( nSyncsUnmount, 1 );
+
+    // (creating and writing the file are separate metadata changes)
+    ck_assert_uint_gt ( syncs_on_file_write ( ADF_SYNC_METADATA, &nSyncsUnmount ), 1 );
+    ck_assert_uint_eq ( nSyncsUnmount, 1 );
+
+    // a directory created
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "sync", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    counting_start ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "Test_sync", ADF_DOSFS_FFS ), ADF_RC_OK );
+    adfDevSetSyncPolicy ( dev, ADF_SYNC_METADATA );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    counting_reset();
+    ck_assert_int_eq ( adfCreateDir ( vol, vol->rootBlock, "dir" ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.syncs, 1 );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+
+    // closing an unmounted device
+    adfDevSetSyncPolicy ( dev, ADF_SYNC_UNMOUNT );
+    counting_reset();
+    adfDevClose ( dev );
+    ck_assert_uint_eq ( counting.syncs, 1 );
+}
+END_TEST
+
+
+START_TEST ( test_sync_dump )
+{
+    struct AdfDevice * dev = adfDevCreate ( "dump", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "Test_sync", ADF_DOSFS_OFS ), ADF_RC_OK );
+    adfDevSetSyncPolicy ( dev, ADF_SYNC_METADATA );
+    struct AdfVolume * vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    write_file ( vol, "file" );
+    ck_assert_int_eq ( adfVolSync ( vol ), ADF_RC_OK );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    // read-only - nothing to sync
+    dev = adfDevOpen ( IMAGE, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfDevMount ( dev ), ADF_RC_OK );
+    vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_int_eq ( adfVolSync ( vol ), ADF_RC_OK );
+    adfVolUnMount ( vol );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    unlink ( IMAGE );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_sync_policy" );
+    tcase_add_test ( tc, test_sync_policy );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_sync_dump" );
+    tcase_add_test ( tc, test_sync_dump );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
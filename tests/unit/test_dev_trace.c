@@ -0,0 +1,139 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define IMAGE  "test_dev_trace.adf"
+#define TRACE  "test_dev_trace.trace"
+
+static uint8_t data[ 20000 ];
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+START_TEST ( test_dev_trace )
+{
+    pattern_random ( data, sizeof data );
+
+    struct AdfDevice * const dev = adfDevCreate ( "dump", IMAGE, 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "trace", ADF_DOSFS_FFS ), ADF_RC_OK );
+
+    ck_assert_int_ne ( adfDevTraceStop ( dev ), ADF_RC_OK );    // not started
+    ck_assert_int_eq ( adfDevTraceStart ( dev, TRACE ), ADF_RC_OK );
+    ck_assert_int_ne ( adfDevTraceStart ( dev, TRACE ), ADF_RC_OK );
+
+    // a direct device access, a file written and read
+    uint8_t buf[ 3 * 512 ];
+    ck_assert_int_eq ( adfDevReadBlock ( dev, 10, sizeof buf, buf ), ADF_RC_OK );
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * const file = adfFileOpen ( vol, "data", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof data, data ), sizeof data );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( verify_file_data ( vol, "data", data, sizeof data, 10 ), 0 );
+    adfVolUnMount ( vol );
+
+    ck_assert_int_eq ( adfDevTraceStop ( dev ), ADF_RC_OK );
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+
+    // the trace
+    FILE * const f = fopen ( TRACE, "rb" );
+    ck_assert_ptr_nonnull ( f );
+    struct AdfTraceHeader header;
+    ck_assert_int_eq ( adfTraceReadHeader ( f, &header ), ADF_RC_OK );
+    ck_assert_uint_eq ( header.blockSize, 512 );
+    ck_assert_uint_eq ( header.cylinders, 80 );
+    ck_assert_uint_eq ( header.heads, 2 );
+    ck_assert_uint_eq ( header.sectors, 11 );
+
+    struct AdfTraceRecord rec;
+    ck_assert ( adfTraceReadRecord ( f, &rec ) );
+    ck_assert_int_eq ( rec.op, ADF_TRACE_OP_READ );
+    ck_assert_int_eq ( rec.source, ADF_TRACE_SRC_DEVICE );
+    ck_assert_int_eq ( rec.blockType, ADF_STATS_BLOCK_OTHER );
+    ck_assert_uint_eq ( rec.sector, 10 );
+    ck_assert_uint_eq ( rec.nBlocks, 3 );
+    ck_assert_uint_eq ( rec.flags, 0 );
+
+    unsigned nRecords = 1,
+             blocksRead[ ADF_STATS_BLOCK_TYPES ]    = { 0 },
+             blocksWritten[ ADF_STATS_BLOCK_TYPES ] = { 0 };
+    uint64_t timeNs = rec.timeNs;
+    while ( adfTraceReadRecord ( f, &rec ) ) {
+        nRecords++;
+        ck_assert_uint_ge ( rec.timeNs, timeNs );
+        timeNs = rec.timeNs;
+        ck_assert_int_eq ( rec.source, ADF_TRACE_SRC_VOLUME );
+        ck_assert_uint_lt ( rec.blockType, ADF_STATS_BLOCK_TYPES );
+        ck_assert_uint_lt ( rec.sector + rec.nBlocks, 80 * 2 * 11 + 1 );
+        ck_assert_uint_eq ( rec.flags, 0 );
+        if ( rec.op == ADF_TRACE_OP_READ )
+            blocksRead[ rec.blockType ] += rec.nBlocks;
+        else
+            blocksWritten[ rec.blockType ] += rec.nBlocks;
+    }
+    fclose ( f );
+
+    ck_assert_uint_gt ( nRecords, 10 );
+    ck_assert_uint_gt ( blocksRead[ ADF_STATS_BLOCK_ROOT ], 0 );
+    ck_assert_uint_ge ( blocksRead[ ADF_STATS_BLOCK_DATA ], sizeof data / 512 );
+    ck_assert_uint_ge ( blocksWritten[ ADF_STATS_BLOCK_DATA ], sizeof data / 512 );
+    ck_assert_uint_gt ( blocksWritten[ ADF_STATS_BLOCK_HEADER ], 0 );
+    ck_assert_uint_gt ( blocksWritten[ ADF_STATS_BLOCK_BITMAP ], 0 );
+
+    // not a trace
+    FILE * const fImage = fopen ( IMAGE, "rb" );
+    ck_assert_ptr_nonnull ( fImage );
+    ck_assert_int_ne ( adfTraceReadHeader ( fImage, &header ), ADF_RC_OK );
+    fclose ( fImage );
+
+    unlink ( TRACE );
+    unlink ( IMAGE );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_dev_trace" );
+    tcase_add_test ( tc, test_dev_trace );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
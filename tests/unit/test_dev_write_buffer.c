@@ -0,0 +1,215 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+/* block n filled with byte value n + tag */
+static void fill ( uint8_t * const  block,
+                   const uint32_t   n,
+                   const uint8_t    tag )
+{
+    memset ( block, (uint8_t) ( n + tag ), 512 );
+}
+
+static void check_blocks ( struct AdfDevice * const  dev,
+                           const uint32_t            first,
+                           const uint32_t            nBlocks,
+                           const uint8_t             tag )
+{
+    uint8_t * const buf = malloc ( nBlocks * 512 ),
+              expected[ 512 ];
+    ck_assert_ptr_nonnull ( buf );
+    ck_assert_int_eq ( adfDevReadBlock ( dev, first, nBlocks * 512, buf ), ADF_RC_OK );
+    for ( uint32_t i = 0 ; i < nBlocks ; i++ ) {
+        fill ( expected, first + i, tag );
+        ck_assert_mem_eq ( buf + i * 512, expected, 512 );
+    }
+    free ( buf );
+}
+
+
+START_TEST ( test_write_buffer )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "wbuf", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    counting_start ( dev );
+    ck_assert_int_eq ( adfDevSetWriteBuffer ( dev, 64 ), ADF_RC_OK );
+
+    // scattered single-block writes (descending, two runs), one written twice
+    uint8_t block[ 512 ];
+    counting_reset();
+    for ( uint32_t n = 40 ; n > 0 ; n-- ) {
+        const uint32_t sect = ( n <= 20 ) ? n - 1 : 1000 + n;
+        fill ( block, sect, 0 );
+        ck_assert_int_eq ( adfDevWriteBlock ( dev, sect, 512, block ), ADF_RC_OK );
+    }
+    fill ( block, 5, 1 );
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, 5, 512, block ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.writes, 0 );
+
+    // buffered blocks are read (also a part of a block)
+    check_blocks ( dev, 0, 5, 0 );
+    check_blocks ( dev, 5, 1, 1 );
+    check_blocks ( dev, 1021, 20, 0 );
+    uint8_t part[ 100 ];
+    ck_assert_int_eq ( adfDevReadBlock ( dev, 5, 100, part ), ADF_RC_OK );
+    ck_assert_mem_eq ( part, block, 100 );
+
+    // flushed in ascending order, merged
+    ck_assert_int_eq ( adfDevSync ( dev ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.writes, 2 );
+    ck_assert_uint_eq ( counting.writeBlock[ 0 ], 0 );
+    ck_assert_uint_eq ( counting.writeLen[ 0 ], 20 );
+    ck_assert_uint_eq ( counting.writeBlock[ 1 ], 1021 );
+    ck_assert_uint_eq ( counting.writeLen[ 1 ], 20 );
+    ck_assert_int_eq ( adfDevSync ( dev ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.writes, 2 );
+    check_blocks ( dev, 0, 5, 0 );
+    check_blocks ( dev, 5, 1, 1 );
+
+    // a full buffer is flushed (runs limited to ADF_DEV_WRITE_RUN_MAX)
+    counting_reset();
+    for ( uint32_t n = 0 ; n < 65 ; n++ ) {
+        fill ( block, 100 + n, 2 );
+        ck_assert_int_eq ( adfDevWriteBlock ( dev, 100 + n, 512, block ), ADF_RC_OK );
+    }
+    ck_assert_uint_eq ( counting.writes, 1 );
+    ck_assert_uint_eq ( counting.writeBlock[ 0 ], 100 );
+    ck_assert_uint_eq ( counting.writeLen[ 0 ], 64 );
+    check_blocks ( dev, 100, 65, 2 );
+
+    // writes bigger than the buffer go directly (after buffered ones)
+    uint8_t * const big = malloc ( 100 * 512 );
+    ck_assert_ptr_nonnull ( big );
+    for ( uint32_t n = 0 ; n < 100 ; n++ )
+        fill ( big + n * 512, 200 + n, 3 );
+    counting_reset();
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, 200, 100 * 512, big ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.writes, 2 );
+    ck_assert_uint_eq ( counting.writeBlock[ 0 ], 164 );
+    ck_assert_uint_eq ( counting.writeBlock[ 1 ], 200 );
+    ck_assert_uint_eq ( counting.writeLen[ 1 ], 100 );
+    check_blocks ( dev, 200, 100, 3 );
+    free ( big );
+
+    // out of range
+    ck_assert_int_ne ( adfDevWriteBlock ( dev, dev->sizeBlocks, 512, block ),
+                       ADF_RC_OK );
+
+    // disabling flushes
+    fill ( block, 7, 4 );
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, 7, 512, block ), ADF_RC_OK );
+    counting_reset();
+    ck_assert_int_eq ( adfDevSetWriteBuffer ( dev, 0 ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.writes, 1 );
+    ck_assert_ptr_null ( dev->wBuf );
+    check_blocks ( dev, 7, 1, 4 );
+
+    ck_assert_int_eq ( adfDevClose ( dev ), ADF_RC_OK );
+}
+END_TEST
+
+
+START_TEST ( test_write_buffer_close_error )
+{
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "wbuf", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    counting_start ( dev );
+    ck_assert_int_eq ( adfDevSetWriteBuffer ( dev, 64 ), ADF_RC_OK );
+
+    // a buffered block that cannot be written is reported on closing
+    uint8_t block[ 512 ];
+    fill ( block, 3, 0 );
+    counting_reset();
+    ck_assert_int_eq ( adfDevWriteBlock ( dev, 3, 512, block ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.writes, 0 );
+    counting.failWrites = true;
+    ck_assert_int_ne ( adfDevClose ( dev ), ADF_RC_OK );
+    ck_assert_uint_gt ( counting.writes, 0 );
+    counting.failWrites = false;
+}
+END_TEST
+
+
+START_TEST ( test_write_buffer_volume )
+{
+    // a volume created and used with buffered writes
+    struct AdfDevice * const dev = adfDevCreate ( "ramdisk", "wbuf", 80, 2, 11 );
+    ck_assert_ptr_nonnull ( dev );
+    ck_assert_int_eq ( adfDevSetWriteBuffer ( dev, ADF_DEV_WRITE_BUFFER_BLOCKS ),
+                       ADF_RC_OK );
+    ck_assert_int_eq ( adfCreateFlop ( dev, "Test_wbuf", ADF_DOSFS_FFS ), ADF_RC_OK );
+
+    static uint8_t data[ 50000 ];
+    pattern_random ( data, sizeof data );
+    struct AdfVolume * vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * const file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeof data, data ), sizeof data );
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+
+    // (the data is read back with the buffer disabled)
+    ck_assert_int_eq ( adfDevSetWriteBuffer ( dev, 0 ), ADF_RC_OK );
+
+    vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", data, sizeof data, 10 ), 0 );
+    adfVolUnMount ( vol );
+
+    adfDevUnMount ( dev );
+    adfDevClose ( dev );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_write_buffer" );
+    tcase_add_test ( tc, test_write_buffer );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_write_buffer_close_error" );
+    tcase_add_test ( tc, test_write_buffer_close_error );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_write_buffer_volume" );
+    tcase_add_test ( tc, test_write_buffer_volume );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
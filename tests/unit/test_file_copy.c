@@ -0,0 +1,313 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define FILE_SIZE    150000
+#define FILE_SIZE_A  1000
+#define FILE_SIZE_B  70000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * devSrc,
+                     * devDst;
+    uint8_t            fstypeSrc,   // 0 - OFS, 1 - FFS
+                       fstypeDst;
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void write_file ( struct AdfVolume * const     vol,
+                         const char * const           name,
+                         const unsigned char * const  data,
+                         const uint32_t               size,
+                         const int32_t                access,
+                         const char * const           comment )
+{
+    struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, size, data ), size );
+    adfFileClose ( file );
+
+    // an old date (to be preserved)
+    struct AdfEntryBlock entry;
+    const ADF_SECTNUM nSect = adfGetEntryBlock ( vol, vol->curDirPtr, name, &entry );
+    ck_assert_int_ne ( nSect, -1 );
+    entry.days  = 1000;
+    entry.mins  = 100;
+    entry.ticks = 10;
+    ck_assert_int_eq ( adfWriteEntryBlock ( vol, nSect, &entry ), ADF_RC_OK );
+
+    ck_assert_int_eq ( adfSetEntryAccess ( vol, vol->curDirPtr, name, access ),
+                       ADF_RC_OK );
+    ck_assert_int_eq ( adfSetEntryComment ( vol, vol->curDirPtr, name, comment ),
+                       ADF_RC_OK );
+}
+
+
+/* a data source failing after some bytes */
+struct short_source {
+    const unsigned char * data;
+    uint32_t              left;
+};
+
+static uint32_t short_source_read ( void * const     ctx,
+                                    uint8_t * const  buf,
+                                    const uint32_t   n )
+{
+    struct short_source * const src = (struct short_source *) ctx;
+    const uint32_t nRead = ( n < src->left ) ? n : src->left;
+    memcpy ( buf, src->data, nRead );
+    src->data += nRead;
+    src->left -= nRead;
+    return nRead;
+}
+
+
+static void check_metadata ( struct AdfVolume * const  volSrc,
+                             const ADF_SECTNUM         dirSrc,
+                             const char * const        nameSrc,
+                             struct AdfVolume * const  volDst,
+                             const ADF_SECTNUM         dirDst,
+                             const char * const        nameDst )
+{
+    struct AdfEntryBlock src, dst;
+    ck_assert_int_ne ( adfGetEntryBlock ( volSrc, dirSrc, nameSrc, &src ), -1 );
+    ck_assert_int_ne ( adfGetEntryBlock ( volDst, dirDst, nameDst, &dst ), -1 );
+    ck_assert_int_eq ( dst.secType, src.secType );
+    ck_assert_int_eq ( dst.access, src.access );
+    ck_assert_uint_eq ( dst.commLen, src.commLen );
+    ck_assert_mem_eq ( dst.comment, src.comment, src.commLen );
+    ck_assert_int_eq ( dst.days, src.days );
+    ck_assert_int_eq ( dst.mins, src.mins );
+    ck_assert_int_eq ( dst.ticks, src.ticks );
+}
+
+
+static void test_file_copy ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+
+    struct AdfVolume * const volSrc = adfVolMount ( tdata->devSrc, 0,
+                                                    ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( volSrc );
+    struct AdfVolume * const volDst = adfVolMount ( tdata->devDst, 0,
+                                                    ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( volDst );
+
+    // source: file, dir/a, dir/sub/b, dir/empty
+    write_file ( volSrc, "file", buffer, FILE_SIZE, 0x11, "a file" );
+    ck_assert_int_eq ( adfCreateDir ( volSrc, volSrc->rootBlock, "dir" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfChangeDir ( volSrc, "dir" ), ADF_RC_OK );
+    write_file ( volSrc, "a", buffer + 1, FILE_SIZE_A, 0x02, "" );
+    ck_assert_int_eq ( adfCreateDir ( volSrc, volSrc->curDirPtr, "sub" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfCreateDir ( volSrc, volSrc->curDirPtr, "empty" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfSetEntryComment ( volSrc, volSrc->curDirPtr, "sub",
+                                            "a subdirectory" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfChangeDir ( volSrc, "sub" ), ADF_RC_OK );
+    write_file ( volSrc, "b", buffer + 2, FILE_SIZE_B, 0x00, "file b" );
+    ck_assert_int_eq ( adfToRootDir ( volSrc ), ADF_RC_OK );
+
+    // a file
+    ck_assert_int_eq ( adfFileCopy ( volSrc, "file", volDst, "copy" ), ADF_RC_OK );
+    ck_assert_uint_eq ( verify_file_data ( volDst, "copy", buffer, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( volDst, "copy", 10 ), 0 );
+    check_metadata ( volSrc, volSrc->rootBlock, "file",
+                     volDst, volDst->rootBlock, "copy" );
+
+    // ... not overwriting an existing entry
+    ck_assert_int_eq ( adfFileCopy ( volSrc, "file", volDst, "copy" ), ADF_RC_ERROR );
+
+    // a tree, writing the bitmap once
+    counting_start ( tdata->devDst );
+    counting.watchedSect = (uint32_t) ( volDst->firstBlock + volDst->bitmap.blocks[ 0 ] );
+
+    ck_assert_int_eq ( adfCreateDir ( volDst, volDst->rootBlock, "to" ), ADF_RC_OK );
+    counting_reset();
+    ck_assert_int_eq ( adfTreeCopy ( volSrc, "dir", volDst, "to/dircopy" ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.watchedWrites, 1 );
+    counting_stop ( tdata->devDst );
+
+    ck_assert_int_eq ( adfChangeDir ( volDst, "to" ), ADF_RC_OK );
+    const ADF_SECTNUM dirTo = volDst->curDirPtr;
+    ck_assert_int_eq ( adfChangeDir ( volDst, "dircopy" ), ADF_RC_OK );
+    const ADF_SECTNUM dirCopy = volDst->curDirPtr;
+    ck_assert_int_eq ( adfChangeDir ( volSrc, "dir" ), ADF_RC_OK );
+    const ADF_SECTNUM dirSrc = volSrc->curDirPtr;
+
+    ck_assert_int_eq ( adfDirCountEntries ( volDst, dirCopy ), 3 );
+    ck_assert_uint_eq ( verify_file_data ( volDst, "a", buffer + 1, FILE_SIZE_A, 10 ), 0 );
+    check_metadata ( volSrc, dirSrc, "a", volDst, dirCopy, "a" );
+    check_metadata ( volSrc, dirSrc, "sub", volDst, dirCopy, "sub" );
+    check_metadata ( volSrc, dirSrc, "empty", volDst, dirCopy, "empty" );
+    check_metadata ( volSrc, volSrc->rootBlock, "dir", volDst, dirTo, "dircopy" );
+
+    ck_assert_int_eq ( adfChangeDir ( volDst, "sub" ), ADF_RC_OK );
+    ck_assert_uint_eq ( verify_file_data ( volDst, "b", buffer + 2, FILE_SIZE_B, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( volDst, "b", 10 ), 0 );
+    ck_assert_int_eq ( adfChangeDir ( volSrc, "sub" ), ADF_RC_OK );
+    check_metadata ( volSrc, volSrc->curDirPtr, "b", volDst, volDst->curDirPtr, "b" );
+    ck_assert_int_eq ( adfToRootDir ( volSrc ), ADF_RC_OK );
+    ck_assert_int_eq ( adfToRootDir ( volDst ), ADF_RC_OK );
+
+    // a directory cannot be copied into itself
+    ck_assert_int_eq ( adfTreeCopy ( volSrc, "dir", volSrc, "dir/sub/dir" ),
+                       ADF_RC_ERROR );
+
+    // a failed append (the source too short - in the last block or later)
+    // leaves the file and the bitmap as they were
+    const uint32_t shortFails[] = { 10, 30000 };
+    for ( unsigned i = 0 ; i < sizeof shortFails / sizeof shortFails[ 0 ] ; i++ ) {
+        write_file ( volDst, "short", buffer, FILE_SIZE_B, 0x00, "" );
+        const uint32_t nFree = adfCountFreeBlocks ( volDst );
+
+        struct AdfFile * const file = adfFileOpen ( volDst, "short", ADF_FILE_MODE_WRITE );
+        ck_assert_ptr_nonnull ( file );
+        struct short_source src = { buffer + FILE_SIZE_B, shortFails[ i ] };
+        ck_assert_int_ne ( adfFileAppend ( file, FILE_SIZE - FILE_SIZE_B,
+                                           short_source_read, &src ), ADF_RC_OK );
+        ck_assert_uint_eq ( adfFileGetSize ( file ), FILE_SIZE_B );
+        adfFileClose ( file );
+
+        ck_assert_uint_eq ( adfCountFreeBlocks ( volDst ), nFree );
+        ck_assert_uint_eq ( verify_file_data ( volDst, "short", buffer, FILE_SIZE_B, 10 ), 0 );
+        ck_assert_uint_eq ( validate_file_metadata ( volDst, "short", 10 ), 0 );
+        ck_assert_int_eq ( adfRemoveEntry ( volDst, volDst->rootBlock, "short" ),
+                           ADF_RC_OK );
+    }
+
+    // the bitmap written is consistent
+    struct AdfBitmapCheck check;
+    ck_assert_int_eq ( adfVerifyBitmap ( volDst, 1, &check ), ADF_RC_OK );
+    ck_assert_uint_eq ( check.usedUnreferenced.nItems, 0 );
+    ck_assert_uint_eq ( check.referencedFree.nItems, 0 );
+    adfFreeBitmapCheck ( &check );
+
+    adfVolUnMount ( volDst );
+    adfVolUnMount ( volSrc );
+}
+
+
+START_TEST ( test_file_copy_ofs_ffs )
+{
+    test_data_t test_data = {
+        .fstypeSrc = 0,     // OFS
+        .fstypeDst = 1      // FFS
+    };
+    setup ( &test_data );
+    test_file_copy ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_copy_ffs_ofs )
+{
+    test_data_t test_data = {
+        .fstypeSrc = 1,     // FFS
+        .fstypeDst = 0      // OFS
+    };
+    setup ( &test_data );
+    test_file_copy ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_copy_ffs_ffs )
+{
+    test_data_t test_data = {
+        .fstypeSrc = 1,     // FFS
+        .fstypeDst = 1      // FFS
+    };
+    setup ( &test_data );
+    test_file_copy ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_copy_ofs_ffs" );
+    tcase_add_test ( tc, test_file_copy_ofs_ffs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_copy_ffs_ofs" );
+    tcase_add_test ( tc, test_file_copy_ffs_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_copy_ffs_ffs" );
+    tcase_add_test ( tc, test_file_copy_ffs_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->devSrc = adfDevCreate ( "ramdisk", "test_file_copy_src.adf", 80, 2, 11 );
+    tdata->devDst = adfDevCreate ( "ramdisk", "test_file_copy_dst.adf", 80, 2, 11 );
+    if ( ! tdata->devSrc || ! tdata->devDst ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->devSrc, "Source", tdata->fstypeSrc ) != ADF_RC_OK ||
+         adfCreateFlop ( tdata->devDst, "Destination", tdata->fstypeDst ) != ADF_RC_OK )
+    {
+        fprintf ( stderr, "adfCreateFlop error creating volumes\n" );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->devDst );
+    adfDevClose ( tdata->devDst );
+    adfDevUnMount ( tdata->devSrc );
+    adfDevClose ( tdata->devSrc );
+}
@@ -0,0 +1,189 @@
+#include <check.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+/* FFS: 586 data blocks, 8 ext. blocks */
+#define FILE_SIZE  300000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             adfname;
+    char *             hostname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void test_file_export ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+
+    struct AdfVolume * const vol = adfVolMount ( tdata->device, 0,
+                                                 ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    // (data not flushed to the image yet)
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, buffer ), FILE_SIZE );
+    adfFileClose ( file );
+
+    // export
+    int fd = open ( tdata->hostname, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    ck_assert_int_ge ( fd, 0 );
+    ck_assert_int_eq ( write ( fd, "hdr", 3 ), 3 );   // written at the position
+
+    counting_start ( tdata->device );
+
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileExportToFd ( file, fd ), ADF_RC_OK );
+    adfFileClose ( file );
+    counting_stop ( tdata->device );
+
+#if defined HAVE_COPY_FILE_RANGE || defined HAVE_SENDFILE
+    // FFS: the data is not read through the library
+    if ( adfVolIsFFS ( vol ) )
+        ck_assert_uint_lt ( counting.blocksRead, FILE_SIZE / 512 / 8 );
+#endif
+
+    unsigned char * const exported = malloc ( FILE_SIZE + 3 );
+    ck_assert_ptr_nonnull ( exported );
+    ck_assert_int_eq ( lseek ( fd, 0, SEEK_END ), FILE_SIZE + 3 );
+    ck_assert_int_eq ( pread ( fd, exported, FILE_SIZE + 3, 0 ), FILE_SIZE + 3 );
+    ck_assert_mem_eq ( exported, "hdr", 3 );
+    ck_assert_mem_eq ( exported + 3, buffer, FILE_SIZE );
+    free ( exported );
+
+    // import (what was exported)
+    ck_assert_int_eq ( lseek ( fd, 3, SEEK_SET ), 3 );
+    ck_assert_int_eq ( adfFileImportFromFd ( vol, "imported", fd, FILE_SIZE ),
+                       ADF_RC_OK );
+    ck_assert_uint_eq ( verify_file_data ( vol, "imported", buffer, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "imported", 10 ), 0 );
+
+    // ... failing if there is not enough data (leaving no partial file)
+    const uint32_t nFree = adfCountFreeBlocks ( vol );
+    ck_assert_int_eq ( lseek ( fd, -100, SEEK_END ), FILE_SIZE + 3 - 100 );
+    ck_assert_int_ne ( adfFileImportFromFd ( vol, "short", fd, 1000 ), ADF_RC_OK );
+    struct AdfEntryBlock entry;
+    ck_assert_int_eq ( adfGetEntryBlock ( vol, vol->curDirPtr, "short", &entry ), -1 );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), nFree );
+
+    // ... and not overwriting an existing file
+    ck_assert_int_eq ( adfFileImportFromFd ( vol, "imported", fd, 10 ), ADF_RC_ERROR );
+
+    close ( fd );
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_file_export_ofs )
+{
+    test_data_t test_data = {
+        .adfname  = "test_file_export_ofs.adf",
+        .hostname = "test_file_export_ofs.bin",
+        .fstype   = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_export ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_export_ffs )
+{
+    test_data_t test_data = {
+        .adfname  = "test_file_export_ffs.adf",
+        .hostname = "test_file_export_ffs.bin",
+        .fstype   = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_export ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_export_ofs" );
+    tcase_add_test ( tc, test_file_export_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_export_ffs" );
+    tcase_add_test ( tc, test_file_export_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "dump", tdata->adfname, 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, "Test_file_export", tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume\n" );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+    unlink ( tdata->adfname );
+    unlink ( tdata->hostname );
+}
@@ -0,0 +1,293 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define BUFFER_SIZE  110000
+#define NFILES       6
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+static const struct {
+    const char * path;
+    uint32_t     offset,
+                 size;
+} files[ NFILES ] = {
+    { "empty",      0,      0 },
+    { "small",      1,    100 },
+    { "block",      2,    488 },
+    { "big",        3, 100000 },
+    { "dir/file",   4,   5000 },
+    { "dir/sub/x",  5,    513 }
+};
+
+static struct AdfHashes  expected[ NFILES ];
+static unsigned          nReported[ NFILES ];
+
+
+static void hex_to_bin ( const char * const  hex,
+                         uint8_t * const     bin )
+{
+    for ( size_t i = 0 ; i < strlen ( hex ) / 2 ; i++ ) {
+        unsigned byte;
+        sscanf ( hex + 2 * i, "%02x", &byte );
+        bin[ i ] = (uint8_t) byte;
+    }
+}
+
+static void check_vector ( const uint8_t * const  data,
+                           const uint32_t         len,
+                           const uint32_t         crc32,
+                           const char * const     md5,
+                           const char * const     sha1,
+                           const char * const     sha256 )
+{
+    struct AdfHashes hashes;
+    uint8_t digest[ 32 ];
+
+    adfHashData ( ADF_HASH_ALL, data, len, &hashes );
+    ck_assert_uint_eq ( hashes.size, len );
+    ck_assert_uint_eq ( hashes.crc32, crc32 );
+    hex_to_bin ( md5, digest );
+    ck_assert_mem_eq ( hashes.md5, digest, 16 );
+    hex_to_bin ( sha1, digest );
+    ck_assert_mem_eq ( hashes.sha1, digest, 20 );
+    hex_to_bin ( sha256, digest );
+    ck_assert_mem_eq ( hashes.sha256, digest, 32 );
+}
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+START_TEST ( test_hash_vectors )
+{
+    check_vector ( (const uint8_t *) "", 0, 0x00000000,
+                   "d41d8cd98f00b204e9800998ecf8427e",
+                   "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+                   "e3b0c44298fc1c149afbf4c8996fb924"
+                   "27ae41e4649b934ca495991b7852b855" );
+
+    check_vector ( (const uint8_t *) "abc", 3, 0x352441c2,
+                   "900150983cd24fb0d6963f7d28e17f72",
+                   "a9993e364706816aba3e25717850c26c9cd0d89d",
+                   "ba7816bf8f01cfea414140de5dae2223"
+                   "b00361a396177a9cb410ff61f20015ad" );
+
+    uint8_t * const million = malloc ( 1000000 );
+    ck_assert_ptr_nonnull ( million );
+    memset ( million, 'a', 1000000 );
+    check_vector ( million, 1000000, 0xdc25bfbc,
+                   "7707d6ae4e027c70eea2a935c2296f21",
+                   "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+                   "cdc76e5c9914fb9281a1c7e284d73e67"
+                   "f1809a48a497200e046d39ccc7112cd0" );
+    free ( million );
+
+    // only the requested digests are set
+    struct AdfHashes hashes;
+    const uint8_t zeros[ 32 ] = { 0 };
+    adfHashData ( ADF_HASH_MD5, (const uint8_t *) "abc", 3, &hashes );
+    ck_assert_uint_eq ( hashes.crc32, 0 );
+    ck_assert_mem_eq ( hashes.sha1, zeros, 20 );
+    ck_assert_mem_eq ( hashes.sha256, zeros, 32 );
+}
+END_TEST
+
+
+static void hash_callback ( void * const                    ctx,
+                            const char * const              path,
+                            const ADF_SECTNUM               fileSect,
+                            const ADF_RETCODE               rc,
+                            const struct AdfHashes * const  hashes )
+{
+    (void) ctx, (void) fileSect;
+
+    ck_assert_int_eq ( rc, ADF_RC_OK );
+    for ( unsigned i = 0 ; i < NFILES ; i++ ) {
+        if ( strcmp ( path, files[ i ].path ) == 0 ) {
+            ck_assert_mem_eq ( hashes, &expected[ i ], sizeof ( struct AdfHashes ) );
+            nReported[ i ]++;
+            return;
+        }
+    }
+    ck_assert_msg ( false, "unexpected path %s", path );
+}
+
+
+static void test_file_hash ( test_data_t * const tdata )
+{
+    struct AdfVolume * const vol = adfVolMount ( tdata->device, 0,
+                                                 ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    ck_assert_int_eq ( adfCreateDir ( vol, vol->rootBlock, "dir" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfChangeDir ( vol, "dir" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfCreateDir ( vol, vol->curDirPtr, "sub" ), ADF_RC_OK );
+    ck_assert_int_eq ( adfToRootDir ( vol ), ADF_RC_OK );
+
+    for ( unsigned i = 0 ; i < NFILES ; i++ ) {
+        // (adfFileOpen takes a name in the current directory)
+        char path[ 32 ];
+        strcpy ( path, files[ i ].path );
+        char * name = path,
+             * slash;
+        while ( ( slash = strchr ( name, '/' ) ) != NULL ) {
+            *slash = '\0';
+            ck_assert_int_eq ( adfChangeDir ( vol, name ), ADF_RC_OK );
+            name = slash + 1;
+        }
+        struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_WRITE );
+        ck_assert_ptr_nonnull ( file );
+        ck_assert_uint_eq ( adfFileWrite ( file, files[ i ].size,
+                                           tdata->buffer + files[ i ].offset ),
+                            files[ i ].size );
+        adfFileClose ( file );
+        ck_assert_int_eq ( adfToRootDir ( vol ), ADF_RC_OK );
+        adfHashData ( ADF_HASH_ALL, tdata->buffer + files[ i ].offset,
+                      files[ i ].size, &expected[ i ] );
+    }
+
+    // a single file
+    struct AdfEntryBlock entry;
+    const ADF_SECTNUM bigSect = adfGetEntryBlock ( vol, vol->rootBlock, "big",
+                                                   &entry );
+    ck_assert_int_ne ( bigSect, -1 );
+    struct AdfHashes hashes;
+    ck_assert_int_eq ( adfFileHash ( vol, bigSect, ADF_HASH_ALL, &hashes ),
+                       ADF_RC_OK );
+    ck_assert_mem_eq ( &hashes, &expected[ 3 ], sizeof ( struct AdfHashes ) );
+
+    // (a directory is not hashed)
+    ck_assert_int_ne ( adfFileHash ( vol, vol->rootBlock, ADF_HASH_ALL, &hashes ),
+                       ADF_RC_OK );
+
+    // all files, with 1 and more threads
+    const unsigned nThreads[] = { 1, 4 };
+    for ( unsigned t = 0 ; t < 2 ; t++ ) {
+        memset ( nReported, 0, sizeof ( nReported ) );
+        struct AdfHashStats stats;
+        ck_assert_int_eq ( adfVolHashAllFiles ( vol, ADF_HASH_ALL, hash_callback,
+                                                NULL, nThreads[ t ], &stats ),
+                           ADF_RC_OK );
+        uint64_t nBytes = 0;
+        for ( unsigned i = 0 ; i < NFILES ; i++ ) {
+            ck_assert_uint_eq ( nReported[ i ], 1 );
+            nBytes += files[ i ].size;
+        }
+        ck_assert_uint_eq ( stats.nFiles, NFILES );
+        ck_assert_uint_eq ( stats.nErrors, 0 );
+        ck_assert_uint_eq ( stats.nBytes, nBytes );
+        ck_assert ( stats.seconds >= 0.0 );
+    }
+
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_file_hash_ofs )
+{
+    test_data_t test_data = {
+        .fstype = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_hash ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_hash_ffs )
+{
+    test_data_t test_data = {
+        .fstype = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_hash ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_hash_vectors" );
+    tcase_add_test ( tc, test_hash_vectors );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_hash_ofs" );
+    tcase_add_test ( tc, test_file_hash_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_hash_ffs" );
+    tcase_add_test ( tc, test_file_hash_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", "test_file_hash.adf", 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, "Test_file_hash", tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume\n" );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( BUFFER_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, BUFFER_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
@@ -0,0 +1,307 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+/* a file using ext. blocks (300000 bytes - 586 (FFS) or 615 (OFS) data blocks) */
+#define FILE_SIZE  300000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             adfname;
+    char *             volname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+/* split len bytes of data into 3 buffers (of uneven sizes) */
+static void make_iov ( struct AdfIoVec   iov[ 3 ],
+                       unsigned char *   data,
+                       const uint32_t    len )
+{
+    iov[ 0 ].base = data;
+    iov[ 0 ].len  = len / 7;
+    iov[ 1 ].base = data + iov[ 0 ].len;
+    iov[ 1 ].len  = 0;
+    iov[ 2 ].base = data + iov[ 0 ].len;
+    iov[ 2 ].len  = len - iov[ 0 ].len;
+}
+
+
+static void check_pread ( const struct AdfFile * const  file,
+                          const uint32_t                offset,
+                          const uint32_t                len,
+                          const unsigned char * const   expected )
+{
+    static unsigned char data[ 20000 ];
+    struct AdfIoVec iov[ 3 ];
+    make_iov ( iov, data, len );
+
+    const uint32_t lenExpected = ( offset >= FILE_SIZE ) ? 0 :
+        ( FILE_SIZE - offset < len ) ? FILE_SIZE - offset : len;
+    ck_assert_uint_eq ( adfFilePread ( file, offset, iov, 3 ), lenExpected );
+    ck_assert_mem_eq ( data, expected + offset, lenExpected );
+}
+
+
+static void test_file_iov_read ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+    const unsigned blockSize = ( tdata->fstype & 1 ) ? 512 : 488;
+
+    struct AdfVolume * vol = adfVolMount ( tdata->device, 0,
+                                           ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, buffer ), FILE_SIZE );
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+
+    counting_start ( tdata->device );
+
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+
+    // blocks are read in coalesced batches (plus the ext. blocks leading
+    // to them), the handle is not changed
+    const unsigned nBlocks = 20000 / blockSize + 1;
+    counting_reset();
+    check_pread ( file, 200000, 20000, buffer );
+    ck_assert_uint_lt ( counting.reads, nBlocks / 4 );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), 0 );
+
+    // at random offsets, also reaching EOF
+    srand ( 1 );
+    for ( unsigned i = 0 ; i < 200 ; i++ )
+        check_pread ( file, (uint32_t) rand() % FILE_SIZE,
+                      (uint32_t) rand() % 20000, buffer );
+    check_pread ( file, FILE_SIZE - 10, 100, buffer );
+    check_pread ( file, FILE_SIZE, 100, buffer );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), 0 );
+
+    // readv advances the position
+    unsigned char data[ 5000 ];
+    struct AdfIoVec iov[ 3 ];
+    make_iov ( iov, data, sizeof ( data ) );
+    ck_assert_int_eq ( adfFileSeek ( file, 1234 ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileReadv ( file, iov, 3 ), sizeof ( data ) );
+    ck_assert_mem_eq ( data, buffer + 1234, sizeof ( data ) );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), 1234 + sizeof ( data ) );
+    ck_assert_uint_eq ( adfFileRead ( file, 100, data ), 100 );
+    ck_assert_mem_eq ( data, buffer + 1234 + sizeof ( data ), 100 );
+
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+    counting_stop ( tdata->device );
+}
+
+
+static void test_file_iov_write ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+    const unsigned blockSize = ( tdata->fstype & 1 ) ? 512 : 488;
+    const uint32_t sizeInitial = FILE_SIZE / 2;
+
+    struct AdfVolume * const vol = adfVolMount ( tdata->device, 0,
+                                                 ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * file = adfFileOpen ( vol, "file2", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, sizeInitial, buffer ), sizeInitial );
+
+    // overwrite existing data (partial and full blocks) at random offsets
+    unsigned char * const expected = malloc ( FILE_SIZE );
+    ck_assert_ptr_nonnull ( expected );
+    memcpy ( expected, buffer, sizeInitial );
+    unsigned char data[ 10000 ];
+    struct AdfIoVec iov[ 3 ];
+    srand ( 2 );
+    for ( unsigned i = 0 ; i < 50 ; i++ ) {
+        const uint32_t offset = (uint32_t) rand() % ( sizeInitial - (uint32_t) sizeof ( data ) );
+        const uint32_t len    = (uint32_t) rand() % (uint32_t) sizeof ( data );
+        pattern_random ( data, len );
+        memcpy ( expected + offset, data, len );
+        make_iov ( iov, data, len );
+        ck_assert_uint_eq ( adfFilePwrite ( file, offset, iov, 3 ), len );
+        ck_assert_uint_eq ( adfFileGetPos ( file ), sizeInitial );
+    }
+
+    // the current (changed) block of the handle overwritten
+    ck_assert_int_eq ( adfFileSeek ( file, 10 * blockSize + 5 ), ADF_RC_OK );
+    memset ( data, 0xaa, 20 );
+    ck_assert_uint_eq ( adfFileWrite ( file, 20, data ), 20 );
+    memcpy ( expected + 10 * blockSize + 5, data, 20 );
+    pattern_random ( data, 3 * blockSize );
+    make_iov ( iov, data, 3 * blockSize );
+    ck_assert_uint_eq ( adfFilePwrite ( file, 9 * blockSize + 100, iov, 3 ),
+                        3 * blockSize );
+    memcpy ( expected + 9 * blockSize + 100, data, 3 * blockSize );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), 10 * blockSize + 25 );
+    memset ( data, 0x55, 10 );
+    ck_assert_uint_eq ( adfFileWrite ( file, 10, data ), 10 );
+    memcpy ( expected + 10 * blockSize + 25, data, 10 );
+
+    // writing beyond EOF (with a gap) extends the file
+    const uint32_t gapStart = sizeInitial + 1000,
+                   gapEnd   = gapStart + 3000;
+    memcpy ( data, buffer + gapEnd, sizeof ( data ) );
+    make_iov ( iov, data, sizeof ( data ) );
+    ck_assert_int_eq ( adfFileSeek ( file, 0 ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFilePwrite ( file, gapEnd, iov, 3 ), sizeof ( data ) );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), 0 );
+    ck_assert_uint_eq ( adfFileGetSize ( file ), gapEnd + sizeof ( data ) );
+
+    // ... writev too (from the position)
+    const uint32_t size = adfFileGetSize ( file );
+    memcpy ( expected + sizeInitial, buffer + sizeInitial, FILE_SIZE - sizeInitial );
+    memset ( expected + gapStart, 0, gapEnd - gapStart );
+    make_iov ( iov, expected + sizeInitial, gapStart - sizeInitial );
+    ck_assert_int_eq ( adfFileSeek ( file, sizeInitial ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileWritev ( file, iov, 3 ), gapStart - sizeInitial );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), gapStart );
+    make_iov ( iov, expected + size, FILE_SIZE - size );
+    ck_assert_int_eq ( adfFileSeekEOF ( file ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileWritev ( file, iov, 3 ), FILE_SIZE - size );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), FILE_SIZE );
+    adfFileClose ( file );
+
+    ck_assert_uint_eq ( verify_file_data ( vol, "file2", expected, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file2", 10 ), 0 );
+
+    // OFS: data block headers of the blocks overwritten
+    if ( adfVolIsOFS ( vol ) ) {
+        file = adfFileOpen ( vol, "file2", ADF_FILE_MODE_READ );
+        ck_assert_ptr_nonnull ( file );
+        ck_assert_int_eq ( adfFileSeekEOF ( file ), ADF_RC_OK );
+        const unsigned nDataBlocks = ( FILE_SIZE + blockSize - 1 ) / blockSize;
+        ck_assert_uint_eq ( file->dataBlockMap.nItems, nDataBlocks );
+        for ( unsigned i = 0 ; i < nDataBlocks ; i++ ) {
+            struct AdfOFSDataBlock block;
+            ck_assert_int_eq ( adfReadDataBlock (
+                                   vol, file->dataBlockMap.sectors[ i ], &block ),
+                               ADF_RC_OK );
+            ck_assert_uint_eq ( block.seqNum, i + 1 );
+            ck_assert_uint_eq ( block.dataSize, ( i < nDataBlocks - 1 ) ?
+                                blockSize : FILE_SIZE - i * blockSize );
+            ck_assert_uint_eq ( block.nextData, ( i < nDataBlocks - 1 ) ?
+                                (uint32_t) file->dataBlockMap.sectors[ i + 1 ] : 0 );
+        }
+        adfFileClose ( file );
+    }
+
+    free ( expected );
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_file_iov_ofs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_iov_ofs.adf",
+        .volname = "Test_file_iov_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_iov_read ( &test_data );
+    test_file_iov_write ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_iov_ffs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_iov_ffs.adf",
+        .volname = "Test_file_iov_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_iov_read ( &test_data );
+    test_file_iov_write ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_iov_ofs" );
+    tcase_add_test ( tc, test_file_iov_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_iov_ffs" );
+    tcase_add_test ( tc, test_file_iov_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", tdata->adfname, 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, tdata->volname, tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume: %s\n",
+                  tdata->volname );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
@@ -0,0 +1,212 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+/* 300000 bytes - 586 (FFS) or 615 (OFS) data blocks */
+#define FILE_SIZE  300000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             adfname;
+    char *             volname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+/* read the whole file (in chunks like unadf does), return device reads */
+static unsigned read_file ( struct AdfFile * const      file,
+                            const unsigned char * const expected )
+{
+    unsigned char chunk[ 8192 ];
+    unsigned pos = 0;
+    counting_reset();
+    while ( pos < FILE_SIZE ) {
+        const unsigned n = adfFileRead ( file, sizeof ( chunk ), chunk );
+        ck_assert_uint_gt ( n, 0 );
+        ck_assert_mem_eq ( chunk, expected + pos, n );
+        pos += n;
+    }
+    ck_assert_uint_eq ( pos, FILE_SIZE );
+    return counting.reads;
+}
+
+
+static void test_file_read_ahead ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+    const unsigned blockSize = ( tdata->fstype & 1 ) ? 512 : 488;
+    const unsigned nDataBlocks = ( FILE_SIZE + blockSize - 1 ) / blockSize;
+
+    struct AdfVolume * vol = adfVolMount ( tdata->device, 0,
+                                           ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, buffer ), FILE_SIZE );
+
+    // no read-ahead in write mode
+    ck_assert_int_eq ( adfFileSeek ( file, 0 ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileGetStats ( file )->readAheads, 0 );
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+
+    counting_start ( tdata->device );
+
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+
+    // without read-ahead - a device read for each data (and ext.) block
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileSetReadAhead ( file, 0, 0 ), ADF_RC_OK );
+    ck_assert_uint_ge ( read_file ( file, buffer ), nDataBlocks - 1 );
+    const struct AdfFileStats * stats = adfFileGetStats ( file );
+    ck_assert_uint_eq ( stats->blocksRead, nDataBlocks );
+    ck_assert_uint_eq ( stats->readAheads, 0 );
+    ck_assert_uint_eq ( stats->blocksReadAhead, 0 );
+    adfFileClose ( file );
+
+    // sequential read - the window grows 8, 16, ..., 256
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    const unsigned nReadsSeq = read_file ( file, buffer );
+    stats = adfFileGetStats ( file );
+    ck_assert_uint_eq ( stats->blocksRead, nDataBlocks );
+    ck_assert_uint_eq ( stats->blocksReadAhead, nDataBlocks - 1 );
+    ck_assert_uint_eq ( stats->blocksPrefetched, nDataBlocks - 1 );
+    ck_assert_uint_eq ( stats->readAheads, 7 );
+    ck_assert_uint_eq ( file->readAhead.window, ADF_FILE_READAHEAD_MAX );
+    ck_assert_uint_lt ( nReadsSeq, nDataBlocks / 8 );
+
+    // random access shrinks the window (and stops read-ahead)
+    srand ( 1 );
+    for ( unsigned i = 0 ; i < 8 ; i++ ) {
+        const unsigned pos = (unsigned) rand() % FILE_SIZE;
+        unsigned char data[ 10 ];
+        const unsigned len = ( FILE_SIZE - pos < sizeof ( data ) ) ?
+            FILE_SIZE - pos : sizeof ( data );
+        ck_assert_int_eq ( adfFileSeek ( file, pos ), ADF_RC_OK );
+        ck_assert_uint_eq ( adfFileRead ( file, len, data ), len );
+        ck_assert_mem_eq ( data, buffer + pos, len );
+    }
+    ck_assert_uint_eq ( file->readAhead.window, 0 );
+    ck_assert_uint_eq ( stats->readAheads, 7 );
+
+    // ...and sequential access restarts it
+    ck_assert_int_eq ( adfFileSeek ( file, 0 ), ADF_RC_OK );
+    read_file ( file, buffer );
+    ck_assert_uint_gt ( stats->readAheads, 7 );
+    adfFileClose ( file );
+
+    adfVolUnMount ( vol );
+    counting_stop ( tdata->device );
+}
+
+
+START_TEST ( test_file_read_ahead_ofs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_read_ahead_ofs.adf",
+        .volname = "Test_file_read_ahead_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_read_ahead ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_read_ahead_ffs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_read_ahead_ffs.adf",
+        .volname = "Test_file_read_ahead_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_read_ahead ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_read_ahead_ofs" );
+    tcase_add_test ( tc, test_file_read_ahead_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_read_ahead_ffs" );
+    tcase_add_test ( tc, test_file_read_ahead_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", tdata->adfname, 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, tdata->volname, tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume: %s\n",
+                  tdata->volname );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
@@ -0,0 +1,331 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "adf_file_util.h"
+#include "test_util.h"
+
+
+/* 600000 bytes - 1172 (FFS) or 1230 (OFS) data blocks, 16 or 17 ext. blocks */
+#define FILE_SIZE_SMALL  1000
+#define FILE_SIZE        600000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             adfname;
+    char *             volname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void test_file_resize ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+    const unsigned blockSize = ( tdata->fstype & 1 ) ? 512 : 488;
+    const unsigned nDataBlocks = ( FILE_SIZE + blockSize - 1 ) / blockSize;
+
+    struct AdfVolume * const vol = adfVolMount ( tdata->device, 0,
+                                                 ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    const uint32_t freeBlocks = adfCountFreeBlocks ( vol );
+
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE_SMALL, buffer ),
+                        FILE_SIZE_SMALL );
+
+    // enlarging writes the new data blocks in runs
+    counting_start ( tdata->device );
+
+    counting_reset();
+    ck_assert_int_eq ( adfFileTruncate ( file, FILE_SIZE ), ADF_RC_OK );
+    ck_assert_uint_lt ( counting.writes, nDataBlocks / 8 );
+    counting_stop ( tdata->device );
+
+    ck_assert_uint_eq ( adfFileGetPos ( file ), FILE_SIZE );
+    ck_assert_uint_eq ( adfFileGetSize ( file ), FILE_SIZE );
+    ck_assert_uint_eq ( file->dataBlockMap.nItems, nDataBlocks );
+    ck_assert_uint_eq ( file->extBlockMap.nItems,
+                        ( nDataBlocks - 1 ) / ADF_MAX_DATABLK );
+
+    // writing at the new EOF continues the file
+    ck_assert_uint_eq ( adfFileWrite ( file, 100, buffer + FILE_SIZE ), 100 );
+    adfFileClose ( file );
+
+    memset ( buffer + FILE_SIZE_SMALL, 0, FILE_SIZE - FILE_SIZE_SMALL );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", buffer, FILE_SIZE + 100, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+
+    // OFS: data block headers
+    if ( adfVolIsOFS ( vol ) ) {
+        file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+        ck_assert_ptr_nonnull ( file );
+        ck_assert_int_eq ( adfFileSeekEOF ( file ), ADF_RC_OK );
+        const unsigned n = ( FILE_SIZE + 100 + blockSize - 1 ) / blockSize;
+        ck_assert_uint_eq ( file->dataBlockMap.nItems, n );
+        for ( unsigned i = 0 ; i < n ; i++ ) {
+            struct AdfOFSDataBlock block;
+            ck_assert_int_eq ( adfReadDataBlock (
+                                   vol, file->dataBlockMap.sectors[ i ], &block ),
+                               ADF_RC_OK );
+            ck_assert_uint_eq ( block.seqNum, i + 1 );
+            ck_assert_uint_eq ( block.dataSize, ( i < n - 1 ) ?
+                                blockSize : FILE_SIZE + 100 - i * blockSize );
+            ck_assert_uint_eq ( block.nextData, ( i < n - 1 ) ?
+                                (uint32_t) file->dataBlockMap.sectors[ i + 1 ] : 0 );
+        }
+        adfFileClose ( file );
+    }
+
+    // shrinking frees all the blocks (in runs)
+    const uint32_t freeBlocksSmall =
+        freeBlocks - 1 - ( FILE_SIZE_SMALL + blockSize - 1 ) / blockSize;
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileTruncate ( file, FILE_SIZE_SMALL ), ADF_RC_OK );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), freeBlocksSmall );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", buffer, FILE_SIZE_SMALL, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+
+    // enlarging beyond the free space fails (allocating nothing)
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileTruncate ( file, 2000000 ), ADF_RC_VOLFULL );
+    ck_assert_uint_eq ( adfFileGetSize ( file ), FILE_SIZE_SMALL );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), freeBlocksSmall );
+
+    // ... and an empty file can be enlarged too
+    file = adfFileOpen ( vol, "file2", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileTruncate ( file, ADF_MAX_DATABLK * blockSize ), ADF_RC_OK );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file2", buffer + FILE_SIZE_SMALL,
+                                           ADF_MAX_DATABLK * blockSize, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file2", 10 ), 0 );
+
+    adfVolUnMount ( vol );
+}
+
+
+/* shrink sizes (in data blocks, minus bytes) across and at ext. block boundaries */
+static const struct {
+    unsigned nDataBlocks,
+             bytesLess;
+} shrinkSizes[] = {
+    { 16 * ADF_MAX_DATABLK + 1, 0 },   // the first data block of the last ext.
+    { 15 * ADF_MAX_DATABLK,     0 },   // the last ext. full
+    { 13 * ADF_MAX_DATABLK,     1 },
+    { 10 * ADF_MAX_DATABLK + 1, 1 },
+    {  7 * ADF_MAX_DATABLK + 5, 0 },
+    {  3 * ADF_MAX_DATABLK,     0 },
+    {  2 * ADF_MAX_DATABLK + 1, 0 },
+    {  1 * ADF_MAX_DATABLK + 1, 0 },   // one ext. block with one data block
+    {  1 * ADF_MAX_DATABLK,     0 },   // no ext. blocks, the header full
+    {  1 * ADF_MAX_DATABLK - 1, 7 },
+    {  1,                       0 },
+    {  0,                       0 }
+};
+
+static void test_file_shrink ( test_data_t * const  tdata,
+                               const bool           reopen )
+{
+    unsigned char * const buffer = tdata->buffer;
+    const unsigned blockSize = ( tdata->fstype & 1 ) ? 512 : 488;
+
+    struct AdfVolume * const vol = adfVolMount ( tdata->device, 0,
+                                                 ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    const uint32_t freeBlocks = adfCountFreeBlocks ( vol );
+
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, buffer ), FILE_SIZE );
+
+    // shrinking step by step, across (and at) ext. block boundaries
+    for ( unsigned i = 0 ; i < sizeof shrinkSizes / sizeof shrinkSizes[ 0 ] ; i++ ) {
+        const unsigned nDataBlocks = shrinkSizes[ i ].nDataBlocks;
+        const uint32_t size = ( nDataBlocks > 0 ) ?
+            nDataBlocks * blockSize - shrinkSizes[ i ].bytesLess : 0;
+        ck_assert_uint_lt ( size, FILE_SIZE );
+
+        if ( reopen ) {
+            adfFileClose ( file );
+            file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+            ck_assert_ptr_nonnull ( file );
+        }
+        ck_assert_int_eq ( adfFileTruncate ( file, size ), ADF_RC_OK );
+        ck_assert_uint_eq ( adfFileGetPos ( file ), size );
+        ck_assert_uint_eq ( adfFileGetSize ( file ), size );
+        ck_assert_uint_eq ( adfCountFreeBlocks ( vol ),
+                            freeBlocks - adfFileSize2Blocks ( size, blockSize ) );
+
+        // the file stays consistent (and can be written at the new EOF)
+        adfFileClose ( file );
+        ck_assert_uint_eq ( verify_file_data ( vol, "file", buffer, size, 10 ), 0 );
+        ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+        file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+        ck_assert_ptr_nonnull ( file );
+        ck_assert_int_eq ( adfFileSeek ( file, size ), ADF_RC_OK );
+        if ( i == 4 ) {
+            // growing back and shrinking again
+            ck_assert_uint_eq ( adfFileWrite ( file, 3 * ADF_MAX_DATABLK * blockSize,
+                                               buffer + size ),
+                                3 * ADF_MAX_DATABLK * blockSize );
+            ck_assert_int_eq ( adfFileTruncate ( file, size ), ADF_RC_OK );
+        }
+    }
+    adfFileClose ( file );
+    ck_assert_uint_eq ( adfCountFreeBlocks ( vol ), freeBlocks - 1 );
+
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_file_resize_ofs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_resize_ofs.adf",
+        .volname = "Test_file_resize_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_resize ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_resize_ffs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_resize_ffs.adf",
+        .volname = "Test_file_resize_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_resize ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_shrink_ofs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_shrink_ofs.adf",
+        .volname = "Test_file_shrink_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_shrink ( &test_data, false );
+    teardown ( &test_data );
+    setup ( &test_data );
+    test_file_shrink ( &test_data, true );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_shrink_ffs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_shrink_ffs.adf",
+        .volname = "Test_file_shrink_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_shrink ( &test_data, false );
+    teardown ( &test_data );
+    setup ( &test_data );
+    test_file_shrink ( &test_data, true );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_resize_ofs" );
+    tcase_add_test ( tc, test_file_resize_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_resize_ffs" );
+    tcase_add_test ( tc, test_file_resize_ffs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_shrink_ofs" );
+    tcase_add_test ( tc, test_file_shrink_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_shrink_ffs" );
+    tcase_add_test ( tc, test_file_shrink_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", tdata->adfname, 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, tdata->volname, tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume: %s\n",
+                  tdata->volname );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE + 100 );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE + 100 );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
@@ -0,0 +1,264 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define FILE_SIZE  100000
+#define PATCH_LEN  16
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+/* patch PATCH_LEN bytes in nPatches places (every 3rd data block, some
+   crossing block boundaries), checking that the data patched is read back
+   (through the same handle) */
+static void patch_blocks ( struct AdfFile * const  file,
+                           unsigned char * const   expected,
+                           const unsigned          nPatches )
+{
+    const unsigned blockSize = file->volume->datablockSize;
+    unsigned char patch[ PATCH_LEN ],
+                  readBack[ PATCH_LEN ];
+
+    uint32_t prev = 0;
+    for ( unsigned i = 0 ; i < nPatches ; i++ ) {
+        const uint32_t offset = ( 3 * i + 1 ) * blockSize - PATCH_LEN / 2 * ( i % 2 );
+        pattern_random ( patch, PATCH_LEN );
+        memcpy ( expected + offset, patch, PATCH_LEN );
+
+        ck_assert_int_eq ( adfFileSeek ( file, offset ), ADF_RC_OK );
+        ck_assert_uint_eq ( adfFileWrite ( file, PATCH_LEN, patch ), PATCH_LEN );
+
+        // the previous patch (in another block)
+        if ( i > 0 ) {
+            ck_assert_int_eq ( adfFileSeek ( file, prev ), ADF_RC_OK );
+            ck_assert_uint_eq ( adfFileRead ( file, PATCH_LEN, readBack ), PATCH_LEN );
+            ck_assert_mem_eq ( readBack, expected + prev, PATCH_LEN );
+        }
+        prev = offset;
+    }
+    ck_assert_uint_eq ( adfFileGetSize ( file ), FILE_SIZE );
+}
+
+
+/* OFS: the data size and the sequence number in the headers
+   of all data blocks (also of those overwritten) */
+static void check_ofs_data_blocks ( struct AdfVolume * const  vol,
+                                    const char * const        name,
+                                    const uint32_t            size )
+{
+    const unsigned blockSize = vol->datablockSize;
+    struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileSeek ( file, size - 1 ), ADF_RC_OK );   // maps all blocks
+
+    const unsigned nDataBlocks = ( size + blockSize - 1 ) / blockSize;
+    ck_assert_uint_eq ( file->dataBlockMap.nItems, nDataBlocks );
+    for ( unsigned i = 0 ; i < nDataBlocks ; i++ ) {
+        struct AdfOFSDataBlock data;
+        ck_assert_int_eq ( adfReadDataBlock ( vol, file->dataBlockMap.sectors[ i ],
+                                              &data ), ADF_RC_OK );
+        ck_assert_uint_eq ( data.seqNum, i + 1 );
+        ck_assert_uint_eq ( data.dataSize, ( i < nDataBlocks - 1 ) ?
+                            blockSize : size - i * blockSize );
+    }
+    adfFileClose ( file );
+}
+
+
+static void test_file_rw ( test_data_t * const tdata )
+{
+    struct AdfDevice * const dev = tdata->device;
+    struct AdfVolume * const vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, tdata->buffer ), FILE_SIZE );
+    adfFileClose ( file );
+
+    unsigned char * const expected = malloc ( FILE_SIZE );
+    ck_assert_ptr_nonnull ( expected );
+    memcpy ( expected, tdata->buffer, FILE_SIZE );
+
+    // only reading - nothing is written (the header too)
+    counting_start ( dev );
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( file );
+    unsigned char readBack[ 1000 ];
+    ck_assert_uint_eq ( adfFileRead ( file, sizeof ( readBack ), readBack ),
+                        sizeof ( readBack ) );
+    ck_assert_mem_eq ( readBack, expected, sizeof ( readBack ) );
+    adfFileClose ( file );
+    counting_stop ( dev );
+    ck_assert_uint_eq ( counting.blocksWritten, 0 );
+
+    // patching: the changed blocks are written only on flush
+    // (every other patch changes 2 blocks)
+    const unsigned nPatches = ADF_FILE_DIRTY_MAX / 2;
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( file );
+    counting_start ( dev );
+    patch_blocks ( file, expected, nPatches );
+    ck_assert_uint_eq ( counting.blocksWritten, 0 );
+
+    // ... but are seen by positional reads
+    unsigned char * const pread = malloc ( FILE_SIZE );
+    ck_assert_ptr_nonnull ( pread );
+    const struct AdfIoVec iov = { pread, FILE_SIZE };
+    ck_assert_uint_eq ( adfFilePread ( file, 0, &iov, 1 ), FILE_SIZE );
+    ck_assert_mem_eq ( pread, expected, FILE_SIZE );
+    free ( pread );
+
+    ck_assert_int_eq ( adfFileFlush ( file ), ADF_RC_OK );
+    counting_stop ( dev );
+    ck_assert_uint_ge ( counting.blocksWritten, nPatches * 3 / 2 + 1 );   // + header
+    adfFileClose ( file );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", expected, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+
+    // more changed blocks than kept by the handle
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( file );
+    counting_start ( dev );
+    patch_blocks ( file, expected, 2 * ADF_FILE_DIRTY_MAX + 5 );
+    counting_stop ( dev );
+    ck_assert_uint_gt ( counting.blocksWritten, 0 );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", expected, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+    if ( adfVolIsOFS ( vol ) )
+        check_ofs_data_blocks ( vol, "file", FILE_SIZE );
+
+    // changed blocks beyond the new EOF are not written
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( file );
+    patch_blocks ( file, expected, 10 );
+    ck_assert_int_eq ( adfFileTruncate ( file, 6000 ), ADF_RC_OK );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", expected, 6000, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+
+    free ( expected );
+
+    // a new file opened for reading and writing
+    file = adfFileOpen ( vol, "new", ADF_FILE_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileGetSize ( file ), 0 );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, tdata->buffer ), FILE_SIZE );
+    ck_assert_int_eq ( adfFileSeek ( file, 0 ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileRead ( file, sizeof ( readBack ), readBack ),
+                        sizeof ( readBack ) );
+    ck_assert_mem_eq ( readBack, tdata->buffer, sizeof ( readBack ) );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( verify_file_data ( vol, "new", tdata->buffer, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "new", 10 ), 0 );
+
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_file_rw_ofs )
+{
+    test_data_t test_data = {
+        .fstype = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_rw ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_rw_ffs )
+{
+    test_data_t test_data = {
+        .fstype = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_rw ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_rw_ofs" );
+    tcase_add_test ( tc, test_file_rw_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_rw_ffs" );
+    tcase_add_test ( tc, test_file_rw_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", "test_file_rw.adf", 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, "Test_file_rw", tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume\n" );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
@@ -0,0 +1,235 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+/* a file using 8 (FFS) or 9 (OFS) ext. blocks */
+#define FILE_SIZE  300000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    char *             adfname;
+    char *             volname;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+static void check_read_at ( struct AdfFile * const      file,
+                            const unsigned              pos,
+                            const unsigned char * const expected )
+{
+    unsigned char data[ 100 ];
+    const unsigned len = ( FILE_SIZE - pos < sizeof ( data ) ) ?
+        FILE_SIZE - pos : sizeof ( data );
+
+    ck_assert_int_eq ( adfFileSeek ( file, pos ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileGetPos ( file ), pos );
+    ck_assert_uint_eq ( adfFileRead ( file, len, data ), len );
+    ck_assert_mem_eq ( data, expected + pos, len );
+}
+
+
+static void test_file_seek_random ( test_data_t * const tdata )
+{
+    unsigned char * const buffer = tdata->buffer;
+    const unsigned blockSize = ( tdata->fstype & 1 ) ? 512 : 488;
+
+    struct AdfVolume * vol = adfVolMount ( tdata->device, 0,
+                                           ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    struct AdfFile * file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, buffer ), FILE_SIZE );
+
+    // all blocks created are mapped
+    const unsigned nDataBlocks = ( FILE_SIZE + blockSize - 1 ) / blockSize;
+    ck_assert_uint_eq ( file->dataBlockMap.nItems, nDataBlocks );
+    ck_assert_uint_eq ( file->extBlockMap.nItems,
+                        ( nDataBlocks - 1 ) / ADF_MAX_DATABLK );
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+
+    // count device reads
+    counting_start ( tdata->device );
+
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+
+    // seeking to the end maps the whole file...
+    const unsigned nExtBlocks = ( nDataBlocks - 1 ) / ADF_MAX_DATABLK;
+    counting_reset();
+    check_read_at ( file, FILE_SIZE - 1, buffer );
+    ck_assert_uint_eq ( counting.reads, nExtBlocks + 1 );   // ext. blocks + a data block
+    ck_assert_uint_eq ( file->dataBlockMap.nItems, nDataBlocks );
+    ck_assert_uint_eq ( file->extBlockMap.nItems, nExtBlocks );
+
+    // ... so any other seek reads at most a data and an ext. block
+    srand ( 1 );
+    for ( unsigned i = 0 ; i < 500 ; i++ ) {
+        const unsigned pos = (unsigned) rand() % FILE_SIZE;
+        counting_reset();
+        ck_assert_int_eq ( adfFileSeek ( file, pos ), ADF_RC_OK );
+        ck_assert_uint_le ( counting.reads, 2 );
+        check_read_at ( file, pos, buffer );
+    }
+
+    // seeks within the same ext. block read only data blocks
+    check_read_at ( file, 100 * blockSize, buffer );
+    counting_reset();
+    ck_assert_int_eq ( adfFileSeek ( file, 130 * blockSize + 10 ), ADF_RC_OK );
+    ck_assert_uint_eq ( counting.reads, 1 );
+    check_read_at ( file, 130 * blockSize + 10, buffer );
+
+    adfFileClose ( file );
+    adfVolUnMount ( vol );
+    counting_stop ( tdata->device );
+
+    // overwrite at random positions, truncate and extend
+    vol = adfVolMount ( tdata->device, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+
+    for ( unsigned i = 0 ; i < 100 ; i++ ) {
+        const unsigned pos = (unsigned) rand() % ( FILE_SIZE - 1000 );
+        for ( unsigned j = 0 ; j < 1000 ; j++ )
+            buffer[ pos + j ] = (unsigned char) ( buffer[ pos + j ] + 1 );
+        ck_assert_int_eq ( adfFileSeek ( file, pos ), ADF_RC_OK );
+        ck_assert_uint_eq ( adfFileWrite ( file, 1000, buffer + pos ), 1000 );
+    }
+
+    const unsigned sizeTruncated = 100 * blockSize + 7;
+    ck_assert_int_eq ( adfFileTruncate ( file, sizeTruncated ), ADF_RC_OK );
+    ck_assert_uint_eq ( file->dataBlockMap.nItems, 101 );
+    ck_assert_uint_eq ( file->extBlockMap.nItems, 1 );
+
+    ck_assert_int_eq ( adfFileSeekEOF ( file ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE - sizeTruncated,
+                                       buffer + sizeTruncated ),
+                        FILE_SIZE - sizeTruncated );
+    ck_assert_uint_eq ( file->dataBlockMap.nItems, nDataBlocks );
+    ck_assert_uint_eq ( file->extBlockMap.nItems, nExtBlocks );
+    adfFileClose ( file );
+
+    ck_assert_uint_eq ( verify_file_data ( vol, "file", buffer, FILE_SIZE, 10 ), 0 );
+    ck_assert_uint_eq ( validate_file_metadata ( vol, "file", 10 ), 0 );
+
+    file = adfFileOpen ( vol, "file", ADF_FILE_MODE_READ );
+    ck_assert_ptr_nonnull ( file );
+    for ( unsigned i = 0 ; i < 200 ; i++ )
+        check_read_at ( file, (unsigned) rand() % FILE_SIZE, buffer );
+    adfFileClose ( file );
+
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_file_seek_random_ofs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_seek_random_ofs.adf",
+        .volname = "Test_file_seek_random_ofs",
+        .fstype  = 0          // OFS
+    };
+    setup ( &test_data );
+    test_file_seek_random ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_file_seek_random_ffs )
+{
+    test_data_t test_data = {
+        .adfname = "test_file_seek_random_ffs.adf",
+        .volname = "Test_file_seek_random_ffs",
+        .fstype  = 1          // FFS
+    };
+    setup ( &test_data );
+    test_file_seek_random ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_seek_random_ofs" );
+    tcase_add_test ( tc, test_file_seek_random_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_file_seek_random_ffs" );
+    tcase_add_test ( tc, test_file_seek_random_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", tdata->adfname, 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, tdata->volname, tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume: %s\n",
+                  tdata->volname );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
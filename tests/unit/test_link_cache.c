@@ -0,0 +1,215 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adflib.h"
+#include "test_util.h"
+
+
+#define FILE_SIZE  5000
+
+
+typedef struct test_data_s {
+    struct AdfDevice * device;
+    uint8_t            fstype;   // 0 - OFS, 1 - FFS
+    unsigned char *    buffer;
+} test_data_t;
+
+
+void setup ( test_data_t * const tdata );
+void teardown ( test_data_t * const tdata );
+
+
+START_TEST ( test_check_framework )
+{
+    ck_assert ( 1 );
+}
+END_TEST
+
+
+/* create a hard link (in the root directory) to the entry realSect */
+static void create_link ( struct AdfVolume * const  vol,
+                          const char * const        name,
+                          const ADF_SECTNUM         realSect )
+{
+    struct AdfEntryBlock parent;
+    ck_assert_int_eq ( adfReadEntryBlock ( vol, vol->rootBlock, &parent ),
+                       ADF_RC_OK );
+
+    const ADF_SECTNUM nSect = adfCreateEntry ( vol, &parent, name, -1 );
+    ck_assert_int_ne ( nSect, -1 );
+
+    struct AdfEntryBlock link;
+    memset ( &link, 0, sizeof link );
+    link.type      = ADF_T_HEADER;
+    link.headerKey = nSect;
+    link.secType   = ADF_ST_LFILE;
+    link.realEntry = realSect;
+    link.parent    = vol->rootBlock;
+    link.nameLen   = (uint8_t) strlen ( name );
+    memcpy ( link.name, name, link.nameLen );
+    ck_assert_int_eq ( adfWriteEntryBlock ( vol, nSect, &link ), ADF_RC_OK );
+    ck_assert_int_eq ( adfUpdateBitmap ( vol ), ADF_RC_OK );
+}
+
+
+static unsigned open_link_reads ( struct AdfVolume * const  vol,
+                                  const char * const        name,
+                                  const uint32_t            size )
+{
+    counting_start ( vol->dev );
+    struct AdfFile * const file = adfFileOpen ( vol, name, ADF_FILE_MODE_READ );
+    counting_stop ( vol->dev );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileGetSize ( file ), size );
+    adfFileClose ( file );
+    return counting.blocksRead;
+}
+
+
+static void test_link_cache ( test_data_t * const tdata )
+{
+    struct AdfDevice * const dev = tdata->device;
+    struct AdfVolume * vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READWRITE );
+    ck_assert_ptr_nonnull ( vol );
+
+    struct AdfFile * file = adfFileOpen ( vol, "target", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_uint_eq ( adfFileWrite ( file, FILE_SIZE, tdata->buffer ), FILE_SIZE );
+    adfFileClose ( file );
+
+    struct AdfEntryBlock entry;
+    const ADF_SECTNUM targetSect = adfGetEntryBlock ( vol, vol->rootBlock,
+                                                      "target", &entry );
+    ck_assert_int_ne ( targetSect, -1 );
+    create_link ( vol, "link1", targetSect );
+    create_link ( vol, "link2", targetSect );
+
+    // the second open through a link does not read the real entry
+    const unsigned nReadsFirst = open_link_reads ( vol, "link1", FILE_SIZE );
+    ck_assert_uint_eq ( open_link_reads ( vol, "link1", FILE_SIZE ),
+                        nReadsFirst - 1 );
+
+    // writing the real entry drops it from the cache
+    file = adfFileOpen ( vol, "target", ADF_FILE_MODE_WRITE );
+    ck_assert_ptr_nonnull ( file );
+    ck_assert_int_eq ( adfFileSeekEOF ( file ), ADF_RC_OK );
+    ck_assert_uint_eq ( adfFileWrite ( file, 100, tdata->buffer ), 100 );
+    adfFileClose ( file );
+    ck_assert_uint_eq ( open_link_reads ( vol, "link1", FILE_SIZE + 100 ),
+                        nReadsFirst );
+
+    ck_assert_uint_eq ( verify_file_data ( vol, "link2", tdata->buffer,
+                                           FILE_SIZE, 10 ), 0 );
+
+    // (an empty cache)
+    adfVolUnMount ( vol );
+    vol = adfVolMount ( dev, 0, ADF_ACCESS_MODE_READONLY );
+    ck_assert_ptr_nonnull ( vol );
+
+    // resolving links of a listing reads the real entry (once)
+    struct AdfList * const list = adfGetDirEnt ( vol, vol->rootBlock );
+    ck_assert_ptr_nonnull ( list );
+    counting.watchedSect = (uint32_t) targetSect;
+    counting_start ( dev );
+    ck_assert_int_eq ( adfDirResolveLinks ( vol, list ), ADF_RC_OK );
+    counting_stop ( dev );
+    ck_assert_uint_eq ( counting.blocksRead, 1 );
+    ck_assert_uint_eq ( counting.watchedReads, 1 );
+    adfFreeDirList ( list );
+
+    // ... so opening the links does not read it
+    open_link_reads ( vol, "link1", FILE_SIZE + 100 );
+    ck_assert_uint_eq ( counting.watchedReads, 0 );
+    open_link_reads ( vol, "link2", FILE_SIZE + 100 );
+    ck_assert_uint_eq ( counting.watchedReads, 0 );
+
+    adfVolUnMount ( vol );
+}
+
+
+START_TEST ( test_link_cache_ofs )
+{
+    test_data_t test_data = {
+        .fstype = 0          // OFS
+    };
+    setup ( &test_data );
+    test_link_cache ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+START_TEST ( test_link_cache_ffs )
+{
+    test_data_t test_data = {
+        .fstype = 1          // FFS
+    };
+    setup ( &test_data );
+    test_link_cache ( &test_data );
+    teardown ( &test_data );
+}
+END_TEST
+
+
+Suite * adflib_suite ( void )
+{
+    Suite * s = suite_create ( "adflib" );
+
+    TCase * tc = tcase_create ( "check framework" );
+    tcase_add_test ( tc, test_check_framework );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_link_cache_ofs" );
+    tcase_add_test ( tc, test_link_cache_ofs );
+    suite_add_tcase ( s, tc );
+
+    tc = tcase_create ( "adflib test_link_cache_ffs" );
+    tcase_add_test ( tc, test_link_cache_ffs );
+    suite_add_tcase ( s, tc );
+
+    return s;
+}
+
+
+int main ( void )
+{
+    Suite * s = adflib_suite();
+    SRunner * sr = srunner_create ( s );
+
+    adfLibInit();
+    srunner_run_all ( sr, CK_VERBOSE );
+    adfLibCleanUp();
+
+    int number_failed = srunner_ntests_failed ( sr );
+    srunner_free ( sr );
+    return ( number_failed == 0 ) ?
+        EXIT_SUCCESS :
+        EXIT_FAILURE;
+}
+
+
+void setup ( test_data_t * const tdata )
+{
+    tdata->device = adfDevCreate ( "ramdisk", "test_link_cache.adf", 80, 2, 11 );
+    if ( ! tdata->device ) {
+        exit(1);
+    }
+    if ( adfCreateFlop ( tdata->device, "Test_link_cache", tdata->fstype ) != ADF_RC_OK ) {
+        fprintf ( stderr, "adfCreateFlop error creating volume\n" );
+        exit(1);
+    }
+
+    tdata->buffer = malloc ( FILE_SIZE );
+    if ( ! tdata->buffer )
+        exit(1);
+    pattern_random ( tdata->buffer, FILE_SIZE );
+}
+
+
+void teardown ( test_data_t * const tdata )
+{
+    free ( tdata->buffer );
+    adfDevUnMount ( tdata->device );
+    adfDevClose ( tdata->device );
+}
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "test_util.h"
 #include "adf_file_util.h"
@@ -217,3 +218,70 @@ unsigned datablock2posInExtBlk ( unsigned datablock_idx )
         return 0;
     return ( datablock_idx - ADF_MAX_DATABLK ) % ( ADF_MAX_DATABLK );
 }
+
+
+// counting driver calls
+
+counting_t counting;
+
+static const struct AdfDeviceDriver * drvOrig = NULL;
+static struct AdfDeviceDriver         drvCounting;
+
+static ADF_RETCODE countingReadSectors ( const struct AdfDevice * const dev,
+                                         const uint32_t                 block,
+                                         const uint32_t                 lenBlocks,
+                                         uint8_t * const                buf )
+{
+    counting.reads++;
+    counting.blocksRead += lenBlocks;
+    if ( block <= counting.watchedSect && counting.watchedSect < block + lenBlocks )
+        counting.watchedReads++;
+    return drvOrig->readSectors ( dev, block, lenBlocks, buf );
+}
+
+static ADF_RETCODE countingWriteSectors ( const struct AdfDevice * const dev,
+                                          const uint32_t                 block,
+                                          const uint32_t                 lenBlocks,
+                                          const uint8_t * const          buf )
+{
+    if ( counting.writes < COUNTING_WRITE_LOG ) {
+        counting.writeBlock[ counting.writes ] = block;
+        counting.writeLen[ counting.writes ]   = lenBlocks;
+    }
+    counting.writes++;
+    counting.blocksWritten += lenBlocks;
+    if ( block <= counting.watchedSect && counting.watchedSect < block + lenBlocks )
+        counting.watchedWrites++;
+    if ( counting.failWrites )
+        return ADF_RC_ERROR;
+    return drvOrig->writeSectors ( dev, block, lenBlocks, buf );
+}
+
+static ADF_RETCODE countingSync ( const struct AdfDevice * const dev )
+{
+    counting.syncs++;
+    return ( drvOrig->sync != NULL ) ? drvOrig->sync ( dev ) : ADF_RC_OK;
+}
+
+void counting_start ( struct AdfDevice * const dev )
+{
+    drvOrig = dev->drv;
+    memcpy ( &drvCounting, drvOrig, sizeof ( struct AdfDeviceDriver ) );
+    drvCounting.readSectors  = countingReadSectors;
+    drvCounting.writeSectors = countingWriteSectors;
+    drvCounting.sync         = countingSync;
+    dev->drv = &drvCounting;
+    counting_reset();
+}
+
+void counting_stop ( struct AdfDevice * const dev )
+{
+    dev->drv = drvOrig;
+}
+
+void counting_reset ( void )
+{
+    const uint32_t watchedSect = counting.watchedSect;
+    memset ( &counting, 0, sizeof ( counting ) );
+    counting.watchedSect = watchedSect;
+}
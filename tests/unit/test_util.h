@@ -35,4 +35,29 @@ unsigned filesize2blocks ( unsigned fsize,
 
 unsigned datablock2posInExtBlk ( unsigned datablock_idx );
 
+
+// counting the driver calls of a device: its driver is replaced (until
+// counting_stop) with a copy calling the original one and counting
+#define COUNTING_WRITE_LOG  256
+
+typedef struct counting_s {
+    unsigned reads,            // driver calls
+             writes,
+             syncs,
+             blocksRead,
+             blocksWritten,
+             watchedReads,     // calls reading / writing watchedSect
+             watchedWrites;
+    uint32_t watchedSect;
+    uint32_t writeBlock[ COUNTING_WRITE_LOG ],   // the first writes (calls)
+             writeLen[ COUNTING_WRITE_LOG ];
+    bool     failWrites;       // writes fail (counted, not done)
+} counting_t;
+
+extern counting_t counting;
+
+void counting_start ( struct AdfDevice * const dev );   // counters reset
+void counting_stop ( struct AdfDevice * const dev );
+void counting_reset ( void );                          // (watchedSect kept)
+
 #endif